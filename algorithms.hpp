@@ -1,13 +1,19 @@
 ﻿#pragma once
 
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
 #include <optional>
 #include "vector.hpp"
 #include "line.hpp"
 #include "segment.hpp"
 #include "polygon.hpp"
+#include "arena.hpp"
 #include <vector>    
 #include <algorithm>  
 #include "ray.hpp"
+#include "instrumentation.hpp"
 
 namespace geom {
 
@@ -33,36 +39,6 @@ namespace geom {
         std::optional<Point<2, T>> point;
     };
 
-    template<typename T>
-    T cross_product(const Vector<2, T>& a, const Vector<2, T>& b) {
-        return a[0] * b[1] - a[1] * b[0];
-    }
-
-    template<typename T>
-    IntersectionResult2D<T> intersection(const Line<2, T>& l1, const Line<2, T>& l2) {
-        using Result = IntersectionResult2D<T>;
-
-        const auto& p1 = l1.origin();
-        const auto& dir1 = l1.direction();
-        const auto& p2 = l2.origin();
-        const auto& dir2 = l2.direction();
-
-        const T dir_cross = cross_product(dir1, dir2);
-        const Vector<2, T> p_diff = p2 - p1;
-
-        if (std::abs(dir_cross) < Coord<T>::Epsilon) {
-            if (std::abs(cross_product(p_diff, dir1)) < Coord<T>::Epsilon) {
-                return { Result::Status::COINCIDENT, std::nullopt };
-            }
-            else {
-                return { Result::Status::PARALLEL, std::nullopt };
-            }
-        }
-        const T t = cross_product(p_diff, dir2) / dir_cross;
-        const Point<2, T> intersection_point = p1 + dir1 * t;
-        return { Result::Status::INTERSECTING, intersection_point };
-    }
-
     template<typename T>
     struct SegmentIntersectionResult2D {
         enum class Status { NO_INTERSECTION, INTERSECTING, OVERLAPPING };
@@ -72,95 +48,356 @@ namespace geom {
         std::optional<Segment<2, T>> segment;
     };
 
+    // One row of a batch intersection: the status byte (the scalar Status value) and the
+    // parameters of the hit on both primitives. A segment is p1 + t * (p2 - p1) with t in [0, 1];
+    // lines and rays are origin + t * direction. For OVERLAPPING rows t and u are where the overlap
+    // starts and ends on the first primitive; u is infinite when a ray overlaps a line.
     template<typename T>
-    SegmentIntersectionResult2D<T> intersection(const Segment<2, T>& s1, const Segment<2, T>& s2) {
-        using Result = SegmentIntersectionResult2D<T>;
+    struct IntersectionRow {
+        uint8_t status;
+        T t;
+        T u;
+    };
 
-        Line<2, T> l1 = Line<2, T>::from_points(s1.p1(), s1.p2());
-        Line<2, T> l2 = Line<2, T>::from_points(s2.p1(), s2.p2());
+    // Caller-owned structure-of-arrays output of the batch intersections. status is required; any
+    // other column may be null to skip it. t, u, x and y are written only for rows that intersect
+    // or overlap; x and y get the intersection point or the start of the overlap.
+    template<typename T>
+    struct IntersectionOutput {
+        uint8_t* status = nullptr;
+        T* t = nullptr;
+        T* u = nullptr;
+        T* x = nullptr;
+        T* y = nullptr;
+    };
 
-        auto line_isect = intersection(l1, l2);
+    // Storage for IntersectionOutput when the caller has none of its own.
+    template<typename T>
+    struct IntersectionBuffers {
+        std::vector<uint8_t> status;
+        std::vector<T> t, u, x, y;
+
+        IntersectionOutput<T> resize(size_t count, bool with_points = true) {
+            status.resize(count);
+            t.resize(count);
+            u.resize(count);
+            x.resize(with_points ? count : 0);
+            y.resize(with_points ? count : 0);
+            return { status.data(), t.data(), u.data(), with_points ? x.data() : nullptr, with_points ? y.data() : nullptr };
+        }
+    };
 
-        switch (line_isect.status) {
-        case IntersectionResult2D<T>::Status::PARALLEL: {
-            return { Result::Status::NO_INTERSECTION, std::nullopt, std::nullopt };
+    template<typename E1, typename E2, std::enable_if_t<E1::dimension == 2 && E2::dimension == 2, int> = 0>
+    typename E1::value_type cross_product(const VectorExpression<E1>& a, const VectorExpression<E2>& b) {
+        return a.self().eval(0) * b.self().eval(1) - a.self().eval(1) * b.self().eval(0);
+    }
+
+    template<typename E1, typename E2, std::enable_if_t<E1::dimension == 3 && E2::dimension == 3, int> = 0>
+    Vector<3, typename E1::value_type> cross_product(const VectorExpression<E1>& a, const VectorExpression<E2>& b) {
+        const Vector<3, typename E1::value_type> u(a), v(b);
+        return Vector<3, typename E1::value_type>(u[1].value * v[2].value - u[2].value * v[1].value,
+                                                  u[2].value * v[0].value - u[0].value * v[2].value,
+                                                  u[0].value * v[1].value - u[1].value * v[0].value);
+    }
+
+    namespace detail {
+
+        template<typename Status>
+        constexpr uint8_t status_byte(Status status) { return static_cast<uint8_t>(status); }
+
+        // Lines p1 + t * d1 and p2 + u * d2; t and u are only meaningful when INTERSECTING.
+        template<typename T>
+        IntersectionRow<T> intersect_lines(const Point<2, T>& p1, const Vector<2, T>& d1, const Point<2, T>& p2, const Vector<2, T>& d2) {
+            using Status = typename IntersectionResult2D<T>::Status;
+            const T dir_cross = cross_product(d1, d2);
+            const Vector<2, T> p_diff = lazy(p2) - lazy(p1);
+
+            if (std::abs(dir_cross) < Coord<T>::Epsilon) {
+                const bool coincident = std::abs(cross_product(p_diff, d1)) < Coord<T>::Epsilon;
+                return { status_byte(coincident ? Status::COINCIDENT : Status::PARALLEL), T(0), T(0) };
+            }
+            return { status_byte(Status::INTERSECTING), cross_product(p_diff, d2) / dir_cross, cross_product(p_diff, d1) / dir_cross };
         }
 
-        case IntersectionResult2D<T>::Status::INTERSECTING: {
-            Point<2, T> p = line_isect.point.value();
-            if (contains(p, s1) && contains(p, s2)) {
-                return { Result::Status::INTERSECTING, p, std::nullopt };
+        // Overlap [lo, hi] along a segment of length len, as a segment row: nothing, a touching
+        // point or an overlap.
+        template<typename T>
+        IntersectionRow<T> overlap_row(T lo, T hi, T len) {
+            using Status = typename SegmentIntersectionResult2D<T>::Status;
+            if (hi < lo - Coord<T>::Epsilon) {
+                return { status_byte(Status::NO_INTERSECTION), T(0), T(0) };
             }
-            else {
-                return { Result::Status::NO_INTERSECTION, std::nullopt, std::nullopt };
+            if (hi - lo < Coord<T>::Epsilon) {
+                return { status_byte(Status::INTERSECTING), lo / len, lo / len };
             }
+            return { status_byte(Status::OVERLAPPING), lo / len, hi / len };
         }
 
-        case IntersectionResult2D<T>::Status::COINCIDENT: {
-            auto p1 = s1.p1(), p2 = s1.p2();
-            auto q1 = s2.p1(), q2 = s2.p2();
-            if (p1[0] > p2[0]) std::swap(p1, p2);
-            if (q1[0] > q2[0]) std::swap(q1, q2);
+        template<typename T>
+        IntersectionRow<T> intersection_row(const Line<2, T>& l1, const Line<2, T>& l2) {
+            using Status = typename IntersectionResult2D<T>::Status;
+            GEOM_COUNT(LINE_INTERSECTION_CALLS);
+            const IntersectionRow<T> row = intersect_lines(l1.origin(), l1.direction(), l2.origin(), l2.direction());
+            if (row.status == status_byte(Status::COINCIDENT)) GEOM_COUNT(LINE_INTERSECTION_COINCIDENT);
+            if (row.status == status_byte(Status::PARALLEL)) GEOM_COUNT(LINE_INTERSECTION_PARALLEL);
+            return row;
+        }
 
-            if (p1[0] <= q2[0] && q1[0] <= p2[0]) {
-                Point<2, T> overlap_start = (p1[0] > q1[0]) ? p1 : q1;
-                Point<2, T> overlap_end = (p2[0] < q2[0]) ? p2 : q2;
+        template<typename T>
+        IntersectionRow<T> intersection_row(const Segment<2, T>& s1, const Segment<2, T>& s2) {
+            using Status = typename SegmentIntersectionResult2D<T>::Status;
+            using LineStatus = typename IntersectionResult2D<T>::Status;
+            GEOM_COUNT(SEGMENT_INTERSECTION_CALLS);
+            const Vector<2, T> e1 = lazy(s1.p2()) - lazy(s1.p1()), e2 = lazy(s2.p2()) - lazy(s2.p1());
+            const T len1 = e1.length(), len2 = e2.length();
+            const Vector<2, T> d1 = lazy(e1) * (T(1) / len1), d2 = lazy(e2) * (T(1) / len2);
+
+            const IntersectionRow<T> line = intersect_lines(s1.p1(), d1, s2.p1(), d2);
+            if (line.status == status_byte(LineStatus::PARALLEL)) {
+                return { status_byte(Status::NO_INTERSECTION), T(0), T(0) };
+            }
+            if (line.status == status_byte(LineStatus::INTERSECTING)) {
+                const T t = line.t;
+                const T u = dot_product(lazy(s1.p1()) + lazy(d1) * t - lazy(s2.p1()), d2);
+                if (t > -Coord<T>::Epsilon && t < len1 + Coord<T>::Epsilon && u > -Coord<T>::Epsilon && u < len2 + Coord<T>::Epsilon) {
+                    return { status_byte(Status::INTERSECTING), t / len1, u / len2 };
+                }
+                return { status_byte(Status::NO_INTERSECTION), T(0), T(0) };
+            }
+
+            GEOM_COUNT(SEGMENT_INTERSECTION_COINCIDENT);
+            const T b0 = dot_product(lazy(s2.p1()) - lazy(s1.p1()), d1), b1 = dot_product(lazy(s2.p2()) - lazy(s1.p1()), d1);
+            IntersectionRow<T> row = overlap_row(std::max(T(0), std::min(b0, b1)), std::min(len1, std::max(b0, b1)), len1);
+            if (row.status == status_byte(Status::INTERSECTING)) {
+                row.u = dot_product(lazy(s1.p1()) + lazy(e1) * row.t - lazy(s2.p1()), d2) / len2;
+            }
+            return row;
+        }
+
+        template<typename T>
+        IntersectionRow<T> intersection_row(const Line<2, T>& line, const Ray<2, T>& ray) {
+            using Status = typename SegmentIntersectionResult2D<T>::Status;
+            using LineStatus = typename IntersectionResult2D<T>::Status;
+            const IntersectionRow<T> row = intersect_lines(line.origin(), line.direction(), ray.origin(), ray.direction());
+            if (row.status == status_byte(LineStatus::PARALLEL)) {
+                return { status_byte(Status::NO_INTERSECTION), T(0), T(0) };
+            }
+            if (row.status == status_byte(LineStatus::COINCIDENT)) {
+                const T start = dot_product(lazy(ray.origin()) - lazy(line.origin()), line.direction());
+                const T inf = std::numeric_limits<T>::infinity();
+                return { status_byte(Status::OVERLAPPING), start, dot_product(ray.direction(), line.direction()) > 0 ? inf : -inf };
+            }
+            const T u = dot_product(lazy(line.origin()) + lazy(line.direction()) * row.t - lazy(ray.origin()), ray.direction());
+            if (u >= 0) {
+                return { status_byte(Status::INTERSECTING), row.t, u };
+            }
+            return { status_byte(Status::NO_INTERSECTION), T(0), T(0) };
+        }
 
-                if ((overlap_start - overlap_end).length_sq() < Coord<T>::Epsilon) {
-                    return { Result::Status::INTERSECTING, overlap_start, std::nullopt };
+        template<typename T>
+        IntersectionRow<T> intersection_row(const Segment<2, T>& segment, const Ray<2, T>& ray) {
+            using Status = typename SegmentIntersectionResult2D<T>::Status;
+            using LineStatus = typename IntersectionResult2D<T>::Status;
+            const Vector<2, T> e = lazy(segment.p2()) - lazy(segment.p1());
+            const T len = e.length();
+            const Vector<2, T> d = lazy(e) * (T(1) / len);
+
+            const IntersectionRow<T> line = intersect_lines(segment.p1(), d, ray.origin(), ray.direction());
+            if (line.status == status_byte(LineStatus::PARALLEL)) {
+                return { status_byte(Status::NO_INTERSECTION), T(0), T(0) };
+            }
+            if (line.status == status_byte(LineStatus::INTERSECTING)) {
+                const T t = line.t;
+                const T u = dot_product(lazy(segment.p1()) + lazy(d) * t - lazy(ray.origin()), ray.direction());
+                if (t > -Coord<T>::Epsilon && t < len + Coord<T>::Epsilon && u >= 0) {
+                    return { status_byte(Status::INTERSECTING), t / len, u };
                 }
+                return { status_byte(Status::NO_INTERSECTION), T(0), T(0) };
+            }
 
-                return { Result::Status::OVERLAPPING, std::nullopt, Segment<2, T>(overlap_start, overlap_end) };
+            const T start = dot_product(ray.origin() - segment.p1(), d);
+            const bool forward = dot_product(ray.direction(), d) > 0;
+            IntersectionRow<T> row = forward ? overlap_row(std::max(T(0), start), len, len) : overlap_row(T(0), std::min(len, start), len);
+            if (row.status == status_byte(Status::INTERSECTING)) {
+                row.u = dot_product(lazy(segment.p1()) + lazy(e) * row.t - lazy(ray.origin()), ray.direction());
             }
-            else {
+            return row;
+        }
+
+        template<typename T>
+        Point<2, T> point_at(const Line<2, T>& line, T t) { return line.point_at(t); }
+
+        template<typename T>
+        Point<2, T> point_at(const Segment<2, T>& segment, T t) { return lazy(segment.p1()) + (lazy(segment.p2()) - lazy(segment.p1())) * t; }
+
+        template<typename T>
+        Segment<2, T> overlap_segment(const Segment<2, T>& segment, const IntersectionRow<T>& row) {
+            Point<2, T> a = point_at(segment, row.t), b = point_at(segment, row.u);
+            if (b[0] < a[0] || (b[0] == a[0] && b[1] < a[1])) std::swap(a, b);
+            return Segment<2, T>(a, b);
+        }
+
+        template<typename T>
+        SegmentIntersectionResult2D<T> segment_result(const Segment<2, T>& segment, const IntersectionRow<T>& row) {
+            using Result = SegmentIntersectionResult2D<T>;
+            const auto status = static_cast<typename Result::Status>(row.status);
+            switch (status) {
+            case Result::Status::INTERSECTING:
+                return { status, point_at(segment, row.t), std::nullopt };
+            case Result::Status::OVERLAPPING:
+                return { status, std::nullopt, overlap_segment(segment, row) };
+            default:
                 return { Result::Status::NO_INTERSECTION, std::nullopt, std::nullopt };
             }
         }
+
+        template<typename A, typename B, typename T>
+        void intersection_batch(const A* a, const B* b, size_t count, const IntersectionOutput<T>& out, uint8_t hit, uint8_t overlap) {
+            assert(out.status && "Batch intersection needs a status column.");
+            for (size_t i = 0; i < count; ++i) {
+                const IntersectionRow<T> row = intersection_row(a[i], b[i]);
+                out.status[i] = row.status;
+                if (row.status != hit && row.status != overlap) continue;
+                if (out.t) out.t[i] = row.t;
+                if (out.u) out.u[i] = row.u;
+                if (out.x || out.y) {
+                    const Point<2, T> p = point_at(a[i], row.t);
+                    if (out.x) out.x[i] = p[0].value;
+                    if (out.y) out.y[i] = p[1].value;
+                }
+            }
         }
-        return { Result::Status::NO_INTERSECTION, std::nullopt, std::nullopt }; 
-    }
+
+    } // namespace detail
 
     template<typename T>
-    std::optional<Polygon<2, T>> convex_hull(std::vector<Point<2, T>>& points) {
-        if (points.size() < 3) {
-            return std::nullopt; 
+    IntersectionResult2D<T> intersection(const Line<2, T>& l1, const Line<2, T>& l2) {
+        using Result = IntersectionResult2D<T>;
+        GEOM_TIME_SCOPE(LINE_INTERSECTION);
+
+        const IntersectionRow<T> row = detail::intersection_row(l1, l2);
+        const auto status = static_cast<typename Result::Status>(row.status);
+        if (status != Result::Status::INTERSECTING) {
+            return { status, std::nullopt };
         }
+        return { status, l1.point_at(row.t) };
+    }
 
-        std::sort(points.begin(), points.end(), [](const Point<2, T>& a, const Point<2, T>& b) {
-            if (a[0] != b[0]) return a[0] < b[0];
-            return a[1] < b[1];
-            });
+    template<typename T>
+    SegmentIntersectionResult2D<T> intersection(const Segment<2, T>& s1, const Segment<2, T>& s2) {
+        GEOM_TIME_SCOPE(SEGMENT_INTERSECTION);
+        return detail::segment_result(s1, detail::intersection_row(s1, s2));
+    }
 
-        std::vector<Point<2, T>> lower_hull;
-        std::vector<Point<2, T>> upper_hull;
+    namespace detail {
 
-        for (const auto& p : points) {
-            while (lower_hull.size() >= 2 &&
-                cross_product(lower_hull.back() - lower_hull[lower_hull.size() - 2], p - lower_hull.back()) <= 0) {
-                lower_hull.pop_back();
+        // Andrew's monotone chain over sorted points into out, which needs room for 2 * count
+        // points. Returns the number of hull vertices, counter-clockwise from the first point.
+        template<typename T>
+        size_t monotone_chain(const Point<2, T>* points, size_t count, Point<2, T>* out) {
+            size_t k = 0;
+            for (size_t i = 0; i < count; ++i) {
+                while (k >= 2 && cross_product(out[k - 1] - out[k - 2], points[i] - out[k - 1]) <= 0) --k;
+                out[k++] = points[i];
+            }
+            // The upper chain starts at the last point, already on top of the lower one.
+            const size_t lower = k + 1;
+            for (size_t i = count - 1; i-- > 0;) {
+                while (k >= lower && cross_product(out[k - 1] - out[k - 2], points[i] - out[k - 1]) <= 0) --k;
+                out[k++] = points[i];
             }
-            lower_hull.push_back(p);
+            return k - 1;
         }
 
-        for (int i = points.size() - 1; i >= 0; --i) {
-            const auto& p = points[i];
-            while (upper_hull.size() >= 2 &&
-                cross_product(upper_hull.back() - upper_hull[upper_hull.size() - 2], p - upper_hull.back()) <= 0) {
-                upper_hull.pop_back();
+        struct HullOrder {
+            template<typename T>
+            bool operator()(const Point<2, T>& a, const Point<2, T>& b) const {
+                if (a[0] != b[0]) return a[0] < b[0];
+                return a[1] < b[1];
             }
-            upper_hull.push_back(p);
+        };
+
+    } // namespace detail
+
+    // Monotone chain over points already sorted by x, then y (for instance by sort_lexicographic).
+    // The chain is built in the thread's scratch arena, so the result is the only allocation.
+    template<typename T>
+    std::optional<Polygon<2, T>> convex_hull_presorted(const std::vector<Point<2, T>>& points) {
+        if (points.size() < 3) {
+            return std::nullopt;
         }
 
-        upper_hull.pop_back();
-        upper_hull.erase(upper_hull.begin());
+        ScratchScope scratch;
+        std::pmr::vector<Point<2, T>> chain(2 * points.size(), scratch.resource());
+        const size_t k = detail::monotone_chain(points.data(), points.size(), chain.data());
+        if (k < 3) {
+            return std::nullopt;
+        }
+        return Polygon<2, T>(std::vector<Point<2, T>>(chain.begin(), chain.begin() + k));
+    }
+
+    // As above, with exactly the hull vertices allocated from resource; the chain is built in the
+    // thread's scratch arena. With a ScratchArena as the resource, hulling many small point sets
+    // reaches a steady state without heap allocations.
+    template<typename T, typename Allocator>
+    std::optional<pmr::Polygon<2, T>> convex_hull_presorted(const std::vector<Point<2, T>, Allocator>& points, std::pmr::memory_resource* resource) {
+        if (points.size() < 3) {
+            return std::nullopt;
+        }
 
-        lower_hull.insert(lower_hull.end(), upper_hull.begin(), upper_hull.end());
+        // Rewinding a scope on the thread's arena would also free a result taken from it, so then
+        // the chain is built in place.
+        ScratchArena& arena = thread_scratch_arena();
+        if (resource == &arena) {
+            std::pmr::vector<Point<2, T>> hull(2 * points.size(), resource);
+            const size_t k = detail::monotone_chain(points.data(), points.size(), hull.data());
+            if (k < 3) {
+                return std::nullopt;
+            }
+            hull.resize(k);
+            return pmr::Polygon<2, T>(std::move(hull));
+        }
 
-        return Polygon<2, T>(lower_hull);
+        ScratchScope scratch(arena);
+        std::pmr::vector<Point<2, T>> chain(2 * points.size(), scratch.resource());
+        const size_t k = detail::monotone_chain(points.data(), points.size(), chain.data());
+        if (k < 3) {
+            return std::nullopt;
+        }
+        return pmr::Polygon<2, T>(std::pmr::vector<Point<2, T>>(chain.begin(), chain.begin() + k, resource));
     }
 
     template<typename T>
-    bool contains(const Point<2, T>& p, const Polygon<2, T>& polygon) {
+    std::optional<Polygon<2, T>> convex_hull(std::vector<Point<2, T>>& points) {
+        GEOM_COUNT(CONVEX_HULL_CALLS);
+        GEOM_TIME_SCOPE(CONVEX_HULL);
+        if (points.size() < 3) {
+            return std::nullopt; 
+        }
+
+        std::sort(points.begin(), points.end(), detail::HullOrder());
+
+        return convex_hull_presorted(points);
+    }
+
+    // Sorts points in place and takes the hull vertices from resource.
+    template<typename T, typename Allocator>
+    std::optional<pmr::Polygon<2, T>> convex_hull(std::vector<Point<2, T>, Allocator>& points, std::pmr::memory_resource* resource) {
+        GEOM_COUNT(CONVEX_HULL_CALLS);
+        GEOM_TIME_SCOPE(CONVEX_HULL);
+        if (points.size() < 3) {
+            return std::nullopt;
+        }
+
+        std::sort(points.begin(), points.end(), detail::HullOrder());
+
+        return convex_hull_presorted(points, resource);
+    }
+
+    template<typename T, typename Allocator>
+    bool contains(const Point<2, T>& p, const Polygon<2, T, Allocator>& polygon) {
+        GEOM_COUNT(POLYGON_CONTAINS_CALLS);
+        GEOM_TIME_SCOPE(POLYGON_CONTAINS);
         bool is_inside = false;
         const size_t num_verts = polygon.num_vertices();
 
@@ -169,6 +406,7 @@ namespace geom {
             const auto& p2 = polygon.vertices()[(i + 1) % num_verts];
 
             if (contains(p, Segment<2, T>(p1, p2))) {
+                GEOM_COUNT(POLYGON_CONTAINS_BOUNDARY);
                 return true;
             }
 
@@ -220,28 +458,12 @@ namespace geom {
     template<typename T>
     SegmentIntersectionResult2D<T> intersection(const Line<2, T>& line, const Ray<2, T>& ray) {
         using Result = SegmentIntersectionResult2D<T>;
-
-        Line<2, T> ray_line = Line<2, T>::from_point_direction(ray.origin(), ray.direction());
-        auto line_isect = intersection(line, ray_line);
-
-        switch (line_isect.status) {
-        case IntersectionResult2D<T>::Status::PARALLEL:
-            return { Result::Status::NO_INTERSECTION };
-
-        case IntersectionResult2D<T>::Status::INTERSECTING: {
-            Point<2, T> p = line_isect.point.value();
-            if (ray.contains(p)) { 
-                return { Result::Status::INTERSECTING, p };
-            }
-            else {
-                return { Result::Status::NO_INTERSECTION };
-            }
-        }
-
-        case IntersectionResult2D<T>::Status::COINCIDENT:
-            return { Result::Status::OVERLAPPING }; 
+        const IntersectionRow<T> row = detail::intersection_row(line, ray);
+        const auto status = static_cast<typename Result::Status>(row.status);
+        if (status == Result::Status::INTERSECTING) {
+            return { status, line.point_at(row.t) };
         }
-        return { Result::Status::NO_INTERSECTION };
+        return { status };
     }
 
     template<typename T>
@@ -251,53 +473,44 @@ namespace geom {
 
     template<typename T>
     SegmentIntersectionResult2D<T> intersection(const Segment<2, T>& segment, const Ray<2, T>& ray) {
-        using Result = SegmentIntersectionResult2D<T>;
-
-        Line<2, T> seg_line = Line<2, T>::from_points(segment.p1(), segment.p2());
-        Line<2, T> ray_line = Line<2, T>::from_point_direction(ray.origin(), ray.direction());
-        auto line_isect = intersection(seg_line, ray_line);
-
-        switch (line_isect.status) {
-        case IntersectionResult2D<T>::Status::PARALLEL:
-            return { Result::Status::NO_INTERSECTION };
-
-        case IntersectionResult2D<T>::Status::INTERSECTING: {
-            Point<2, T> p = line_isect.point.value();
-            if (contains(p, segment) && ray.contains(p)) {
-                return { Result::Status::INTERSECTING, p };
-            }
-            else {
-                return { Result::Status::NO_INTERSECTION };
-            }
-        }
-
-        case IntersectionResult2D<T>::Status::COINCIDENT: {
-            auto p1 = segment.p1(), p2 = segment.p2();
-            auto q1 = ray.origin();
+        return detail::segment_result(segment, detail::intersection_row(segment, ray));
+    }
 
-            int axis = (std::abs(p2[0] - p1[0]) > std::abs(p2[1] - p1[1])) ? 0 : 1;
-            if (p1[axis] > p2[axis]) std::swap(p1, p2);
+    template<typename T>
+    SegmentIntersectionResult2D<T> intersection(const Ray<2, T>& ray, const Segment<2, T>& segment) {
+        return intersection(segment, ray);
+    }
 
-            Point<2, T> overlap_start = (p1[axis] > q1[axis]) ? p1 : q1;
-            Point<2, T> overlap_end = p2;
+    // Batch intersections of pairs (a[i], b[i]), written row by row into out; see
+    // IntersectionRow for what t and u mean. Statuses are the scalar Status values as bytes.
+    template<typename T>
+    void intersection_batch(const Line<2, T>* a, const Line<2, T>* b, size_t count, const IntersectionOutput<T>& out) {
+        using Status = typename IntersectionResult2D<T>::Status;
+        detail::intersection_batch(a, b, count, out, detail::status_byte(Status::INTERSECTING), detail::status_byte(Status::INTERSECTING));
+    }
 
-            bool ray_goes_towards_segment = dot_product(p2 - q1, ray.direction()) >= 0;
+    template<typename T>
+    void intersection_batch(const Segment<2, T>* a, const Segment<2, T>* b, size_t count, const IntersectionOutput<T>& out) {
+        using Status = typename SegmentIntersectionResult2D<T>::Status;
+        detail::intersection_batch(a, b, count, out, detail::status_byte(Status::INTERSECTING), detail::status_byte(Status::OVERLAPPING));
+    }
 
-            if (ray_goes_towards_segment && overlap_start[axis] <= overlap_end[axis]) {
-                if ((overlap_start - overlap_end).length_sq() < Coord<T>::Epsilon * Coord<T>::Epsilon) {
-                    return { Result::Status::INTERSECTING, overlap_start };
-                }
-                return { Result::Status::OVERLAPPING, std::nullopt, Segment<2, T>(overlap_start, overlap_end) };
-            }
-            return { Result::Status::NO_INTERSECTION };
-        }
-        }
-        return { Result::Status::NO_INTERSECTION };
+    template<typename T>
+    void intersection_batch(const Line<2, T>* a, const Ray<2, T>* b, size_t count, const IntersectionOutput<T>& out) {
+        using Status = typename SegmentIntersectionResult2D<T>::Status;
+        detail::intersection_batch(a, b, count, out, detail::status_byte(Status::INTERSECTING), detail::status_byte(Status::OVERLAPPING));
     }
 
     template<typename T>
-    SegmentIntersectionResult2D<T> intersection(const Ray<2, T>& ray, const Segment<2, T>& segment) {
-        return intersection(segment, ray);
+    void intersection_batch(const Segment<2, T>* a, const Ray<2, T>* b, size_t count, const IntersectionOutput<T>& out) {
+        using Status = typename SegmentIntersectionResult2D<T>::Status;
+        detail::intersection_batch(a, b, count, out, detail::status_byte(Status::INTERSECTING), detail::status_byte(Status::OVERLAPPING));
+    }
+
+    template<typename A, typename B, typename T>
+    void intersection_batch(const std::vector<A>& a, const std::vector<B>& b, const IntersectionOutput<T>& out) {
+        assert(a.size() == b.size() && "Batch intersection needs one b for every a.");
+        intersection_batch(a.data(), b.data(), a.size(), out);
     }
 
 } // namespace geom
@@ -0,0 +1,133 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+
+namespace geom {
+
+    // Bump allocator for short-lived memory: algorithm temporaries, or results that die before the
+    // next rewind. Allocations are carved from one buffer and released together by rewind();
+    // deallocate() does nothing. Requests that do not fit go to the upstream resource, and the
+    // next rewind to zero grows the buffer to the high-water mark, so a loop that rewinds once per
+    // iteration stops allocating once it has seen its largest iteration.
+    class ScratchArena final : public std::pmr::memory_resource {
+    private:
+        // Header in front of each block taken from upstream.
+        struct Overflow {
+            Overflow* next;
+            size_t bytes;
+            size_t alignment;
+        };
+
+        std::pmr::memory_resource* m_upstream;
+        std::byte* m_buffer = nullptr;
+        size_t m_capacity = 0;
+        size_t m_used = 0;
+        Overflow* m_overflow = nullptr;
+        size_t m_peak = 0;          // Bytes needed since the last rewind to zero, overflow included.
+
+    public:
+        explicit ScratchArena(size_t initial_bytes = 64 * 1024, std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+            : m_upstream(upstream) {
+            reserve(initial_bytes);
+        }
+
+        ScratchArena(const ScratchArena&) = delete;
+        ScratchArena& operator=(const ScratchArena&) = delete;
+
+        ~ScratchArena() override {
+            release_overflow();
+            if (m_buffer) m_upstream->deallocate(m_buffer, m_capacity, alignof(std::max_align_t));
+        }
+
+        size_t capacity() const { return m_capacity; }
+        size_t used() const { return m_used; }
+
+        // Frees everything allocated since used() returned mark. Blocks that overflowed to the
+        // upstream resource are returned only by a rewind to zero, which also grows the buffer.
+        void rewind(size_t mark = 0) {
+            assert(mark <= m_used && "Scratch marks must be rewound in reverse order.");
+            m_used = mark;
+            if (mark == 0) {
+                if (m_overflow) {
+                    release_overflow();
+                    reserve(std::max(m_peak, 2 * m_capacity));
+                }
+                m_peak = 0;
+            }
+        }
+
+        // Replaces the buffer with one of at least the given size. The arena must be empty.
+        void reserve(size_t bytes) {
+            assert(m_used == 0 && "Only an empty scratch arena can be resized.");
+            if (bytes <= m_capacity) {
+                return;
+            }
+            if (m_buffer) m_upstream->deallocate(m_buffer, m_capacity, alignof(std::max_align_t));
+            m_buffer = static_cast<std::byte*>(m_upstream->allocate(bytes, alignof(std::max_align_t)));
+            m_capacity = bytes;
+        }
+
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override {
+            const uintptr_t base = reinterpret_cast<uintptr_t>(m_buffer);
+            const size_t start = static_cast<size_t>(((base + m_used + alignment - 1) & ~uintptr_t(alignment - 1)) - base);
+            if (m_buffer && start + bytes <= m_capacity) {
+                m_used = start + bytes;
+                m_peak = std::max(m_peak, m_used);
+                return m_buffer + start;
+            }
+
+            const size_t block_alignment = std::max(alignment, alignof(Overflow));
+            const size_t header = (sizeof(Overflow) + block_alignment - 1) / block_alignment * block_alignment;
+            std::byte* block = static_cast<std::byte*>(m_upstream->allocate(header + bytes, block_alignment));
+            m_overflow = new (block) Overflow{ m_overflow, header + bytes, block_alignment };
+            m_peak += bytes + alignment;
+            return block + header;
+        }
+
+        void do_deallocate(void*, size_t, size_t) override {}
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+
+        void release_overflow() {
+            while (m_overflow) {
+                Overflow* next = m_overflow->next;
+                m_upstream->deallocate(m_overflow, m_overflow->bytes, m_overflow->alignment);
+                m_overflow = next;
+            }
+        }
+    };
+
+    // The calling thread's scratch arena, for temporaries inside algorithms.
+    inline ScratchArena& thread_scratch_arena() {
+        thread_local ScratchArena arena;
+        return arena;
+    }
+
+    // Frees what was allocated from the arena during its lifetime. Scopes nest; results that must
+    // outlive a scope have to come from somewhere else.
+    class ScratchScope {
+    private:
+        ScratchArena& m_arena;
+        size_t m_mark;
+
+    public:
+        explicit ScratchScope(ScratchArena& arena = thread_scratch_arena()) : m_arena(arena), m_mark(arena.used()) {}
+
+        ScratchScope(const ScratchScope&) = delete;
+        ScratchScope& operator=(const ScratchScope&) = delete;
+
+        ~ScratchScope() { m_arena.rewind(m_mark); }
+
+        std::pmr::memory_resource* resource() const { return &m_arena; }
+    };
+
+
+} // namespace geom
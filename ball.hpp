@@ -0,0 +1,52 @@
+﻿#pragma once
+
+#include <cassert>
+#include "vector.hpp"
+#include "box.hpp"
+
+namespace geom {
+
+    template<size_t Dim, typename T>
+    class Ball {
+    public:
+        using point_type = Point<Dim, T>;
+
+    private:
+        point_type m_center;
+        T m_radius;
+
+    public:
+        Ball() : m_center(), m_radius(0) {}
+
+        Ball(const point_type& center, const T& radius) : m_center(center), m_radius(radius) {
+            assert(radius >= 0 && "Ball radius cannot be negative.");
+        }
+
+        const point_type& center() const { return m_center; }
+        T radius() const { return m_radius; }
+
+        bool contains(const point_type& p) const {
+            return Coord<T>((p - m_center).length()) <= Coord<T>(m_radius);
+        }
+
+        Box<Dim, T> bounds() const {
+            point_type min = m_center, max = m_center;
+            for (size_t i = 0; i < Dim; ++i) {
+                min[i].value -= m_radius;
+                max[i].value += m_radius;
+            }
+            return Box<Dim, T>(min, max);
+        }
+    };
+
+    template<typename T> using Ball2 = Ball<2, T>;
+    template<typename T> using Ball3 = Ball<3, T>;
+
+    using Ball2d = Ball2<double>;
+    using Ball3d = Ball3<double>;
+
+    using Ball2f = Ball2<float>;
+    using Ball3f = Ball3<float>;
+
+
+} // namespace geom
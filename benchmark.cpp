@@ -0,0 +1,183 @@
+﻿#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <vector>
+#include "vector.hpp"
+#include "line.hpp"
+#include "segment.hpp"
+#include "algorithms.hpp"
+#include "arena.hpp"
+#include "spatial_sort.hpp"
+#include "transform.hpp"
+
+// Micro-benchmarks for the hot geometric kernels. Build with optimizations, e.g.
+//   g++ -std=c++17 -O2 -pthread benchmark.cpp -o benchmark
+// Streaming kernels only vectorize at -O3; add -march=native to compare float and double lane widths.
+
+namespace {
+
+    volatile double g_sink = 0;
+
+    template<typename Func>
+    void run_benchmark(const char* name, size_t iterations, Func&& func) {
+        func(0); // Warm-up.
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; ++i) {
+            // The round number rotates the inputs so the compiler cannot hoist the batch out of the loop.
+            g_sink = g_sink + func(i);
+        }
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+
+        const double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+        std::cout << name << ": " << ns / iterations << " ns/batch" << std::endl;
+    }
+
+    template<typename T>
+    std::vector<geom::Line2<T>> make_lines(size_t count) {
+        std::vector<geom::Line2<T>> lines;
+        lines.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            const T a = T(0.37) * T(i);
+            lines.push_back(geom::Line2<T>::from_point_direction(geom::Point2<T>(std::cos(a), std::sin(a)),
+                                                                 geom::Vector2<T>(std::sin(T(1.3) * a) + T(1.5), std::cos(a))));
+        }
+        return lines;
+    }
+
+    template<typename T>
+    std::vector<geom::Point2<T>> make_points(size_t count) {
+        std::vector<geom::Point2<T>> points;
+        points.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            const T a = T(0.11) * T(i);
+            points.push_back(geom::Point2<T>(T(10) * std::cos(a), T(7) * std::sin(T(1.7) * a)));
+        }
+        return points;
+    }
+
+    template<typename T>
+    void run_kernel_benchmarks(const char* type_name) {
+        const size_t count = 4096; // Power of two, inputs are rotated with a mask.
+        const size_t iterations = 500;
+        const auto lines = make_lines<T>(count);
+        const auto points = make_points<T>(count);
+
+        std::vector<geom::Segment2<T>> segments;
+        for (size_t i = 0; i + 1 < count; ++i) {
+            segments.push_back(geom::Segment2<T>(points[i], points[i + 1]));
+        }
+
+        std::cout << "--- " << type_name << " kernels (" << count << " elements per batch) ---" << std::endl;
+
+        run_benchmark("intersection(Line2, Line2)", iterations, [&](size_t round) {
+            double sum = 0;
+            for (size_t i = 0; i + 1 < count; ++i) {
+                auto r = geom::intersection(lines[(i + round) & (count - 1)], lines[i + 1]);
+                if (r.point.has_value()) sum += r.point.value()[0].value;
+            }
+            return sum;
+        });
+
+        std::vector<geom::Segment2<T>> rotated(segments);
+        run_benchmark("intersection(Segment2, Segment2)", iterations, [&](size_t round) {
+            double sum = 0;
+            for (size_t i = 0; i + 1 < segments.size(); ++i) {
+                auto r = geom::intersection(segments[(i * 5 + round) % segments.size()], segments[i + 1]);
+                if (r.point.has_value()) sum += r.point.value()[0].value;
+            }
+            return sum;
+        });
+
+        // Same pairs through the batch kernel: one status byte and one parameter per row instead
+        // of a result struct with two optionals.
+        geom::IntersectionBuffers<T> rows;
+        const auto out = rows.resize(segments.size() - 1, false);
+        run_benchmark("intersection_batch(Segment2, Segment2)", iterations, [&](size_t round) {
+            for (size_t i = 0; i + 1 < segments.size(); ++i) rotated[i] = segments[(i * 5 + round) % segments.size()];
+            geom::intersection_batch(rotated.data(), segments.data() + 1, segments.size() - 1, out);
+            double sum = 0;
+            for (size_t i = 0; i + 1 < segments.size(); ++i) sum += rows.status[i];
+            return sum;
+        });
+
+        run_benchmark("Line2::project", iterations, [&](size_t round) {
+            double sum = 0;
+            for (size_t i = 0; i < count; ++i) {
+                sum += lines[i].project(points[(i + round) & (count - 1)])[1].value;
+            }
+            return sum;
+        });
+
+        run_benchmark("Line2::point_at", iterations, [&](size_t round) {
+            double sum = 0;
+            for (size_t i = 0; i < count; ++i) {
+                sum += lines[i].point_at(T(0.5) * T((i + round) & 7))[0].value;
+            }
+            return sum;
+        });
+
+        run_benchmark("distance(Point2, Segment2)", iterations, [&](size_t round) {
+            double sum = 0;
+            for (size_t i = 0; i < segments.size(); ++i) {
+                sum += geom::distance(points[(i * 7 + round) & (count - 1)], segments[i]);
+            }
+            return sum;
+        });
+
+        std::vector<geom::Point2<T>> scratch;
+        run_benchmark("convex_hull (comparison sort)", iterations / 10, [&](size_t round) {
+            scratch.assign(points.begin(), points.end());
+            std::rotate(scratch.begin(), scratch.begin() + (round & (count - 1)), scratch.end());
+            return double(geom::convex_hull(scratch)->num_vertices());
+        });
+
+        run_benchmark("convex_hull_radix", iterations / 10, [&](size_t round) {
+            scratch.assign(points.begin(), points.end());
+            std::rotate(scratch.begin(), scratch.begin() + (round & (count - 1)), scratch.end());
+            return double(geom::convex_hull_radix(scratch)->num_vertices());
+        });
+
+        // Many tiny hulls: the default entry point allocates each result, the pmr one takes it
+        // from a scratch arena rewound after every hull.
+        std::vector<geom::Point2<T>> tiny(8);
+        auto fill_tiny = [&](size_t round, size_t k) {
+            for (size_t i = 0; i < tiny.size(); ++i) tiny[i] = points[(round * 131 + k * 8 + i) & (count - 1)];
+        };
+        run_benchmark("convex_hull x512 (8 points, std::allocator)", iterations, [&](size_t round) {
+            double sum = 0;
+            for (size_t k = 0; k < 512; ++k) {
+                fill_tiny(round, k);
+                if (auto hull = geom::convex_hull(tiny)) sum += double(hull->num_vertices());
+            }
+            return sum;
+        });
+
+        geom::ScratchArena arena;
+        run_benchmark("convex_hull x512 (8 points, ScratchArena)", iterations, [&](size_t round) {
+            double sum = 0;
+            for (size_t k = 0; k < 512; ++k) {
+                fill_tiny(round, k);
+                geom::ScratchScope scope(arena);
+                if (auto hull = geom::convex_hull(tiny, scope.resource())) sum += double(hull->num_vertices());
+            }
+            return sum;
+        });
+
+        // Streaming kernel: float halves the bytes per point and doubles the SIMD lanes.
+        std::vector<geom::Point2<T>> cloud;
+        for (size_t i = 0; i < 16; ++i) cloud.insert(cloud.end(), points.begin(), points.end());
+        const auto rotation = geom::Affine2<T>::rotation(T(1e-3));
+        run_benchmark("Affine2::apply_in_place (65536 points)", iterations / 10, [&](size_t) {
+            rotation.apply_in_place(cloud, 1);
+            return double(cloud[0][0].value);
+        });
+    }
+
+} // namespace
+
+int main() {
+    run_kernel_benchmarks<double>("double");
+    std::cout << std::endl;
+    run_kernel_benchmarks<float>("float");
+    return 0;
+}
@@ -0,0 +1,135 @@
+﻿#pragma once
+
+#include <limits>
+#include <vector>
+#include "vector.hpp"
+
+namespace geom {
+
+    template<size_t Dim, typename T>
+    class Box {
+    public:
+        using point_type = Point<Dim, T>;
+        using vector_type = Vector<Dim, T>;
+
+    private:
+        point_type m_min;
+        point_type m_max;
+
+    public:
+        // Default-constructed boxes are empty: expanding by the first point makes them degenerate boxes around it.
+        Box() {
+            for (size_t i = 0; i < Dim; ++i) {
+                m_min[i] = std::numeric_limits<T>::infinity();
+                m_max[i] = -std::numeric_limits<T>::infinity();
+            }
+        }
+
+        Box(const point_type& min, const point_type& max) : m_min(min), m_max(max) {
+        }
+
+        static Box from_points(const std::vector<point_type>& points) {
+            Box box;
+            for (const auto& p : points) {
+                box.expand(p);
+            }
+            return box;
+        }
+
+        const point_type& min() const { return m_min; }
+        const point_type& max() const { return m_max; }
+
+        bool is_empty() const {
+            for (size_t i = 0; i < Dim; ++i) {
+                if (m_min[i].value > m_max[i].value) return true;
+            }
+            return false;
+        }
+
+        void expand(const point_type& p) {
+            for (size_t i = 0; i < Dim; ++i) {
+                m_min[i].value = std::min(m_min[i].value, p[i].value);
+                m_max[i].value = std::max(m_max[i].value, p[i].value);
+            }
+        }
+
+        void expand(const Box& other) {
+            for (size_t i = 0; i < Dim; ++i) {
+                m_min[i].value = std::min(m_min[i].value, other.m_min[i].value);
+                m_max[i].value = std::max(m_max[i].value, other.m_max[i].value);
+            }
+        }
+
+        vector_type extent() const {
+            vector_type e;
+            if (is_empty()) return e;
+            for (size_t i = 0; i < Dim; ++i) {
+                e[i] = m_max[i].value - m_min[i].value;
+            }
+            return e;
+        }
+
+        point_type center() const {
+            point_type c;
+            for (size_t i = 0; i < Dim; ++i) {
+                c[i] = (m_min[i].value + m_max[i].value) / T(2);
+            }
+            return c;
+        }
+
+        size_t longest_axis() const {
+            const vector_type e = extent();
+            size_t axis = 0;
+            for (size_t i = 1; i < Dim; ++i) {
+                if (e[i].value > e[axis].value) axis = i;
+            }
+            return axis;
+        }
+
+        // Perimeter in 2D, surface area in 3D. Used as the SAH cost metric.
+        T surface_area() const {
+            static_assert(Dim == 2 || Dim == 3, "Surface area is only implemented for 2D and 3D boxes.");
+            const vector_type e = extent();
+            if constexpr (Dim == 2) {
+                return T(2) * (e[0].value + e[1].value);
+            }
+            else {
+                return T(2) * (e[0].value * e[1].value + e[1].value * e[2].value + e[2].value * e[0].value);
+            }
+        }
+
+        T volume() const {
+            const vector_type e = extent();
+            T result = 1;
+            for (size_t i = 0; i < Dim; ++i) {
+                result *= e[i].value;
+            }
+            return result;
+        }
+
+        bool contains(const point_type& p) const {
+            for (size_t i = 0; i < Dim; ++i) {
+                if (p[i] < m_min[i] || p[i] > m_max[i]) return false;
+            }
+            return true;
+        }
+
+        bool intersects(const Box& other) const {
+            for (size_t i = 0; i < Dim; ++i) {
+                if (other.m_max[i] < m_min[i] || other.m_min[i] > m_max[i]) return false;
+            }
+            return true;
+        }
+    };
+
+    template<typename T> using Box2 = Box<2, T>;
+    template<typename T> using Box3 = Box<3, T>;
+
+    using Box2d = Box2<double>;
+    using Box3d = Box3<double>;
+
+    using Box2f = Box2<float>;
+    using Box3f = Box3<float>;
+
+
+} // namespace geom
@@ -0,0 +1,438 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <vector>
+#include "vector.hpp"
+#include "box.hpp"
+#include "ray.hpp"
+#include "mesh.hpp"
+#include "parallel.hpp"
+#include "spatial_sort.hpp"
+#include "instrumentation.hpp"
+
+namespace geom {
+
+    template<typename T>
+    struct RayMeshHit {
+        size_t triangle;    // Index of the triangle in the source mesh.
+        T t;
+        T u;
+        T v;
+        Point<3, T> point;
+    };
+
+    // Bounding volume hierarchy over a TriangleMesh, built with a binned surface area heuristic.
+    // The hierarchy keeps its own packed copy of the triangles, so the mesh does not need to outlive it.
+    template<typename T>
+    class MeshBVH {
+    public:
+        using point_type = Point<3, T>;
+        using ray_type = Ray<3, T>;
+        using hit_type = RayMeshHit<T>;
+
+        static constexpr size_t BinCount = 16;
+        static constexpr size_t MaxSahDepth = 32;   // Deeper nodes use median splits so traversal depth stays bounded.
+        static constexpr size_t MaxStackSize = 64;
+
+    private:
+        struct Node {
+            T bounds_min[3];
+            T bounds_max[3];
+            uint32_t first; // Leaf: first packed triangle. Internal: left child, the right child is first + 1.
+            uint32_t count; // Number of triangles in a leaf, 0 for internal nodes.
+        };
+
+        // Vertex and edges are precomputed so the Moller-Trumbore test does not touch the index buffer.
+        struct PackedTriangle {
+            T v0[3];
+            T e1[3];
+            T e2[3];
+            T edge_scale;   // |e1| * |e2|, the largest |det| for a unit direction.
+        };
+
+        struct BuildTask {
+            uint32_t node;
+            uint32_t depth;
+        };
+
+        std::vector<Node> m_nodes;
+        std::vector<PackedTriangle> m_triangles;
+        std::vector<uint32_t> m_triangle_ids;
+        size_t m_max_leaf_size;
+
+    public:
+        explicit MeshBVH(const TriangleMesh<T>& mesh, size_t max_leaf_size = 4) : m_max_leaf_size(std::max<size_t>(1, max_leaf_size)) {
+            build(mesh);
+        }
+
+        size_t num_nodes() const { return m_nodes.size(); }
+        size_t num_triangles() const { return m_triangles.size(); }
+
+        Box<3, T> bounds() const {
+            if (m_nodes.empty()) return Box<3, T>();
+            const Node& root = m_nodes[0];
+            return Box<3, T>(point_type(root.bounds_min[0], root.bounds_min[1], root.bounds_min[2]),
+                             point_type(root.bounds_max[0], root.bounds_max[1], root.bounds_max[2]));
+        }
+
+        std::optional<hit_type> closest_hit(const ray_type& ray, T max_distance = std::numeric_limits<T>::infinity()) const {
+            GEOM_COUNT(BVH_CLOSEST_HIT_QUERIES);
+            GEOM_TIME_SCOPE(BVH_CLOSEST_HIT);
+            RayData r(ray);
+            T best_t = max_distance;
+            T best_u = 0, best_v = 0;
+            uint32_t best_triangle = std::numeric_limits<uint32_t>::max();
+
+            if (m_nodes.empty() || intersect_box(r, m_nodes[0], best_t) == std::numeric_limits<T>::infinity()) {
+                return std::nullopt;
+            }
+
+            uint32_t stack[MaxStackSize];
+            size_t stack_size = 0;
+            stack[stack_size++] = 0;
+
+            while (stack_size > 0) {
+                const Node& node = m_nodes[stack[--stack_size]];
+
+                if (node.count > 0) {
+                    for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+                        T t, u, v;
+                        if (intersect_triangle(r, m_triangles[i], best_t, t, u, v)) {
+                            best_t = t;
+                            best_u = u;
+                            best_v = v;
+                            best_triangle = i;
+                        }
+                    }
+                    continue;
+                }
+
+                // Visit the nearer child first so that best_t shrinks as early as possible.
+                uint32_t near_child = node.first;
+                uint32_t far_child = node.first + 1;
+                T near_t = intersect_box(r, m_nodes[near_child], best_t);
+                T far_t = intersect_box(r, m_nodes[far_child], best_t);
+                if (far_t < near_t) {
+                    std::swap(near_child, far_child);
+                    std::swap(near_t, far_t);
+                }
+                if (far_t != std::numeric_limits<T>::infinity()) stack[stack_size++] = far_child;
+                if (near_t != std::numeric_limits<T>::infinity()) stack[stack_size++] = near_child;
+            }
+
+            if (best_triangle == std::numeric_limits<uint32_t>::max()) {
+                return std::nullopt;
+            }
+            return hit_type{ m_triangle_ids[best_triangle], best_t, best_u, best_v, ray.origin() + ray.direction() * best_t };
+        }
+
+        // Occlusion query: stops at the first triangle hit closer than max_distance.
+        bool any_hit(const ray_type& ray, T max_distance = std::numeric_limits<T>::infinity()) const {
+            GEOM_COUNT(BVH_ANY_HIT_QUERIES);
+            RayData r(ray);
+            if (m_nodes.empty()) return false;
+
+            uint32_t stack[MaxStackSize];
+            size_t stack_size = 0;
+            stack[stack_size++] = 0;
+
+            while (stack_size > 0) {
+                const Node& node = m_nodes[stack[--stack_size]];
+                if (intersect_box(r, node, max_distance) == std::numeric_limits<T>::infinity()) {
+                    continue;
+                }
+                if (node.count > 0) {
+                    for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+                        T t, u, v;
+                        if (intersect_triangle(r, m_triangles[i], max_distance, t, u, v)) {
+                            return true;
+                        }
+                    }
+                    continue;
+                }
+                stack[stack_size++] = node.first + 1;
+                stack[stack_size++] = node.first;
+            }
+            return false;
+        }
+
+        // Large batches are traced in Hilbert order of the ray origins (see batch_query_order).
+        void closest_hit_batch(const std::vector<ray_type>& rays, std::vector<std::optional<hit_type>>& hits, size_t num_threads = 0) const {
+            hits.resize(rays.size());
+            const std::vector<uint32_t> order = query_order(rays);
+            parallel_for(rays.size(), [&](size_t begin, size_t end) {
+                for (size_t k = begin; k < end; ++k) {
+                    const size_t i = order.empty() ? k : order[k];
+                    hits[i] = closest_hit(rays[i]);
+                }
+            }, num_threads);
+        }
+
+        // occluded[i] is 1 when rays[i] hits the mesh closer than max_distances[i] (or anywhere, if max_distances is empty).
+        void any_hit_batch(const std::vector<ray_type>& rays, const std::vector<T>& max_distances, std::vector<uint8_t>& occluded, size_t num_threads = 0) const {
+            assert((max_distances.empty() || max_distances.size() == rays.size()) && "max_distances must be empty or match the number of rays.");
+            occluded.resize(rays.size());
+            const std::vector<uint32_t> order = query_order(rays);
+            parallel_for(rays.size(), [&](size_t begin, size_t end) {
+                for (size_t k = begin; k < end; ++k) {
+                    const size_t i = order.empty() ? k : order[k];
+                    const T max_distance = max_distances.empty() ? std::numeric_limits<T>::infinity() : max_distances[i];
+                    occluded[i] = any_hit(rays[i], max_distance) ? 1 : 0;
+                }
+            }, num_threads);
+        }
+
+    private:
+        static std::vector<uint32_t> query_order(const std::vector<ray_type>& rays) {
+            if (rays.size() < SpatialOrderMinBatch) {
+                return {};
+            }
+            std::vector<point_type> origins;
+            origins.reserve(rays.size());
+            for (const ray_type& ray : rays) origins.push_back(ray.origin());
+            return batch_query_order(origins);
+        }
+
+        struct RayData {
+            T origin[3];
+            T dir[3];
+            T inv_dir[3];
+            T dir_length;
+
+            explicit RayData(const ray_type& ray) : dir_length(ray.direction().length()) {
+                for (size_t i = 0; i < 3; ++i) {
+                    origin[i] = ray.origin()[i].value;
+                    dir[i] = ray.direction()[i].value;
+                    inv_dir[i] = T(1) / dir[i];
+                }
+            }
+        };
+
+        // Returns the entry distance into the node's box, or infinity if the ray misses it before max_t.
+        static T intersect_box(const RayData& r, const Node& node, T max_t) {
+            T t_min = 0;
+            T t_max = max_t;
+            for (size_t i = 0; i < 3; ++i) {
+                const T t1 = (node.bounds_min[i] - r.origin[i]) * r.inv_dir[i];
+                const T t2 = (node.bounds_max[i] - r.origin[i]) * r.inv_dir[i];
+                t_min = std::max(t_min, std::min(t1, t2));
+                t_max = std::min(t_max, std::max(t1, t2));
+            }
+            return t_min <= t_max ? t_min : std::numeric_limits<T>::infinity();
+        }
+
+        static bool intersect_triangle(const RayData& r, const PackedTriangle& tri, T max_t, T& t, T& u, T& v) {
+            const T px = r.dir[1] * tri.e2[2] - r.dir[2] * tri.e2[1];
+            const T py = r.dir[2] * tri.e2[0] - r.dir[0] * tri.e2[2];
+            const T pz = r.dir[0] * tri.e2[1] - r.dir[1] * tri.e2[0];
+            const T det = tri.e1[0] * px + tri.e1[1] * py + tri.e1[2] * pz;
+            if (std::abs(det) <= Coord<T>::Epsilon * tri.edge_scale * r.dir_length) return false;
+            const T inv_det = T(1) / det;
+
+            const T tx = r.origin[0] - tri.v0[0];
+            const T ty = r.origin[1] - tri.v0[1];
+            const T tz = r.origin[2] - tri.v0[2];
+            u = (tx * px + ty * py + tz * pz) * inv_det;
+            if (u < 0 || u > 1) return false;
+
+            const T qx = ty * tri.e1[2] - tz * tri.e1[1];
+            const T qy = tz * tri.e1[0] - tx * tri.e1[2];
+            const T qz = tx * tri.e1[1] - ty * tri.e1[0];
+            v = (r.dir[0] * qx + r.dir[1] * qy + r.dir[2] * qz) * inv_det;
+            if (v < 0 || u + v > 1) return false;
+
+            t = (tri.e2[0] * qx + tri.e2[1] * qy + tri.e2[2] * qz) * inv_det;
+            return t > Coord<T>::Epsilon && t < max_t;
+        }
+
+        void build(const TriangleMesh<T>& mesh) {
+            const size_t n = mesh.num_triangles();
+            if (n == 0) return;
+
+            std::vector<Box<3, T>> tri_bounds(n);
+            std::vector<point_type> centroids(n);
+            for (size_t i = 0; i < n; ++i) {
+                const auto tri = mesh.triangle(i);
+                for (const auto& p : tri) tri_bounds[i].expand(p);
+                centroids[i] = tri_bounds[i].center();
+            }
+            // Triangles enter the build in Morton order of their centroids, so the binning and
+            // partitioning passes below read nearly contiguous memory even for a shuffled mesh.
+            const std::vector<uint32_t> source = morton_order(centroids);
+            apply_permutation(tri_bounds, source);
+            apply_permutation(centroids, source);
+            std::vector<uint32_t> order(n);
+            std::iota(order.begin(), order.end(), 0u);
+
+            m_nodes.reserve(2 * n);
+            m_nodes.push_back(make_node(order, tri_bounds, 0, static_cast<uint32_t>(n)));
+
+            std::vector<BuildTask> tasks;
+            tasks.push_back({ 0, 0 });
+            while (!tasks.empty()) {
+                const BuildTask task = tasks.back();
+                tasks.pop_back();
+
+                const uint32_t first = m_nodes[task.node].first;
+                const uint32_t count = m_nodes[task.node].count;
+                if (count <= 1) continue;
+
+                uint32_t split = 0;
+                if (!choose_split(order, tri_bounds, centroids, m_nodes[task.node], task.depth, split)) {
+                    continue; // Leaf.
+                }
+
+                const uint32_t left = static_cast<uint32_t>(m_nodes.size());
+                m_nodes.push_back(make_node(order, tri_bounds, first, split - first));
+                m_nodes.push_back(make_node(order, tri_bounds, split, first + count - split));
+                m_nodes[task.node].first = left;
+                m_nodes[task.node].count = 0;
+
+                tasks.push_back({ left, task.depth + 1 });
+                tasks.push_back({ left + 1, task.depth + 1 });
+            }
+
+            m_triangles.resize(n);
+            m_triangle_ids.resize(n);
+            for (size_t i = 0; i < n; ++i) {
+                m_triangle_ids[i] = source[order[i]];
+                const auto tri = mesh.triangle(m_triangle_ids[i]);
+                for (size_t k = 0; k < 3; ++k) {
+                    m_triangles[i].v0[k] = tri[0][k].value;
+                    m_triangles[i].e1[k] = tri[1][k].value - tri[0][k].value;
+                    m_triangles[i].e2[k] = tri[2][k].value - tri[0][k].value;
+                }
+                m_triangles[i].edge_scale = (tri[1] - tri[0]).length() * (tri[2] - tri[0]).length();
+            }
+        }
+
+        static Node make_node(const std::vector<uint32_t>& order, const std::vector<Box<3, T>>& tri_bounds, uint32_t first, uint32_t count) {
+            Box<3, T> box;
+            for (uint32_t i = first; i < first + count; ++i) {
+                box.expand(tri_bounds[order[i]]);
+            }
+            Node node;
+            for (size_t k = 0; k < 3; ++k) {
+                node.bounds_min[k] = box.min()[k].value;
+                node.bounds_max[k] = box.max()[k].value;
+            }
+            node.first = first;
+            node.count = count;
+            return node;
+        }
+
+        // Partitions order[first, first + count) and returns true with the split position,
+        // or returns false when the node should stay a leaf.
+        bool choose_split(std::vector<uint32_t>& order, const std::vector<Box<3, T>>& tri_bounds,
+                          const std::vector<point_type>& centroids, const Node& node, uint32_t depth, uint32_t& split) const {
+            const uint32_t first = node.first;
+            const uint32_t count = node.count;
+
+            Box<3, T> centroid_bounds;
+            for (uint32_t i = first; i < first + count; ++i) {
+                centroid_bounds.expand(centroids[order[i]]);
+            }
+            const size_t longest = centroid_bounds.longest_axis();
+            const T longest_extent = centroid_bounds.extent()[longest].value;
+            if (longest_extent <= 0) {
+                return false; // All centroids coincide; no split can separate them.
+            }
+
+            if (depth >= MaxSahDepth) {
+                return median_split(order, centroids, first, count, longest, split);
+            }
+
+            struct Bin {
+                Box<3, T> bounds;
+                uint32_t count = 0;
+            };
+
+            T best_cost = std::numeric_limits<T>::infinity();
+            size_t best_axis = 0;
+            size_t best_bin = 0;
+
+            for (size_t axis = 0; axis < 3; ++axis) {
+                const T axis_min = centroid_bounds.min()[axis].value;
+                const T axis_extent = centroid_bounds.max()[axis].value - axis_min;
+                if (axis_extent <= 0) continue;
+                const T scale = T(BinCount) / axis_extent;
+
+                std::array<Bin, BinCount> bins;
+                for (uint32_t i = first; i < first + count; ++i) {
+                    const uint32_t id = order[i];
+                    const size_t b = std::min(BinCount - 1, static_cast<size_t>((centroids[id][axis].value - axis_min) * scale));
+                    bins[b].count++;
+                    bins[b].bounds.expand(tri_bounds[id]);
+                }
+
+                // Sweep from the right to get suffix areas, then from the left to evaluate every plane.
+                std::array<T, BinCount> right_area;
+                std::array<uint32_t, BinCount> right_count;
+                Box<3, T> right_box;
+                uint32_t right_sum = 0;
+                for (size_t b = BinCount - 1; b > 0; --b) {
+                    right_box.expand(bins[b].bounds);
+                    right_sum += bins[b].count;
+                    right_area[b] = right_sum > 0 ? right_box.surface_area() : T(0);
+                    right_count[b] = right_sum;
+                }
+
+                Box<3, T> left_box;
+                uint32_t left_sum = 0;
+                for (size_t b = 0; b + 1 < BinCount; ++b) {
+                    left_box.expand(bins[b].bounds);
+                    left_sum += bins[b].count;
+                    if (left_sum == 0 || right_count[b + 1] == 0) continue;
+                    const T cost = left_box.surface_area() * left_sum + right_area[b + 1] * right_count[b + 1];
+                    if (cost < best_cost) {
+                        best_cost = cost;
+                        best_axis = axis;
+                        best_bin = b;
+                    }
+                }
+            }
+
+            Box<3, T> node_box(point_type(node.bounds_min[0], node.bounds_min[1], node.bounds_min[2]),
+                               point_type(node.bounds_max[0], node.bounds_max[1], node.bounds_max[2]));
+            const T node_area = node_box.surface_area();
+            // Traversal costs roughly one triangle test, so splitting pays off when 1 + SAH < count.
+            const T split_cost = T(1) + (node_area > 0 ? best_cost / node_area : T(count));
+            if (count <= m_max_leaf_size && split_cost >= T(count)) {
+                return false;
+            }
+            if (best_cost == std::numeric_limits<T>::infinity()) {
+                return median_split(order, centroids, first, count, longest, split);
+            }
+
+            const T axis_min = centroid_bounds.min()[best_axis].value;
+            const T scale = T(BinCount) / (centroid_bounds.max()[best_axis].value - axis_min);
+            auto middle = std::partition(order.begin() + first, order.begin() + first + count, [&](uint32_t id) {
+                const size_t b = std::min(BinCount - 1, static_cast<size_t>((centroids[id][best_axis].value - axis_min) * scale));
+                return b <= best_bin;
+            });
+            split = static_cast<uint32_t>(middle - order.begin());
+            if (split == first || split == first + count) {
+                return median_split(order, centroids, first, count, longest, split);
+            }
+            return true;
+        }
+
+        static bool median_split(std::vector<uint32_t>& order, const std::vector<point_type>& centroids,
+                                 uint32_t first, uint32_t count, size_t axis, uint32_t& split) {
+            split = first + count / 2;
+            std::nth_element(order.begin() + first, order.begin() + split, order.begin() + first + count,
+                [&](uint32_t a, uint32_t b) { return centroids[a][axis].value < centroids[b][axis].value; });
+            return true;
+        }
+    };
+
+    using MeshBVH3d = MeshBVH<double>;
+
+
+} // namespace geom
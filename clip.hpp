@@ -0,0 +1,197 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <optional>
+#include <vector>
+#include "vector.hpp"
+#include "line.hpp"
+#include "ray.hpp"
+#include "segment.hpp"
+#include "algorithms.hpp"
+#include "polygon.hpp"
+
+namespace geom {
+
+    // Parameter range [t_enter, t_leave] of a primitive that lies inside the clip region.
+    // Parameters follow each primitive's own parametrization: p1 + t * (p2 - p1) for segments,
+    // point_at(t) for rays and lines.
+    template<typename T>
+    struct ClipInterval {
+        T t_enter;
+        T t_leave;
+
+        bool empty() const { return t_enter > t_leave; }
+    };
+
+    // Cyrus-Beck clipper for a convex polygon. Edge normals and offsets are computed once, in
+    // structure-of-arrays form, so batches can be clipped edge by edge in branch-free loops.
+    // (GCC only if-converts the floating-point selects into vector code with -fno-trapping-math.)
+    template<typename T>
+    class ConvexClipper {
+    public:
+        using point_type = Point<2, T>;
+        using vector_type = Vector<2, T>;
+
+        static constexpr size_t BatchBlock = 256;
+
+    private:
+        // A point p is inside edge k when m_nx[k] * p.x + m_ny[k] * p.y - m_offset[k] >= 0.
+        std::vector<T> m_nx;
+        std::vector<T> m_ny;
+        std::vector<T> m_offset;
+
+    public:
+        template<typename Allocator>
+        explicit ConvexClipper(const Polygon<2, T, Allocator>& convex_polygon) {
+            const auto& v = convex_polygon.vertices();
+            const size_t n = v.size();
+
+            T signed_area = 0;
+            for (size_t i = 0, j = n - 1; i < n; j = i++) {
+                signed_area += cross_product(v[j], v[i]);
+            }
+            const T orientation = signed_area >= 0 ? T(1) : T(-1);
+
+            m_nx.reserve(n);
+            m_ny.reserve(n);
+            m_offset.reserve(n);
+            for (size_t i = 0, j = n - 1; i < n; j = i++) {
+                const T ex = v[i][0].value - v[j][0].value;
+                const T ey = v[i][1].value - v[j][1].value;
+                if (ex * ex + ey * ey < Coord<T>::Epsilon * Coord<T>::Epsilon) {
+                    continue; // Repeated vertex.
+                }
+                // Inward normal: left of the edge for counter-clockwise polygons.
+                const T nx = -ey * orientation;
+                const T ny = ex * orientation;
+                m_nx.push_back(nx);
+                m_ny.push_back(ny);
+                m_offset.push_back(nx * v[j][0].value + ny * v[j][1].value);
+            }
+
+#ifndef NDEBUG
+            for (size_t k = 0; k < m_nx.size(); ++k) {
+                for (size_t i = 0; i < n; ++i) {
+                    const T side = m_nx[k] * v[i][0].value + m_ny[k] * v[i][1].value - m_offset[k];
+                    const T scale = std::sqrt(m_nx[k] * m_nx[k] + m_ny[k] * m_ny[k]);
+                    assert(side >= -Coord<T>::Epsilon * std::max(T(1), scale) && "ConvexClipper requires a convex polygon.");
+                    (void)side; (void)scale;
+                }
+            }
+#endif
+        }
+
+        size_t num_edges() const { return m_nx.size(); }
+
+        ClipInterval<T> clip(const Segment<2, T>& segment) const {
+            const vector_type d = segment.p2() - segment.p1();
+            return clip_parametric(segment.p1()[0].value, segment.p1()[1].value, d[0].value, d[1].value, T(0), T(1));
+        }
+
+        ClipInterval<T> clip(const Ray<2, T>& ray) const {
+            return clip_parametric(ray.origin()[0].value, ray.origin()[1].value, ray.direction()[0].value, ray.direction()[1].value,
+                                   T(0), std::numeric_limits<T>::infinity());
+        }
+
+        ClipInterval<T> clip(const Line<2, T>& line) const {
+            return clip_parametric(line.origin()[0].value, line.origin()[1].value, line.direction()[0].value, line.direction()[1].value,
+                                   -std::numeric_limits<T>::infinity(), std::numeric_limits<T>::infinity());
+        }
+
+        std::optional<Segment<2, T>> clipped(const Segment<2, T>& segment) const {
+            const ClipInterval<T> range = clip(segment);
+            if (range.empty()) {
+                return std::nullopt;
+            }
+            const vector_type d = segment.p2() - segment.p1();
+            return Segment<2, T>(segment.p1() + d * range.t_enter, segment.p1() + d * range.t_leave);
+        }
+
+        void clip(const std::vector<Segment<2, T>>& segments, std::vector<ClipInterval<T>>& out) const {
+            clip_batch(segments.size(), out, T(0), T(1), [&](size_t i, T& px, T& py, T& dx, T& dy) {
+                const auto& s = segments[i];
+                px = s.p1()[0].value;
+                py = s.p1()[1].value;
+                dx = s.p2()[0].value - px;
+                dy = s.p2()[1].value - py;
+            });
+        }
+
+        void clip(const std::vector<Ray<2, T>>& rays, std::vector<ClipInterval<T>>& out) const {
+            clip_batch(rays.size(), out, T(0), std::numeric_limits<T>::infinity(), [&](size_t i, T& px, T& py, T& dx, T& dy) {
+                const auto& r = rays[i];
+                px = r.origin()[0].value;
+                py = r.origin()[1].value;
+                dx = r.direction()[0].value;
+                dy = r.direction()[1].value;
+            });
+        }
+
+        void clip(const std::vector<Line<2, T>>& lines, std::vector<ClipInterval<T>>& out) const {
+            clip_batch(lines.size(), out, -std::numeric_limits<T>::infinity(), std::numeric_limits<T>::infinity(),
+                [&](size_t i, T& px, T& py, T& dx, T& dy) {
+                    const auto& l = lines[i];
+                    px = l.origin()[0].value;
+                    py = l.origin()[1].value;
+                    dx = l.direction()[0].value;
+                    dy = l.direction()[1].value;
+                });
+        }
+
+    private:
+        // One edge's update of a parametric range. Written with selects only so the batch loop vectorizes.
+        static void update(T num, T den, T& t_enter, T& t_leave) {
+            const T eps = Coord<T>::Epsilon;
+            const bool entering = den >= eps;
+            const bool leaving = den <= -eps;
+            const T t = -num / ((entering | leaving) ? den : T(1));
+            const T enter = (entering & (t > t_enter)) ? t : t_enter;
+            const T leave = (leaving & (t < t_leave)) ? t : t_leave;
+            // A primitive parallel to an edge and outside it is rejected entirely.
+            const bool rejected = !(entering | leaving) & (num < -eps);
+            t_enter = rejected ? std::numeric_limits<T>::infinity() : enter;
+            t_leave = leave;
+        }
+
+        ClipInterval<T> clip_parametric(T px, T py, T dx, T dy, T t_enter, T t_leave) const {
+            for (size_t k = 0; k < m_nx.size(); ++k) {
+                const T num = m_nx[k] * px + m_ny[k] * py - m_offset[k];
+                const T den = m_nx[k] * dx + m_ny[k] * dy;
+                update(num, den, t_enter, t_leave);
+            }
+            return { t_enter, t_leave };
+        }
+
+        // Gathers blocks of primitives into local arrays, then sweeps each edge across the whole block.
+        template<typename Load>
+        void clip_batch(size_t count, std::vector<ClipInterval<T>>& out, T t_min, T t_max, Load&& load) const {
+            out.resize(count);
+            T px[BatchBlock], py[BatchBlock], dx[BatchBlock], dy[BatchBlock];
+            T enter[BatchBlock], leave[BatchBlock];
+
+            for (size_t base = 0; base < count; base += BatchBlock) {
+                const size_t n = std::min(BatchBlock, count - base);
+                for (size_t i = 0; i < n; ++i) {
+                    load(base + i, px[i], py[i], dx[i], dy[i]);
+                    enter[i] = t_min;
+                    leave[i] = t_max;
+                }
+                for (size_t k = 0; k < m_nx.size(); ++k) {
+                    const T nx = m_nx[k], ny = m_ny[k], offset = m_offset[k];
+                    for (size_t i = 0; i < n; ++i) {
+                        update(nx * px[i] + ny * py[i] - offset, nx * dx[i] + ny * dy[i], enter[i], leave[i]);
+                    }
+                }
+                for (size_t i = 0; i < n; ++i) {
+                    out[base + i] = { enter[i], leave[i] };
+                }
+            }
+        }
+    };
+
+    using ConvexClipper2d = ConvexClipper<double>;
+
+
+} // namespace geom
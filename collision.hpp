@@ -0,0 +1,476 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+#include "vector.hpp"
+#include "box.hpp"
+#include "ball.hpp"
+#include "algorithms.hpp"
+#include "polygon.hpp"
+
+namespace geom {
+
+    // Support mappings: the point of a convex shape that is furthest along a direction.
+    // GJK and EPA work with any shape for which an unqualified support(shape, direction) call resolves.
+
+    template<typename T, typename Allocator>
+    Point<2, T> support(const Polygon<2, T, Allocator>& polygon, const Vector<2, T>& direction) {
+        const auto& vertices = polygon.vertices();
+        size_t best = 0;
+        T best_dot = dot_product(vertices[0], direction);
+        for (size_t i = 1; i < vertices.size(); ++i) {
+            const T d = dot_product(vertices[i], direction);
+            if (d > best_dot) {
+                best_dot = d;
+                best = i;
+            }
+        }
+        return vertices[best];
+    }
+
+    template<typename T>
+    Point<2, T> support(const Ball<2, T>& ball, const Vector<2, T>& direction) {
+        const T len = direction.length();
+        if (len <= 0) {
+            return ball.center();
+        }
+        return ball.center() + direction * (ball.radius() / len);
+    }
+
+    template<typename T>
+    struct DistanceResult2D {
+        bool intersecting;
+        T distance;
+        Point<2, T> closest_a;  // Closest points on each shape; only meaningful when not intersecting.
+        Point<2, T> closest_b;
+    };
+
+    template<typename T>
+    struct PenetrationResult2D {
+        bool colliding;
+        T depth;
+        Vector<2, T> normal;    // Unit vector pointing from A towards B; moving A by -normal * depth separates them.
+    };
+
+    namespace detail {
+
+        template<typename T>
+        struct MinkowskiVertex {
+            Vector<2, T> w;     // a - b
+            Point<2, T> a;
+            Point<2, T> b;
+        };
+
+        template<typename ShapeA, typename ShapeB, typename T>
+        MinkowskiVertex<T> minkowski_support(const ShapeA& a, const ShapeB& b, const Vector<2, T>& direction) {
+            const Point<2, T> pa = support(a, direction);
+            const Point<2, T> pb = support(b, Vector<2, T>(-direction[0].value, -direction[1].value));
+            return { pa - pb, pa, pb };
+        }
+
+        // GJK simplex in 2D: up to three Minkowski vertices and their barycentric weights for the
+        // point closest to the origin.
+        template<typename T>
+        struct Simplex2 {
+            MinkowskiVertex<T> v[3];
+            T lambda[3];
+            size_t size = 0;
+
+            Vector<2, T> closest() const {
+                Vector<2, T> result;
+                for (size_t i = 0; i < size; ++i) result += v[i].w * lambda[i];
+                return result;
+            }
+
+            void keep(std::initializer_list<size_t> indices, std::initializer_list<T> weights) {
+                MinkowskiVertex<T> kept[3];
+                T kept_lambda[3];
+                size_t n = 0;
+                auto w = weights.begin();
+                for (size_t i : indices) {
+                    kept[n] = v[i];
+                    kept_lambda[n] = *w++;
+                    ++n;
+                }
+                for (size_t i = 0; i < n; ++i) {
+                    v[i] = kept[i];
+                    lambda[i] = kept_lambda[i];
+                }
+                size = n;
+            }
+
+            // Reduces the simplex to the smallest face containing the point closest to the origin.
+            // Returns true when the origin lies inside the triangle.
+            bool solve() {
+                if (size == 1) {
+                    lambda[0] = 1;
+                    return false;
+                }
+                if (size == 2) {
+                    solve_segment(0, 1);
+                    return false;
+                }
+                return solve_triangle();
+            }
+
+        private:
+            void solve_segment(size_t i, size_t j) {
+                const Vector<2, T> a = v[i].w, b = v[j].w;
+                const Vector<2, T> ab = b - a;
+                const T len_sq = ab.length_sq();
+                const T t = len_sq > 0 ? -dot_product(a, ab) / len_sq : T(0);
+                if (t <= 0) keep({ i }, { T(1) });
+                else if (t >= 1) keep({ j }, { T(1) });
+                else keep({ i, j }, { T(1) - t, t });
+            }
+
+            // Closest point of a triangle to the origin (Ericson, Real-Time Collision Detection 5.1.5).
+            bool solve_triangle() {
+                const Vector<2, T> a = v[0].w, b = v[1].w, c = v[2].w;
+                const Vector<2, T> ab = b - a, ac = c - a, ap = Vector<2, T>() - a;
+
+                const T d1 = dot_product(ab, ap), d2 = dot_product(ac, ap);
+                if (d1 <= 0 && d2 <= 0) { keep({ 0 }, { T(1) }); return false; }
+
+                const Vector<2, T> bp = Vector<2, T>() - b;
+                const T d3 = dot_product(ab, bp), d4 = dot_product(ac, bp);
+                if (d3 >= 0 && d4 <= d3) { keep({ 1 }, { T(1) }); return false; }
+
+                const T vc = d1 * d4 - d3 * d2;
+                if (vc <= 0 && d1 >= 0 && d3 <= 0) {
+                    const T t = d1 / (d1 - d3);
+                    keep({ 0, 1 }, { T(1) - t, t });
+                    return false;
+                }
+
+                const Vector<2, T> cp = Vector<2, T>() - c;
+                const T d5 = dot_product(ab, cp), d6 = dot_product(ac, cp);
+                if (d6 >= 0 && d5 <= d6) { keep({ 2 }, { T(1) }); return false; }
+
+                const T vb = d5 * d2 - d1 * d6;
+                if (vb <= 0 && d2 >= 0 && d6 <= 0) {
+                    const T t = d2 / (d2 - d6);
+                    keep({ 0, 2 }, { T(1) - t, t });
+                    return false;
+                }
+
+                const T va = d3 * d6 - d5 * d4;
+                if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0) {
+                    const T t = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+                    keep({ 1, 2 }, { T(1) - t, t });
+                    return false;
+                }
+
+                const T denom = T(1) / (va + vb + vc);
+                lambda[0] = va * denom;
+                lambda[1] = vb * denom;
+                lambda[2] = vc * denom;
+                return true;
+            }
+        };
+
+        template<typename ShapeA, typename ShapeB, typename T>
+        bool run_gjk(const ShapeA& a, const ShapeB& b, Simplex2<T>& simplex, Vector<2, T>& closest) {
+            constexpr size_t MaxIterations = 64;
+            const T eps = Coord<T>::Epsilon;
+
+            simplex.v[0] = minkowski_support(a, b, Vector<2, T>(T(1), T(0)));
+            simplex.lambda[0] = 1;
+            simplex.size = 1;
+            closest = simplex.v[0].w;
+
+            for (size_t iter = 0; iter < MaxIterations; ++iter) {
+                const T closest_sq = closest.length_sq();
+                if (closest_sq <= eps * eps) {
+                    return true; // Touching: the origin is on the Minkowski difference.
+                }
+
+                const MinkowskiVertex<T> w = minkowski_support(a, b, Vector<2, T>(-closest[0].value, -closest[1].value));
+                // No further progress towards the origin: closest is the distance vector.
+                if (closest_sq - dot_product(closest, w.w) <= eps * std::max(T(1), closest_sq)) {
+                    return false;
+                }
+                for (size_t i = 0; i < simplex.size; ++i) {
+                    if ((simplex.v[i].w - w.w).length_sq() <= eps * eps) return false;
+                }
+
+                simplex.v[simplex.size++] = w;
+                if (simplex.solve()) {
+                    closest = Vector<2, T>();
+                    return true;
+                }
+                closest = simplex.closest();
+            }
+            return closest.length_sq() <= eps * eps;
+        }
+
+    } // namespace detail
+
+    // GJK boolean overlap test for convex support-mapped shapes.
+    template<typename ShapeA, typename ShapeB, typename T = typename ShapeA::point_type::value_type>
+    bool gjk_intersects(const ShapeA& a, const ShapeB& b) {
+        detail::Simplex2<T> simplex;
+        Vector<2, T> closest;
+        return detail::run_gjk(a, b, simplex, closest);
+    }
+
+    // GJK distance query. Returns the separation and the closest points when the shapes are disjoint.
+    template<typename ShapeA, typename ShapeB, typename T = typename ShapeA::point_type::value_type>
+    DistanceResult2D<T> gjk_distance(const ShapeA& a, const ShapeB& b) {
+        detail::Simplex2<T> simplex;
+        Vector<2, T> closest;
+        if (detail::run_gjk(a, b, simplex, closest)) {
+            return { true, T(0), Point<2, T>(), Point<2, T>() };
+        }
+        Point<2, T> pa, pb;
+        for (size_t i = 0; i < simplex.size; ++i) {
+            pa += simplex.v[i].a * simplex.lambda[i];
+            pb += simplex.v[i].b * simplex.lambda[i];
+        }
+        return { false, closest.length(), pa, pb };
+    }
+
+    // GJK followed by the expanding polytope algorithm for the penetration depth and normal.
+    template<typename ShapeA, typename ShapeB, typename T = typename ShapeA::point_type::value_type>
+    PenetrationResult2D<T> epa_penetration(const ShapeA& a, const ShapeB& b) {
+        constexpr size_t MaxIterations = 64;
+        const T eps = Coord<T>::Epsilon;
+
+        detail::Simplex2<T> simplex;
+        Vector<2, T> closest;
+        if (!detail::run_gjk(a, b, simplex, closest)) {
+            return { false, T(0), Vector<2, T>() };
+        }
+
+        // GJK may stop with a point or segment when the shapes only touch; grow it into a triangle.
+        std::vector<detail::MinkowskiVertex<T>> polytope(simplex.v, simplex.v + simplex.size);
+        const Vector<2, T> probes[4] = { Vector<2, T>(T(1), T(0)), Vector<2, T>(T(0), T(1)), Vector<2, T>(T(-1), T(0)), Vector<2, T>(T(0), T(-1)) };
+        for (size_t p = 0; polytope.size() < 3 && p < 4; ++p) {
+            Vector<2, T> dir = probes[p];
+            if (polytope.size() == 2) {
+                const Vector<2, T> e = polytope[1].w - polytope[0].w;
+                dir = (p % 2 == 0) ? Vector<2, T>(-e[1].value, e[0].value) : Vector<2, T>(e[1].value, -e[0].value);
+            }
+            const auto w = detail::minkowski_support(a, b, dir);
+            bool duplicate = false;
+            for (const auto& q : polytope) duplicate = duplicate || (q.w - w.w).length_sq() <= eps * eps;
+            if (polytope.size() == 2 && !duplicate) {
+                duplicate = std::abs(cross_product(polytope[1].w - polytope[0].w, w.w - polytope[0].w)) <= eps * eps;
+            }
+            if (!duplicate) polytope.push_back(w);
+        }
+        if (polytope.size() < 3) {
+            return { true, T(0), Vector<2, T>(T(1), T(0)) }; // Degenerate shapes (segments or points) in contact.
+        }
+        if (cross_product(polytope[1].w - polytope[0].w, polytope[2].w - polytope[0].w) < 0) {
+            std::swap(polytope[1], polytope[2]);
+        }
+
+        Vector<2, T> best_normal(T(1), T(0));
+        T best_distance = 0;
+        for (size_t iter = 0; iter < MaxIterations; ++iter) {
+            // Closest edge of the counter-clockwise polytope to the origin.
+            best_distance = std::numeric_limits<T>::infinity();
+            size_t best_edge = 0;
+            for (size_t i = 0; i < polytope.size(); ++i) {
+                const Vector<2, T>& p = polytope[i].w;
+                const Vector<2, T>& q = polytope[(i + 1) % polytope.size()].w;
+                Vector<2, T> n(q[1].value - p[1].value, p[0].value - q[0].value);
+                const T len = n.length();
+                if (len <= eps) continue;
+                n /= len;
+                const T d = dot_product(n, p);
+                if (d < best_distance) {
+                    best_distance = d;
+                    best_edge = i;
+                    best_normal = n;
+                }
+            }
+
+            const auto w = detail::minkowski_support(a, b, best_normal);
+            if (dot_product(w.w, best_normal) - best_distance <= eps * std::max(T(1), best_distance)) {
+                break;
+            }
+            polytope.insert(polytope.begin() + best_edge + 1, w);
+        }
+        return { true, std::max(T(0), best_distance), best_normal };
+    }
+
+    // Separating axis test for convex polygons. Gives the same depth and normal convention as
+    // epa_penetration, but is exact for polygons and usually faster for small vertex counts.
+    template<typename T, typename AllocatorA, typename AllocatorB>
+    PenetrationResult2D<T> sat_penetration(const Polygon<2, T, AllocatorA>& a, const Polygon<2, T, AllocatorB>& b) {
+        T best_depth = std::numeric_limits<T>::infinity();
+        Vector<2, T> best_normal;
+
+        auto test_axes = [&](const auto& poly) {
+            const auto& v = poly.vertices();
+            for (size_t i = 0, j = v.size() - 1; i < v.size(); j = i++) {
+                Vector<2, T> axis(v[i][1].value - v[j][1].value, v[j][0].value - v[i][0].value);
+                const T len = axis.length();
+                if (len <= Coord<T>::Epsilon) continue;
+                axis /= len;
+
+                T min_a = std::numeric_limits<T>::infinity(), max_a = -min_a;
+                for (const auto& p : a.vertices()) {
+                    const T d = dot_product(p, axis);
+                    min_a = std::min(min_a, d);
+                    max_a = std::max(max_a, d);
+                }
+                T min_b = std::numeric_limits<T>::infinity(), max_b = -min_b;
+                for (const auto& p : b.vertices()) {
+                    const T d = dot_product(p, axis);
+                    min_b = std::min(min_b, d);
+                    max_b = std::max(max_b, d);
+                }
+
+                // Overlap when pushing A in the negative and in the positive axis direction.
+                const T push_negative = max_a - min_b;
+                const T push_positive = max_b - min_a;
+                if (push_negative < -Coord<T>::Epsilon || push_positive < -Coord<T>::Epsilon) {
+                    return false;
+                }
+                if (push_negative < best_depth) {
+                    best_depth = push_negative;
+                    best_normal = axis;
+                }
+                if (push_positive < best_depth) {
+                    best_depth = push_positive;
+                    best_normal = Vector<2, T>(-axis[0].value, -axis[1].value);
+                }
+            }
+            return true;
+        };
+
+        if (!test_axes(a) || !test_axes(b)) {
+            return { false, T(0), Vector<2, T>() };
+        }
+        return { true, std::max(T(0), best_depth), best_normal };
+    }
+
+    // Sort-and-sweep broad phase over axis-aligned bounding boxes. Proxies stay sorted by their
+    // minimum on the sweep axis between frames, so re-sorting after small motions is an insertion
+    // sort over an almost sorted array. New proxies are sorted on their own and merged in, and an
+    // insertion sort that moves too much (after many proxies teleported) gives way to a full sort.
+    template<typename T>
+    class SweepAndPrune {
+    public:
+        using box_type = Box<2, T>;
+        using pair_type = std::pair<uint32_t, uint32_t>;
+
+    private:
+        struct Proxy {
+            box_type box;
+            bool alive;
+        };
+
+        std::vector<Proxy> m_proxies;
+        std::vector<uint32_t> m_free;
+        std::vector<uint32_t> m_order;  // Live proxy ids sorted by box minimum along m_axis.
+        std::vector<uint32_t> m_added;  // Ids added since the last sort, merged into m_order by the next one.
+        size_t m_axis;
+
+    public:
+        explicit SweepAndPrune(size_t axis = 0) : m_axis(axis) {
+            assert(axis < 2 && "Sweep axis must be 0 (x) or 1 (y).");
+        }
+
+        size_t size() const { return m_order.size() + m_added.size(); }
+
+        uint32_t add(const box_type& box) {
+            uint32_t id;
+            if (!m_free.empty()) {
+                id = m_free.back();
+                m_free.pop_back();
+                m_proxies[id] = { box, true };
+            }
+            else {
+                id = static_cast<uint32_t>(m_proxies.size());
+                m_proxies.push_back({ box, true });
+            }
+            m_added.push_back(id);
+            return id;
+        }
+
+        void update(uint32_t id, const box_type& box) {
+            assert(id < m_proxies.size() && m_proxies[id].alive && "Unknown broad phase proxy.");
+            m_proxies[id].box = box;
+        }
+
+        void remove(uint32_t id) {
+            assert(id < m_proxies.size() && m_proxies[id].alive && "Unknown broad phase proxy.");
+            m_proxies[id].alive = false;
+            m_free.push_back(id);
+            auto it = std::find(m_order.begin(), m_order.end(), id);
+            if (it != m_order.end()) m_order.erase(it);
+            else m_added.erase(std::find(m_added.begin(), m_added.end(), id));
+        }
+
+        const box_type& box(uint32_t id) const { return m_proxies[id].box; }
+
+        // Writes every pair of live proxies whose boxes overlap, with the smaller id first.
+        void find_pairs(std::vector<pair_type>& pairs) {
+            pairs.clear();
+            sort_order();
+
+            const size_t other = 1 - m_axis;
+            for (size_t i = 0; i < m_order.size(); ++i) {
+                const box_type& bi = m_proxies[m_order[i]].box;
+                const T max_i = bi.max()[m_axis].value;
+                for (size_t j = i + 1; j < m_order.size(); ++j) {
+                    const box_type& bj = m_proxies[m_order[j]].box;
+                    if (bj.min()[m_axis].value > max_i) break;
+                    if (bj.min()[other].value > bi.max()[other].value || bi.min()[other].value > bj.max()[other].value) continue;
+                    const uint32_t a = m_order[i], b = m_order[j];
+                    pairs.push_back(a < b ? pair_type(a, b) : pair_type(b, a));
+                }
+            }
+        }
+
+    private:
+        void sort_order() {
+            auto less = [this](uint32_t a, uint32_t b) {
+                return m_proxies[a].box.min()[m_axis].value < m_proxies[b].box.min()[m_axis].value;
+            };
+            if (!insertion_sort(4 * m_order.size() + 64)) {
+                std::sort(m_order.begin(), m_order.end(), less);
+            }
+            if (!m_added.empty()) {
+                std::sort(m_added.begin(), m_added.end(), less);
+                const size_t middle = m_order.size();
+                m_order.insert(m_order.end(), m_added.begin(), m_added.end());
+                std::inplace_merge(m_order.begin(), m_order.begin() + middle, m_order.end(), less);
+                m_added.clear();
+            }
+        }
+
+        // Returns false, with m_order still a permutation of the ids, once more than max_moves
+        // element moves would be needed.
+        bool insertion_sort(size_t max_moves) {
+            size_t moves = 0;
+            for (size_t i = 1; i < m_order.size(); ++i) {
+                const uint32_t id = m_order[i];
+                const T key = m_proxies[id].box.min()[m_axis].value;
+                size_t j = i;
+                while (j > 0 && m_proxies[m_order[j - 1]].box.min()[m_axis].value > key) {
+                    if (++moves > max_moves) {
+                        m_order[j] = id;
+                        return false;
+                    }
+                    m_order[j] = m_order[j - 1];
+                    --j;
+                }
+                m_order[j] = id;
+            }
+            return true;
+        }
+    };
+
+    using SweepAndPrune2d = SweepAndPrune<double>;
+
+
+} // namespace geom
@@ -4,15 +4,47 @@
 #include <type_traits>
 #include <iostream>
 
+// Absolute tolerances used by Coord comparisons and every geometric predicate. Override one by
+// defining it before including any geom header.
+#ifndef GEOM_FLOAT_EPSILON
+#define GEOM_FLOAT_EPSILON 1e-5f
+#endif
+#ifndef GEOM_DOUBLE_EPSILON
+#define GEOM_DOUBLE_EPSILON 1e-9
+#endif
+#ifndef GEOM_LONG_DOUBLE_EPSILON
+#define GEOM_LONG_DOUBLE_EPSILON 1e-12L
+#endif
+
 namespace geom {
 
+    // Per-type tolerance policy. float has roughly 7 significant digits, so it cannot share the
+    // tolerance of double; specialize for other floating-point types.
+    template<typename T>
+    struct ToleranceTraits;
+
+    template<>
+    struct ToleranceTraits<float> {
+        static constexpr float Epsilon = GEOM_FLOAT_EPSILON;
+    };
+
+    template<>
+    struct ToleranceTraits<double> {
+        static constexpr double Epsilon = GEOM_DOUBLE_EPSILON;
+    };
+
+    template<>
+    struct ToleranceTraits<long double> {
+        static constexpr long double Epsilon = GEOM_LONG_DOUBLE_EPSILON;
+    };
+
     template<typename T>
     struct Coord {
         T value;
 
         static_assert(std::is_floating_point<T>::value, "Coord<T> is intended for floating-point types like double or float.");
 
-        static constexpr T Epsilon = 1e-9;
+        static constexpr T Epsilon = ToleranceTraits<T>::Epsilon;
 
         Coord() : value(0) {}
         Coord(const T& val) : value(val) {} // թույլ է տալիս գրել Coord c = 5.0;
@@ -0,0 +1,557 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "vector.hpp"
+#include "box.hpp"
+#include "segment.hpp"
+#include "algorithms.hpp"
+#include "polygon.hpp"
+#include "polygon_collection.hpp"
+#include "spatial_sort.hpp"
+#include "parallel.hpp"
+
+namespace geom {
+
+    // Doubly-connected edge list of the planar subdivision induced by a set of segments. All
+    // records live in flat arrays and refer to each other by index; the half-edges of one edge are
+    // stored next to each other, so the twin of half-edge h is h ^ 1.
+    template<typename T>
+    class Dcel {
+    public:
+        using point_type = Point<2, T>;
+
+        static constexpr uint32_t Invalid = std::numeric_limits<uint32_t>::max();
+
+        struct Vertex {
+            point_type point;
+            uint32_t edge;      // Some half-edge leaving the vertex.
+        };
+
+        struct HalfEdge {
+            uint32_t origin;
+            uint32_t next;      // Next half-edge along the face to the left.
+            uint32_t prev;
+            uint32_t face;
+            uint32_t source;    // Input segment this edge was cut from (the first one, for shared edges).
+            int32_t winding;    // Input segments running along this half-edge minus those running against it.
+        };
+
+        struct Face {
+            uint32_t outer_edge;    // Half-edge on the counter-clockwise outer boundary; Invalid for the unbounded face.
+            uint32_t first_hole;    // Range into hole_edges() of one half-edge per inner boundary.
+            uint32_t num_holes;
+        };
+
+    private:
+        std::vector<Vertex> m_vertices;
+        std::vector<HalfEdge> m_half_edges;
+        std::vector<Face> m_faces;
+        std::vector<uint32_t> m_hole_edges;
+
+        Dcel() = default;
+
+    public:
+        // Nodes the segments at their intersections and overlaps (as reported by intersection()),
+        // merges endpoints closer than tolerance and links the resulting half-edges into faces.
+        // Face 0 is the unbounded face.
+        static Dcel from_segments(const std::vector<Segment<2, T>>& segments, T tolerance = Coord<T>::Epsilon, size_t num_threads = 0) {
+            Dcel dcel;
+            std::vector<SplitPoint> splits = node_segments(segments, num_threads);
+            std::vector<RawEdge> edges = dcel.build_vertices_and_edges(splits, tolerance);
+            dcel.build_half_edges(edges);
+            dcel.build_faces();
+            return dcel;
+        }
+
+        const std::vector<Vertex>& vertices() const { return m_vertices; }
+        const std::vector<HalfEdge>& half_edges() const { return m_half_edges; }
+        const std::vector<Face>& faces() const { return m_faces; }
+        const std::vector<uint32_t>& hole_edges() const { return m_hole_edges; }
+
+        size_t num_vertices() const { return m_vertices.size(); }
+        size_t num_edges() const { return m_half_edges.size() / 2; }
+        size_t num_faces() const { return m_faces.size(); }
+
+        static uint32_t twin(uint32_t h) { return h ^ 1u; }
+        uint32_t target(uint32_t h) const { return m_half_edges[twin(h)].origin; }
+
+        // Vertices of the boundary cycle starting at half-edge h.
+        std::vector<point_type> cycle_points(uint32_t h) const {
+            std::vector<point_type> points;
+            uint32_t e = h;
+            do {
+                points.push_back(m_vertices[m_half_edges[e].origin].point);
+                e = m_half_edges[e].next;
+            } while (e != h);
+            return points;
+        }
+
+        // Outer boundary of a bounded face. Dangling edges inside the face appear twice.
+        Polygon<2, T> face_polygon(size_t face) const {
+            assert(face > 0 && face < m_faces.size() && "Only bounded faces have an outer boundary.");
+            return Polygon<2, T>(cycle_points(m_faces[face].outer_edge));
+        }
+
+        // Every bounded face as a polygon, in face order (face i is at index i - 1).
+        std::vector<Polygon<2, T>> face_polygons() const {
+            std::vector<Polygon<2, T>> polygons;
+            polygons.reserve(m_faces.size() - 1);
+            for (size_t f = 1; f < m_faces.size(); ++f) polygons.push_back(face_polygon(f));
+            return polygons;
+        }
+
+        // Bounded faces with their holes; face i becomes polygon i - 1.
+        PolygonCollection<T> to_collection() const {
+            PolygonCollection<T> collection;
+            for (size_t f = 1; f < m_faces.size(); ++f) {
+                const Face& face = m_faces[f];
+                std::vector<std::vector<point_type>> holes;
+                for (uint32_t k = 0; k < face.num_holes; ++k) {
+                    holes.push_back(cycle_points(m_hole_edges[face.first_hole + k]));
+                }
+                collection.add_polygon(cycle_points(face.outer_edge), holes);
+            }
+            return collection;
+        }
+
+    private:
+        struct SplitPoint {
+            uint32_t segment;
+            T t;                // Position along the segment, 0 at p1 and 1 at p2.
+            point_type point;
+        };
+
+        struct RawEdge {
+            uint32_t u, v;      // u < v.
+            uint32_t source;
+            int32_t winding;    // +1 when the source segment runs from u to v.
+        };
+
+        static T parameter(const Segment<2, T>& s, const point_type& p) {
+            const Vector<2, T> d = s.p2() - s.p1();
+            const T len_sq = d.length_sq();
+            return len_sq > 0 ? std::clamp(dot_product(p - s.p1(), d) / len_sq, T(0), T(1)) : T(0);
+        }
+
+        // Candidate pairs come from a uniform grid sized to the segment lengths; a pair is tested
+        // only in the cell holding the lower-left corner of the overlap of its bounding boxes.
+        static std::vector<SplitPoint> node_segments(const std::vector<Segment<2, T>>& segments, size_t num_threads) {
+            const size_t n = segments.size();
+            std::vector<T> min_x(n), max_x(n), min_y(n), max_y(n);
+            Box<2, T> bounds;
+            T mean_extent = 0;
+            for (size_t i = 0; i < n; ++i) {
+                const auto& s = segments[i];
+                min_x[i] = std::min(s.p1()[0].value, s.p2()[0].value) - Coord<T>::Epsilon;
+                max_x[i] = std::max(s.p1()[0].value, s.p2()[0].value) + Coord<T>::Epsilon;
+                min_y[i] = std::min(s.p1()[1].value, s.p2()[1].value) - Coord<T>::Epsilon;
+                max_y[i] = std::max(s.p1()[1].value, s.p2()[1].value) + Coord<T>::Epsilon;
+                bounds.expand(point_type(min_x[i], min_y[i]));
+                bounds.expand(point_type(max_x[i], max_y[i]));
+                mean_extent += std::max(max_x[i] - min_x[i], max_y[i] - min_y[i]);
+            }
+
+            std::vector<SplitPoint> splits;
+            splits.reserve(2 * n);
+            for (uint32_t i = 0; i < n; ++i) {
+                splits.push_back({ i, T(0), segments[i].p1() });
+                splits.push_back({ i, T(1), segments[i].p2() });
+            }
+            if (n < 2) {
+                return splits;
+            }
+
+            const T width = bounds.max()[0].value - bounds.min()[0].value;
+            const T height = bounds.max()[1].value - bounds.min()[1].value;
+            mean_extent /= T(n);
+            const T cell = std::max({ mean_extent, std::sqrt(width * height / T(n)), std::max(width, height) / T(4096) });
+            const size_t cells_x = std::max<size_t>(1, static_cast<size_t>(width / cell));
+            const size_t cells_y = std::max<size_t>(1, static_cast<size_t>(height / cell));
+            const T inv_x = width > 0 ? T(cells_x) / width : T(0);
+            const T inv_y = height > 0 ? T(cells_y) / height : T(0);
+            auto cell_x = [&](T x) { return std::min(cells_x - 1, static_cast<size_t>(std::max(T(0), (x - bounds.min()[0].value) * inv_x))); };
+            auto cell_y = [&](T y) { return std::min(cells_y - 1, static_cast<size_t>(std::max(T(0), (y - bounds.min()[1].value) * inv_y))); };
+
+            // Segments per cell in CSR form.
+            std::vector<uint32_t> offsets(cells_x * cells_y + 1, 0);
+            std::vector<uint32_t> entries;
+            for (int pass = 0; pass < 2; ++pass) {
+                std::vector<uint32_t> fill;
+                if (pass == 1) {
+                    for (size_t c = 0; c + 1 < offsets.size(); ++c) offsets[c + 1] += offsets[c];
+                    entries.resize(offsets.back());
+                    fill.assign(offsets.begin(), offsets.end() - 1);
+                }
+                for (uint32_t i = 0; i < n; ++i) {
+                    const size_t x1 = cell_x(max_x[i]), y1 = cell_y(max_y[i]);
+                    for (size_t y = cell_y(min_y[i]); y <= y1; ++y) {
+                        for (size_t x = cell_x(min_x[i]); x <= x1; ++x) {
+                            if (pass == 0) ++offsets[y * cells_x + x + 1];
+                            else entries[fill[y * cells_x + x]++] = i;
+                        }
+                    }
+                }
+            }
+
+            std::mutex merge_mutex;
+            parallel_for(cells_x * cells_y, [&](size_t begin, size_t end) {
+                std::vector<SplitPoint> local;
+                auto split = [&](uint32_t s, const point_type& p) {
+                    local.push_back({ s, parameter(segments[s], p), p });
+                };
+                for (size_t c = begin; c < end; ++c) {
+                    for (uint32_t ia = offsets[c]; ia < offsets[c + 1]; ++ia) {
+                        const uint32_t a = entries[ia];
+                        for (uint32_t ib = ia + 1; ib < offsets[c + 1]; ++ib) {
+                            const uint32_t b = entries[ib];
+                            if (min_x[b] > max_x[a] || min_x[a] > max_x[b] || min_y[b] > max_y[a] || min_y[a] > max_y[b]) continue;
+                            if (cell_y(std::max(min_y[a], min_y[b])) * cells_x + cell_x(std::max(min_x[a], min_x[b])) != c) continue;
+
+                            const auto result = intersection(segments[a], segments[b]);
+                            using Status = typename SegmentIntersectionResult2D<T>::Status;
+                            if (result.status == Status::INTERSECTING) {
+                                split(a, *result.point);
+                                split(b, *result.point);
+                            }
+                            else if (result.status == Status::OVERLAPPING) {
+                                // Collinear overlap: each segment is cut where the other one ends.
+                                for (const point_type& p : { segments[b].p1(), segments[b].p2() }) {
+                                    if (contains(p, segments[a])) split(a, p);
+                                }
+                                for (const point_type& p : { segments[a].p1(), segments[a].p2() }) {
+                                    if (contains(p, segments[b])) split(b, p);
+                                }
+                            }
+                        }
+                    }
+                }
+                std::lock_guard<std::mutex> lock(merge_mutex);
+                splits.insert(splits.end(), local.begin(), local.end());
+            }, num_threads, 256);
+
+            std::sort(splits.begin(), splits.end(), [](const SplitPoint& a, const SplitPoint& b) {
+                return a.segment != b.segment ? a.segment < b.segment : a.t < b.t;
+            });
+            return splits;
+        }
+
+        // Merges split points closer than the tolerance into vertices. Points are bucketed by a
+        // hashed grid cell much larger than the tolerance and radix sorted by bucket; points near a
+        // cell border are also compared with the neighbouring buckets, found by binary search.
+        // Every segment is then cut into edges between consecutive distinct vertices.
+        std::vector<RawEdge> build_vertices_and_edges(const std::vector<SplitPoint>& splits, T tolerance) {
+            assert(tolerance > 0 && "Vertex merge tolerance must be positive.");
+            const size_t m = splits.size();
+            const T cell_size = 1024 * tolerance;
+            const T inv_cell = T(1) / cell_size;
+            auto cell_key = [](int64_t cx, int64_t cy) {
+                return static_cast<uint64_t>(cx) * 0x9E3779B97F4A7C15ull ^ static_cast<uint64_t>(cy);
+            };
+            auto close = [&](uint32_t a, uint32_t b) {
+                return (splits[a].point - splits[b].point).length_sq() <= tolerance * tolerance;
+            };
+
+            std::vector<int64_t> cells(2 * m);
+            std::vector<uint8_t> border(m);
+            std::vector<uint64_t> keys(m);
+            std::vector<uint32_t> order(m);
+            for (uint32_t i = 0; i < m; ++i) {
+                const point_type& p = splits[i].point;
+                const T fx = std::floor(p[0].value * inv_cell), fy = std::floor(p[1].value * inv_cell);
+                const T offset_x = p[0].value - fx * cell_size, offset_y = p[1].value - fy * cell_size;
+                cells[2 * i] = static_cast<int64_t>(fx);
+                cells[2 * i + 1] = static_cast<int64_t>(fy);
+                border[i] = uint8_t((offset_x < tolerance) | ((cell_size - offset_x < tolerance) << 1) |
+                                    ((offset_y < tolerance) << 2) | ((cell_size - offset_y < tolerance) << 3));
+                keys[i] = cell_key(cells[2 * i], cells[2 * i + 1]);
+                order[i] = i;
+            }
+            radix_sort(keys, order);
+
+            // Union-find over split points, linking each point to a close point in its own or a neighbouring cell.
+            std::vector<uint32_t> parent(m);
+            for (uint32_t i = 0; i < m; ++i) parent[i] = i;
+            auto find = [&](uint32_t i) {
+                while (parent[i] != i) {
+                    parent[i] = parent[parent[i]];
+                    i = parent[i];
+                }
+                return i;
+            };
+            auto unite = [&](uint32_t a, uint32_t b) {
+                a = find(a);
+                b = find(b);
+                if (a != b) parent[std::max(a, b)] = std::min(a, b);
+            };
+
+            for (size_t g0 = 0, g1 = 0; g0 < m; g0 = g1) {
+                while (g1 < m && keys[g1] == keys[g0]) ++g1;
+                for (size_t k = g0 + 1; k < g1; ++k) {
+                    for (size_t j = g0; j < k; ++j) {
+                        if (close(order[k], order[j])) {
+                            unite(order[k], order[j]);
+                            break;
+                        }
+                    }
+                }
+            }
+            for (uint32_t i = 0; i < m; ++i) {
+                if (border[i] == 0) continue;
+                const int64_t x0 = (border[i] & 1) ? -1 : 0, x1 = (border[i] & 2) ? 1 : 0;
+                const int64_t y0 = (border[i] & 4) ? -1 : 0, y1 = (border[i] & 8) ? 1 : 0;
+                for (int64_t dx = x0; dx <= x1; ++dx) {
+                    for (int64_t dy = y0; dy <= y1; ++dy) {
+                        if (dx == 0 && dy == 0) continue;
+                        const auto range = std::equal_range(keys.begin(), keys.end(), cell_key(cells[2 * i] + dx, cells[2 * i + 1] + dy));
+                        for (auto it = range.first; it != range.second; ++it) {
+                            const uint32_t j = order[it - keys.begin()];
+                            if (close(i, j)) unite(i, j);
+                        }
+                    }
+                }
+            }
+
+            // Each cluster becomes a vertex at the position of its first split point.
+            std::vector<uint32_t> split_vertex(m, Invalid);
+            for (uint32_t i = 0; i < m; ++i) {
+                const uint32_t root = find(i);
+                if (split_vertex[root] == Invalid) {
+                    split_vertex[root] = static_cast<uint32_t>(m_vertices.size());
+                    m_vertices.push_back({ splits[root].point, Invalid });
+                }
+                split_vertex[i] = split_vertex[root];
+            }
+
+            std::vector<RawEdge> edges;
+            edges.reserve(splits.size());
+            for (size_t i = 0; i + 1 < splits.size(); ++i) {
+                if (splits[i].segment != splits[i + 1].segment) continue;
+                const uint32_t u = split_vertex[i], v = split_vertex[i + 1];
+                if (u == v) continue;
+                edges.push_back({ std::min(u, v), std::max(u, v), splits[i].segment, u < v ? 1 : -1 });
+            }
+
+            // Overlapping input produces the same edge several times; keep one and sum the windings.
+            std::sort(edges.begin(), edges.end(), [](const RawEdge& a, const RawEdge& b) {
+                if (a.u != b.u) return a.u < b.u;
+                if (a.v != b.v) return a.v < b.v;
+                return a.source < b.source;
+            });
+            size_t unique = 0;
+            for (size_t i = 0; i < edges.size(); ++i) {
+                if (unique > 0 && edges[unique - 1].u == edges[i].u && edges[unique - 1].v == edges[i].v) {
+                    edges[unique - 1].winding += edges[i].winding;
+                }
+                else {
+                    edges[unique++] = edges[i];
+                }
+            }
+            edges.resize(unique);
+            return edges;
+        }
+
+        void build_half_edges(const std::vector<RawEdge>& edges) {
+            m_half_edges.resize(2 * edges.size());
+            for (size_t e = 0; e < edges.size(); ++e) {
+                m_half_edges[2 * e] = { edges[e].u, Invalid, Invalid, Invalid, edges[e].source, edges[e].winding };
+                m_half_edges[2 * e + 1] = { edges[e].v, Invalid, Invalid, Invalid, edges[e].source, -edges[e].winding };
+            }
+
+            // Outgoing half-edges of every vertex in CSR form, sorted counter-clockwise by angle.
+            std::vector<uint32_t> offsets(m_vertices.size() + 1, 0);
+            for (const HalfEdge& h : m_half_edges) ++offsets[h.origin + 1];
+            for (size_t v = 0; v < m_vertices.size(); ++v) offsets[v + 1] += offsets[v];
+            std::vector<uint32_t> outgoing(m_half_edges.size());
+            std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+            for (uint32_t h = 0; h < m_half_edges.size(); ++h) outgoing[fill[m_half_edges[h].origin]++] = h;
+
+            for (size_t v = 0; v < m_vertices.size(); ++v) {
+                auto first = outgoing.begin() + offsets[v], last = outgoing.begin() + offsets[v + 1];
+                if (first == last) continue;
+                m_vertices[v].edge = *first;
+                std::sort(first, last, [&](uint32_t a, uint32_t b) { return angle_less(direction(a), direction(b)); });
+
+                // Walking into v along twin(o_i), the face on the left continues along the edge
+                // just clockwise of o_i.
+                const size_t k = static_cast<size_t>(last - first);
+                for (size_t i = 0; i < k; ++i) {
+                    const uint32_t incoming = twin(first[i]);
+                    const uint32_t next = first[(i + k - 1) % k];
+                    m_half_edges[incoming].next = next;
+                    m_half_edges[next].prev = incoming;
+                }
+            }
+        }
+
+        Vector<2, T> direction(uint32_t h) const {
+            return m_vertices[target(h)].point - m_vertices[m_half_edges[h].origin].point;
+        }
+
+        // Orders directions by angle in [0, 2*pi) without trigonometry.
+        static bool angle_less(const Vector<2, T>& a, const Vector<2, T>& b) {
+            const bool upper_a = a[1].value > 0 || (a[1].value == 0 && a[0].value > 0);
+            const bool upper_b = b[1].value > 0 || (b[1].value == 0 && b[0].value > 0);
+            if (upper_a != upper_b) return upper_a;
+            return a[0].value * b[1].value - a[1].value * b[0].value > 0;
+        }
+
+        T cycle_signed_area(uint32_t h) const {
+            T sum = 0;
+            uint32_t e = h;
+            do {
+                sum += cross_product(m_vertices[m_half_edges[e].origin].point, m_vertices[target(e)].point);
+                e = m_half_edges[e].next;
+            } while (e != h);
+            return sum / 2;
+        }
+
+        // Uniform grid over the bounding boxes of the bounded faces, for locating inner boundaries.
+        struct FaceGrid {
+            Box<2, T> bounds;
+            size_t cells_x = 0, cells_y = 0;
+            T inv_width = 0, inv_height = 0;
+            std::vector<uint32_t> offsets;
+            std::vector<uint32_t> faces;
+
+            void build(const std::vector<Box<2, T>>& face_bounds) {
+                for (size_t f = 1; f < face_bounds.size(); ++f) bounds.expand(face_bounds[f]);
+                const size_t side = std::max<size_t>(1, static_cast<size_t>(std::sqrt(T(face_bounds.size()))));
+                cells_x = cells_y = side;
+                const T width = bounds.max()[0].value - bounds.min()[0].value;
+                const T height = bounds.max()[1].value - bounds.min()[1].value;
+                inv_width = width > 0 ? T(side) / width : T(0);
+                inv_height = height > 0 ? T(side) / height : T(0);
+
+                offsets.assign(cells_x * cells_y + 1, 0);
+                for (int pass = 0; pass < 2; ++pass) {
+                    std::vector<uint32_t> fill;
+                    if (pass == 1) {
+                        for (size_t c = 0; c < cells_x * cells_y; ++c) offsets[c + 1] += offsets[c];
+                        faces.resize(offsets.back());
+                        fill.assign(offsets.begin(), offsets.end() - 1);
+                    }
+                    for (uint32_t f = 1; f < face_bounds.size(); ++f) {
+                        const size_t x0 = cell_x(face_bounds[f].min()[0].value), x1 = cell_x(face_bounds[f].max()[0].value);
+                        const size_t y0 = cell_y(face_bounds[f].min()[1].value), y1 = cell_y(face_bounds[f].max()[1].value);
+                        for (size_t y = y0; y <= y1; ++y) {
+                            for (size_t x = x0; x <= x1; ++x) {
+                                if (pass == 0) ++offsets[y * cells_x + x + 1];
+                                else faces[fill[y * cells_x + x]++] = f;
+                            }
+                        }
+                    }
+                }
+            }
+
+            size_t cell_x(T x) const {
+                const T c = (x - bounds.min()[0].value) * inv_width;
+                return std::min(cells_x - 1, static_cast<size_t>(std::max(c, T(0))));
+            }
+
+            size_t cell_y(T y) const {
+                const T c = (y - bounds.min()[1].value) * inv_height;
+                return std::min(cells_y - 1, static_cast<size_t>(std::max(c, T(0))));
+            }
+
+            template<typename Visit>
+            void for_each_candidate(const point_type& p, Visit&& visit) const {
+                if (faces.empty() || !bounds.contains(p)) return;
+                const size_t cell = cell_y(p[1].value) * cells_x + cell_x(p[0].value);
+                for (uint32_t k = offsets[cell]; k < offsets[cell + 1]; ++k) visit(faces[k]);
+            }
+        };
+
+        // Counter-clockwise cycles bound faces; the remaining cycles are inner boundaries and are
+        // assigned to the smallest face around them, or to the unbounded face.
+        void build_faces() {
+            m_faces.push_back({ Invalid, 0, 0 });
+            std::vector<uint32_t> inner_cycles;
+            std::vector<T> face_area{ T(0) };
+            std::vector<Box<2, T>> face_bounds{ Box<2, T>() };
+
+            std::vector<uint8_t> visited(m_half_edges.size(), 0);
+            for (uint32_t h = 0; h < m_half_edges.size(); ++h) {
+                if (visited[h]) continue;
+                const T area = cycle_signed_area(h);
+                uint32_t face = Invalid;
+                if (area > Coord<T>::Epsilon) {
+                    face = static_cast<uint32_t>(m_faces.size());
+                    m_faces.push_back({ h, 0, 0 });
+                    face_area.push_back(area);
+                    face_bounds.push_back(Box<2, T>::from_points(cycle_points(h)));
+                }
+                else {
+                    inner_cycles.push_back(h);
+                }
+                uint32_t e = h;
+                do {
+                    m_half_edges[e].face = face;
+                    visited[e] = 1;
+                    e = m_half_edges[e].next;
+                } while (e != h);
+            }
+
+            std::vector<std::pair<uint32_t, uint32_t>> holes;   // (face, half-edge)
+            holes.reserve(inner_cycles.size());
+            std::vector<Polygon<2, T>> boundaries;
+            FaceGrid grid;
+            if (!inner_cycles.empty() && m_faces.size() > 1) {
+                boundaries.reserve(m_faces.size() - 1);
+                for (size_t f = 1; f < m_faces.size(); ++f) boundaries.push_back(Polygon<2, T>(cycle_points(m_faces[f].outer_edge)));
+                grid.build(face_bounds);
+            }
+            for (uint32_t h : inner_cycles) {
+                // Probe just left of the cycle's leftmost vertex, which lies in the enclosing face.
+                const point_type probe = inner_probe(h);
+                uint32_t owner = 0;
+                grid.for_each_candidate(probe, [&](uint32_t f) {
+                    if (!face_bounds[f].contains(probe)) return;
+                    if ((owner == 0 || face_area[f] < face_area[owner]) && contains(probe, boundaries[f - 1])) {
+                        owner = f;
+                    }
+                });
+                holes.push_back({ owner, h });
+                uint32_t e = h;
+                do {
+                    m_half_edges[e].face = owner;
+                    e = m_half_edges[e].next;
+                } while (e != h);
+            }
+
+            std::sort(holes.begin(), holes.end());
+            m_hole_edges.reserve(holes.size());
+            for (const auto& hole : holes) {
+                Face& face = m_faces[hole.first];
+                if (face.num_holes == 0) face.first_hole = static_cast<uint32_t>(m_hole_edges.size());
+                ++face.num_holes;
+                m_hole_edges.push_back(hole.second);
+            }
+        }
+
+        // A point just outside an inner boundary cycle, next to its leftmost vertex.
+        point_type inner_probe(uint32_t h) const {
+            uint32_t best = h;
+            uint32_t e = h;
+            do {
+                const point_type& p = m_vertices[m_half_edges[e].origin].point;
+                const point_type& q = m_vertices[m_half_edges[best].origin].point;
+                if (p[0].value < q[0].value) best = e;
+                e = m_half_edges[e].next;
+            } while (e != h);
+            point_type probe = m_vertices[m_half_edges[best].origin].point;
+            probe[0].value -= 16 * Coord<T>::Epsilon * std::max(T(1), std::abs(probe[0].value));
+            return probe;
+        }
+    };
+
+    using Dcel2d = Dcel<double>;
+
+
+} // namespace geom
@@ -0,0 +1,154 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <random>
+#include <vector>
+#include "vector.hpp"
+#include "ball.hpp"
+#include "parallel.hpp"
+
+namespace geom {
+
+    namespace detail {
+
+        // Welzl's algorithm in Gärtner's move-to-front form. mtf(end) encloses points [0, end)
+        // with the current support points on the boundary; a point found outside joins the
+        // support and moves to the front of the list, where it is tested first from then on. The
+        // support never exceeds Dim + 1 points, so the recursion depth is at most Dim + 2 whatever
+        // the number of points.
+        template<size_t Dim, typename T>
+        class EnclosingBallBuilder {
+        public:
+            using point_type = Point<Dim, T>;
+
+        private:
+            std::vector<point_type>& m_points;
+            std::array<point_type, Dim + 1> m_support;
+            size_t m_num_support = 0;
+            point_type m_center;
+            T m_radius_sq = -1;
+            T m_limit_sq = -1;      // Squared radius plus tolerance; points beyond it are outside.
+
+        public:
+            explicit EnclosingBallBuilder(std::vector<point_type>& points) : m_points(points) {
+            }
+
+            Ball<Dim, T> build() {
+                mtf(m_points.size());
+                return Ball<Dim, T>(m_center, std::sqrt(std::max(T(0), m_radius_sq)));
+            }
+
+        private:
+            void mtf(size_t end) {
+                if (m_num_support == Dim + 1) {
+                    return;
+                }
+                for (size_t i = 0; i < end; ++i) {
+                    if ((m_points[i] - m_center).length_sq() > m_limit_sq) {
+                        m_support[m_num_support++] = m_points[i];
+                        set_circumball();
+                        mtf(i);
+                        --m_num_support;
+                        std::rotate(m_points.begin(), m_points.begin() + i, m_points.begin() + i + 1);
+                    }
+                }
+            }
+
+            // Smallest ball with every support point on its boundary: its center lies in their affine
+            // hull, c = s0 + sum(l_j * v_j) with v_j = s_j - s0 and 2 v_j . (c - s0) = v_j . v_j.
+            void set_circumball() {
+                const size_t k = m_num_support - 1;
+                T a[Dim][Dim + 1];
+                std::array<Vector<Dim, T>, Dim> v;
+                for (size_t j = 0; j < k; ++j) v[j] = m_support[j + 1] - m_support[0];
+                for (size_t j = 0; j < k; ++j) {
+                    for (size_t l = 0; l < k; ++l) a[j][l] = 2 * dot_product(v[j], v[l]);
+                    a[j][k] = dot_product(v[j], v[j]);
+                }
+                // Gaussian elimination with partial pivoting. A singular system means the support
+                // is degenerate (rounding only), and the previous ball is kept.
+                for (size_t col = 0; col < k; ++col) {
+                    size_t pivot = col;
+                    for (size_t row = col + 1; row < k; ++row) {
+                        if (std::abs(a[row][col]) > std::abs(a[pivot][col])) pivot = row;
+                    }
+                    if (std::abs(a[pivot][col]) <= std::numeric_limits<T>::min()) {
+                        return;
+                    }
+                    for (size_t l = 0; l <= k; ++l) std::swap(a[col][l], a[pivot][l]);
+                    for (size_t row = col + 1; row < k; ++row) {
+                        const T f = a[row][col] / a[col][col];
+                        for (size_t l = col; l <= k; ++l) a[row][l] -= f * a[col][l];
+                    }
+                }
+                Vector<Dim, T> offset;
+                for (size_t col = k; col-- > 0;) {
+                    T x = a[col][k];
+                    for (size_t l = col + 1; l < k; ++l) x -= a[col][l] * a[l][k];
+                    a[col][k] = x / a[col][col];
+                    offset += v[col] * a[col][k];
+                }
+                m_center = m_support[0] + offset;
+                m_radius_sq = offset.length_sq();
+                const T radius = std::sqrt(m_radius_sq);
+                const T limit = radius + Coord<T>::Epsilon * std::max(T(1), radius);
+                m_limit_sq = limit * limit;
+            }
+        };
+
+    } // namespace detail
+
+    // Smallest ball enclosing the points (Welzl), in expected linear time over a seeded random
+    // order; nullopt for no points. Works in scratch, which is overwritten and may be reused
+    // between calls to avoid allocating.
+    template<size_t Dim, typename T>
+    std::optional<Ball<Dim, T>> minimal_enclosing_ball(const Point<Dim, T>* points, size_t count, std::vector<Point<Dim, T>>& scratch, uint64_t seed = 0x5EED) {
+        if (count == 0) {
+            return std::nullopt;
+        }
+        scratch.assign(points, points + count);
+        std::mt19937_64 rng(seed);
+        std::shuffle(scratch.begin(), scratch.end(), rng);
+        return detail::EnclosingBallBuilder<Dim, T>(scratch).build();
+    }
+
+    template<size_t Dim, typename T>
+    std::optional<Ball<Dim, T>> minimal_enclosing_ball(const std::vector<Point<Dim, T>>& points, uint64_t seed = 0x5EED) {
+        std::vector<Point<Dim, T>> scratch;
+        return minimal_enclosing_ball(points.data(), points.size(), scratch, seed);
+    }
+
+    // out[g] is the minimal enclosing ball of points [offsets[g], offsets[g + 1]). Each thread
+    // reuses one scratch buffer across its groups.
+    template<size_t Dim, typename T>
+    void minimal_enclosing_balls(const std::vector<Point<Dim, T>>& points, const std::vector<size_t>& offsets, std::vector<std::optional<Ball<Dim, T>>>& out,
+                                 size_t num_threads = 0, uint64_t seed = 0x5EED) {
+        assert(!offsets.empty() && offsets.back() <= points.size() && "Offsets must end within the points.");
+        const size_t num_groups = offsets.size() - 1;
+        out.resize(num_groups);
+        parallel_for(num_groups, [&](size_t begin, size_t end) {
+            std::vector<Point<Dim, T>> scratch;
+            for (size_t g = begin; g < end; ++g) {
+                out[g] = minimal_enclosing_ball(points.data() + offsets[g], offsets[g + 1] - offsets[g], scratch, seed);
+            }
+        }, num_threads, 64);
+    }
+
+    template<size_t Dim, typename T>
+    void minimal_enclosing_balls(const std::vector<std::vector<Point<Dim, T>>>& groups, std::vector<std::optional<Ball<Dim, T>>>& out,
+                                 size_t num_threads = 0, uint64_t seed = 0x5EED) {
+        out.resize(groups.size());
+        parallel_for(groups.size(), [&](size_t begin, size_t end) {
+            std::vector<Point<Dim, T>> scratch;
+            for (size_t g = begin; g < end; ++g) out[g] = minimal_enclosing_ball(groups[g].data(), groups[g].size(), scratch, seed);
+        }, num_threads, 64);
+    }
+
+
+} // namespace geom
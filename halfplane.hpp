@@ -0,0 +1,263 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <deque>
+#include <optional>
+#include <vector>
+#include "vector.hpp"
+#include "line.hpp"
+#include "algorithms.hpp"
+#include "polygon.hpp"
+
+namespace geom {
+
+    enum class HalfPlaneStatus {
+        BOUNDED,
+        EMPTY,
+        UNBOUNDED
+    };
+
+    // polygon is set only for BOUNDED regions, counter-clockwise. Regions of zero area count as
+    // EMPTY.
+    template<typename T>
+    struct HalfPlaneResult {
+        HalfPlaneStatus status;
+        std::optional<Polygon<2, T>> polygon;
+    };
+
+    namespace detail {
+
+        // Closed half-plane left of the line through (ox, oy) with unit direction (dx, dy).
+        template<typename T>
+        struct HalfPlane {
+            T ox, oy, dx, dy;
+            T angle;
+            bool frame;         // One of the bounding box sides added for unbounded inputs.
+
+            static HalfPlane from_line(const Line<2, T>& line) {
+                const T dx = line.direction()[0].value, dy = line.direction()[1].value;
+                return { line.origin()[0].value, line.origin()[1].value, dx, dy, std::atan2(dy, dx), false };
+            }
+
+            T side(T px, T py) const {
+                return dx * (py - oy) - dy * (px - ox);
+            }
+
+            // Tolerance scales with the coordinates, so the far frame corners are tested fairly.
+            bool outside(T px, T py) const {
+                const T scale = std::max({ T(1), std::abs(px), std::abs(py), std::abs(ox), std::abs(oy) });
+                return side(px, py) < -Coord<T>::Epsilon * scale;
+            }
+        };
+
+        template<typename T>
+        Point<2, T> halfplane_meet(const HalfPlane<T>& a, const HalfPlane<T>& b) {
+            const T t = ((b.ox - a.ox) * b.dy - (b.oy - a.oy) * b.dx) / (a.dx * b.dy - a.dy * b.dx);
+            return Point<2, T>(a.ox + a.dx * t, a.oy + a.dy * t);
+        }
+
+        // Sort by angle and sweep with a deque, dropping half-planes made redundant at either end.
+        // The directions must positively span the plane (or the frame must be among the input),
+        // so the region, if not empty, is bounded. Returns the half-planes of its edges in order.
+        template<typename T>
+        std::optional<std::vector<HalfPlane<T>>> halfplane_sweep(std::vector<HalfPlane<T>> planes) {
+            std::sort(planes.begin(), planes.end(), [](const HalfPlane<T>& a, const HalfPlane<T>& b) { return a.angle < b.angle; });
+            std::deque<HalfPlane<T>> dq;
+            auto out_of = [](const HalfPlane<T>& h, const HalfPlane<T>& a, const HalfPlane<T>& b) {
+                const Point<2, T> p = halfplane_meet(a, b);
+                return h.outside(p[0].value, p[1].value);
+            };
+            for (const HalfPlane<T>& h : planes) {
+                while (dq.size() >= 2 && out_of(h, dq[dq.size() - 1], dq[dq.size() - 2])) dq.pop_back();
+                while (dq.size() >= 2 && out_of(h, dq[0], dq[1])) dq.pop_front();
+                if (!dq.empty() && std::abs(h.dx * dq.back().dy - h.dy * dq.back().dx) <= Coord<T>::Epsilon) {
+                    // Opposite directions left next to each other: nothing between them survived.
+                    if (h.dx * dq.back().dx + h.dy * dq.back().dy < 0) {
+                        return std::nullopt;
+                    }
+                    // Same direction: keep the tighter one.
+                    if (!h.outside(dq.back().ox, dq.back().oy)) {
+                        continue;
+                    }
+                    dq.pop_back();
+                }
+                dq.push_back(h);
+            }
+            while (dq.size() >= 3 && out_of(dq[0], dq[dq.size() - 1], dq[dq.size() - 2])) dq.pop_back();
+            while (dq.size() >= 3 && out_of(dq[dq.size() - 1], dq[0], dq[1])) dq.pop_front();
+            if (dq.size() < 3) {
+                return std::nullopt;
+            }
+            return std::vector<HalfPlane<T>>(dq.begin(), dq.end());
+        }
+
+        // Vertices of consecutive edges, without repeats; nullopt when fewer than three remain.
+        template<typename T>
+        std::optional<std::vector<Point<2, T>>> halfplane_vertices(const std::vector<HalfPlane<T>>& edges) {
+            std::vector<Point<2, T>> vertices;
+            for (size_t i = 0; i < edges.size(); ++i) {
+                const Point<2, T> p = halfplane_meet(edges[i], edges[(i + 1) % edges.size()]);
+                if (vertices.empty() || !(vertices.back() == p)) vertices.push_back(p);
+            }
+            while (vertices.size() > 1 && vertices.front() == vertices.back()) vertices.pop_back();
+            if (vertices.size() < 3) {
+                return std::nullopt;
+            }
+            return vertices;
+        }
+
+    } // namespace detail
+
+    // Intersection of the closed half-planes to the left of each line, in O(n log n). Directions
+    // leaving an angular gap of half a turn or more could make the region unbounded; those inputs
+    // are swept again inside a frame about a million times the input extent, and the region is
+    // UNBOUNDED if the frame still bounds it.
+    template<typename T>
+    HalfPlaneResult<T> halfplane_intersection(const std::vector<Line<2, T>>& halfplanes) {
+        using Result = HalfPlaneResult<T>;
+        if (halfplanes.empty()) {
+            return { HalfPlaneStatus::UNBOUNDED, std::nullopt };
+        }
+        std::vector<detail::HalfPlane<T>> planes;
+        planes.reserve(halfplanes.size() + 4);
+        T extent = 1;
+        for (const auto& line : halfplanes) {
+            planes.push_back(detail::HalfPlane<T>::from_line(line));
+            extent = std::max({ extent, std::abs(planes.back().ox), std::abs(planes.back().oy) });
+        }
+
+        std::vector<T> angles(planes.size());
+        for (size_t i = 0; i < planes.size(); ++i) angles[i] = planes[i].angle;
+        std::sort(angles.begin(), angles.end());
+        const T pi = T(3.14159265358979323846);
+        T max_gap = angles.front() + 2 * pi - angles.back();
+        for (size_t i = 1; i < angles.size(); ++i) max_gap = std::max(max_gap, angles[i] - angles[i - 1]);
+        if (max_gap >= pi - std::sqrt(Coord<T>::Epsilon)) {
+            const T m = extent * T(1e6);
+            planes.push_back({ -m, -m, 1, 0, 0, true });
+            planes.push_back({ m, -m, 0, 1, pi / 2, true });
+            planes.push_back({ m, m, -1, 0, pi, true });
+            planes.push_back({ -m, m, 0, -1, -pi / 2, true });
+        }
+
+        const auto edges = detail::halfplane_sweep(std::move(planes));
+        if (!edges) {
+            return { HalfPlaneStatus::EMPTY, std::nullopt };
+        }
+        const bool framed = std::any_of(edges->begin(), edges->end(), [](const detail::HalfPlane<T>& h) { return h.frame; });
+        auto vertices = detail::halfplane_vertices(*edges);
+        if (!vertices) {
+            return { HalfPlaneStatus::EMPTY, std::nullopt };
+        }
+        if (framed) {
+            return { HalfPlaneStatus::UNBOUNDED, std::nullopt };
+        }
+        return Result{ HalfPlaneStatus::BOUNDED, Polygon<2, T>(*vertices) };
+    }
+
+    // Region built up one half-plane at a time. While it is unbounded every addition re-runs
+    // halfplane_intersection; once bounded, an addition clips the current polygon in O(k) for k
+    // vertices, and leaves it untouched when all of them are already inside.
+    template<typename T>
+    class HalfPlaneRegion {
+    public:
+        using point_type = Point<2, T>;
+
+    private:
+        HalfPlaneStatus m_status = HalfPlaneStatus::UNBOUNDED;
+        std::vector<Line<2, T>> m_halfplanes;      // Kept until the region is bounded.
+        std::vector<point_type> m_vertices;
+        std::vector<point_type> m_scratch;
+
+    public:
+        HalfPlaneRegion() = default;
+
+        static HalfPlaneRegion from_lines(const std::vector<Line<2, T>>& halfplanes) {
+            HalfPlaneRegion region;
+            region.m_halfplanes = halfplanes;
+            region.rebuild();
+            return region;
+        }
+
+        HalfPlaneStatus status() const { return m_status; }
+
+        std::optional<Polygon<2, T>> polygon() const {
+            if (m_status != HalfPlaneStatus::BOUNDED) {
+                return std::nullopt;
+            }
+            return Polygon<2, T>(m_vertices);
+        }
+
+        const std::vector<point_type>& vertices() const { return m_vertices; }
+
+        void add(const Line<2, T>& halfplane) {
+            if (m_status == HalfPlaneStatus::EMPTY) {
+                return;
+            }
+            if (m_status == HalfPlaneStatus::UNBOUNDED) {
+                m_halfplanes.push_back(halfplane);
+                rebuild();
+                return;
+            }
+
+            const auto h = detail::HalfPlane<T>::from_line(halfplane);
+            const size_t n = m_vertices.size();
+            size_t outside = 0;
+            for (const auto& v : m_vertices) outside += h.outside(v[0].value, v[1].value);
+            if (outside == 0) {
+                return;
+            }
+            if (outside == n) {
+                set_empty();
+                return;
+            }
+
+            // Sutherland-Hodgman against one line.
+            m_scratch.clear();
+            for (size_t i = 0, j = n - 1; i < n; j = i++) {
+                const point_type& a = m_vertices[j];
+                const point_type& b = m_vertices[i];
+                const T sa = h.side(a[0].value, a[1].value), sb = h.side(b[0].value, b[1].value);
+                const bool a_in = !h.outside(a[0].value, a[1].value), b_in = !h.outside(b[0].value, b[1].value);
+                if (a_in != b_in) {
+                    const point_type p = a + (b - a) * (sa / (sa - sb));
+                    if (m_scratch.empty() || !(m_scratch.back() == p)) m_scratch.push_back(p);
+                }
+                if (b_in && (m_scratch.empty() || !(m_scratch.back() == b))) m_scratch.push_back(b);
+            }
+            while (m_scratch.size() > 1 && m_scratch.front() == m_scratch.back()) m_scratch.pop_back();
+            if (m_scratch.size() < 3) {
+                set_empty();
+                return;
+            }
+            m_vertices.swap(m_scratch);
+        }
+
+    private:
+        void rebuild() {
+            const HalfPlaneResult<T> result = halfplane_intersection(m_halfplanes);
+            m_status = result.status;
+            m_vertices.clear();
+            if (result.polygon) {
+                m_vertices = result.polygon->vertices();
+                m_halfplanes.clear();
+                m_halfplanes.shrink_to_fit();
+            }
+            else if (m_status == HalfPlaneStatus::EMPTY) {
+                set_empty();
+            }
+        }
+
+        void set_empty() {
+            m_status = HalfPlaneStatus::EMPTY;
+            m_vertices.clear();
+            m_halfplanes.clear();
+        }
+    };
+
+    using HalfPlaneRegion2d = HalfPlaneRegion<double>;
+
+
+} // namespace geom
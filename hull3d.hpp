@@ -0,0 +1,385 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <vector>
+#include "vector.hpp"
+#include "mesh.hpp"
+#include "parallel.hpp"
+#include "algorithms.hpp"
+
+namespace geom {
+
+    namespace detail {
+
+        // Incremental Quickhull state. Faces live in a pool indexed by uint32_t; deleted faces are
+        // pushed onto a free list and reused together with the capacity of their outside sets.
+        template<typename T>
+        class QuickHull3 {
+        public:
+            using point_type = Point<3, T>;
+
+            static constexpr uint32_t None = std::numeric_limits<uint32_t>::max();
+            static constexpr size_t ParallelThreshold = 4096;
+
+        private:
+            struct Face {
+                uint32_t v[3];
+                uint32_t neighbor[3];   // neighbor[i] shares the edge (v[i], v[(i + 1) % 3]).
+                T normal[3];
+                T offset;
+                std::vector<uint32_t> outside;
+                uint32_t furthest;
+                T furthest_distance;
+                bool alive;
+            };
+
+            struct HorizonEdge {
+                uint32_t a;
+                uint32_t b;
+                uint32_t neighbor;
+            };
+
+            const std::vector<point_type>& m_points;
+            T m_eps;
+            size_t m_num_threads;
+
+            std::vector<Face> m_faces;
+            std::vector<uint32_t> m_free_faces;
+
+            // Scratch buffers kept across iterations.
+            std::vector<uint32_t> m_visible;
+            std::vector<uint32_t> m_visit_stack;
+            std::vector<uint8_t> m_visit_mark;
+            std::vector<HorizonEdge> m_horizon;
+            std::vector<uint32_t> m_new_faces;
+            std::vector<uint32_t> m_face_by_start;
+            std::vector<uint32_t> m_orphans;
+            std::vector<uint32_t> m_assignment;
+
+        public:
+            QuickHull3(const std::vector<point_type>& points, size_t num_threads)
+                : m_points(points), m_eps(0), m_num_threads(num_threads) {
+            }
+
+            std::optional<TriangleMesh<T>> run() {
+                const size_t n = m_points.size();
+                if (n < 4) {
+                    return std::nullopt;
+                }
+
+                T scale = 0;
+                for (const auto& p : m_points) {
+                    scale = std::max(scale, std::abs(p[0].value) + std::abs(p[1].value) + std::abs(p[2].value));
+                }
+                m_eps = Coord<T>::Epsilon * std::max(T(1), scale);
+
+                std::array<uint32_t, 4> simplex;
+                if (!initial_simplex(simplex)) {
+                    return std::nullopt; // All points are collinear or coplanar.
+                }
+
+                m_face_by_start.assign(n, None);
+                build_simplex(simplex);
+
+                std::vector<uint32_t> candidates;
+                candidates.reserve(n);
+                for (uint32_t i = 0; i < n; ++i) {
+                    if (i != simplex[0] && i != simplex[1] && i != simplex[2] && i != simplex[3]) {
+                        candidates.push_back(i);
+                    }
+                }
+                std::vector<uint32_t> initial_faces = { 0, 1, 2, 3 };
+                assign_outside(candidates, initial_faces);
+
+                std::vector<uint32_t> pending = initial_faces;
+                while (!pending.empty()) {
+                    const uint32_t face = pending.back();
+                    pending.pop_back();
+                    if (!m_faces[face].alive || m_faces[face].outside.empty()) {
+                        continue;
+                    }
+                    add_point(face);
+                    for (uint32_t f : m_new_faces) {
+                        if (!m_faces[f].outside.empty()) pending.push_back(f);
+                    }
+                }
+
+                return extract_mesh();
+            }
+
+        private:
+            T distance(const Face& f, uint32_t p) const {
+                const auto& q = m_points[p];
+                return f.normal[0] * q[0].value + f.normal[1] * q[1].value + f.normal[2] * q[2].value - f.offset;
+            }
+
+            bool initial_simplex(std::array<uint32_t, 4>& simplex) const {
+                const size_t n = m_points.size();
+
+                // The most distant pair of axis extremes seeds the first edge.
+                std::array<uint32_t, 6> extremes = { 0, 0, 0, 0, 0, 0 };
+                for (uint32_t i = 1; i < n; ++i) {
+                    for (size_t axis = 0; axis < 3; ++axis) {
+                        if (m_points[i][axis].value < m_points[extremes[2 * axis]][axis].value) extremes[2 * axis] = i;
+                        if (m_points[i][axis].value > m_points[extremes[2 * axis + 1]][axis].value) extremes[2 * axis + 1] = i;
+                    }
+                }
+                T best = -1;
+                for (size_t i = 0; i < 6; ++i) {
+                    for (size_t j = i + 1; j < 6; ++j) {
+                        const T d = (m_points[extremes[i]] - m_points[extremes[j]]).length_sq();
+                        if (d > best) {
+                            best = d;
+                            simplex[0] = extremes[i];
+                            simplex[1] = extremes[j];
+                        }
+                    }
+                }
+                if (best <= m_eps * m_eps) {
+                    return false;
+                }
+
+                const Vector<3, T> edge = m_points[simplex[1]] - m_points[simplex[0]];
+                best = -1;
+                for (uint32_t i = 0; i < n; ++i) {
+                    const T d = cross_product(edge, m_points[i] - m_points[simplex[0]]).length_sq();
+                    if (d > best) {
+                        best = d;
+                        simplex[2] = i;
+                    }
+                }
+                if (std::sqrt(best) / edge.length() <= m_eps) {
+                    return false;
+                }
+
+                Vector<3, T> normal = cross_product(edge, m_points[simplex[2]] - m_points[simplex[0]]);
+                normal.normalize();
+                best = -1;
+                for (uint32_t i = 0; i < n; ++i) {
+                    const T d = std::abs(dot_product(normal, m_points[i] - m_points[simplex[0]]));
+                    if (d > best) {
+                        best = d;
+                        simplex[3] = i;
+                    }
+                }
+                return best > m_eps;
+            }
+
+            uint32_t allocate_face(uint32_t a, uint32_t b, uint32_t c) {
+                uint32_t id;
+                if (!m_free_faces.empty()) {
+                    id = m_free_faces.back();
+                    m_free_faces.pop_back();
+                }
+                else {
+                    id = static_cast<uint32_t>(m_faces.size());
+                    m_faces.emplace_back();
+                }
+
+                Face& f = m_faces[id];
+                f.v[0] = a; f.v[1] = b; f.v[2] = c;
+                f.neighbor[0] = f.neighbor[1] = f.neighbor[2] = None;
+                f.outside.clear();
+                f.furthest = None;
+                f.furthest_distance = 0;
+                f.alive = true;
+
+                const Vector<3, T> normal = cross_product(m_points[b] - m_points[a], m_points[c] - m_points[a]);
+                const T len = normal.length();
+                const T inv = len > 0 ? T(1) / len : T(0);
+                for (size_t k = 0; k < 3; ++k) {
+                    f.normal[k] = normal[k].value * inv;
+                }
+                f.offset = f.normal[0] * m_points[a][0].value + f.normal[1] * m_points[a][1].value + f.normal[2] * m_points[a][2].value;
+                return id;
+            }
+
+            void release_face(uint32_t id) {
+                m_faces[id].alive = false;
+                m_faces[id].outside.clear();
+                m_free_faces.push_back(id);
+            }
+
+            void build_simplex(const std::array<uint32_t, 4>& s) {
+                // Orient the base triangle so that the apex is behind it.
+                uint32_t a = s[0], b = s[1], c = s[2];
+                const Vector<3, T> normal = cross_product(m_points[b] - m_points[a], m_points[c] - m_points[a]);
+                if (dot_product(normal, m_points[s[3]] - m_points[a]) > 0) {
+                    std::swap(b, c);
+                }
+                const uint32_t d = s[3];
+
+                const uint32_t f0 = allocate_face(a, b, c);
+                const uint32_t f1 = allocate_face(a, d, b);
+                const uint32_t f2 = allocate_face(b, d, c);
+                const uint32_t f3 = allocate_face(c, d, a);
+                link_all({ f0, f1, f2, f3 });
+            }
+
+            // Connects faces that share an edge in opposite directions.
+            void link_all(const std::vector<uint32_t>& faces) {
+                for (uint32_t f : faces) {
+                    for (size_t i = 0; i < 3; ++i) {
+                        const uint32_t a = m_faces[f].v[i];
+                        const uint32_t b = m_faces[f].v[(i + 1) % 3];
+                        for (uint32_t g : faces) {
+                            if (g == f) continue;
+                            for (size_t j = 0; j < 3; ++j) {
+                                if (m_faces[g].v[j] == b && m_faces[g].v[(j + 1) % 3] == a) {
+                                    m_faces[f].neighbor[i] = g;
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+
+            // Assigns each point to the first face it lies strictly outside of. Distances are
+            // evaluated in parallel for large point sets; the outside sets are filled serially.
+            void assign_outside(const std::vector<uint32_t>& points, const std::vector<uint32_t>& faces) {
+                m_assignment.resize(points.size());
+                auto classify = [&](size_t begin, size_t end) {
+                    for (size_t i = begin; i < end; ++i) {
+                        uint32_t target = None;
+                        for (uint32_t f : faces) {
+                            if (distance(m_faces[f], points[i]) > m_eps) {
+                                target = f;
+                                break;
+                            }
+                        }
+                        m_assignment[i] = target;
+                    }
+                };
+                if (points.size() >= ParallelThreshold) {
+                    parallel_for(points.size(), classify, m_num_threads, ParallelThreshold / 4);
+                }
+                else {
+                    classify(0, points.size());
+                }
+
+                for (size_t i = 0; i < points.size(); ++i) {
+                    const uint32_t f = m_assignment[i];
+                    if (f == None) continue;
+                    Face& face = m_faces[f];
+                    const T d = distance(face, points[i]);
+                    face.outside.push_back(points[i]);
+                    if (face.furthest == None || d > face.furthest_distance) {
+                        face.furthest = points[i];
+                        face.furthest_distance = d;
+                    }
+                }
+            }
+
+            void add_point(uint32_t start_face) {
+                const uint32_t eye = m_faces[start_face].furthest;
+
+                // Flood the faces visible from the eye point.
+                m_visible.clear();
+                m_visit_stack.clear();
+                if (m_visit_mark.size() < m_faces.size()) m_visit_mark.resize(m_faces.size(), 0);
+                m_visit_stack.push_back(start_face);
+                m_visit_mark[start_face] = 1;
+                while (!m_visit_stack.empty()) {
+                    const uint32_t f = m_visit_stack.back();
+                    m_visit_stack.pop_back();
+                    m_visible.push_back(f);
+                    for (size_t i = 0; i < 3; ++i) {
+                        const uint32_t g = m_faces[f].neighbor[i];
+                        if (m_visit_mark[g] != 0) continue;
+                        if (distance(m_faces[g], eye) > m_eps) {
+                            m_visit_mark[g] = 1;
+                            m_visit_stack.push_back(g);
+                        }
+                    }
+                }
+
+                // Edges between visible and hidden faces form the horizon.
+                m_horizon.clear();
+                for (uint32_t f : m_visible) {
+                    for (size_t i = 0; i < 3; ++i) {
+                        const uint32_t g = m_faces[f].neighbor[i];
+                        if (m_visit_mark[g] == 0) {
+                            m_horizon.push_back({ m_faces[f].v[i], m_faces[f].v[(i + 1) % 3], g });
+                        }
+                    }
+                }
+
+                m_orphans.clear();
+                for (uint32_t f : m_visible) {
+                    for (uint32_t p : m_faces[f].outside) {
+                        if (p != eye) m_orphans.push_back(p);
+                    }
+                    m_visit_mark[f] = 0;
+                    release_face(f);
+                }
+
+                // Cone of new faces from the horizon to the eye point.
+                m_new_faces.clear();
+                for (const HorizonEdge& e : m_horizon) {
+                    const uint32_t f = allocate_face(e.a, e.b, eye);
+                    if (m_visit_mark.size() < m_faces.size()) m_visit_mark.resize(m_faces.size(), 0);
+                    m_faces[f].neighbor[0] = e.neighbor;
+                    Face& hidden = m_faces[e.neighbor];
+                    for (size_t j = 0; j < 3; ++j) {
+                        if (hidden.v[j] == e.b && hidden.v[(j + 1) % 3] == e.a) {
+                            hidden.neighbor[j] = f;
+                        }
+                    }
+                    m_face_by_start[e.a] = f;
+                    m_new_faces.push_back(f);
+                }
+                for (uint32_t f : m_new_faces) {
+                    Face& face = m_faces[f];
+                    const uint32_t next = m_face_by_start[face.v[1]];   // Shares (b, eye).
+                    face.neighbor[1] = next;
+                    m_faces[next].neighbor[2] = f;                      // Its (eye, b) edge.
+                }
+                for (const HorizonEdge& e : m_horizon) {
+                    m_face_by_start[e.a] = None;
+                }
+
+                assign_outside(m_orphans, m_new_faces);
+            }
+
+            TriangleMesh<T> extract_mesh() const {
+                std::vector<uint32_t> remap(m_points.size(), None);
+                std::vector<point_type> vertices;
+                std::vector<uint32_t> indices;
+                for (const Face& f : m_faces) {
+                    if (!f.alive) continue;
+                    for (size_t i = 0; i < 3; ++i) {
+                        if (remap[f.v[i]] == None) {
+                            remap[f.v[i]] = static_cast<uint32_t>(vertices.size());
+                            vertices.push_back(m_points[f.v[i]]);
+                        }
+                        indices.push_back(remap[f.v[i]]);
+                    }
+                }
+                return TriangleMesh<T>(vertices, indices);
+            }
+        };
+
+    } // namespace detail
+
+    // Quickhull in 3D. Returns the hull as a triangle mesh whose faces are oriented outward and which
+    // only references hull vertices, or std::nullopt if fewer than 4 points are given or all points
+    // are (within tolerance) collinear or coplanar. Points closer than a scale-relative epsilon to a
+    // face are treated as lying on it, so coplanar points on hull facets are not added as vertices.
+    template<typename T>
+    std::optional<TriangleMesh<T>> convex_hull(const std::vector<Point<3, T>>& points, size_t num_threads = 0) {
+        GEOM_COUNT(CONVEX_HULL_3D_CALLS);
+        GEOM_TIME_SCOPE(CONVEX_HULL_3D);
+        detail::QuickHull3<T> hull(points, num_threads);
+        auto result = hull.run();
+        if (!result.has_value()) {
+            GEOM_COUNT(CONVEX_HULL_3D_DEGENERATE);
+        }
+        return result;
+    }
+
+
+} // namespace geom
@@ -0,0 +1,298 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Opt-in hot-path instrumentation. Define GEOM_ENABLE_INSTRUMENTATION before including any geom
+// header to collect per-thread call counts, degenerate-branch counters and sampled timings.
+// Without it, GEOM_COUNT and GEOM_TIME_SCOPE expand to nothing.
+#ifdef GEOM_ENABLE_INSTRUMENTATION
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#endif
+
+namespace geom {
+namespace instrumentation {
+
+    enum class Counter : size_t {
+        LINE_INTERSECTION_CALLS,
+        LINE_INTERSECTION_PARALLEL,
+        LINE_INTERSECTION_COINCIDENT,
+        SEGMENT_INTERSECTION_CALLS,
+        SEGMENT_INTERSECTION_COINCIDENT,
+        POLYGON_CONTAINS_CALLS,
+        POLYGON_CONTAINS_BOUNDARY,
+        CONVEX_HULL_CALLS,
+        CONVEX_HULL_3D_CALLS,
+        CONVEX_HULL_3D_DEGENERATE,
+        BVH_CLOSEST_HIT_QUERIES,
+        BVH_ANY_HIT_QUERIES,
+        COUNT
+    };
+
+    enum class Timer : size_t {
+        LINE_INTERSECTION,
+        SEGMENT_INTERSECTION,
+        POLYGON_CONTAINS,
+        CONVEX_HULL,
+        CONVEX_HULL_3D,
+        BVH_CLOSEST_HIT,
+        COUNT
+    };
+
+    inline const char* name(Counter counter) {
+        static const char* const names[] = {
+            "line_intersection.calls",
+            "line_intersection.parallel",
+            "line_intersection.coincident",
+            "segment_intersection.calls",
+            "segment_intersection.coincident",
+            "polygon_contains.calls",
+            "polygon_contains.boundary",
+            "convex_hull.calls",
+            "convex_hull_3d.calls",
+            "convex_hull_3d.degenerate",
+            "bvh.closest_hit_queries",
+            "bvh.any_hit_queries",
+        };
+        static_assert(sizeof(names) / sizeof(names[0]) == static_cast<size_t>(Counter::COUNT), "Every counter needs a name.");
+        return names[static_cast<size_t>(counter)];
+    }
+
+    inline const char* name(Timer timer) {
+        static const char* const names[] = {
+            "line_intersection",
+            "segment_intersection",
+            "polygon_contains",
+            "convex_hull",
+            "convex_hull_3d",
+            "bvh.closest_hit",
+        };
+        static_assert(sizeof(names) / sizeof(names[0]) == static_cast<size_t>(Timer::COUNT), "Every timer needs a name.");
+        return names[static_cast<size_t>(timer)];
+    }
+
+#ifdef GEOM_ENABLE_INSTRUMENTATION
+
+    constexpr size_t CounterCount = static_cast<size_t>(Counter::COUNT);
+    constexpr size_t TimerCount = static_cast<size_t>(Timer::COUNT);
+
+    // Bucket b of a timing histogram counts samples that took [2^b, 2^(b+1)) nanoseconds.
+    constexpr size_t HistogramBuckets = 40;
+
+    // Only every SampleInterval-th call of a timed scope reads the clock.
+#ifndef GEOM_INSTRUMENTATION_SAMPLE_INTERVAL
+#define GEOM_INSTRUMENTATION_SAMPLE_INTERVAL 64
+#endif
+    constexpr uint64_t SampleInterval = GEOM_INSTRUMENTATION_SAMPLE_INTERVAL;
+    static_assert((SampleInterval & (SampleInterval - 1)) == 0, "The sample interval must be a power of two.");
+
+    struct TimerStats {
+        uint64_t calls = 0;
+        uint64_t samples = 0;
+        uint64_t total_ns = 0;
+        std::array<uint64_t, HistogramBuckets> histogram{};
+    };
+
+    struct Snapshot {
+        std::array<uint64_t, CounterCount> counters{};
+        std::array<TimerStats, TimerCount> timers{};
+
+        uint64_t operator[](Counter counter) const { return counters[static_cast<size_t>(counter)]; }
+        const TimerStats& operator[](Timer timer) const { return timers[static_cast<size_t>(timer)]; }
+
+        void write_json(std::ostream& os) const {
+            os << "{\n  \"counters\": {";
+            for (size_t i = 0; i < CounterCount; ++i) {
+                os << (i == 0 ? "\n" : ",\n") << "    \"" << name(static_cast<Counter>(i)) << "\": " << counters[i];
+            }
+            os << "\n  },\n  \"timers\": {";
+            for (size_t i = 0; i < TimerCount; ++i) {
+                const TimerStats& t = timers[i];
+                os << (i == 0 ? "\n" : ",\n") << "    \"" << name(static_cast<Timer>(i)) << "\": {"
+                   << "\"calls\": " << t.calls
+                   << ", \"samples\": " << t.samples
+                   << ", \"total_sampled_ns\": " << t.total_ns
+                   << ", \"mean_ns\": " << (t.samples > 0 ? t.total_ns / t.samples : 0)
+                   << ", \"histogram_log2_ns\": [";
+                for (size_t b = 0; b < HistogramBuckets; ++b) {
+                    os << (b == 0 ? "" : ", ") << t.histogram[b];
+                }
+                os << "]}";
+            }
+            os << "\n  }\n}\n";
+        }
+
+        std::string to_json() const {
+            std::ostringstream os;
+            write_json(os);
+            return os.str();
+        }
+    };
+
+    namespace detail {
+
+        // Each thread writes only to its own stats, so updates are relaxed load/store pairs
+        // rather than atomic read-modify-writes; readers may see slightly stale values.
+        struct ThreadStats {
+            std::array<std::atomic<uint64_t>, CounterCount> counters{};
+            std::array<std::atomic<uint64_t>, TimerCount> timer_calls{};
+            std::array<std::atomic<uint64_t>, TimerCount> timer_samples{};
+            std::array<std::atomic<uint64_t>, TimerCount> timer_total_ns{};
+            std::array<std::array<std::atomic<uint64_t>, HistogramBuckets>, TimerCount> histograms{};
+        };
+
+        inline void bump(std::atomic<uint64_t>& value, uint64_t amount = 1) {
+            value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+        }
+
+        inline void accumulate(Snapshot& into, const ThreadStats& stats) {
+            for (size_t i = 0; i < CounterCount; ++i) {
+                into.counters[i] += stats.counters[i].load(std::memory_order_relaxed);
+            }
+            for (size_t i = 0; i < TimerCount; ++i) {
+                TimerStats& t = into.timers[i];
+                t.calls += stats.timer_calls[i].load(std::memory_order_relaxed);
+                t.samples += stats.timer_samples[i].load(std::memory_order_relaxed);
+                t.total_ns += stats.timer_total_ns[i].load(std::memory_order_relaxed);
+                for (size_t b = 0; b < HistogramBuckets; ++b) {
+                    t.histogram[b] += stats.histograms[i][b].load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        // Stats of running threads, plus the sum of everything recorded by threads that have
+        // exited, so aggregation still sees the work of finished workers without keeping one
+        // entry per thread ever started.
+        struct Registry {
+            std::mutex mutex;
+            std::vector<ThreadStats*> threads;
+            Snapshot retired;
+
+            static Registry& instance() {
+                static Registry registry;
+                return registry;
+            }
+        };
+
+        // Registers the thread's stats on first use and folds them into the retired sum when
+        // the thread exits.
+        class ThreadStatsHolder {
+        private:
+            Registry& m_registry;
+
+        public:
+            ThreadStats stats;
+
+            ThreadStatsHolder() : m_registry(Registry::instance()) {
+                std::lock_guard<std::mutex> lock(m_registry.mutex);
+                m_registry.threads.push_back(&stats);
+            }
+
+            ~ThreadStatsHolder() {
+                std::lock_guard<std::mutex> lock(m_registry.mutex);
+                accumulate(m_registry.retired, stats);
+                auto it = std::find(m_registry.threads.begin(), m_registry.threads.end(), &stats);
+                *it = m_registry.threads.back();
+                m_registry.threads.pop_back();
+            }
+
+            ThreadStatsHolder(const ThreadStatsHolder&) = delete;
+            ThreadStatsHolder& operator=(const ThreadStatsHolder&) = delete;
+        };
+
+        inline ThreadStats& local_stats() {
+            thread_local ThreadStatsHolder holder;
+            return holder.stats;
+        }
+
+        inline void count(Counter counter) {
+            bump(local_stats().counters[static_cast<size_t>(counter)]);
+        }
+
+        class ScopedTimer {
+        private:
+            ThreadStats& m_stats;
+            size_t m_timer;
+            bool m_sampled;
+            std::chrono::steady_clock::time_point m_start;
+
+        public:
+            explicit ScopedTimer(Timer timer) : m_stats(local_stats()), m_timer(static_cast<size_t>(timer)) {
+                const uint64_t calls = m_stats.timer_calls[m_timer].load(std::memory_order_relaxed);
+                m_stats.timer_calls[m_timer].store(calls + 1, std::memory_order_relaxed);
+                m_sampled = (calls & (SampleInterval - 1)) == 0;
+                if (m_sampled) {
+                    m_start = std::chrono::steady_clock::now();
+                }
+            }
+
+            ~ScopedTimer() {
+                if (!m_sampled) return;
+                const auto elapsed = std::chrono::steady_clock::now() - m_start;
+                const uint64_t ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+                size_t bucket = 0;
+                while (bucket + 1 < HistogramBuckets && (ns >> (bucket + 1)) != 0) {
+                    ++bucket;
+                }
+                bump(m_stats.timer_samples[m_timer]);
+                bump(m_stats.timer_total_ns[m_timer], ns);
+                bump(m_stats.histograms[m_timer][bucket]);
+            }
+
+            ScopedTimer(const ScopedTimer&) = delete;
+            ScopedTimer& operator=(const ScopedTimer&) = delete;
+        };
+
+    } // namespace detail
+
+    // Sums the stats of every thread that has recorded anything so far, finished threads included.
+    inline Snapshot snapshot() {
+        detail::Registry& registry = detail::Registry::instance();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        Snapshot result = registry.retired;
+        for (const detail::ThreadStats* stats : registry.threads) {
+            detail::accumulate(result, *stats);
+        }
+        return result;
+    }
+
+    // Clears all stats. Increments racing with a reset on other threads may be lost.
+    inline void reset() {
+        detail::Registry& registry = detail::Registry::instance();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.retired = Snapshot();
+        for (detail::ThreadStats* stats : registry.threads) {
+            for (auto& c : stats->counters) c.store(0, std::memory_order_relaxed);
+            for (auto& c : stats->timer_calls) c.store(0, std::memory_order_relaxed);
+            for (auto& c : stats->timer_samples) c.store(0, std::memory_order_relaxed);
+            for (auto& c : stats->timer_total_ns) c.store(0, std::memory_order_relaxed);
+            for (auto& h : stats->histograms) {
+                for (auto& c : h) c.store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    inline std::string to_json() {
+        return snapshot().to_json();
+    }
+
+#endif // GEOM_ENABLE_INSTRUMENTATION
+
+} // namespace instrumentation
+} // namespace geom
+
+#ifdef GEOM_ENABLE_INSTRUMENTATION
+#define GEOM_COUNT(counter) ::geom::instrumentation::detail::count(::geom::instrumentation::Counter::counter)
+#define GEOM_TIME_SCOPE(timer) ::geom::instrumentation::detail::ScopedTimer geom_instrumentation_timer_(::geom::instrumentation::Timer::timer)
+#else
+#define GEOM_COUNT(counter) ((void)0)
+#define GEOM_TIME_SCOPE(timer) ((void)0)
+#endif
@@ -37,12 +37,11 @@ namespace geom {
         const vector_type& direction() const { return this->m_direction; }
 
         point_type point_at(const T& t) const {
-            return this->m_origin + (this->m_direction * t);
+            return lazy(this->m_origin) + lazy(this->m_direction) * t;
         }
 
         point_type project(const point_type& p) const {
-            vector_type to_p = p - this->m_origin;
-            T t = dot_product(to_p, this->m_direction);
+            const T t = dot_product(lazy(p) - lazy(this->m_origin), this->m_direction);
             return this->point_at(t);
         }
 
@@ -57,5 +56,8 @@ namespace geom {
     using Line2d = Line2<double>;
     using Line3d = Line3<double>;
 
+    using Line2f = Line2<float>;
+    using Line3f = Line3<float>;
+
 
 } // namespace geom
@@ -1,10 +1,40 @@
 ﻿#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <stdexcept>
+#include <thread>
 #include "vector.hpp"
 #include "line.hpp"
 #include "algorithms.hpp"
 #include "segment.hpp"
 #include "polygon.hpp"
 #include "ray.hpp"
+#include "bvh.hpp"
+#include "hull3d.hpp"
+#include "instrumentation.hpp"
+#include "clip.hpp"
+#include "collision.hpp"
+#include "transform.hpp"
+#include "pipeline.hpp"
+#include "polygon_collection.hpp"
+#include "spatial_sort.hpp"
+#include "dcel.hpp"
+#include "trapezoidal_map.hpp"
+#include "visibility.hpp"
+#include "range_tree.hpp"
+#include "ball.hpp"
+#include "snapshot.hpp"
+#include "similarity.hpp"
+#include "polyline.hpp"
+#include "enclosing_ball.hpp"
+#include "halfplane.hpp"
+#include "offset.hpp"
+#include "visibility_graph.hpp"
+#include "arena.hpp"
 
 void run_vector_tests() {
     std::cout << "--- Running Vector/Point Tests ---" << std::endl;
@@ -39,6 +69,25 @@ void run_vector_tests() {
     if (p_a != p_c) std::cout << "SUCCESS (Not Equal)" << std::endl;
     else std::cout << "FAILED" << std::endl;
 
+    std::cout << "Test 7.1: Arithmetic results behave like vectors... ";
+    auto make_vector = []() { return geom::Vector2d(3.0, 4.0); };
+    auto d = p_c - p_a;
+    d.normalize();
+    auto from_temporary = make_vector() - p_a;
+    if ((p1 - p_a)[0].value == 2.0 && (p_a + v1) == geom::Point2d(2.0, 0.0) && d == geom::Vector2d(1.0, 0.0) &&
+        from_temporary == geom::Vector2d(2.0, 2.0)) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 7.2: Lazy expressions copy temporaries and read like vectors... ";
+    auto fused = geom::lazy(p_a) + make_vector() * 2.0;
+    const geom::Point2d evaluated = fused;
+    if (evaluated == geom::Point2d(7.0, 10.0) && fused[1].value == 10.0 && fused == geom::Point2d(7.0, 10.0) && fused != p_a) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
     std::cout << "--- Vector/Point Tests Finished ---\n" << std::endl;
 }
 
@@ -577,6 +626,1992 @@ void run_mixed_intersection_tests() {
 }
 
 
+void run_mesh_bvh_tests() {
+    std::cout << "\n--- Running Mesh BVH Tests ---" << std::endl;
+
+    // Unit cube made of 12 triangles.
+    std::vector<geom::Point3d> cube_vertices = {
+        {0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {0, 1, 0},
+        {0, 0, 1}, {1, 0, 1}, {1, 1, 1}, {0, 1, 1}
+    };
+    std::vector<uint32_t> cube_indices = {
+        0, 2, 1, 0, 3, 2,   4, 5, 6, 4, 6, 7,
+        0, 1, 5, 0, 5, 4,   2, 3, 7, 2, 7, 6,
+        1, 2, 6, 1, 6, 5,   0, 4, 7, 0, 7, 3
+    };
+    geom::TriangleMesh3d cube(cube_vertices, cube_indices);
+    geom::MeshBVH3d bvh(cube);
+
+    std::cout << "Test 1.1: Single triangle intersection... ";
+    geom::Ray3d down = geom::Ray3d::from_point_direction({ 0.25, 0.25, 5 }, { 0, 0, -1 });
+    auto tri_hit = geom::intersection(down, cube.triangle(2));
+    if (tri_hit.has_value() && std::abs(tri_hit->t - 4.0) < geom::Coord<double>::Epsilon) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 1.2: Closest hit through the cube... ";
+    geom::Ray3d ray = geom::Ray3d::from_point_direction({ 0.5, 0.25, -5 }, { 0, 0, 1 });
+    auto hit = bvh.closest_hit(ray);
+    if (hit.has_value() && std::abs(hit->t - 5.0) < geom::Coord<double>::Epsilon && hit->point == geom::Point3d(0.5, 0.25, 0)) {
+        std::cout << "SUCCESS. Point: " << hit->point << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 1.3: Ray missing the cube... ";
+    geom::Ray3d miss = geom::Ray3d::from_point_direction({ 2, 2, -5 }, { 0, 0, 1 });
+    if (!bvh.closest_hit(miss).has_value() && !bvh.any_hit(miss)) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED" << std::endl;
+
+    std::cout << "Test 1.4: Occlusion respects max distance... ";
+    if (bvh.any_hit(ray, 6.0) && !bvh.any_hit(ray, 4.0)) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED" << std::endl;
+
+    std::cout << "Test 1.5: Batch closest hits match brute force... ";
+    std::vector<geom::Ray3d> rays;
+    for (int i = 0; i < 2000; ++i) {
+        const double a = 0.013 * i, b = 0.007 * i;
+        rays.push_back(geom::Ray3d::from_point_direction({ 0.5 + 3 * std::cos(a), 0.5 + 3 * std::sin(a), 0.5 + std::sin(b) },
+                                                         { -std::cos(a) + 0.1 * std::sin(b), -std::sin(a), 0.05 * std::cos(b) }));
+    }
+    std::vector<std::optional<geom::RayMeshHit<double>>> hits;
+    bvh.closest_hit_batch(rays, hits);
+    bool batch_ok = true;
+    for (size_t i = 0; i < rays.size(); ++i) {
+        std::optional<double> best;
+        for (size_t t = 0; t < cube.num_triangles(); ++t) {
+            auto h = geom::intersection(rays[i], cube.triangle(t));
+            if (h.has_value() && (!best.has_value() || h->t < *best)) best = h->t;
+        }
+        if (best.has_value() != hits[i].has_value() || (best.has_value() && std::abs(*best - hits[i]->t) > 1e-6)) {
+            batch_ok = false;
+        }
+    }
+    if (batch_ok) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED" << std::endl;
+
+    std::cout << "Test 1.6: Millimetre and micrometre triangles are hit head-on... ";
+    const geom::TriangleMesh<float> tiny_float({ { 0, 0, 0 }, { 1e-3f, 0, 0 }, { 0, 1e-3f, 0 } }, { 0, 1, 2 });
+    const geom::MeshBVH<float> tiny_float_bvh(tiny_float);
+    const geom::Ray3f float_down = geom::Ray3f::from_point_direction({ 2e-4f, 2e-4f, 1 }, { 0, 0, -1 });
+    const geom::TriangleMesh3d tiny_double({ { 0, 0, 0 }, { 1e-5, 0, 0 }, { 0, 1e-5, 0 } }, { 0, 1, 2 });
+    const geom::MeshBVH3d tiny_double_bvh(tiny_double);
+    const geom::Ray3d double_down = geom::Ray3d::from_point_direction({ 2e-6, 2e-6, 1 }, { 0, 0, -1 });
+    const geom::Ray3d grazing = geom::Ray3d::from_point_direction({ -1, 2e-6, 0 }, { 1, 0, 0 });
+    auto float_hit = tiny_float_bvh.closest_hit(float_down);
+    auto double_hit = tiny_double_bvh.closest_hit(double_down);
+    if (geom::intersection(float_down, tiny_float.triangle(0)).has_value() && float_hit && std::abs(float_hit->t - 1) < 1e-5f &&
+        geom::intersection(double_down, tiny_double.triangle(0)).has_value() && double_hit && std::abs(double_hit->t - 1) < 1e-9 &&
+        !geom::intersection(grazing, tiny_double.triangle(0)).has_value() && !tiny_double_bvh.any_hit(grazing)) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "--- Mesh BVH Tests Finished ---" << std::endl;
+}
+
+void run_convex_hull_3d_tests() {
+    std::cout << "\n--- Running 3D Convex Hull Tests ---" << std::endl;
+
+    // Cube corners plus interior points and points lying on the cube faces.
+    std::vector<geom::Point3d> points;
+    for (int i = 0; i < 8; ++i) {
+        points.push_back(geom::Point3d(i & 1 ? 2.0 : 0.0, i & 2 ? 2.0 : 0.0, i & 4 ? 2.0 : 0.0));
+    }
+    for (int i = 1; i < 10; ++i) {
+        points.push_back(geom::Point3d(0.2 * i, 0.15 * i, 0.1 * i));
+        points.push_back(geom::Point3d(0.2 * i, 0.1 * i, 2.0));
+        points.push_back(geom::Point3d(0.0, 0.2 * i, 0.05 * i));
+    }
+
+    auto hull = geom::convex_hull(points);
+    std::cout << "Test 1.1: Cube hull creation... ";
+    if (hull.has_value()) std::cout << "SUCCESS" << std::endl;
+    else { std::cout << "FAILED" << std::endl; return; }
+
+    std::cout << "Test 1.2: Coplanar face points are not hull vertices... ";
+    if (hull->num_vertices() == 8 && hull->num_triangles() == 12) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED. Got " << hull->num_vertices() << " vertices and " << hull->num_triangles() << " triangles" << std::endl;
+
+    std::cout << "Test 2.1: Coplanar input is rejected... ";
+    std::vector<geom::Point3d> flat = { {0, 0, 1}, {1, 0, 1}, {0, 1, 1}, {1, 1, 1}, {0.5, 0.5, 1} };
+    if (!geom::convex_hull(flat).has_value()) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED" << std::endl;
+
+    // Points on a sphere: every point is a hull vertex and the mesh is a closed, outward-facing surface.
+    std::vector<geom::Point3d> sphere;
+    const int count = 20000;
+    for (int i = 0; i < count; ++i) {
+        const double z = 1.0 - 2.0 * (i + 0.5) / count;
+        const double r = std::sqrt(1.0 - z * z);
+        const double phi = 2.399963229728653 * i;
+        sphere.push_back(geom::Point3d(r * std::cos(phi), r * std::sin(phi), z));
+        sphere.push_back(geom::Point3d(0.5 * r * std::cos(phi), 0.5 * r * std::sin(phi), 0.5 * z));
+    }
+    auto sphere_hull = geom::convex_hull(sphere);
+    std::cout << "Test 3.1: Sphere hull keeps exactly the surface points... ";
+    if (sphere_hull.has_value() && sphere_hull->num_vertices() == static_cast<size_t>(count) &&
+        sphere_hull->num_triangles() == static_cast<size_t>(2 * count - 4)) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 3.2: Every input point is inside the hull... ";
+    bool inside = sphere_hull.has_value();
+    for (size_t t = 0; inside && t < sphere_hull->num_triangles(); t += 97) {
+        auto tri = sphere_hull->triangle(t);
+        geom::Vector3d normal = geom::cross_product(tri[1] - tri[0], tri[2] - tri[0]);
+        normal.normalize();
+        for (const auto& p : sphere) {
+            if (geom::dot_product(normal, p - tri[0]) > 1e-7) { inside = false; break; }
+        }
+    }
+    if (inside) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED" << std::endl;
+
+    std::cout << "--- 3D Convex Hull Tests Finished ---" << std::endl;
+}
+
+void run_instrumentation_tests() {
+    std::cout << "\n--- Running Instrumentation Tests ---" << std::endl;
+#ifdef GEOM_ENABLE_INSTRUMENTATION
+    using geom::instrumentation::Counter;
+    geom::instrumentation::reset();
+
+    geom::Line2d l1 = geom::Line2d::from_points({ 0, 0 }, { 1, 0 });
+    geom::Line2d l2 = geom::Line2d::from_points({ 0, 1 }, { 1, 1 });
+    geom::Line2d l3 = geom::Line2d::from_points({ 5, 0 }, { 6, 0 });
+    geom::intersection(l1, l2);
+    geom::intersection(l1, l3);
+    geom::intersection(l1, l3);
+
+    std::vector<geom::Point2d> square_vertices = { {0, 0}, {5, 0}, {5, 5}, {0, 5} };
+    geom::Polygon2d square(square_vertices);
+    geom::contains(geom::Point2d(5, 2), square);
+    geom::contains(geom::Point2d(2, 2), square);
+
+    auto stats = geom::instrumentation::snapshot();
+    std::cout << "Test 1.1: Degenerate intersection branches are counted... ";
+    if (stats[Counter::LINE_INTERSECTION_CALLS] == 3 && stats[Counter::LINE_INTERSECTION_PARALLEL] == 1 &&
+        stats[Counter::LINE_INTERSECTION_COINCIDENT] == 2) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 1.2: Polygon boundary hits are counted... ";
+    if (stats[Counter::POLYGON_CONTAINS_CALLS] == 2 && stats[Counter::POLYGON_CONTAINS_BOUNDARY] == 1) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 1.3: JSON export... ";
+    const std::string json = stats.to_json();
+    if (json.find("\"line_intersection.parallel\": 1") != std::string::npos) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED" << std::endl;
+
+    std::cout << "Test 1.4: Finished threads keep their counts but leave the registry... ";
+    geom::instrumentation::reset();
+    for (int round = 0; round < 50; ++round) {
+        std::thread worker([&]() { geom::intersection(l1, l2); });
+        worker.join();
+    }
+    geom::parallel_for(4096, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) geom::intersection(l1, l3);
+    }, 4, 1);
+    auto after_workers = geom::instrumentation::snapshot();
+    size_t registered = 0;
+    {
+        auto& registry = geom::instrumentation::detail::Registry::instance();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registered = registry.threads.size();
+    }
+    if (after_workers[Counter::LINE_INTERSECTION_PARALLEL] == 50 && after_workers[Counter::LINE_INTERSECTION_COINCIDENT] == 4096 && registered == 1) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED (" << registered << " registered threads)" << std::endl; }
+#else
+    std::cout << "Instrumentation is disabled; define GEOM_ENABLE_INSTRUMENTATION to run these tests." << std::endl;
+#endif
+    std::cout << "--- Instrumentation Tests Finished ---" << std::endl;
+}
+
+void run_clip_tests() {
+    std::cout << "\n--- Running Convex Clipping Tests ---" << std::endl;
+
+    std::vector<geom::Point2d> square_vertices = { {0, 0}, {10, 0}, {10, 10}, {0, 10} };
+    geom::ConvexClipper2d clipper{ geom::Polygon2d(square_vertices) };
+
+    std::cout << "Test 1.1: Segment crossing the square... ";
+    auto range = clipper.clip(geom::Segment2d({ -5, 5 }, { 15, 5 }));
+    if (!range.empty() && std::abs(range.t_enter - 0.25) < geom::Coord<double>::Epsilon && std::abs(range.t_leave - 0.75) < geom::Coord<double>::Epsilon) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 1.2: Segment outside the square... ";
+    if (clipper.clip(geom::Segment2d({ -5, 15 }, { 15, 12 })).empty()) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED" << std::endl;
+
+    std::cout << "Test 1.3: Clipped segment endpoints... ";
+    auto clipped = clipper.clipped(geom::Segment2d({ 5, 5 }, { 5, 20 }));
+    if (clipped.has_value() && clipped->p1() == geom::Point2d(5, 5) && clipped->p2() == geom::Point2d(5, 10)) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 2.1: Ray from inside leaves through an edge... ";
+    auto ray_range = clipper.clip(geom::Ray2d::from_point_direction({ 5, 5 }, { 1, 0 }));
+    if (ray_range.t_enter == 0.0 && std::abs(ray_range.t_leave - 5.0) < geom::Coord<double>::Epsilon) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED" << std::endl;
+
+    std::cout << "Test 2.2: Line through the diagonal (clockwise polygon)... ";
+    std::vector<geom::Point2d> clockwise = { {0, 0}, {0, 10}, {10, 10}, {10, 0} };
+    geom::ConvexClipper2d cw_clipper{ geom::Polygon2d(clockwise) };
+    auto line_range = cw_clipper.clip(geom::Line2d::from_points({ 0, 0 }, { 1, 1 }));
+    if (std::abs(line_range.t_enter) < 1e-9 && std::abs(line_range.t_leave - std::sqrt(200.0)) < 1e-9) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED" << std::endl;
+
+    std::cout << "Test 3.1: Batch clipping matches scalar clipping... ";
+    std::vector<geom::Segment2d> segments;
+    for (int i = 0; i < 1000; ++i) {
+        segments.push_back(geom::Segment2d({ -3.0 + 0.017 * i, -2.0 + 0.011 * i }, { 14.0 - 0.013 * i, 3.0 + 0.009 * i }));
+    }
+    segments.push_back(geom::Segment2d({ -1, 0 }, { -1, 10 })); // Parallel to an edge, outside.
+    std::vector<geom::ClipInterval<double>> ranges;
+    clipper.clip(segments, ranges);
+    bool batch_ok = ranges.size() == segments.size();
+    for (size_t i = 0; batch_ok && i < segments.size(); ++i) {
+        auto expected = clipper.clip(segments[i]);
+        if (expected.empty() != ranges[i].empty() ||
+            (!expected.empty() && (expected.t_enter != ranges[i].t_enter || expected.t_leave != ranges[i].t_leave))) {
+            batch_ok = false;
+        }
+    }
+    if (batch_ok && ranges.back().empty()) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED" << std::endl;
+
+    std::cout << "--- Convex Clipping Tests Finished ---" << std::endl;
+}
+
+void run_collision_tests() {
+    std::cout << "\n--- Running Collision Detection Tests ---" << std::endl;
+
+    geom::Polygon2d square(std::vector<geom::Point2d>{ {0, 0}, {2, 0}, {2, 2}, {0, 2} });
+    geom::Polygon2d far_square(std::vector<geom::Point2d>{ {5, 0}, {7, 0}, {7, 2}, {5, 2} });
+    geom::Polygon2d overlapping(std::vector<geom::Point2d>{ {1.5, 0.5}, {3.5, 0.5}, {3.5, 1.5}, {1.5, 1.5} });
+
+    std::cout << "Test 1.1: GJK distance between separated squares... ";
+    auto dist = geom::gjk_distance(square, far_square);
+    if (!dist.intersecting && std::abs(dist.distance - 3.0) < 1e-9 && std::abs(dist.closest_a[0].value - 2.0) < 1e-9 && std::abs(dist.closest_b[0].value - 5.0) < 1e-9) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 1.2: GJK overlap test and ball distance... ";
+    geom::Ball2d ball({ 5, 5 }, 1);
+    auto ball_dist = geom::gjk_distance(square, ball);
+    if (geom::gjk_intersects(square, overlapping) && !geom::gjk_intersects(square, far_square) && !ball_dist.intersecting &&
+        std::abs(ball_dist.distance - (std::sqrt(18.0) - 1.0)) < 1e-6) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 2.1: EPA and SAT agree on penetration... ";
+    auto epa = geom::epa_penetration(square, overlapping);
+    auto sat = geom::sat_penetration(square, overlapping);
+    if (epa.colliding && sat.colliding && std::abs(epa.depth - 0.5) < 1e-6 && std::abs(sat.depth - 0.5) < 1e-9 &&
+        std::abs(epa.normal[0].value - 1.0) < 1e-6 && std::abs(sat.normal[0].value - 1.0) < 1e-9) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 2.2: Separated polygons do not collide... ";
+    if (!geom::epa_penetration(square, far_square).colliding && !geom::sat_penetration(square, far_square).colliding) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED" << std::endl;
+
+    std::cout << "Test 3.1: Sweep and prune matches brute force across frames... ";
+    geom::SweepAndPrune2d broad_phase;
+    std::vector<geom::Box2d> boxes;
+    for (int i = 0; i < 200; ++i) {
+        const double x = std::fmod(i * 7.3, 50.0), y = std::fmod(i * 3.1, 20.0);
+        boxes.push_back(geom::Box2d({ x, y }, { x + 2.0, y + 1.5 }));
+        broad_phase.add(boxes.back());
+    }
+    bool pairs_ok = true;
+    std::vector<std::pair<uint32_t, uint32_t>> pairs;
+    for (int frame = 0; frame < 5 && pairs_ok; ++frame) {
+        for (uint32_t i = 0; i < boxes.size(); ++i) {
+            const double dx = 0.3 * std::sin(0.7 * i + frame);
+            boxes[i] = geom::Box2d({ boxes[i].min()[0].value + dx, boxes[i].min()[1].value }, { boxes[i].max()[0].value + dx, boxes[i].max()[1].value });
+            broad_phase.update(i, boxes[i]);
+        }
+        broad_phase.find_pairs(pairs);
+        std::sort(pairs.begin(), pairs.end());
+        std::vector<std::pair<uint32_t, uint32_t>> expected;
+        for (uint32_t i = 0; i < boxes.size(); ++i) {
+            for (uint32_t j = i + 1; j < boxes.size(); ++j) {
+                const bool overlap = boxes[i].min()[0].value <= boxes[j].max()[0].value && boxes[j].min()[0].value <= boxes[i].max()[0].value &&
+                                     boxes[i].min()[1].value <= boxes[j].max()[1].value && boxes[j].min()[1].value <= boxes[i].max()[1].value;
+                if (overlap) expected.push_back({ i, j });
+            }
+        }
+        pairs_ok = pairs == expected;
+    }
+    if (pairs_ok) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED" << std::endl;
+
+    std::cout << "Test 3.2: Sweep and prune takes 10^5 reversed adds and a teleport of every proxy... ";
+    // Boxes on a line overlapping only their neighbours, added right to left.
+    const uint32_t row = 100000;
+    geom::SweepAndPrune2d crowd;
+    auto slot = [](uint32_t k) { return geom::Box2d({ double(k), 0 }, { k + 1.5, 1 }); };
+    for (uint32_t i = 0; i < row; ++i) crowd.add(slot(row - 1 - i));
+    const uint32_t extra = crowd.add(geom::Box2d({ -10, 0 }, { 2, 1 }));
+    crowd.remove(extra);
+    std::vector<std::pair<uint32_t, uint32_t>> crowd_pairs;
+    crowd.find_pairs(crowd_pairs);
+    bool neighbours = crowd.size() == row && crowd_pairs.size() == row - 1;
+    for (const auto& pair : crowd_pairs) neighbours = neighbours && pair.second == pair.first + 1;
+    for (uint32_t i = 0; i < row; ++i) crowd.update(i, slot(i));
+    crowd.find_pairs(crowd_pairs);
+    neighbours = neighbours && crowd_pairs.size() == row - 1;
+    for (const auto& pair : crowd_pairs) neighbours = neighbours && pair.second == pair.first + 1;
+    if (neighbours) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED" << std::endl;
+}
+
+void run_transform_tests() {
+    std::cout << "\n--- Running Affine Transform Tests ---" << std::endl;
+    const double pi = std::acos(-1.0);
+
+    std::cout << "Test 1.1: Composition applies right to left... ";
+    auto rotate = geom::Affine2d::rotation(pi / 2);
+    auto shift = geom::Affine2d::translation(geom::Vector2d(1, 0));
+    auto p = (shift * rotate).apply(geom::Point2d(1, 0));
+    if (p == geom::Point2d(1, 1) && geom::Affine2d::rotation_about({ 1, 1 }, pi).apply(geom::Point2d(0, 0)) == geom::Point2d(2, 2)) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED. Got " << p << std::endl; }
+
+    std::cout << "Test 1.2: Inverse round-trips and singular maps have none... ";
+    auto m = geom::Affine3d::rotation(geom::Vector3d(1, 2, 3), 0.7) * geom::Affine3d::scaling(geom::Vector3d(2, 0.5, 3)) * geom::Affine3d::translation(geom::Vector3d(4, -1, 2));
+    auto inv = m.inverse();
+    geom::Point3d q(0.3, -7, 2.5);
+    if (inv.has_value() && inv->apply(m.apply(q)) == q && !geom::Affine2d::scaling(geom::Vector2d(1, 0)).inverse().has_value()) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 2.1: Decomposition recovers rotation, shear and scale... ";
+    std::array<double, 4> shear_matrix = { 1, 0.5, 0, 1 };
+    auto composed = geom::Affine2d::translation(geom::Vector2d(3, 4)) * geom::Affine2d::rotation(0.3) *
+                    geom::Affine2d::from_matrix(shear_matrix) * geom::Affine2d::scaling(geom::Vector2d(2, -3));
+    auto parts = composed.decompose();
+    if (std::abs(parts.angle() - 0.3) < 1e-9 && std::abs(parts.scale[0].value - 2) < 1e-9 && std::abs(parts.scale[1].value + 3) < 1e-9 &&
+        std::abs(parts.shear[1] - 0.5) < 1e-9 && parts.translation == geom::Vector2d(3, 4)) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 3.1: Polygon, segment and ray transforms... ";
+    geom::Polygon2d square(std::vector<geom::Point2d>{ {0, 0}, {1, 0}, {1, 1}, {0, 1} });
+    auto scaled = geom::Affine2d::scaling(3.0).apply(square);
+    auto ray = geom::Affine2d::scaling(geom::Vector2d(2, 1)).apply(geom::Ray2d::from_point_direction({ 1, 1 }, { 1, 1 }));
+    auto segment = rotate.apply(geom::Segment2d({ 1, 0 }, { 2, 0 }));
+    if (std::abs(scaled.area() - 9.0) < 1e-9 && ray.origin() == geom::Point2d(2, 1) && ray.direction() == geom::Vector2d(2 / std::sqrt(5.0), 1 / std::sqrt(5.0)) &&
+        segment.p2() == geom::Point2d(0, 2) && rotate.is_rigid() && !composed.is_rigid()) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 3.2: Bulk in-place transform matches per-point apply... ";
+    std::vector<geom::Point2d> points;
+    for (int i = 0; i < 100000; ++i) points.push_back(geom::Point2d(std::cos(0.01 * i) * i, std::sin(0.013 * i)));
+    std::vector<geom::Point2d> bulk = points;
+    composed.apply_in_place(bulk, 4);
+    bool bulk_ok = true;
+    for (size_t i = 0; i < points.size() && bulk_ok; ++i) bulk_ok = bulk[i] == composed.apply(points[i]);
+    if (bulk_ok) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED" << std::endl;
+}
+
+void run_pipeline_tests() {
+    std::cout << "\n--- Running Pipeline Tests ---" << std::endl;
+
+    auto make_clouds = []() {
+        std::vector<std::vector<geom::Point2d>> clouds;
+        for (int c = 0; c < 200; ++c) {
+            const double size = 1.0 + c % 5;
+            clouds.push_back({ {0, 0}, {size, 0}, {size, size}, {0, size}, {size / 2, size / 2} });
+        }
+        return clouds;
+    };
+    double expected_area = 0;
+    for (int c = 0; c < 200; ++c) expected_area += (1.0 + c % 5) * (1.0 + c % 5);
+
+    std::cout << "Test 1.1: Hull and area stages reduce to the serial total... ";
+    geom::Pipeline pipeline(4);
+    auto total = pipeline.source_from(make_clouds())
+                         .transform(geom::stages::ConvexHull(), 3)
+                         .transform(geom::stages::Area())
+                         .reduce(0.0, std::plus<double>());
+    pipeline.wait();
+    const double total_area = total.get();
+    if (std::abs(total_area - expected_area) < 1e-9) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED. Got " << total_area << " expected " << expected_area << std::endl;
+
+    std::cout << "Test 1.2: Batched stages and filtering... ";
+    geom::Pipeline batched(2);
+    std::vector<double> areas;
+    batched.source_from(make_clouds())
+           .filter([](const std::vector<geom::Point2d>& cloud) { return cloud[1][0].value > 2.5; })
+           .batch(16)
+           .transform(geom::stages::ConvexHull(), 2)
+           .transform(geom::stages::Area())
+           .sink([&](std::vector<double>&& batch) { areas.insert(areas.end(), batch.begin(), batch.end()); });
+    batched.wait();
+    if (areas.size() == 120 && std::all_of(areas.begin(), areas.end(), [](double a) { return a >= 9.0; })) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED. Got " << areas.size() << " areas" << std::endl;
+
+    std::cout << "Test 2.1: A full queue blocks the source... ";
+    std::atomic<int> produced{ 0 };
+    int max_in_flight = 0, consumed = 0;
+    {
+        geom::Pipeline throttled(2);
+        throttled.source([&]() -> std::optional<int> {
+            if (produced.load() == 50) return std::nullopt;
+            return produced.fetch_add(1);
+        }).sink([&](int&&) {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            ++consumed;
+            max_in_flight = std::max(max_in_flight, produced.load() - consumed);
+        });
+        throttled.wait();
+    }
+    if (consumed == 50 && max_in_flight <= 3) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED. " << max_in_flight << " items in flight" << std::endl;
+
+    std::cout << "Test 2.2: Stage exceptions propagate through wait and the reduction... ";
+    geom::Pipeline failing(2);
+    auto count = failing.source_from(std::vector<int>(1000, 1))
+                        .transform([](int&& x) { if (x > 0) throw std::runtime_error("bad item"); return x; })
+                        .reduce(0, std::plus<int>());
+    bool wait_threw = false, future_threw = false;
+    try { failing.wait(); }
+    catch (const std::runtime_error&) { wait_threw = true; }
+    try { count.get(); }
+    catch (const std::runtime_error&) { future_threw = true; }
+    if (wait_threw && future_threw) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED" << std::endl;
+
+    std::cout << "Test 2.3: Batched hulls keep their input positions... ";
+    std::vector<std::vector<geom::Point2d>> mixed = { { {0, 0}, {2, 0}, {0, 2} }, { {0, 0}, {1, 1}, {2, 2} }, { {0, 0}, {3, 0}, {3, 3}, {0, 3} } };
+    const auto hulls = geom::stages::ConvexHull()(std::move(mixed));
+    const auto mixed_areas = geom::stages::Area()(hulls);
+    if (hulls.size() == 3 && hulls[0] && !hulls[1] && hulls[2] && mixed_areas == std::vector<double>{ 2.0, 0.0, 9.0 }) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED" << std::endl;
+
+    std::cout << "Test 2.4: Destroying a pipeline stops stages blocked on dropped handles... ";
+    std::future<int> unfinished;
+    {
+        geom::Pipeline abandoned(2);
+        (void)abandoned.source([]() { return std::optional<int>(1); });
+        unfinished = abandoned.source([]() { return std::optional<int>(1); }).reduce(0, std::plus<int>());
+    }
+    bool broken = false;
+    try { unfinished.get(); }
+    catch (const std::future_error& e) { broken = e.code() == std::future_errc::broken_promise; }
+    if (broken) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED" << std::endl;
+}
+
+void run_polygon_collection_tests() {
+    std::cout << "\n--- Running Polygon Collection Tests ---" << std::endl;
+
+    geom::PolygonCollection2d parcels;
+    // Clockwise exterior with a counter-clockwise hole; both get normalized on insertion.
+    parcels.add_polygon(std::vector<geom::Point2d>{ {0, 0}, {0, 10}, {10, 10}, {10, 0} },
+                        { std::vector<geom::Point2d>{ {2, 2}, {4, 2}, {4, 4}, {2, 4} } });
+    parcels.add_polygon(geom::Polygon2d(std::vector<geom::Point2d>{ {20, 0}, {30, 0}, {25, 5} }));
+
+    std::cout << "Test 1.1: Layout and views... ";
+    auto first = parcels[0];
+    if (parcels.size() == 2 && parcels.num_rings() == 3 && parcels.num_vertices() == 11 && first.num_holes() == 1 &&
+        first.exterior().signed_area() > 0 && first.hole(0).signed_area() < 0 && parcels[1].exterior().vertex(2) == geom::Point2d(25, 5)) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 1.2: Bulk areas and bounds... ";
+    std::vector<double> areas;
+    std::vector<geom::Box2d> boxes;
+    parcels.areas(areas);
+    parcels.bounds(boxes);
+    if (std::abs(areas[0] - 96.0) < 1e-9 && std::abs(areas[1] - 25.0) < 1e-9 &&
+        boxes[0].min() == geom::Point2d(0, 0) && boxes[1].max() == geom::Point2d(30, 5)) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 2.1: Holes are outside under both fill rules... ";
+    if (first.contains({ 1, 1 }) && !first.contains({ 3, 3 }) && first.contains({ 1, 1 }, geom::FillRule::NONZERO) &&
+        !first.contains({ 3, 3 }, geom::FillRule::NONZERO) && !first.contains({ 11, 1 })) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 2.2: Fill rules differ on a self-overlapping ring... ";
+    geom::PolygonCollection2d star;
+    star.add_polygon(std::vector<geom::Point2d>{ {0, 0}, {2, 6}, {4, 0}, {-1, 4}, {5, 4} });
+    if (!star.contains(0, { 2, 3 }) && star.contains(0, { 2, 3 }, geom::FillRule::NONZERO)) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED" << std::endl;
+
+    std::cout << "Test 3.1: Bulk contains matches the single-ring algorithm... ";
+    geom::PolygonCollection2d many;
+    std::vector<geom::Polygon2d> reference;
+    std::vector<geom::Point2d> queries;
+    for (int i = 0; i < 3000; ++i) {
+        const double cx = i % 100, cy = i / 100, r = 0.3 + 0.1 * (i % 3);
+        std::vector<geom::Point2d> ring;
+        for (int k = 0; k < 7; ++k) ring.push_back(geom::Point2d(cx + r * std::cos(0.9 * k), cy + r * std::sin(0.9 * k)));
+        many.add_polygon(ring);
+        reference.push_back(geom::Polygon2d(ring));
+        queries.push_back(geom::Point2d(cx + 0.37 * std::sin(i), cy + 0.41 * std::cos(1.3 * i)));
+    }
+    std::vector<uint8_t> inside;
+    many.contains(queries, inside, geom::FillRule::EVEN_ODD, 4);
+    size_t mismatches = 0;
+    for (size_t i = 0; i < queries.size(); ++i) {
+        if ((inside[i] != 0) != geom::contains(queries[i], reference[i])) ++mismatches;
+    }
+    if (mismatches == 0) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED. " << mismatches << " mismatches" << std::endl;
+}
+
+void run_spatial_sort_tests() {
+    std::cout << "\n--- Running Spatial Sort Tests ---" << std::endl;
+
+    std::cout << "Test 1.1: Morton keys interleave the quantized coordinates... ";
+    geom::Box2d unit({ 0, 0 }, { 1, 1 });
+    const uint64_t corner = geom::morton_key(geom::Point2d(1, 1), unit);
+    const uint64_t x_only = geom::morton_key(geom::Point2d(1, 0), unit);
+    if (corner == ~uint64_t(0) && x_only == 0xAAAAAAAAAAAAAAAAull && geom::morton_key(geom::Point2d(0, 0), unit) == 0) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED" << std::endl;
+
+    std::cout << "Test 1.2: Hilbert order visits grid cells through neighbours (2D and 3D)... ";
+    std::vector<geom::Point2d> grid2;
+    for (int x = 0; x < 16; ++x) for (int y = 0; y < 16; ++y) grid2.push_back(geom::Point2d(x + 0.5, y + 0.5));
+    std::vector<geom::Point3d> grid3;
+    for (int x = 0; x < 8; ++x) for (int y = 0; y < 8; ++y) for (int z = 0; z < 8; ++z) grid3.push_back(geom::Point3d(x + 0.5, y + 0.5, z + 0.5));
+    auto order2 = geom::hilbert_order(grid2, geom::Box2d({ 0, 0 }, { 16, 16 }));
+    auto order3 = geom::hilbert_order(grid3, geom::Box3d({ 0, 0, 0 }, { 8, 8, 8 }));
+    bool adjacent = true;
+    for (size_t i = 1; i < order2.size(); ++i) adjacent = adjacent && std::abs((grid2[order2[i]] - grid2[order2[i - 1]]).length() - 1.0) < 1e-9;
+    for (size_t i = 1; i < order3.size(); ++i) adjacent = adjacent && std::abs((grid3[order3[i]] - grid3[order3[i - 1]]).length() - 1.0) < 1e-9;
+    if (adjacent) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED" << std::endl;
+
+    std::cout << "Test 1.3: Float keys put the box's max corner in the last cell... ";
+    const geom::Box2f float_box({ -3.5f, 1.0f }, { 7.25f, 9.0f });
+    const geom::Box3f float_cube({ 0, 0, 0 }, { 2, 3, 4 });
+    const uint64_t float_corner = geom::morton_key(geom::Point2f(7.25f, 9.0f), float_box);
+    const uint64_t cube_corner = geom::morton_key(geom::Point3f(2, 3, 4), float_cube);
+    if (float_corner == ~uint64_t(0) && cube_corner == (uint64_t(1) << 63) - 1 && geom::hilbert_key(geom::Point2f(7.25f, 9.0f), float_box) != 0 &&
+        geom::morton_key(geom::Point2f(-3.5f, 1.0f), float_box) == 0) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 2.1: Radix sort is a stable sort... ";
+    std::vector<uint64_t> keys;
+    std::vector<uint32_t> values;
+    for (uint32_t i = 0; i < 5000; ++i) {
+        keys.push_back((uint64_t(i) * 2654435761u) % 1000 * 0x10000000001ull);
+        values.push_back(i);
+    }
+    std::vector<std::pair<uint64_t, uint32_t>> expected;
+    for (size_t i = 0; i < keys.size(); ++i) expected.push_back({ keys[i], values[i] });
+    std::stable_sort(expected.begin(), expected.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    geom::radix_sort(keys, values);
+    bool sorted_ok = true;
+    for (size_t i = 0; i < keys.size(); ++i) sorted_ok = sorted_ok && keys[i] == expected[i].first && values[i] == expected[i].second;
+    if (sorted_ok) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED" << std::endl;
+
+    std::cout << "Test 2.2: Lexicographic radix sort handles negatives and signed zeros... ";
+    std::vector<geom::Point2d> points = { {1, 2}, {-3, 5}, {0.0, 1}, {-0.0, -1}, {1, -2}, {-3, -5}, {2.5, 0} };
+    geom::sort_lexicographic(points);
+    bool lex_ok = true;
+    for (size_t i = 1; i < points.size(); ++i) {
+        const auto& a = points[i - 1];
+        const auto& b = points[i];
+        lex_ok = lex_ok && (a[0].value < b[0].value || (a[0].value == b[0].value && a[1].value <= b[1].value));
+    }
+    if (lex_ok && points.front() == geom::Point2d(-3, -5)) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED" << std::endl;
+
+    std::cout << "Test 3.1: Radix-sorted hull matches convex_hull... ";
+    std::vector<geom::Point2d> cloud;
+    for (int i = 0; i < 20000; ++i) cloud.push_back(geom::Point2d(std::sin(i * 12.9898) * 100.0, std::cos(i * 78.233) * 50.0));
+    std::vector<geom::Point2d> cloud_copy = cloud;
+    auto reference_hull = geom::convex_hull(cloud);
+    auto radix_hull = geom::convex_hull_radix(cloud_copy);
+    if (reference_hull && radix_hull && reference_hull->num_vertices() == radix_hull->num_vertices() &&
+        std::abs(reference_hull->area() - radix_hull->area()) < 1e-9) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 3.2: Morton-built BVH and Hilbert-ordered batches match scalar queries... ";
+    // A height field whose triangles are listed in shuffled order.
+    std::vector<geom::Point3d> grid_vertices;
+    std::vector<uint32_t> grid_indices;
+    const uint32_t side = 40;
+    for (uint32_t y = 0; y <= side; ++y) {
+        for (uint32_t x = 0; x <= side; ++x) grid_vertices.push_back(geom::Point3d(x, y, std::sin(x * 0.3) * std::cos(y * 0.2)));
+    }
+    std::vector<uint32_t> cells(side * side);
+    std::iota(cells.begin(), cells.end(), 0u);
+    std::shuffle(cells.begin(), cells.end(), std::mt19937(35));
+    for (uint32_t c : cells) {
+        const uint32_t v = c / side * (side + 1) + c % side;
+        grid_indices.insert(grid_indices.end(), { v, v + 1, v + side + 2, v, v + side + 2, v + side + 1 });
+    }
+    geom::TriangleMesh3d terrain(grid_vertices, grid_indices);
+    geom::MeshBVH3d terrain_bvh(terrain);
+    std::vector<geom::Ray3d> rays;
+    for (int i = 0; i < 5000; ++i) {
+        rays.push_back(geom::Ray3d::from_point_direction({ std::fmod(i * 7.31, 40.0), std::fmod(i * 3.17, 40.0), 5 }, { 0.1, -0.05, -1 }));
+    }
+    std::vector<std::optional<geom::RayMeshHit<double>>> hits;
+    std::vector<uint8_t> occluded;
+    terrain_bvh.closest_hit_batch(rays, hits);
+    terrain_bvh.any_hit_batch(rays, {}, occluded);
+    bool batch_ok = true;
+    for (size_t i = 0; i < rays.size() && batch_ok; ++i) {
+        std::optional<double> best;
+        for (size_t t = 0; t < terrain.num_triangles(); ++t) {
+            auto h = geom::intersection(rays[i], terrain.triangle(t));
+            if (h && (!best || h->t < *best)) best = h->t;
+        }
+        batch_ok = best.has_value() == hits[i].has_value() && occluded[i] == (best ? 1 : 0) &&
+                   (!best || (std::abs(*best - hits[i]->t) < 1e-6 && geom::intersection(rays[i], terrain.triangle(hits[i]->triangle)).has_value()));
+    }
+    std::vector<geom::Polygon2d> cells_2d;
+    for (int y = 0; y < 10; ++y) {
+        for (int x = 0; x < 10; ++x) cells_2d.push_back(geom::Polygon2d({ { x * 1.0, y * 1.0 }, { x + 1.0, y * 1.0 }, { x + 1.0, y + 1.0 }, { x * 1.0, y + 1.0 } }));
+    }
+    auto map = geom::TrapezoidalMap2d::from_polygons(cells_2d);
+    std::vector<geom::Point2d> queries;
+    for (int i = 0; i < 4000; ++i) queries.push_back(geom::Point2d(std::fmod(i * 0.737, 11.0) - 0.5, std::fmod(i * 0.311, 10.0) + 0.05));
+    std::vector<uint32_t> faces;
+    map.locate(queries, faces);
+    for (size_t i = 0; i < queries.size() && batch_ok; ++i) {
+        const auto face = map.locate(queries[i]);
+        batch_ok = faces[i] == (face ? *face : geom::TrapezoidalMap2d::Invalid);
+    }
+    if (batch_ok) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED" << std::endl;
+}
+
+void run_dcel_tests() {
+    std::cout << "\n--- Running DCEL Tests ---" << std::endl;
+
+    std::cout << "Test 1.1: Crossing square split by its diagonals... ";
+    std::vector<geom::Segment2d> square = {
+        geom::Segment2d({ 0, 0 }, { 4, 0 }), geom::Segment2d({ 4, 0 }, { 4, 4 }),
+        geom::Segment2d({ 4, 4 }, { 0, 4 }), geom::Segment2d({ 0, 4 }, { 0, 0 }),
+        geom::Segment2d({ 0, 0 }, { 4, 4 }), geom::Segment2d({ 0, 4 }, { 4, 0 }) };
+    auto dcel = geom::Dcel2d::from_segments(square);
+    auto faces = dcel.face_polygons();
+    bool quarters = faces.size() == 4;
+    for (const auto& f : faces) quarters = quarters && f.num_vertices() == 3 && std::abs(f.area() - 4.0) < 1e-9;
+    if (dcel.num_vertices() == 5 && dcel.num_edges() == 8 && quarters) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED. " << dcel.num_vertices() << " vertices, " << dcel.num_edges() << " edges, " << faces.size() << " faces" << std::endl;
+
+    std::cout << "Test 1.2: Half-edge links are consistent... ";
+    bool links_ok = true;
+    for (uint32_t h = 0; h < dcel.half_edges().size(); ++h) {
+        const auto& e = dcel.half_edges()[h];
+        links_ok = links_ok && dcel.half_edges()[e.next].prev == h && dcel.half_edges()[e.next].origin == dcel.target(h) &&
+                   dcel.half_edges()[e.next].face == e.face;
+    }
+    if (links_ok) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED" << std::endl;
+
+    std::cout << "Test 2.1: Overlapping and T-junction segments are noded... ";
+    // Two rectangles sharing part of an edge, drawn with overlapping segments.
+    std::vector<geom::Segment2d> parcels = {
+        geom::Segment2d({ 0, 0 }, { 6, 0 }), geom::Segment2d({ 6, 0 }, { 6, 2 }), geom::Segment2d({ 6, 2 }, { 0, 2 }),
+        geom::Segment2d({ 0, 2 }, { 0, 0 }), geom::Segment2d({ 2, 0 }, { 2, 2 }),
+        geom::Segment2d({ 2, 0 }, { 5, 0 }) };
+    auto split = geom::Dcel2d::from_segments(parcels);
+    auto areas = split.to_collection();
+    std::vector<double> parcel_areas;
+    areas.areas(parcel_areas);
+    std::sort(parcel_areas.begin(), parcel_areas.end());
+    int shared_winding = 0;
+    for (const auto& e : split.half_edges()) {
+        const auto& from = split.vertices()[e.origin].point;
+        if (from == geom::Point2d(2, 0) && split.vertices()[split.target(&e - split.half_edges().data())].point == geom::Point2d(5, 0)) shared_winding = e.winding;
+    }
+    if (parcel_areas.size() == 2 && std::abs(parcel_areas[0] - 4.0) < 1e-9 && std::abs(parcel_areas[1] - 8.0) < 1e-9 && shared_winding == 2) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 2.2: Islands become holes of the enclosing face... ";
+    std::vector<geom::Segment2d> nested = {
+        geom::Segment2d({ 0, 0 }, { 10, 0 }), geom::Segment2d({ 10, 0 }, { 10, 10 }), geom::Segment2d({ 10, 10 }, { 0, 10 }), geom::Segment2d({ 0, 10 }, { 0, 0 }),
+        geom::Segment2d({ 3, 3 }, { 6, 3 }), geom::Segment2d({ 6, 3 }, { 6, 6 }), geom::Segment2d({ 6, 6 }, { 3, 6 }), geom::Segment2d({ 3, 6 }, { 3, 3 }) };
+    auto nested_dcel = geom::Dcel2d::from_segments(nested);
+    auto nested_faces = nested_dcel.to_collection();
+    std::vector<double> nested_areas;
+    nested_faces.areas(nested_areas);
+    std::sort(nested_areas.begin(), nested_areas.end());
+    if (nested_dcel.num_faces() == 3 && nested_areas.size() == 2 && std::abs(nested_areas[0] - 9.0) < 1e-9 && std::abs(nested_areas[1] - 91.0) < 1e-9 &&
+        nested_dcel.faces()[0].num_holes == 1) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 3.1: Street grid produces one face per block... ";
+    std::vector<geom::Segment2d> grid;
+    for (int i = 0; i <= 30; ++i) {
+        grid.push_back(geom::Segment2d({ double(i), 0 }, { double(i), 30 }));
+        grid.push_back(geom::Segment2d({ 0, double(i) }, { 30, double(i) }));
+    }
+    auto blocks = geom::Dcel2d::from_segments(grid, geom::Coord<double>::Epsilon, 4);
+    if (blocks.num_faces() == 901 && blocks.num_vertices() == 961) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED. " << blocks.num_faces() << " faces" << std::endl;
+}
+
+void run_point_location_tests() {
+    std::cout << "\n--- Running Point Location Tests ---" << std::endl;
+
+    // A 12 x 12 grid of unit parcels sharing edges, plus a concave zone to the right.
+    std::vector<geom::Polygon2d> zones;
+    for (int y = 0; y < 12; ++y) {
+        for (int x = 0; x < 12; ++x) {
+            zones.push_back(geom::Polygon2d({ { double(x), double(y) }, { x + 1.0, double(y) }, { x + 1.0, y + 1.0 }, { double(x), y + 1.0 } }));
+        }
+    }
+    zones.push_back(geom::Polygon2d({ { 14, 0 }, { 20, 0 }, { 20, 12 }, { 17, 3 }, { 14, 12 } }));
+    auto map = geom::TrapezoidalMap2d::from_polygons(zones);
+
+    std::mt19937 rng(37);
+    std::uniform_real_distribution<double> coord(-2.0, 22.0);
+    std::vector<geom::Point2d> queries;
+    for (int i = 0; i < 5000; ++i) queries.push_back(geom::Point2d(coord(rng), coord(rng)));
+
+    std::cout << "Test 1.1: Locating among polygons matches brute-force contains... ";
+    size_t mismatches = 0;
+    for (const auto& q : queries) {
+        std::optional<uint32_t> expected;
+        for (uint32_t i = 0; i < zones.size(); ++i) {
+            if (geom::contains(q, zones[i])) expected = i;
+        }
+        if (map.locate(q) != expected) ++mismatches;
+    }
+    if (mismatches == 0 && map.num_edges() == 12 * 13 * 2 + 5) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED. " << mismatches << " mismatches, " << map.num_edges() << " edges" << std::endl;
+
+    std::cout << "Test 1.2: Batch queries match single queries... ";
+    std::vector<uint32_t> faces;
+    map.locate(queries, faces, 4);
+    bool batch_ok = faces.size() == queries.size();
+    for (size_t i = 0; batch_ok && i < queries.size(); ++i) {
+        const auto face = map.locate(queries[i]);
+        batch_ok = faces[i] == (face ? *face : geom::TrapezoidalMap2d::Invalid);
+    }
+    if (batch_ok) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED" << std::endl;
+
+    std::cout << "Test 2.1: Locating DCEL faces, including an island... ";
+    std::vector<geom::Segment2d> nested = {
+        geom::Segment2d({ 0, 0 }, { 10, 0 }), geom::Segment2d({ 10, 0 }, { 10, 10 }), geom::Segment2d({ 10, 10 }, { 0, 10 }), geom::Segment2d({ 0, 10 }, { 0, 0 }),
+        geom::Segment2d({ 3, 3 }, { 6, 3 }), geom::Segment2d({ 6, 3 }, { 6, 6 }), geom::Segment2d({ 6, 6 }, { 3, 6 }), geom::Segment2d({ 3, 6 }, { 3, 3 }) };
+    auto dcel = geom::Dcel2d::from_segments(nested);
+    auto dcel_map = geom::TrapezoidalMap2d::from_dcel(dcel);
+    auto island = dcel_map.locate(geom::Point2d(4, 4));
+    auto ring = dcel_map.locate(geom::Point2d(1, 5));
+    auto beside = dcel_map.locate(geom::Point2d(8, 4.5));
+    if (island && ring && beside && *island != *ring && *ring == *beside && std::abs(dcel.face_polygon(*island).area() - 9.0) < 1e-9 &&
+        !dcel_map.locate(geom::Point2d(11, 5)) && !dcel_map.locate(geom::Point2d(5, -1))) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 2.2: Street grid DCEL faces contain their query points... ";
+    std::vector<geom::Segment2d> streets;
+    for (int i = 0; i <= 30; ++i) {
+        streets.push_back(geom::Segment2d({ double(i), 0 }, { double(i), 30 }));
+        streets.push_back(geom::Segment2d({ 0, double(i) }, { 30, double(i) }));
+    }
+    auto blocks = geom::Dcel2d::from_segments(streets);
+    auto block_map = geom::TrapezoidalMap2d::from_dcel(blocks);
+    std::uniform_real_distribution<double> inside(0.01, 29.99);
+    size_t wrong = 0;
+    for (int i = 0; i < 2000; ++i) {
+        geom::Point2d q(inside(rng), inside(rng));
+        auto face = block_map.locate(q);
+        if (!face || !geom::contains(q, blocks.face_polygon(*face))) ++wrong;
+    }
+    if (wrong == 0) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED. " << wrong << " wrong faces" << std::endl;
+
+    std::cout << "Test 3.1: Search depth stays logarithmic... ";
+    // 1860 edges; the expected depth is O(log n), far below the edge count.
+    if (block_map.depth() < 120) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED. Depth " << block_map.depth() << std::endl;
+}
+
+void run_visibility_tests() {
+    std::cout << "\n--- Running Visibility Tests ---" << std::endl;
+    const geom::Box2d room(geom::Point2d(-10, -10), geom::Point2d(10, 10));
+
+    std::cout << "Test 1.1: Without obstacles the whole box is visible... ";
+    auto open = geom::visibility_polygon(geom::Point2d(1, 2), std::vector<geom::Segment2d>{}, room);
+    if (open && std::abs(open->area() - 400.0) < 1e-9) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED" << std::endl;
+
+    std::cout << "Test 1.2: A wall casts a trapezoidal shadow... ";
+    auto shadowed = geom::visibility_polygon(geom::Point2d(0, 0), { geom::Segment2d({ 2, -1 }, { 2, 1 }) }, room);
+    if (shadowed && std::abs(shadowed->area() - 352.0) < 1e-9 && !geom::contains(geom::Point2d(8, 0), *shadowed) &&
+        geom::contains(geom::Point2d(8, 5), *shadowed)) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED. Area " << (shadowed ? shadowed->area() : -1.0) << std::endl; }
+
+    // Short walls in separate grid cells, some sharing an endpoint with a neighbour.
+    std::mt19937 rng(38);
+    std::uniform_real_distribution<double> unit(0.1, 0.9);
+    std::vector<geom::Segment2d> walls;
+    for (int y = -8; y < 8; y += 2) {
+        for (int x = -8; x < 8; x += 2) {
+            if ((x + y) % 4 == 0) continue;
+            geom::Point2d a(x + 2 * unit(rng), y + 2 * unit(rng));
+            geom::Point2d b(x + 2 * unit(rng), y + 2 * unit(rng));
+            walls.push_back(geom::Segment2d(a, b));
+            if (x % 4 == 0) walls.push_back(geom::Segment2d(b, geom::Point2d(x + 2 * unit(rng), y + 2 * unit(rng))));
+        }
+    }
+    auto blocked = [&](const geom::Point2d& from, const geom::Point2d& to) {
+        auto side = [](const geom::Point2d& a, const geom::Point2d& b, const geom::Point2d& c) {
+            const double v = (b[0].value - a[0].value) * (c[1].value - a[1].value) - (b[1].value - a[1].value) * (c[0].value - a[0].value);
+            return (v > 0) - (v < 0);
+        };
+        for (const auto& w : walls) {
+            if (side(from, to, w.p1()) * side(from, to, w.p2()) < 0 && side(w.p1(), w.p2(), from) * side(w.p1(), w.p2(), to) < 0) return true;
+        }
+        return false;
+    };
+
+    std::cout << "Test 2.1: Visibility polygon matches brute-force line of sight... ";
+    const geom::Point2d eye(0.5, -0.5);
+    auto visible = geom::visibility_polygon(eye, walls, room);
+    std::uniform_real_distribution<double> anywhere(-9.9, 9.9);
+    size_t mismatches = 0;
+    for (int i = 0; visible && i < 3000; ++i) {
+        geom::Point2d q(anywhere(rng), anywhere(rng));
+        if (geom::contains(q, *visible) == blocked(eye, q)) ++mismatches;
+    }
+    if (visible && mismatches == 0) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED. " << mismatches << " mismatches" << std::endl;
+
+    std::cout << "Test 2.2: Incremental updates along a path match fresh sweeps... ";
+    auto sweep = geom::VisibilitySweep2d::from_segments(walls, room);
+    std::vector<geom::Point2d> path;
+    for (int i = 0; i < 50; ++i) path.push_back(geom::Point2d(-9.0 + 0.35 * i, -9.5 + 0.02 * i));
+    bool incremental_ok = true;
+    for (const auto& p : path) {
+        auto warm = sweep.compute(p);
+        auto fresh = geom::visibility_polygon(p, walls, room);
+        incremental_ok = incremental_ok && warm && fresh && warm->num_vertices() == fresh->num_vertices() && std::abs(warm->area() - fresh->area()) < 1e-9;
+    }
+    if (incremental_ok) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED" << std::endl;
+
+    std::cout << "Test 3.1: Batch viewpoints match single sweeps... ";
+    std::vector<std::optional<geom::Polygon2d>> batch;
+    sweep.compute(path, batch, 4);
+    bool batch_ok = batch.size() == path.size();
+    for (size_t i = 0; batch_ok && i < path.size(); ++i) {
+        auto single = geom::visibility_polygon(path[i], walls, room);
+        batch_ok = batch[i] && single && std::abs(batch[i]->area() - single->area()) < 1e-9;
+    }
+    if (batch_ok && !sweep.compute(geom::Point2d(12, 0))) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED" << std::endl;
+}
+
+void run_range_tree_tests() {
+    std::cout << "\n--- Running Range Tree Tests ---" << std::endl;
+
+    // Integer coordinates give many ties in x and y and points on the query borders.
+    std::mt19937 rng(39);
+    std::uniform_int_distribution<int> coord(0, 200);
+    std::vector<geom::Point2d> points;
+    for (int i = 0; i < 20000; ++i) points.push_back(geom::Point2d(coord(rng), coord(rng)));
+    auto tree = geom::RangeTree2d::from_points(points, 4);
+
+    std::vector<geom::Box2d> ranges;
+    for (int i = 0; i < 200; ++i) {
+        const double x0 = coord(rng), y0 = coord(rng);
+        ranges.push_back(geom::Box2d(geom::Point2d(x0, y0), geom::Point2d(x0 + coord(rng) / 2, y0 + coord(rng) / 3)));
+    }
+
+    std::cout << "Test 1.1: Counts match a full scan... ";
+    size_t wrong_counts = 0;
+    for (const auto& range : ranges) {
+        size_t expected = 0;
+        for (const auto& p : points) expected += range.contains(p) ? 1 : 0;
+        if (tree.count(range) != expected) ++wrong_counts;
+    }
+    if (wrong_counts == 0) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED. " << wrong_counts << " wrong counts" << std::endl;
+
+    std::cout << "Test 1.2: Reported spans list every hit exactly once... ";
+    bool report_ok = true;
+    std::vector<geom::IndexSpan> spans;
+    for (const auto& range : ranges) {
+        tree.report(range, spans);
+        std::vector<uint32_t> hits;
+        for (const auto& span : spans) hits.insert(hits.end(), span.begin(), span.end());
+        std::sort(hits.begin(), hits.end());
+        std::vector<uint32_t> expected;
+        for (uint32_t i = 0; i < points.size(); ++i) {
+            if (range.contains(points[i])) expected.push_back(i);
+        }
+        report_ok = report_ok && hits == expected && spans.size() <= 4 * 16;
+    }
+    if (report_ok) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED" << std::endl;
+
+    std::cout << "Test 2.1: Serial and parallel builds agree... ";
+    auto serial = geom::RangeTree2d::from_points(points, 1);
+    bool same = serial.memory_bytes() == tree.memory_bytes();
+    for (const auto& range : ranges) same = same && serial.count(range) == tree.count(range);
+    if (same) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED" << std::endl;
+
+    std::cout << "Test 2.2: Empty trees, single points and empty boxes... ";
+    auto none = geom::RangeTree2d::from_points({});
+    auto one = geom::RangeTree2d::from_points({ geom::Point2d(1, 2) });
+    const geom::Box2d everything(geom::Point2d(-1e9, -1e9), geom::Point2d(1e9, 1e9));
+    if (none.count(everything) == 0 && one.count(everything) == 1 && one.count(geom::Box2d(geom::Point2d(1, 2), geom::Point2d(1, 2))) == 1 &&
+        one.count(geom::Box2d(geom::Point2d(1.5, 0), geom::Point2d(3, 3))) == 0 && tree.count(geom::Box2d()) == 0 &&
+        tree.count(everything) == points.size()) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+}
+
+// Every member of the float instantiations must compile, not only the ones the tests call.
+template class geom::Vector<2, float>;
+template class geom::Vector<3, float>;
+template class geom::Line<2, float>;
+template class geom::Segment<2, float>;
+template class geom::Ray<2, float>;
+template class geom::Polygon<2, float>;
+template class geom::Polygon<2, double, std::pmr::polymorphic_allocator<geom::Point2d>>;
+template class geom::Box<2, float>;
+template class geom::Ball<2, float>;
+template class geom::MeshBVH<float>;
+template class geom::ConvexClipper<float>;
+template class geom::SweepAndPrune<float>;
+template class geom::PolygonCollection<float>;
+template class geom::Dcel<float>;
+template class geom::TrapezoidalMap<float>;
+template class geom::VisibilitySweep<float>;
+template class geom::RangeTree<float>;
+template class geom::ChainIndex<float>;
+template class geom::Polyline<2, float>;
+template class geom::HalfPlaneRegion<float>;
+template class geom::VisibilityGraph<float>;
+
+void run_float_tests() {
+    std::cout << "\n--- Running Float Tests ---" << std::endl;
+    using Status = geom::IntersectionResult2D<float>::Status;
+
+    std::cout << "Test 1.1: Tolerances follow the coordinate type... ";
+    const bool tolerances = geom::Coord<float>::Epsilon == 1e-5f && geom::Coord<double>::Epsilon == 1e-9;
+    // 0.1f + 0.2f is off by one float ulp, far above 1e-9 but well inside the float tolerance.
+    if (tolerances && geom::Point2f(0.1f + 0.2f, 0.7f) == geom::Point2f(0.3f, 0.7f)) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED" << std::endl;
+
+    std::cout << "Test 1.2: Float line and segment intersections... ";
+    auto l1 = geom::Line2f::from_points({ 0, 1 }, { 10, 1 });
+    auto l2 = geom::Line2f::from_points({ 5, 0 }, { 5, 10 });
+    auto l3 = geom::Line2f::from_points({ 0.1f, 2.3f }, { 10.1f, 2.3f });
+    auto crossing = geom::intersection(l1, l2);
+    auto segments = geom::intersection(geom::Segment2f({ 0, 0 }, { 10, 10 }), geom::Segment2f({ 0, 10 }, { 10, 0 }));
+    if (crossing.status == Status::INTERSECTING && *crossing.point == geom::Point2f(5, 1) && geom::intersection(l1, l3).status == Status::PARALLEL &&
+        segments.status == geom::SegmentIntersectionResult2D<float>::Status::INTERSECTING && *segments.point == geom::Point2f(5, 5)) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 2.1: Float convex hull and containment... ";
+    std::vector<geom::Point2f> cloud;
+    for (int i = 0; i < 100; ++i) {
+        const float a = 0.0628318f * i;
+        cloud.push_back(geom::Point2f(std::cos(a) * (i % 2 ? 1.0f : 0.5f), std::sin(a) * (i % 2 ? 1.0f : 0.5f)));
+    }
+    auto hull = geom::convex_hull(cloud);
+    if (hull && hull->num_vertices() == 50 && std::abs(hull->area() - 3.1333f) < 1e-3f && geom::contains(geom::Point2f(0.2f, 0.3f), *hull) &&
+        !geom::contains(geom::Point2f(1.1f, 0), *hull)) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED. " << (hull ? hull->num_vertices() : 0) << " hull vertices" << std::endl; }
+
+    std::cout << "Test 2.2: Float spatial structures agree with double... ";
+    std::mt19937 rng(40);
+    std::uniform_real_distribution<float> coord(0, 100);
+    std::vector<geom::Point2f> points_f;
+    std::vector<geom::Point2d> points_d;
+    for (int i = 0; i < 5000; ++i) {
+        points_f.push_back(geom::Point2f(coord(rng), coord(rng)));
+        points_d.push_back(geom::Point2d(points_f.back()[0].value, points_f.back()[1].value));
+    }
+    auto tree_f = geom::RangeTree<float>::from_points(points_f);
+    auto tree_d = geom::RangeTree2d::from_points(points_d);
+    bool agree = true;
+    for (int i = 0; i < 50; ++i) {
+        const float x = coord(rng), y = coord(rng);
+        agree = agree && tree_f.count(geom::Box2f(geom::Point2f(x, y), geom::Point2f(x + 20, y + 10))) ==
+                         tree_d.count(geom::Box2d(geom::Point2d(x, y), geom::Point2d(x + 20.0f, y + 10.0f)));
+    }
+    auto square = geom::TrapezoidalMap<float>::from_polygons({ geom::Polygon2f({ { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 } }) });
+    if (agree && square.locate(geom::Point2f(0.5f, 0.5f)) == 0u && !square.locate(geom::Point2f(1.5f, 0.5f)) &&
+        tree_f.memory_bytes() < tree_d.memory_bytes()) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+}
+
+void run_snapshot_tests() {
+    std::cout << "\n--- Running Snapshot Tests ---" << std::endl;
+    const std::string dir = std::filesystem::temp_directory_path().string();
+    const std::string tree_path = dir + "/geom_range_tree.snap";
+    const std::string map_path = dir + "/geom_trapezoidal_map.snap";
+
+    std::mt19937 rng(41);
+    std::uniform_real_distribution<double> coord(0, 100);
+    std::vector<geom::Point2d> points;
+    for (int i = 0; i < 10000; ++i) points.push_back(geom::Point2d(coord(rng), coord(rng)));
+    auto tree = geom::RangeTree2d::from_points(points);
+
+    std::cout << "Test 1.1: Mapped range tree answers like the built one... ";
+    bool saved = tree.save(tree_path);
+    auto view = geom::RangeTreeView<double>::open(tree_path);
+    bool same = saved && view && view->size() == tree.size();
+    std::vector<geom::IndexSpan> built_spans, mapped_spans;
+    for (int i = 0; same && i < 100; ++i) {
+        const double x = coord(rng), y = coord(rng);
+        const geom::Box2d range(geom::Point2d(x, y), geom::Point2d(x + 15, y + 25));
+        tree.report(range, built_spans);
+        view->report(range, mapped_spans);
+        same = view->count(range) == tree.count(range) && built_spans.size() == mapped_spans.size();
+        for (size_t s = 0; same && s < built_spans.size(); ++s) {
+            same = std::equal(built_spans[s].begin(), built_spans[s].end(), mapped_spans[s].begin(), mapped_spans[s].end());
+        }
+    }
+    if (same) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED" << std::endl;
+
+    std::cout << "Test 1.2: Mapped point locator answers like the built one... ";
+    std::vector<geom::Polygon2d> zones;
+    for (int y = 0; y < 8; ++y) {
+        for (int x = 0; x < 8; ++x) {
+            zones.push_back(geom::Polygon2d({ { x * 10.0, y * 10.0 }, { x * 10.0 + 10, y * 10.0 }, { x * 10.0 + 5, y * 10.0 + 10 } }));
+        }
+    }
+    auto map = geom::TrapezoidalMap2d::from_polygons(zones);
+    auto map_view = map.save(map_path) ? geom::TrapezoidalMapView<double>::open(map_path) : std::nullopt;
+    std::vector<uint32_t> built_faces, mapped_faces;
+    if (map_view) {
+        map.locate(points, built_faces);
+        map_view->locate(points, mapped_faces, 2);
+    }
+    if (map_view && built_faces == mapped_faces && map_view->locate(geom::Point2d(5, 2)) == 0u) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED" << std::endl;
+
+    auto patch = [](const std::string& path, long offset, char value) {
+        std::FILE* f = std::fopen(path.c_str(), "r+b");
+        if (!f) return;
+        std::fseek(f, offset, SEEK_SET);
+        std::fputc(value, f);
+        std::fclose(f);
+    };
+
+    std::cout << "Test 2.1: Corrupt and mismatched snapshots are rejected... ";
+    const bool wrong_kind = !geom::TrapezoidalMapView<double>::open(tree_path) && !geom::RangeTreeView<float>::open(tree_path);
+    patch(tree_path, 4096, 0x5A);
+    const bool corrupt = !geom::RangeTreeView<double>::open(tree_path);
+    const bool unverified = geom::RangeTreeView<double>::open(tree_path, false).has_value();
+    if (wrong_kind && corrupt && unverified && !geom::RangeTreeView<double>::open(dir + "/geom_missing.snap")) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED" << std::endl;
+
+    std::cout << "Test 2.2: A snapshot from another format version is stale... ";
+    map.save(map_path);
+    patch(map_path, 8, char(geom::SnapshotFormatVersion + 1));
+    if (!geom::TrapezoidalMapView<double>::open(map_path, false)) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED" << std::endl;
+
+    std::cout << "Test 2.3: Unverified snapshots with out-of-range indices are rejected... ";
+    // Sets the high byte of a 32-bit field inside a section, leaving the checksum stale.
+    auto patch_section = [&](const std::string& path, size_t section, long field_offset) {
+        geom::detail::SnapshotSection s{};
+        if (std::FILE* f = std::fopen(path.c_str(), "rb")) {
+            std::fseek(f, static_cast<long>(sizeof(geom::detail::SnapshotHeader) + section * sizeof(s)), SEEK_SET);
+            if (std::fread(&s, sizeof(s), 1, f) != 1) s.offset = 0;
+            std::fclose(f);
+        }
+        patch(path, static_cast<long>(s.offset) + field_offset + 3, 0x7F);
+    };
+    tree.save(tree_path);
+    patch_section(tree_path, 3, 0);                                 // First point index.
+    const bool bad_id = !geom::RangeTreeView<double>::open(tree_path, false);
+    tree.save(tree_path);
+    patch_section(tree_path, 5, 4 * sizeof(uint32_t));              // A rank of the first level.
+    const bool bad_rank = !geom::RangeTreeView<double>::open(tree_path, false);
+    map.save(map_path);
+    patch_section(map_path, 3, sizeof(geom::Point2d) + 2 * sizeof(uint32_t));     // Left child of the root.
+    const bool bad_child = !geom::TrapezoidalMapView<double>::open(map_path, false);
+    map.save(map_path);
+    if (bad_id && bad_rank && bad_child && geom::TrapezoidalMapView<double>::open(map_path, false)) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED" << std::endl;
+
+    std::remove(tree_path.c_str());
+    std::remove(map_path.c_str());
+}
+
+void run_intersection_batch_tests() {
+    std::cout << "\n--- Running Batch Intersection Tests ---" << std::endl;
+    using SegStatus = geom::SegmentIntersectionResult2D<double>::Status;
+    using LineStatus = geom::IntersectionResult2D<double>::Status;
+
+    std::vector<geom::Segment2d> a = { geom::Segment2d({ 0, 0 }, { 10, 10 }), geom::Segment2d({ 0, 0 }, { 5, 0 }), geom::Segment2d({ 0, 0 }, { 6, 0 }),
+                                       geom::Segment2d({ 0, 0 }, { 1, 1 }), geom::Segment2d({ 0, 0 }, { 5, 0 }) };
+    std::vector<geom::Segment2d> b = { geom::Segment2d({ 0, 10 }, { 10, 0 }), geom::Segment2d({ 3, 0 }, { 8, 0 }), geom::Segment2d({ 0, 1 }, { 6, 1 }),
+                                       geom::Segment2d({ 5, 0 }, { 6, 2 }), geom::Segment2d({ 5, 0 }, { 9, 0 }) };
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> coord(-10.0, 10.0);
+    for (int i = 0; i < 200; ++i) {
+        a.push_back(geom::Segment2d({ coord(rng), coord(rng) }, { coord(rng), coord(rng) }));
+        b.push_back(geom::Segment2d({ coord(rng), coord(rng) }, { coord(rng), coord(rng) }));
+    }
+    geom::IntersectionBuffers<double> buffers;
+    geom::intersection_batch(a, b, buffers.resize(a.size()));
+
+    std::cout << "Test 1.1: Batch segment rows match the scalar results... ";
+    bool rows_match = true;
+    for (size_t i = 0; i < a.size(); ++i) {
+        const auto scalar = geom::intersection(a[i], b[i]);
+        const auto status = static_cast<SegStatus>(buffers.status[i]);
+        if (status != scalar.status) rows_match = false;
+        else if (status == SegStatus::INTERSECTING) rows_match = rows_match && geom::Point2d(buffers.x[i], buffers.y[i]) == *scalar.point;
+        else if (status == SegStatus::OVERLAPPING) {
+            const geom::Point2d start(buffers.x[i], buffers.y[i]);
+            rows_match = rows_match && (start == scalar.segment->p1() || start == scalar.segment->p2());
+        }
+    }
+    if (rows_match && static_cast<SegStatus>(buffers.status[1]) == SegStatus::OVERLAPPING && buffers.t[1] == 0.6 && buffers.u[1] == 1.0 &&
+        static_cast<SegStatus>(buffers.status[4]) == SegStatus::INTERSECTING && buffers.t[4] == 1.0) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 1.2: Vertical coincident segments overlap... ";
+    auto vertical = geom::intersection(geom::Segment2d({ 0, 0 }, { 0, 10 }), geom::Segment2d({ 0, 15 }, { 0, 5 }));
+    if (vertical.status == SegStatus::OVERLAPPING && vertical.segment->p1() == geom::Point2d(0, 5) && vertical.segment->p2() == geom::Point2d(0, 10)) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 1.3: Ray pointing back along the segment from inside... ";
+    auto backward = geom::intersection(geom::Segment2d({ 0, 0 }, { 10, 0 }), geom::Ray2d::from_point_direction({ 5, 0 }, { -1, 0 }));
+    if (backward.status == SegStatus::OVERLAPPING && backward.segment->p1() == geom::Point2d(0, 0) && backward.segment->p2() == geom::Point2d(5, 0)) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 2.1: Skipped columns and rows without a hit stay untouched... ";
+    std::vector<uint8_t> status(a.size());
+    std::vector<double> t(a.size(), -1.0);
+    geom::IntersectionOutput<double> out;
+    out.status = status.data();
+    out.t = t.data();
+    geom::intersection_batch(a.data(), b.data(), a.size(), out);
+    bool untouched = status == buffers.status;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (static_cast<SegStatus>(status[i]) == SegStatus::NO_INTERSECTION) untouched = untouched && t[i] == -1.0;
+        else untouched = untouched && t[i] == buffers.t[i];
+    }
+    if (untouched) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED" << std::endl;
+
+    std::cout << "Test 2.2: Line and ray batches... ";
+    const std::vector<geom::Line2d> lines = { geom::Line2d::from_points({ 0, 1 }, { 10, 1 }), geom::Line2d::from_points({ 0, 0 }, { 1, 0 }),
+                                              geom::Line2d::from_points({ 0, 0 }, { 1, 0 }) };
+    const std::vector<geom::Line2d> others = { geom::Line2d::from_points({ 5, 0 }, { 5, 10 }), geom::Line2d::from_points({ 0, 2 }, { 1, 2 }),
+                                               geom::Line2d::from_points({ 3, 0 }, { 4, 0 }) };
+    const std::vector<geom::Ray2d> rays = { geom::Ray2d::from_point_direction({ 5, 0 }, { 0, 1 }), geom::Ray2d::from_point_direction({ 5, 2 }, { 0, 1 }), geom::Ray2d::from_point_direction({ 3, 0 }, { 1, 0 }) };
+    geom::IntersectionBuffers<double> line_rows, ray_rows;
+    geom::intersection_batch(lines, others, line_rows.resize(lines.size()));
+    geom::intersection_batch(lines, rays, ray_rows.resize(lines.size(), false));
+    const bool line_ok = static_cast<LineStatus>(line_rows.status[0]) == LineStatus::INTERSECTING && geom::Point2d(line_rows.x[0], line_rows.y[0]) == geom::Point2d(5, 1) &&
+        static_cast<LineStatus>(line_rows.status[1]) == LineStatus::PARALLEL && static_cast<LineStatus>(line_rows.status[2]) == LineStatus::COINCIDENT;
+    const bool ray_ok = static_cast<SegStatus>(ray_rows.status[0]) == SegStatus::INTERSECTING && ray_rows.u[0] == 1.0 &&
+        static_cast<SegStatus>(ray_rows.status[1]) == SegStatus::NO_INTERSECTION && static_cast<SegStatus>(ray_rows.status[2]) == SegStatus::OVERLAPPING &&
+        ray_rows.t[2] == 3.0 && std::isinf(ray_rows.u[2]) && ray_rows.x.empty();
+    if (line_ok && ray_ok) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED" << std::endl;
+
+    std::cout << "--- Batch Intersection Tests Finished ---" << std::endl;
+}
+
+void run_polygon_moments_tests() {
+    std::cout << "\n--- Running Polygon Moments Tests ---" << std::endl;
+    auto near = [](double a, double b, double tol) { return std::abs(a - b) <= tol; };
+
+    std::cout << "Test 1.1: Rectangle moments in both orientations... ";
+    geom::Polygon2d rect({ { 10, 20 }, { 14, 20 }, { 14, 22 }, { 10, 22 } });
+    geom::Polygon2d rect_cw({ { 10, 20 }, { 10, 22 }, { 14, 22 }, { 14, 20 } });
+    auto m = rect.moments();
+    auto m_cw = rect_cw.moments();
+    if (near(m.signed_area, 8, 1e-12) && near(m_cw.signed_area, -8, 1e-12) && near(m.perimeter, 12, 1e-12) && m.centroid == geom::Point2d(12, 21) &&
+        near(m.ixx, 8.0 / 3.0, 1e-12) && near(m.iyy, 32.0 / 3.0, 1e-12) && near(m.ixy, 0, 1e-12) &&
+        near(m_cw.ixx, m.ixx, 1e-12) && near(m_cw.iyy, m.iyy, 1e-12) && m_cw.centroid == m.centroid) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 1.2: Right triangle centroid and product of inertia... ";
+    auto tri = geom::Polygon2d({ { 0, 0 }, { 3, 0 }, { 0, 3 } }).moments();
+    if (near(tri.area(), 4.5, 1e-12) && tri.centroid == geom::Point2d(1, 1) && near(tri.ixx, 2.25, 1e-12) && near(tri.iyy, 2.25, 1e-12) &&
+        near(tri.ixy, -1.125, 1e-12)) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 2.1: Million-vertex ring far from the origin, parallel and serial... ";
+    const size_t n = 1000000;
+    const double radius = 1000, cx = 500000, cy = 4500000;
+    std::vector<geom::Point2d> ring;
+    ring.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        const double a = 2 * 3.14159265358979323846 * double(i) / double(n);
+        ring.push_back(geom::Point2d(cx + radius * std::cos(a), cy + radius * std::sin(a)));
+    }
+    geom::Polygon2d coast(ring);
+    auto serial = coast.moments(1);
+    auto parallel = coast.moments(4);
+    const double exact = 0.5 * double(n) * radius * radius * std::sin(2 * 3.14159265358979323846 / double(n));
+    if (serial.signed_area == parallel.signed_area && serial.ixx == parallel.ixx && near(serial.signed_area, exact, exact * 1e-12) &&
+        near(serial.centroid[0].value, cx, 1e-6) && near(serial.centroid[1].value, cy, 1e-6) &&
+        near(serial.ixx, serial.iyy, serial.ixx * 1e-9) && near(serial.perimeter, 2 * 3.14159265358979323846 * radius, 1e-3)) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 3.1: Newell vector area and normal of a tilted 3D square... ";
+    geom::Polygon3d tilted({ { 0, 0, 0 }, { 1, 0, 0 }, { 1, 1, 1 }, { 0, 1, 1 } });
+    auto normal = tilted.normal();
+    const double h = std::sqrt(0.5);
+    if (near(tilted.area(), std::sqrt(2.0), 1e-12) && normal && *normal == geom::Vector<3, double>(0, -h, h) &&
+        tilted.vector_area() == geom::Vector<3, double>(0, -1, 1) &&
+        !geom::Polygon3d({ { 0, 0, 0 }, { 1, 1, 1 }, { 2, 2, 2 } }).normal()) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "--- Polygon Moments Tests Finished ---" << std::endl;
+}
+
+void run_similarity_tests() {
+    std::cout << "\n--- Running Trajectory Similarity Tests ---" << std::endl;
+    using Mode = geom::HausdorffMode;
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> coord(-50.0, 50.0);
+    auto random_chain = [&](size_t n) {
+        std::vector<geom::Point2d> chain;
+        for (size_t i = 0; i < n; ++i) chain.push_back(geom::Point2d(coord(rng), coord(rng)));
+        return chain;
+    };
+    auto brute_directed = [](const std::vector<geom::Point2d>& from, const std::vector<geom::Point2d>& to, Mode mode) {
+        double result = 0;
+        for (const auto& p : from) {
+            double best = std::numeric_limits<double>::infinity();
+            if (mode == Mode::POINTS || to.size() == 1) {
+                for (const auto& q : to) best = std::min(best, (p - q).length());
+            }
+            else {
+                for (size_t j = 0; j + 1 < to.size(); ++j) best = std::min(best, geom::distance(p, geom::Segment2d(to[j], to[j + 1])));
+            }
+            result = std::max(result, best);
+        }
+        return result;
+    };
+    auto brute_frechet = [](const std::vector<geom::Point2d>& a, const std::vector<geom::Point2d>& b) {
+        std::vector<std::vector<double>> ca(a.size(), std::vector<double>(b.size()));
+        for (size_t i = 0; i < a.size(); ++i) {
+            for (size_t j = 0; j < b.size(); ++j) {
+                const double d = (a[i] - b[j]).length();
+                if (i == 0 && j == 0) ca[i][j] = d;
+                else if (i == 0) ca[i][j] = std::max(ca[i][j - 1], d);
+                else if (j == 0) ca[i][j] = std::max(ca[i - 1][j], d);
+                else ca[i][j] = std::max(std::min({ ca[i - 1][j], ca[i - 1][j - 1], ca[i][j - 1] }), d);
+            }
+        }
+        return ca.back().back();
+    };
+
+    std::cout << "Test 1.1: Indexed Hausdorff matches brute force in both modes... ";
+    bool hausdorff_ok = true;
+    for (int round = 0; round < 20; ++round) {
+        const auto a = random_chain(1 + round * 7), b = random_chain(2 + round * 5);
+        for (Mode mode : { Mode::POINTS, Mode::SEGMENTS }) {
+            const double expected = std::max(brute_directed(a, b, mode), brute_directed(b, a, mode));
+            const auto got = geom::hausdorff_distance(a, b, mode);
+            hausdorff_ok = hausdorff_ok && got && std::abs(*got - expected) < 1e-9;
+        }
+    }
+    if (hausdorff_ok) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED" << std::endl;
+
+    std::cout << "Test 1.2: Trace against sparse route geometry... ";
+    std::vector<geom::Point2d> route = { { 0, 0 }, { 100, 0 }, { 100, 100 } };
+    std::vector<geom::Point2d> trace;
+    for (int i = 0; i <= 100; ++i) trace.push_back(geom::Point2d(i, 0.5));
+    for (int i = 1; i <= 100; ++i) trace.push_back(geom::Point2d(100.5, i));
+    auto route_index = geom::ChainIndex2d::from_points(route);
+    auto to_route = route_index.directed_hausdorff(trace);
+    auto by_vertices = geom::hausdorff_distance(trace, route, Mode::POINTS);
+    if (to_route && std::abs(*to_route - 0.5) < 1e-12 && std::abs(route_index.distance(geom::Point2d(50, 3)) - 3) < 1e-12 &&
+        by_vertices && std::abs(*by_vertices - std::sqrt(50.0 * 50.0 + 0.25)) < 1e-9) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 1.3: Early abandoning against a threshold... ";
+    auto within = geom::hausdorff_distance(trace, route, Mode::SEGMENTS, 1.0);
+    auto beyond = geom::hausdorff_distance(trace, route, Mode::SEGMENTS, 0.4);
+    if (within && std::abs(*within - 0.5) < 1e-12 && !beyond && !route_index.directed_hausdorff(trace, 0.45)) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 2.1: Discrete Frechet with and without a threshold... ";
+    bool frechet_ok = true;
+    for (int round = 0; round < 20; ++round) {
+        const auto a = random_chain(1 + round * 3), b = random_chain(1 + round * 4);
+        const double expected = brute_frechet(a, b);
+        const auto exact = geom::discrete_frechet_distance(a, b);
+        const auto loose = geom::discrete_frechet_distance(a, b, expected * 1.01);
+        const auto tight = geom::discrete_frechet_distance(a, b, expected * 0.99);
+        frechet_ok = frechet_ok && exact && std::abs(*exact - expected) < 1e-9 && loose && std::abs(*loose - expected) < 1e-9 && !tight;
+    }
+    std::vector<geom::Point2d> reversed(trace.rbegin(), trace.rend());
+    const auto parallel_lines = geom::discrete_frechet_distance(std::vector<geom::Point2d>{ { 0, 0 }, { 1, 0 }, { 2, 0 } },
+                                                                std::vector<geom::Point2d>{ { 0, 1 }, { 1, 1 }, { 2, 1 } });
+    if (frechet_ok && parallel_lines && *parallel_lines == 1.0 && !geom::discrete_frechet_distance(trace, reversed, 10.0)) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 3.1: Batch scoring matches single queries... ";
+    const auto query = random_chain(40);
+    std::vector<std::vector<geom::Point2d>> candidates;
+    for (int i = 0; i < 64; ++i) candidates.push_back(random_chain(10 + i));
+    std::vector<std::optional<double>> hausdorff_scores, frechet_scores;
+    geom::hausdorff_distances(query, candidates, hausdorff_scores, Mode::SEGMENTS, 60.0, 4);
+    geom::discrete_frechet_distances(query, candidates, frechet_scores, 110.0, 4);
+    bool batch_ok = hausdorff_scores.size() == candidates.size() && frechet_scores.size() == candidates.size();
+    size_t kept = 0;
+    for (size_t i = 0; batch_ok && i < candidates.size(); ++i) {
+        batch_ok = hausdorff_scores[i] == geom::hausdorff_distance(query, candidates[i], Mode::SEGMENTS, 60.0) &&
+                   frechet_scores[i] == geom::discrete_frechet_distance(query, candidates[i], 110.0);
+        kept += hausdorff_scores[i].has_value() + frechet_scores[i].has_value();
+    }
+    if (batch_ok && kept > 0 && kept < 2 * candidates.size()) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED" << std::endl;
+
+    std::cout << "--- Trajectory Similarity Tests Finished ---" << std::endl;
+}
+
+void run_polyline_tests() {
+    std::cout << "\n--- Running Polyline Tests ---" << std::endl;
+
+    std::cout << "Test 1.1: Streaming append keeps length, bounds and prefix sums... ";
+    geom::Polyline2d track;
+    track.append(geom::Point2d(0, 0));
+    track.append(geom::Point2d(3, 4));
+    track.append(geom::Point2d(3, 4));
+    track.append(geom::Point2d(3, -6));
+    const std::vector<double> expected_prefix = { 0, 5, 5, 15 };
+    if (track.num_vertices() == 4 && track.num_edges() == 3 && track.length() == 15 && track.cumulative_lengths() == expected_prefix &&
+        track.bounds().min() == geom::Point2d(0, -6) && track.bounds().max() == geom::Point2d(3, 4)) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 1.2: Point at distance and interpolation... ";
+    auto located = track.locate(5);
+    if (track.point_at_distance(2.5) == geom::Point2d(1.5, 2) && track.point_at_distance(10) == geom::Point2d(3, -1) &&
+        track.point_at_distance(-1) == geom::Point2d(0, 0) && track.point_at_distance(99) == geom::Point2d(3, -6) &&
+        track.interpolate(0.5) == geom::Point2d(3, 1.5) && located.first == 2 && located.second == 0) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 1.3: Edges are views into the vertex buffer... ";
+    auto edge = track.edge(0);
+    geom::Segment2d copy = track.edge(2);
+    if (&edge.p1() == &track.vertices()[0] && &edge.p2() == &track.vertices()[1] && edge.length() == 5 &&
+        copy.p1() == geom::Point2d(3, 4) && copy.p2() == geom::Point2d(3, -6) && sizeof(edge) == sizeof(void*)) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 2.1: Long track matches a direct sum, single vertex and clear... ";
+    geom::Polyline2d long_track;
+    double direct = 0;
+    geom::Point2d last(1e6, 1e6);
+    for (int i = 0; i < 100000; ++i) {
+        const geom::Point2d p(1e6 + 0.01 * i, 1e6 + 0.001 * (i % 7));
+        if (i > 0) direct += (p - last).length();
+        long_track.append(p);
+        last = p;
+    }
+    geom::Polyline2d single(std::vector<geom::Point2d>{ { 2, 2 } });
+    const bool long_ok = std::abs(long_track.length() - direct) < 1e-6 && long_track.edge(99998).p2() == last;
+    long_track.clear();
+    if (long_ok && long_track.empty() && long_track.length() == 0 && long_track.bounds().is_empty() && single.length() == 0 &&
+        single.num_edges() == 0 && single.point_at_distance(1) == geom::Point2d(2, 2)) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "--- Polyline Tests Finished ---" << std::endl;
+}
+
+void run_enclosing_ball_tests() {
+    std::cout << "\n--- Running Minimal Enclosing Ball Tests ---" << std::endl;
+    auto near = [](double a, double b) { return std::abs(a - b) < 1e-9; };
+    auto encloses = [](const geom::Ball2d& ball, const std::vector<geom::Point2d>& points) {
+        for (const auto& p : points) {
+            if ((p - ball.center()).length() > ball.radius() + 1e-9) return false;
+        }
+        return true;
+    };
+
+    std::cout << "Test 1.1: Square and obtuse triangle... ";
+    auto square = geom::minimal_enclosing_ball(std::vector<geom::Point2d>{ { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 }, { 0.5, 0.5 } });
+    auto obtuse = geom::minimal_enclosing_ball(std::vector<geom::Point2d>{ { 0, 0 }, { 10, 0 }, { 5, 1 } });
+    if (square && square->center() == geom::Point2d(0.5, 0.5) && near(square->radius(), std::sqrt(0.5)) && obtuse &&
+        obtuse->center() == geom::Point2d(5, 0) && near(obtuse->radius(), 5) && !geom::minimal_enclosing_ball(std::vector<geom::Point2d>{})) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 1.2: Random clouds match a brute-force search... ";
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<double> coord(-5.0, 5.0);
+    bool random_ok = true;
+    for (int round = 0; round < 30; ++round) {
+        std::vector<geom::Point2d> cloud;
+        for (int i = 0; i < 3 + round % 9; ++i) cloud.push_back(geom::Point2d(coord(rng), coord(rng)));
+        double best = std::numeric_limits<double>::infinity();
+        for (size_t i = 0; i < cloud.size(); ++i) {
+            for (size_t j = i + 1; j < cloud.size(); ++j) {
+                const geom::Ball2d pair(cloud[i] + (cloud[j] - cloud[i]) * 0.5, (cloud[j] - cloud[i]).length() / 2);
+                if (encloses(pair, cloud)) best = std::min(best, pair.radius());
+                for (size_t k = j + 1; k < cloud.size(); ++k) {
+                    const auto a = cloud[i], b = cloud[j], c = cloud[k];
+                    const double d = 2 * geom::cross_product(b - a, c - a);
+                    if (std::abs(d) < 1e-12) continue;
+                    const double bb = (b - a).length_sq(), cc = (c - a).length_sq();
+                    const geom::Vector2d ab = b - a, ac = c - a;
+                    const geom::Vector2d offset((ac[1].value * bb - ab[1].value * cc) / d, (ab[0].value * cc - ac[0].value * bb) / d);
+                    const geom::Ball2d triple(a + offset, offset.length());
+                    if (encloses(triple, cloud)) best = std::min(best, triple.radius());
+                }
+            }
+        }
+        const auto ball = geom::minimal_enclosing_ball(cloud);
+        random_ok = random_ok && ball && encloses(*ball, cloud) && std::abs(ball->radius() - best) < 1e-7;
+    }
+    if (random_ok) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED" << std::endl;
+
+    std::cout << "Test 2.1: Spheres in 3D... ";
+    std::vector<geom::Point3d> cube;
+    for (int i = 0; i < 8; ++i) cube.push_back(geom::Point3d(i & 1, (i >> 1) & 1, (i >> 2) & 1));
+    std::vector<geom::Point3d> blob = { { 1, 0, 0 }, { -1, 0, 0 } };
+    for (int i = 0; i < 500; ++i) {
+        const geom::Point3d p(coord(rng) / 10, coord(rng) / 10, coord(rng) / 10);
+        blob.push_back(p);
+    }
+    auto cube_ball = geom::minimal_enclosing_ball(cube);
+    auto blob_ball = geom::minimal_enclosing_ball(blob);
+    if (cube_ball && cube_ball->center() == geom::Point3d(0.5, 0.5, 0.5) && near(cube_ball->radius(), std::sqrt(3.0) / 2) && blob_ball &&
+        blob_ball->center() == geom::Point3d(0, 0, 0) && near(blob_ball->radius(), 1)) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 2.2: Large, collinear and duplicate inputs... ";
+    std::vector<geom::Point2d> ring, line;
+    for (int i = 0; i < 200000; ++i) {
+        const double a = 0.001 * i;
+        ring.push_back(geom::Point2d(3 + 2 * std::cos(a) * (i % 3 ? 0.5 : 1.0), -1 + 2 * std::sin(a) * (i % 3 ? 0.5 : 1.0)));
+        line.push_back(geom::Point2d(i % 101, 2 * (i % 101)));
+    }
+    auto ring_ball = geom::minimal_enclosing_ball(ring);
+    auto line_ball = geom::minimal_enclosing_ball(line);
+    if (ring_ball && std::abs(ring_ball->radius() - 2) < 1e-6 && (ring_ball->center() - geom::Point2d(3, -1)).length() < 1e-6 && encloses(*ring_ball, ring) &&
+        line_ball && line_ball->center() == geom::Point2d(50, 100) && near(line_ball->radius(), std::sqrt(50.0 * 50.0 + 100.0 * 100.0))) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 3.1: Batch over groups... ";
+    std::vector<std::vector<geom::Point2d>> groups(300);
+    std::vector<geom::Point2d> flat;
+    std::vector<size_t> offsets = { 0 };
+    for (size_t g = 0; g < groups.size(); ++g) {
+        for (size_t i = 0; i < g % 17; ++i) groups[g].push_back(geom::Point2d(coord(rng) + double(g), coord(rng)));
+        flat.insert(flat.end(), groups[g].begin(), groups[g].end());
+        offsets.push_back(flat.size());
+    }
+    std::vector<std::optional<geom::Ball2d>> from_groups, from_offsets;
+    geom::minimal_enclosing_balls(groups, from_groups, 4);
+    geom::minimal_enclosing_balls(flat, offsets, from_offsets, 4);
+    bool batch_ok = from_groups.size() == groups.size() && from_offsets.size() == groups.size() && !from_groups[0] && !from_offsets[17];
+    for (size_t g = 0; batch_ok && g < groups.size(); ++g) {
+        const auto single = geom::minimal_enclosing_ball(groups[g]);
+        batch_ok = single.has_value() == from_groups[g].has_value() && single.has_value() == from_offsets[g].has_value() &&
+                   (!single || (single->radius() == from_groups[g]->radius() && single->radius() == from_offsets[g]->radius()));
+    }
+    if (batch_ok) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED" << std::endl;
+
+    std::cout << "--- Minimal Enclosing Ball Tests Finished ---" << std::endl;
+}
+
+void run_halfplane_tests() {
+    std::cout << "\n--- Running Half-Plane Intersection Tests ---" << std::endl;
+    using Status = geom::HalfPlaneStatus;
+    // The region to the left of each directed line is kept.
+    auto hp = [](double x, double y, double dx, double dy) { return geom::Line2d::from_point_direction({ x, y }, { dx, dy }); };
+    auto tangent = [](double a) { return geom::Line2d::from_point_direction({ std::cos(a), std::sin(a) }, { -std::sin(a), std::cos(a) }); };
+
+    std::cout << "Test 1.1: Square with redundant and duplicate constraints... ";
+    std::vector<geom::Line2d> square = { hp(-1, -1, 1, 0), hp(1, -1, 0, 1), hp(1, 1, -1, 0), hp(-1, 1, 0, -1),
+                                         hp(0, -5, 1, 0), hp(3, 0, 0, 1), hp(-1, 1, 0, -1), hp(0, 3, -1, -1) };
+    auto box = geom::halfplane_intersection(square);
+    if (box.status == Status::BOUNDED && box.polygon && box.polygon->num_vertices() == 4 && std::abs(box.polygon->area() - 4) < 1e-12 &&
+        box.polygon->moments().signed_area > 0) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 1.2: Empty and unbounded regions... ";
+    auto empty = geom::halfplane_intersection(std::vector<geom::Line2d>{ hp(1, 0, 0, -1), hp(0, 0, 0, 1), hp(0, -1, 1, 0), hp(0, 1, -1, 0) });
+    auto strip = geom::halfplane_intersection(std::vector<geom::Line2d>{ hp(0, -1, 1, 0), hp(0, 1, -1, 0) });
+    auto wedge = geom::halfplane_intersection(std::vector<geom::Line2d>{ hp(0, 0, 1, 0), hp(0, 0, -1, -1) });
+    auto capped = geom::halfplane_intersection(std::vector<geom::Line2d>{ hp(0, 0, 1, 0), hp(0, 0, -1, -1), hp(2, 0, 0, 1) });
+    auto far_apart = geom::halfplane_intersection(std::vector<geom::Line2d>{ hp(0, 0, 1, 0), hp(0, -1, -1, 0) });
+    if (empty.status == Status::EMPTY && strip.status == Status::UNBOUNDED && !strip.polygon && wedge.status == Status::UNBOUNDED &&
+        capped.status == Status::BOUNDED && std::abs(capped.polygon->area() - 2) < 1e-12 && far_apart.status == Status::EMPTY &&
+        geom::halfplane_intersection(std::vector<geom::Line2d>{}).status == Status::UNBOUNDED) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 1.3: Thousands of tangents of the unit circle... ";
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<double> angle(-3.14159265358979323846, 3.14159265358979323846);
+    std::vector<geom::Line2d> tangents;
+    for (int i = 0; i < 5000; ++i) tangents.push_back(tangent(angle(rng)));
+    auto circle = geom::halfplane_intersection(tangents);
+    bool circle_ok = circle.status == Status::BOUNDED && circle.polygon->area() > 3.14159265358979323846 && circle.polygon->area() < 3.1416;
+    for (const auto& v : circle.polygon->vertices()) circle_ok = circle_ok && v.length() >= 1 - 1e-9;
+    if (circle_ok) std::cout << "SUCCESS" << std::endl;
+    else std::cout << "FAILED" << std::endl;
+
+    std::cout << "Test 2.1: Incremental region matches the batch result... ";
+    geom::HalfPlaneRegion2d region;
+    std::vector<geom::Line2d> added;
+    bool incremental_ok = region.status() == Status::UNBOUNDED;
+    for (int i = 0; i < 400; ++i) {
+        const auto line = tangent(angle(rng));
+        region.add(line);
+        added.push_back(line);
+        if (i % 40 == 39) {
+            const auto batch = geom::halfplane_intersection(added);
+            incremental_ok = incremental_ok && region.status() == batch.status;
+            if (batch.polygon) incremental_ok = incremental_ok && std::abs(region.polygon()->area() - batch.polygon->area()) < 1e-9;
+        }
+    }
+    const auto before = region.vertices();
+    region.add(hp(0, -10, 1, 0));
+    const bool redundant_ok = region.vertices() == before;
+    region.add(hp(0, 0.5, -1, 0));
+    const double clipped_area = region.polygon() ? region.polygon()->area() : 0;
+    region.add(hp(0, 5, 1, 0));
+    if (incremental_ok && redundant_ok && clipped_area > 0 && clipped_area < 3 && region.status() == Status::EMPTY && !region.polygon()) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "--- Half-Plane Intersection Tests Finished ---" << std::endl;
+}
+
+void run_offset_tests() {
+    std::cout << "\n--- Running Offset Tests ---" << std::endl;
+    using Join = geom::JoinType;
+    auto options = [](Join join) {
+        geom::OffsetOptions<double> o;
+        o.join = join;
+        return o;
+    };
+    auto total_area = [](const geom::PolygonCollection<double>& c) {
+        double sum = 0;
+        for (size_t i = 0; i < c.size(); ++i) sum += c.area(i);
+        return sum;
+    };
+    const geom::Polygon2d square({ { 0, 0 }, { 2, 0 }, { 2, 2 }, { 0, 2 } });
+
+    std::cout << "Test 1.1: Outward offset of a square with each join... ";
+    auto miter = geom::offset(square, 1.0, options(Join::MITER));
+    auto squared = geom::offset(square, 1.0, options(Join::SQUARE));
+    auto round = geom::offset(square, 1.0, options(Join::ROUND));
+    const double cut = (std::sqrt(2.0) - 1) * (std::sqrt(2.0) - 1);
+    if (miter.size() == 1 && std::abs(total_area(miter) - 16) < 1e-9 && miter.ring(0).num_vertices() == 4 && squared.size() == 1 &&
+        std::abs(total_area(squared) - (16 - 4 * cut)) < 1e-9 && round.size() == 1 && total_area(round) < 12 + 3.14159265358979323846 &&
+        total_area(round) > 12 + 3.14159265358979323846 - 1e-2) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 1.2: Inward offsets shrink, split and vanish... ";
+    const geom::Polygon2d big({ { 0, 0 }, { 4, 0 }, { 4, 4 }, { 0, 4 } });
+    // Two 4x4 rooms joined by a 1-wide corridor, clockwise on purpose.
+    const geom::Polygon2d dumbbell({ { 0, 0 }, { 0, 4 }, { 4, 4 }, { 4, 2.5 }, { 6, 2.5 }, { 6, 4 }, { 10, 4 }, { 10, 0 }, { 6, 0 }, { 6, 1.5 },
+                                     { 4, 1.5 }, { 4, 0 } });
+    auto shrunk = geom::offset(big, -1.0, options(Join::ROUND));
+    auto split = geom::offset(dumbbell, -0.75, options(Join::MITER));
+    if (shrunk.size() == 1 && std::abs(total_area(shrunk) - 4) < 1e-9 && geom::offset(big, -2.5, options(Join::ROUND)).empty() &&
+        split.size() == 2 && std::abs(total_area(split) - 2 * 2.5 * 2.5) < 1e-9) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 1.3: Outward offset closes a narrow bay into a hole... ";
+    // 10x10 block with a 6x6 courtyard open to the top through a 1-wide gap.
+    const geom::Polygon2d courtyard({ { 0, 0 }, { 10, 0 }, { 10, 10 }, { 5.5, 10 }, { 5.5, 8 }, { 8, 8 }, { 8, 2 }, { 2, 2 }, { 2, 8 }, { 4.5, 8 },
+                                      { 4.5, 10 }, { 0, 10 } });
+    auto closed = geom::offset(courtyard, 0.75, options(Join::MITER));
+    if (closed.size() == 1 && closed[0].num_holes() == 1 && std::abs(closed.ring(1).signed_area() + 4.5 * 4.5) < 1e-9 &&
+        closed.contains(0, geom::Point2d(5, 5)) == false && closed.contains(0, geom::Point2d(5, 9))) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 2.1: Polyline buffers with round, square and flat caps... ";
+    geom::Polyline2d road(std::vector<geom::Point2d>{ { 0, 0 }, { 5, 0 }, { 10, 0 } });
+    geom::Polyline2d cross(std::vector<geom::Point2d>{ { -5, 0 }, { 5, 0 }, { 5, 1 }, { 0, 1 }, { 0, -5 } });
+    auto flat = geom::buffer(road, 1.0, options(Join::MITER));
+    auto capped = geom::buffer(road, 1.0, options(Join::SQUARE));
+    auto rounded = geom::buffer(road, 1.0, options(Join::ROUND));
+    auto crossing = geom::buffer(cross, 0.25, options(Join::ROUND));
+    auto dot = geom::buffer(geom::Polyline2d(std::vector<geom::Point2d>{ { 3, 3 } }), 2.0, options(Join::ROUND));
+    if (std::abs(total_area(flat) - 20) < 1e-9 && std::abs(total_area(capped) - 24) < 1e-9 && total_area(rounded) < 20 + 3.14159265358979323846 &&
+        total_area(rounded) > 20 + 3.1 && crossing.size() == 1 && crossing[0].num_holes() == 1 && total_area(crossing) < 0.5 * 26 + 0.2 &&
+        dot.size() == 1 && total_area(dot) < 4 * 3.14159265358979323846 && total_area(dot) > 4 * 3.14159265358979323846 - 5e-2) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 2.2: Saw-tooth ring with 100000 vertices... ";
+    std::vector<geom::Point2d> teeth;
+    const size_t n = 100000;
+    for (size_t i = 0; i < n; ++i) {
+        const double a = 2 * 3.14159265358979323846 * double(i) / double(n);
+        const double r = 1000 + (i % 2 ? 0.01 : 0.0);
+        teeth.push_back(geom::Point2d(r * std::cos(a), r * std::sin(a)));
+    }
+    auto grown = geom::offset(geom::Polygon2d(teeth), 2.0, options(Join::ROUND));
+    const double expected = 3.14159265358979323846 * 1002.01 * 1002.01;
+    if (grown.size() == 1 && grown[0].num_holes() == 0 && std::abs(total_area(grown) - expected) < expected * 1e-3) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 2.3: Wavy ring offsets to one polygon without holes... ";
+    std::vector<geom::Point2d> wave;
+    for (size_t i = 0; i < 16000; ++i) {
+        const double a = 2 * 3.14159265358979323846 * double(i) / 16000.0;
+        const double r = 100 + 10 * std::sin(50 * a);
+        wave.push_back(geom::Point2d(r * std::cos(a), r * std::sin(a)));
+    }
+    const geom::Polygon2d wavy(wave);
+    const double wavy_area = wavy.area();
+    auto shrunk_wave = geom::offset(wavy, -2.0, options(Join::ROUND));
+    auto grown_wave = geom::offset(wavy, 2.0, options(Join::ROUND));
+    if (shrunk_wave.size() == 1 && shrunk_wave[0].num_holes() == 0 && grown_wave.size() == 1 && grown_wave[0].num_holes() == 0 &&
+        total_area(shrunk_wave) < wavy_area && total_area(grown_wave) > wavy_area) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "--- Offset Tests Finished ---" << std::endl;
+}
+
+void run_visibility_graph_tests() {
+    std::cout << "\n--- Running Visibility Graph Tests ---" << std::endl;
+    auto rect = [](double x0, double y0, double x1, double y1) { return geom::Polygon2d({ { x0, y0 }, { x1, y0 }, { x1, y1 }, { x0, y1 } }); };
+
+    std::cout << "Test 1.1: Path around a single box... ";
+    auto single = geom::VisibilityGraph2d::from_polygons({ rect(2, -1, 4, 1) });
+    auto around = single.shortest_path(geom::Point2d(0, 0), geom::Point2d(6, 0));
+    auto clear = single.shortest_path(geom::Point2d(0, 2), geom::Point2d(6, 2));
+    if (around && around->num_vertices() == 4 && std::abs(around->length() - (2 * std::sqrt(5.0) + 2)) < 1e-9 && std::abs(around->vertices()[1][1].value) == 1 &&
+        clear && clear->num_vertices() == 2 && single.num_nodes() == 4) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 1.2: Out of a pocket, along boundaries and into obstacles... ";
+    // Clockwise U open to the top; the start sits in the pocket.
+    const geom::Polygon2d cup({ { 0, 0 }, { 0, 3 }, { 1, 3 }, { 1, 1 }, { 2, 1 }, { 2, 3 }, { 3, 3 }, { 3, 0 } });
+    auto pocket = geom::VisibilityGraph2d::from_polygons({ cup });
+    auto out = pocket.shortest_path(geom::Point2d(1.5, 1.5), geom::Point2d(1.5, -1));
+    auto along = pocket.shortest_path(geom::Point2d(0, 0), geom::Point2d(3, 0));
+    if (out && out->num_vertices() == 5 && std::abs(out->length() - (std::sqrt(2.5) + 1 + 3 + std::sqrt(3.25))) < 1e-9 &&
+        along && along->num_vertices() == 2 && !pocket.shortest_path(geom::Point2d(0.5, 0.5), geom::Point2d(5, 5)) &&
+        !pocket.visible(geom::Point2d(0, 0), geom::Point2d(3, 3)) && pocket.visible(geom::Point2d(0, 3), geom::Point2d(3, 3))) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 1.3: Matches Dijkstra on the naive visibility graph... ";
+    std::mt19937 rng(49);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::vector<geom::Polygon2d> obstacles;
+    for (int gx = 0; gx < 6; ++gx) {
+        for (int gy = 0; gy < 6; ++gy) {
+            if (unit(rng) < 0.25) continue;
+            const double x = gx * 4 + unit(rng), y = gy * 4 + unit(rng);
+            if (unit(rng) < 0.3) {
+                obstacles.push_back(geom::Polygon2d({ { x, y }, { x + 2.5 + unit(rng), y + unit(rng) }, { x + 1 + unit(rng), y + 2.5 + unit(rng) } }));
+            }
+            else {
+                obstacles.push_back(rect(x, y, x + 1 + 2 * unit(rng), y + 1 + 2 * unit(rng)));
+            }
+        }
+    }
+    auto strictly_inside = [&](double px, double py) {
+        for (const auto& poly : obstacles) {
+            if (!geom::contains(geom::Point2d(px, py), poly)) continue;
+            bool boundary = false;
+            for (size_t i = 0; i < poly.num_vertices(); ++i) boundary = boundary || geom::contains(geom::Point2d(px, py), poly.edge(i));
+            if (!boundary) return true;
+        }
+        return false;
+    };
+    auto naive_visible = [&](const geom::Point2d& a, const geom::Point2d& b) {
+        auto orient = [](const geom::Point2d& p, const geom::Point2d& q, const geom::Point2d& r) {
+            const double c = (q[0].value - p[0].value) * (r[1].value - p[1].value) - (q[1].value - p[1].value) * (r[0].value - p[0].value);
+            return (c > 1e-12) - (c < -1e-12);
+        };
+        for (const auto& poly : obstacles) {
+            for (size_t i = 0; i < poly.num_vertices(); ++i) {
+                const auto& p = poly.vertices()[i];
+                const auto& q = poly.vertices()[(i + 1) % poly.num_vertices()];
+                if (orient(a, b, p) * orient(a, b, q) < 0 && orient(p, q, a) * orient(p, q, b) < 0) return false;
+            }
+        }
+        return !strictly_inside((a[0].value + b[0].value) / 2, (a[1].value + b[1].value) / 2);
+    };
+    auto naive_length = [&](const geom::Point2d& start, const geom::Point2d& goal) {
+        std::vector<geom::Point2d> nodes = { start, goal };
+        for (const auto& poly : obstacles) nodes.insert(nodes.end(), poly.vertices().begin(), poly.vertices().end());
+        std::vector<double> dist(nodes.size(), std::numeric_limits<double>::infinity());
+        std::vector<bool> done(nodes.size(), false);
+        dist[0] = 0;
+        for (size_t round = 0; round < nodes.size(); ++round) {
+            size_t u = nodes.size();
+            for (size_t i = 0; i < nodes.size(); ++i) {
+                if (!done[i] && (u == nodes.size() || dist[i] < dist[u])) u = i;
+            }
+            if (u == nodes.size() || std::isinf(dist[u])) break;
+            done[u] = true;
+            for (size_t w = 0; w < nodes.size(); ++w) {
+                if (done[w]) continue;
+                const double len = (nodes[w] - nodes[u]).length();
+                if (dist[u] + len < dist[w] && naive_visible(nodes[u], nodes[w])) dist[w] = dist[u] + len;
+            }
+        }
+        return dist[1];
+    };
+    auto graph = geom::VisibilityGraph2d::from_polygons(obstacles);
+    bool matches = true;
+    for (int q = 0; q < 12 && matches; ++q) {
+        geom::Point2d start(0, 0), goal(0, 0);
+        do start = geom::Point2d(-1 + 25 * unit(rng), -1 + 25 * unit(rng)); while (strictly_inside(start[0].value, start[1].value));
+        do goal = geom::Point2d(-1 + 25 * unit(rng), -1 + 25 * unit(rng)); while (strictly_inside(goal[0].value, goal[1].value));
+        auto path = graph.shortest_path(start, goal);
+        const double reference = naive_length(start, goal);
+        matches = path && std::abs(path->length() - reference) < 1e-9 * (1 + reference);
+        for (size_t i = 0; path && i + 1 < path->num_vertices(); ++i) matches = matches && naive_visible(path->vertices()[i], path->vertices()[i + 1]);
+    }
+    if (matches && graph.num_expanded() > 0 && graph.num_expanded() <= graph.num_nodes()) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "Test 1.4: Cached graph is reused and matches an eager build... ";
+    const geom::Point2d from(-0.5, -0.5), to(23.5, 23.5);
+    auto first = graph.shortest_path(from, to);
+    const size_t expanded = graph.num_expanded();
+    auto second = graph.shortest_path(from, to);
+    auto eager = geom::VisibilityGraph2d::from_polygons(obstacles);
+    eager.build(4);
+    auto built = eager.shortest_path(from, to);
+    if (first && second && built && graph.num_expanded() == expanded && second->vertices() == first->vertices() &&
+        eager.num_expanded() == eager.num_nodes() && std::abs(built->length() - first->length()) < 1e-9) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "--- Visibility Graph Tests Finished ---" << std::endl;
+}
+
+// Upstream for arenas under test that counts what reaches the heap, so tests can check that a
+// loop does not allocate.
+class CountingResource final : public std::pmr::memory_resource {
+public:
+    size_t allocations = 0;
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        ++allocations;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
+
+void run_arena_tests() {
+    std::cout << "\n--- Running Arena Tests ---" << std::endl;
+
+    std::cout << "Test 1.1: Scratch arena bumps, rewinds and grows to the peak... ";
+    geom::ScratchArena arena(256);
+    (void)arena.allocate(100, 8);
+    void* aligned = arena.allocate(64, 64);
+    const size_t mark = arena.used();
+    bool overflow_ok = false;
+    {
+        geom::ScratchScope scope(arena);
+        void* big = scope.resource()->allocate(1000, 8);
+        std::memset(big, 0, 1000);
+        overflow_ok = arena.used() == mark && arena.capacity() == 256;
+    }
+    const bool rewound = arena.used() == mark;
+    arena.rewind();
+    (void)arena.allocate(1000, 8);
+    if (reinterpret_cast<uintptr_t>(aligned) % 64 == 0 && overflow_ok && rewound && arena.capacity() >= 1164 && arena.used() == 1000) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+    arena.rewind();
+
+    std::cout << "Test 1.2: pmr hull matches the default hull... ";
+    std::mt19937 rng(50);
+    std::uniform_real_distribution<double> unit(-1.0, 1.0);
+    bool same = true;
+    for (int round = 0; round < 200 && same; ++round) {
+        std::vector<geom::Point2d> points;
+        for (int i = 0; i < 3 + round % 20; ++i) points.push_back(round % 17 == 0 ? geom::Point2d(i, 2 * i) : geom::Point2d(unit(rng), unit(rng)));
+        std::pmr::vector<geom::Point2d> copy(points.begin(), points.end(), &arena);
+        geom::ScratchScope scope(arena);
+        auto reference = geom::convex_hull(points);
+        auto pooled = geom::convex_hull(copy, scope.resource());
+        same = reference.has_value() == pooled.has_value() &&
+               (!reference || (std::equal(reference->vertices().begin(), reference->vertices().end(), pooled->vertices().begin(), pooled->vertices().end()) &&
+                               pooled->get_allocator().resource() == &arena));
+    }
+    if (same && arena.used() > 0) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+    arena.rewind();
+
+    std::cout << "Test 1.3: Hulling 10^6 tiny point sets without heap allocations... ";
+    CountingResource heap;
+    geom::ScratchArena results(4096, &heap);
+    std::vector<geom::Point2d> points(8);
+    double total_area = 0;
+    size_t hull_vertices = 0;
+    auto hull_round = [&](size_t round) {
+        for (size_t i = 0; i < points.size(); ++i) {
+            const double a = 0.7 * double(round) + 0.9 * double(i);
+            points[i] = geom::Point2d(std::cos(a) * (1 + 0.1 * double(i)), std::sin(1.3 * a));
+        }
+        geom::ScratchScope scope(results);
+        auto hull = geom::convex_hull(points, scope.resource());
+        if (hull) {
+            total_area += hull->moments(1).area();
+            hull_vertices = hull->num_vertices();
+        }
+    };
+    for (size_t round = 0; round < 100; ++round) hull_round(round);
+    const size_t before = heap.allocations;
+    const size_t scratch_capacity = geom::thread_scratch_arena().capacity();
+    for (size_t round = 0; round < 1000000; ++round) hull_round(round);
+    const size_t pooled_allocations = heap.allocations - before;
+    // Only the hull itself comes from the resource, not the chain of twice the points.
+    {
+        geom::ScratchScope scope(results);
+        auto hull = geom::convex_hull(points, scope.resource());
+        hull_vertices = hull ? hull->num_vertices() : 0;
+        if (results.used() != hull_vertices * sizeof(geom::Point2d)) hull_vertices = 0;
+    }
+    if (pooled_allocations == 0 && geom::thread_scratch_arena().capacity() == scratch_capacity && hull_vertices >= 3 && total_area > 0) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED (" << pooled_allocations << " pooled allocations)" << std::endl; }
+
+    std::cout << "Test 1.4: pmr polygons work with the polygon algorithms... ";
+    std::pmr::vector<geom::Point2d> square_vertices({ { 0, 0 }, { 2, 0 }, { 2, 2 }, { 0, 2 } }, &results);
+    const geom::pmr::Polygon2d square(std::move(square_vertices));
+    const geom::Polygon2d shifted({ { 1, 1 }, { 3, 1 }, { 3, 3 }, { 1, 3 } });
+    const geom::ConvexClipper<double> clipper(square);
+    const auto moved = geom::Affine2d::translation(geom::Vector2d(1, 1)).apply(square);
+    geom::PolygonCollection<double> collection;
+    collection.add_polygon(square);
+    const auto penetration = geom::sat_penetration(square, shifted);
+    const auto grown_square = geom::offset(square, 1.0);
+    if (geom::contains(geom::Point2d(1, 1), square) && geom::support(square, geom::Vector2d(1, 1)) == geom::Point2d(2, 2) &&
+        clipper.clipped(geom::Segment2d(geom::Point2d(-1, 1), geom::Point2d(3, 1))).has_value() && moved.get_allocator().resource() == &results &&
+        moved.vertices()[0] == geom::Point2d(1, 1) && collection.size() == 1 && penetration.colliding && std::abs(penetration.depth - 1) < 1e-9 &&
+        grown_square.size() == 1) {
+        std::cout << "SUCCESS" << std::endl;
+    }
+    else { std::cout << "FAILED" << std::endl; }
+
+    std::cout << "--- Arena Tests Finished ---" << std::endl;
+}
+
 int main() {
     run_vector_tests();
     run_line_tests();
@@ -588,6 +2623,30 @@ int main() {
     run_point_in_polygon_tests();
     run_ray_tests();
     run_mixed_intersection_tests();
+    run_mesh_bvh_tests();
+    run_convex_hull_3d_tests();
+    run_instrumentation_tests();
+    run_clip_tests();
+    run_collision_tests();
+    run_transform_tests();
+    run_pipeline_tests();
+    run_polygon_collection_tests();
+    run_spatial_sort_tests();
+    run_dcel_tests();
+    run_point_location_tests();
+    run_visibility_tests();
+    run_range_tree_tests();
+    run_float_tests();
+    run_snapshot_tests();
+    run_intersection_batch_tests();
+    run_polygon_moments_tests();
+    run_similarity_tests();
+    run_polyline_tests();
+    run_enclosing_ball_tests();
+    run_halfplane_tests();
+    run_offset_tests();
+    run_visibility_graph_tests();
+    run_arena_tests();
     return 0;
 
 }
@@ -0,0 +1,109 @@
+﻿#pragma once
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <optional>
+#include <vector>
+#include "vector.hpp"
+#include "box.hpp"
+#include "ray.hpp"
+#include "algorithms.hpp"
+
+namespace geom {
+
+    template<typename T>
+    class TriangleMesh {
+    public:
+        using point_type = Point<3, T>;
+        using index_type = uint32_t;
+
+    private:
+        std::vector<point_type> m_vertices;
+        std::vector<index_type> m_indices; // Three vertex indices per triangle.
+
+    public:
+        TriangleMesh() = default;
+
+        TriangleMesh(const std::vector<point_type>& vertices, const std::vector<index_type>& indices)
+            : m_vertices(vertices), m_indices(indices) {
+            assert(m_indices.size() % 3 == 0 && "Triangle mesh index buffer size must be a multiple of 3.");
+            for (index_type i : m_indices) {
+                assert(i < m_vertices.size() && "Triangle mesh index out of bounds.");
+                (void)i;
+            }
+        }
+
+        size_t num_vertices() const { return m_vertices.size(); }
+        size_t num_triangles() const { return m_indices.size() / 3; }
+
+        const std::vector<point_type>& vertices() const { return m_vertices; }
+        const std::vector<index_type>& indices() const { return m_indices; }
+
+        index_type add_vertex(const point_type& p) {
+            m_vertices.push_back(p);
+            return static_cast<index_type>(m_vertices.size() - 1);
+        }
+
+        void add_triangle(index_type a, index_type b, index_type c) {
+            assert(a < m_vertices.size() && b < m_vertices.size() && c < m_vertices.size() && "Triangle mesh index out of bounds.");
+            m_indices.push_back(a);
+            m_indices.push_back(b);
+            m_indices.push_back(c);
+        }
+
+        std::array<point_type, 3> triangle(size_t i) const {
+            assert(i < num_triangles() && "Triangle index out of bounds.");
+            return { m_vertices[m_indices[3 * i]], m_vertices[m_indices[3 * i + 1]], m_vertices[m_indices[3 * i + 2]] };
+        }
+
+        Box<3, T> bounds() const {
+            return Box<3, T>::from_points(m_vertices);
+        }
+    };
+
+    template<typename T>
+    struct RayTriangleHit {
+        T t;    // Distance along the (normalized) ray direction.
+        T u;    // Barycentric coordinates of the hit: point = (1 - u - v) * a + u * b + v * c.
+        T v;
+    };
+
+    // Moller-Trumbore. Hits closer than Epsilon to the ray origin are ignored so that
+    // rays cast from a surface do not report that surface. The parallel test is relative to the
+    // edge and direction lengths, so small triangles are hit as reliably as large ones.
+    template<typename T>
+    std::optional<RayTriangleHit<T>> intersection(const Ray<3, T>& ray, const std::array<Point<3, T>, 3>& triangle) {
+        const Vector<3, T> e1 = triangle[1] - triangle[0];
+        const Vector<3, T> e2 = triangle[2] - triangle[0];
+        const Vector<3, T> pvec = cross_product(ray.direction(), e2);
+        const T det = dot_product(e1, pvec);
+
+        if (std::abs(det) <= Coord<T>::Epsilon * e1.length() * e2.length() * ray.direction().length()) {
+            return std::nullopt; // Ray is parallel to the triangle plane.
+        }
+        const T inv_det = T(1) / det;
+
+        const Vector<3, T> tvec = ray.origin() - triangle[0];
+        const T u = dot_product(tvec, pvec) * inv_det;
+        if (u < 0 || u > 1) {
+            return std::nullopt;
+        }
+
+        const Vector<3, T> qvec = cross_product(tvec, e1);
+        const T v = dot_product(ray.direction(), qvec) * inv_det;
+        if (v < 0 || u + v > 1) {
+            return std::nullopt;
+        }
+
+        const T t = dot_product(e2, qvec) * inv_det;
+        if (t <= Coord<T>::Epsilon) {
+            return std::nullopt;
+        }
+        return RayTriangleHit<T>{ t, u, v };
+    }
+
+    using TriangleMesh3d = TriangleMesh<double>;
+
+
+} // namespace geom
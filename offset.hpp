@@ -0,0 +1,474 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <initializer_list>
+#include <limits>
+#include <vector>
+#include "vector.hpp"
+#include "segment.hpp"
+#include "algorithms.hpp"
+#include "polygon.hpp"
+#include "polygon_collection.hpp"
+#include "polyline.hpp"
+#include "dcel.hpp"
+#include "parallel.hpp"
+
+namespace geom {
+
+    enum class JoinType {
+        MITER,
+        ROUND,
+        SQUARE
+    };
+
+    template<typename T>
+    struct OffsetOptions {
+        JoinType join = JoinType::ROUND;
+        T miter_limit = 2;          // Longest miter, in multiples of the distance, before it is squared off.
+        T arc_tolerance = 0;        // Largest gap between a round join and the true arc; 0 means |distance| / 1000.
+        size_t num_threads = 0;
+    };
+
+    namespace detail {
+
+        // Angle between consecutive points of a round join, so the chords stay within the tolerance.
+        template<typename T>
+        T arc_step(T d, const OffsetOptions<T>& options) {
+            const T tolerance = options.arc_tolerance > 0 ? options.arc_tolerance : std::abs(d) / 1000;
+            return 2 * std::acos(std::max(T(-1), 1 - tolerance / std::abs(d)));
+        }
+
+        // Convex pieces whose union is what an offset adds to a polygon (outward) or removes from it
+        // (inward). Only the sides of the pieces facing away from the chain can bound the result;
+        // they are kept in far_sides, directed so that the result lies on their left.
+        template<typename T>
+        struct OffsetPieces {
+            std::vector<Point<2, T>> points;
+            std::vector<uint32_t> starts = { 0 };   // Piece k is points[starts[k]] to points[starts[k + 1] - 1].
+            std::vector<Segment<2, T>> far_sides;
+            T radius = 0;                           // Farthest a far point gets from its piece's near points.
+
+            size_t size() const { return starts.size() - 1; }
+
+            // A piece made of the near points and the chain far, whose edges become far sides.
+            void add(std::initializer_list<Point<2, T>> near, const std::vector<Point<2, T>>& far) {
+                points.insert(points.end(), near.begin(), near.end());
+                points.insert(points.end(), far.begin(), far.end());
+                for (const auto& f : far) {
+                    T nearest = std::numeric_limits<T>::max();
+                    for (const auto& p : near) nearest = std::min(nearest, (f - p).length());
+                    radius = std::max(radius, nearest);
+                }
+                starts.push_back(static_cast<uint32_t>(points.size()));
+                for (size_t i = 0; i + 1 < far.size(); ++i) {
+                    if (!(far[i] == far[i + 1])) far_sides.push_back(Segment<2, T>(far[i], far[i + 1]));
+                }
+            }
+        };
+
+        // Pieces of the offset of a closed chain by d to the right of each edge (outward for a
+        // counter-clockwise ring): a strip beside every edge, and a join at every corner turning
+        // away from the offset side. Corners turning towards it need nothing, as the strips on
+        // both sides of them overlap there; the strips are cut back to where their far sides meet,
+        // so nearly parallel sides never have to be noded. A half-turn is an end cap.
+        template<typename T>
+        void offset_pieces(const std::vector<Point<2, T>>& v, T d, const OffsetOptions<T>& options, OffsetPieces<T>& pieces) {
+            using point_type = Point<2, T>;
+            using vector_type = Vector<2, T>;
+            const size_t n = v.size();
+            const T step = arc_step(d, options);
+            auto unit = [](const vector_type& e) { return vector_type(e * (T(1) / e.length())); };
+
+            std::vector<vector_type> dirs, normals;
+            std::vector<T> lengths;
+            std::vector<point_type> starts, ends;
+            for (size_t i = 0; i < n; ++i) {
+                const vector_type e = v[(i + 1) % n] - v[i];
+                lengths.push_back(e.length());
+                dirs.push_back(unit(e));
+                normals.push_back(vector_type(dirs[i][1].value * d, -dirs[i][0].value * d));
+                starts.push_back(v[i] + normals[i]);
+                ends.push_back(v[(i + 1) % n] + normals[i]);
+            }
+
+            std::vector<point_type> far;
+            for (size_t i = 0; i < n; ++i) {
+                const size_t prev = (i + n - 1) % n;
+                const point_type& p = v[i];
+                const vector_type& in = dirs[prev];
+                const vector_type& out = dirs[i];
+                const vector_type& o1 = normals[prev];
+                const vector_type& o2 = normals[i];
+                const T cross = cross_product(in, out), dot = dot_product(in, out);
+                const bool cap = std::abs(cross) <= Coord<T>::Epsilon && dot < 0;
+
+                if (!cap && (std::abs(cross) <= Coord<T>::Epsilon || cross * d < 0)) {
+                    const point_type meet = p + (o1 + o2) * (T(1) / (1 + dot));
+                    if (2 * (meet - ends[prev]).length() <= std::min(lengths[prev], lengths[i])) {
+                        ends[prev] = meet;
+                        starts[i] = meet;
+                    }
+                    continue;
+                }
+
+                far.assign({ p + o1 });
+                JoinType join = options.join;
+                if (join == JoinType::MITER) {
+                    if (cap) {
+                        far.push_back(p + o2);
+                        pieces.add({ p }, far);
+                        continue;
+                    }
+                    if (std::sqrt(2 / (1 + dot)) <= options.miter_limit) {
+                        far.push_back(p + (o1 + o2) * (T(1) / (1 + dot)));
+                        far.push_back(p + o2);
+                        pieces.add({ p }, far);
+                        continue;
+                    }
+                    join = JoinType::SQUARE;
+                }
+                if (join == JoinType::ROUND) {
+                    const T turn = cap ? T(3.14159265358979323846) * (d > 0 ? 1 : -1) : std::atan2(cross, dot);
+                    const size_t steps = std::max<size_t>(1, size_t(std::ceil(std::abs(turn) / step)));
+                    for (size_t k = 1; k < steps; ++k) {
+                        const T a = turn * T(k) / T(steps);
+                        const T c = std::cos(a), s = std::sin(a);
+                        far.push_back(p + vector_type(o1[0].value * c - o1[1].value * s, o1[0].value * s + o1[1].value * c));
+                    }
+                    far.push_back(p + o2);
+                    pieces.add({ p }, far);
+                    continue;
+                }
+                // Square: cut the corner square to the bisector, |d| away from the vertex.
+                const vector_type u = cap ? in : unit(vector_type(o1 + o2));
+                const T ad = std::abs(d);
+                const T s1 = (ad - dot_product(o1, u)) / dot_product(in, u);
+                const T s2 = (ad - dot_product(o2, u)) / -dot_product(out, u);
+                far.push_back(p + o1 + in * s1);
+                far.push_back(p + o2 - out * s2);
+                far.push_back(p + o2);
+                pieces.add({ p }, far);
+            }
+
+            for (size_t i = 0; i < n; ++i) {
+                far.assign({ starts[i], ends[i] });
+                pieces.add({ v[(i + 1) % n], v[i] }, far);
+            }
+        }
+
+        // Squared distance from x to the segment ab; t is the parameter of the nearest point.
+        template<typename T>
+        T distance_sq_to_segment(const Point<2, T>& x, const Point<2, T>& a, const Point<2, T>& b, T& t) {
+            const T ex = b[0].value - a[0].value, ey = b[1].value - a[1].value;
+            const T px = x[0].value - a[0].value, py = x[1].value - a[1].value;
+            const T len_sq = ex * ex + ey * ey;
+            t = len_sq > 0 ? std::clamp((px * ex + py * ey) / len_sq, T(0), T(1)) : T(0);
+            const T dx = px - t * ex, dy = py - t * ey;
+            return dx * dx + dy * dy;
+        }
+
+        // Whether x lies inside the convex polygon of n points by more than the tolerance.
+        template<typename T>
+        bool strictly_inside_convex(const Point<2, T>* points, size_t n, const Point<2, T>& x, T tolerance) {
+            T area = 0;
+            for (size_t i = 0, j = n - 1; i < n; j = i++) area += cross_product(points[j], points[i]);
+            const T sign = area > 0 ? T(1) : T(-1);
+            for (size_t i = 0, j = n - 1; i < n; j = i++) {
+                const Vector<2, T> e = points[i] - points[j];
+                if (sign * cross_product(e, x - points[j]) <= tolerance * e.length()) return false;
+            }
+            return true;
+        }
+
+        // Uniform grid of boxes in CSR form. A query visits every box registered in a cell that the
+        // query box touches, so a box may be visited more than once.
+        template<typename T>
+        class BoxGrid {
+        private:
+            Box<2, T> m_bounds;
+            T m_inv_cell = 1;
+            size_t m_cells_x = 1, m_cells_y = 1;
+            std::vector<uint32_t> m_cell_start;
+            std::vector<uint32_t> m_items;
+
+        public:
+            // Cells are about cell wide, but never more numerous than a few per box.
+            BoxGrid(const std::vector<Box<2, T>>& boxes, T cell) {
+                for (const auto& b : boxes) m_bounds.expand(b);
+                const T width = m_bounds.extent()[0].value, height = m_bounds.extent()[1].value;
+                cell = std::max({ cell, std::sqrt(width * height / T(4 * boxes.size() + 16)), std::max(width, height) / 4096, Coord<T>::Epsilon });
+                m_inv_cell = 1 / cell;
+                m_cells_x = static_cast<size_t>(width * m_inv_cell) + 1;
+                m_cells_y = static_cast<size_t>(height * m_inv_cell) + 1;
+
+                m_cell_start.assign(m_cells_x * m_cells_y + 1, 0);
+                auto for_cells = [&](const Box<2, T>& b, auto&& func) {
+                    const size_t x0 = cell_x(b.min()[0].value), x1 = cell_x(b.max()[0].value);
+                    const size_t y0 = cell_y(b.min()[1].value), y1 = cell_y(b.max()[1].value);
+                    for (size_t y = y0; y <= y1; ++y) {
+                        for (size_t x = x0; x <= x1; ++x) func(y * m_cells_x + x);
+                    }
+                };
+                for (const auto& b : boxes) for_cells(b, [&](size_t c) { ++m_cell_start[c + 1]; });
+                for (size_t c = 0; c + 1 < m_cell_start.size(); ++c) m_cell_start[c + 1] += m_cell_start[c];
+                m_items.resize(m_cell_start.back());
+                std::vector<uint32_t> cursor(m_cell_start.begin(), m_cell_start.end() - 1);
+                for (uint32_t i = 0; i < boxes.size(); ++i) for_cells(boxes[i], [&](size_t c) { m_items[cursor[c]++] = i; });
+            }
+
+            // Calls visit(i) for the boxes near the query box until it returns true, and returns
+            // whether it did.
+            template<typename Visit>
+            bool visit(const Box<2, T>& query, Visit&& visit) const {
+                const size_t x0 = cell_x(query.min()[0].value), x1 = cell_x(query.max()[0].value);
+                const size_t y0 = cell_y(query.min()[1].value), y1 = cell_y(query.max()[1].value);
+                for (size_t y = y0; y <= y1; ++y) {
+                    for (size_t x = x0; x <= x1; ++x) {
+                        const size_t c = y * m_cells_x + x;
+                        for (uint32_t k = m_cell_start[c]; k < m_cell_start[c + 1]; ++k) {
+                            if (visit(m_items[k])) return true;
+                        }
+                    }
+                }
+                return false;
+            }
+
+        private:
+            size_t cell_x(T x) const {
+                return std::min(m_cells_x - 1, static_cast<size_t>(std::max(T(0), (x - m_bounds.min()[0].value) * m_inv_cell)));
+            }
+
+            size_t cell_y(T y) const {
+                return std::min(m_cells_y - 1, static_cast<size_t>(std::max(T(0), (y - m_bounds.min()[1].value) * m_inv_cell)));
+            }
+        };
+
+        // Drops repeated vertices of a closed cycle, then vertices whose edges turn by less than
+        // the tolerance. The test is on the angle, so dense rings of short edges keep their shape.
+        template<typename T, typename Allocator>
+        std::vector<Point<2, T>> simplify_cycle(const std::vector<Point<2, T>, Allocator>& cycle) {
+            std::vector<Point<2, T>> distinct;
+            for (const auto& p : cycle) {
+                if (distinct.empty() || !(distinct.back() == p)) distinct.push_back(p);
+            }
+            while (distinct.size() > 1 && distinct.back() == distinct.front()) distinct.pop_back();
+
+            std::vector<Point<2, T>> out;
+            const size_t n = distinct.size();
+            for (size_t i = 0; i < n; ++i) {
+                const Point<2, T>& p = distinct[i];
+                const Vector<2, T> a = p - distinct[(i + n - 1) % n], b = distinct[(i + 1) % n] - p;
+                if (std::abs(cross_product(a, b)) <= Coord<T>::Epsilon * a.length() * b.length() && dot_product(a, b) > 0) continue;
+                out.push_back(p);
+            }
+            return out;
+        }
+
+        // The offset region bounded by the far sides of the pieces of a closed chain offset by d.
+        // A far side bounds the result where it is inside no other piece and, for a polygon, lies
+        // outside it (outward) or inside it (inward). The classification is local, so no winding
+        // numbers are carried across the arrangement. Every point of the result boundary is about
+        // |d| from the chain; sides that stay closer are dropped before noding, which removes the
+        // bulk of the crossings when |d| spans many short edges.
+        template<typename T>
+        PolygonCollection<T> fill_offset(const std::vector<Point<2, T>>& chain, const OffsetPieces<T>& pieces, T d, bool polygon, const OffsetOptions<T>& options) {
+            using point_type = Point<2, T>;
+            PolygonCollection<T> result;
+            const T tolerance = Coord<T>::Epsilon;
+            const T ad = std::abs(d);
+            const T reach = ad * std::cos(arc_step(d, options) / 2) - tolerance;
+            const size_t n = chain.size();
+
+            std::vector<Box<2, T>> boxes(n);
+            for (size_t j = 0; j < n; ++j) {
+                boxes[j].expand(chain[j]);
+                boxes[j].expand(chain[(j + 1) % n]);
+            }
+            const BoxGrid<T> chain_grid(boxes, ad / 2);
+            boxes.assign(pieces.size(), Box<2, T>());
+            for (size_t k = 0; k < pieces.size(); ++k) {
+                for (uint32_t i = pieces.starts[k]; i < pieces.starts[k + 1]; ++i) boxes[k].expand(pieces.points[i]);
+            }
+            const BoxGrid<T> piece_grid(boxes, ad / 2);
+
+            auto around = [](const point_type& x, T r) {
+                return Box<2, T>(point_type(x[0].value - r, x[1].value - r), point_type(x[0].value + r, x[1].value + r));
+            };
+            // Distance from x to the chain, or limit when that is farther.
+            auto chain_distance = [&](const point_type& x, T limit) {
+                T best = limit * limit, t;
+                chain_grid.visit(around(x, limit), [&](uint32_t j) {
+                    best = std::min(best, distance_sq_to_segment(x, chain[j], chain[(j + 1) % n], t));
+                    return false;
+                });
+                return std::sqrt(best);
+            };
+            // Inside the counter-clockwise chain, by the side of the nearest edge or the convexity
+            // of the nearest vertex. Only asked for points about |d| from the chain.
+            auto inside_chain = [&](const point_type& x) {
+                T best = std::numeric_limits<T>::max(), best_t = 0, t;
+                size_t best_edge = n;
+                chain_grid.visit(around(x, pieces.radius + tolerance), [&](uint32_t j) {
+                    const T dist_sq = distance_sq_to_segment(x, chain[j], chain[(j + 1) % n], t);
+                    if (dist_sq < best) {
+                        best = dist_sq;
+                        best_edge = j;
+                        best_t = t;
+                    }
+                    return false;
+                });
+                if (best_edge == n) {
+                    return false;
+                }
+                if (best_t > 0 && best_t < 1) {
+                    return cross_product(chain[(best_edge + 1) % n] - chain[best_edge], x - chain[best_edge]) > 0;
+                }
+                const size_t k = best_t > 0 ? (best_edge + 1) % n : best_edge;
+                return cross_product(chain[k] - chain[(k + n - 1) % n], chain[(k + 1) % n] - chain[k]) < 0;
+            };
+            // Inside what the offset adds (outward) or removes (inward): a piece, or the side of the
+            // polygon that the pieces extend.
+            auto in_region = [&](const point_type& x) {
+                return (polygon && inside_chain(x) == (d > 0)) || piece_grid.visit(around(x, 0), [&](uint32_t k) {
+                    return strictly_inside_convex(pieces.points.data() + pieces.starts[k], pieces.starts[k + 1] - pieces.starts[k], x, tolerance);
+                });
+            };
+            // On the chain the pieces only touch, so look around the point instead. Around an end
+            // cap that is flat, part of the neighbourhood stays outside.
+            const T probe = std::max(ad * T(1e-6), 16 * tolerance);
+            auto in_region_interior = [&](const point_type& x) {
+                if (chain_distance(x, 2 * tolerance) > tolerance) {
+                    return in_region(x);
+                }
+                for (int k = 0; k < 8; ++k) {
+                    const T a = T(0.39269908169872415) * T(2 * k + 1);
+                    if (!in_region(point_type(x[0].value + probe * std::cos(a), x[1].value + probe * std::sin(a)))) return false;
+                }
+                return true;
+            };
+
+            // Distance to the chain changes no faster than along the side, so no point of a side is
+            // farther than the mean of its end distances plus half its length.
+            std::vector<uint8_t> near(pieces.far_sides.size());
+            parallel_for(near.size(), [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    const Segment<2, T>& s = pieces.far_sides[i];
+                    near[i] = chain_distance(s.p1(), reach) + chain_distance(s.p2(), reach) + s.length() < 2 * reach;
+                }
+            }, options.num_threads, 256);
+            std::vector<Segment<2, T>> sides;
+            for (size_t i = 0; i < near.size(); ++i) {
+                if (!near[i]) sides.push_back(pieces.far_sides[i]);
+            }
+            if (sides.empty()) {
+                return result;
+            }
+
+            const Dcel<T> noded = Dcel<T>::from_segments(sides, tolerance, options.num_threads);
+            const auto& half_edges = noded.half_edges();
+            std::vector<uint8_t> keep(half_edges.size() / 2);
+            parallel_for(keep.size(), [&](size_t begin, size_t end) {
+                for (size_t e = begin; e < end; ++e) {
+                    if (half_edges[2 * e].winding == 0) continue;
+                    const point_type& a = noded.vertices()[half_edges[2 * e].origin].point;
+                    const point_type& b = noded.vertices()[half_edges[2 * e + 1].origin].point;
+                    const point_type m((a[0].value + b[0].value) / 2, (a[1].value + b[1].value) / 2);
+                    keep[e] = !in_region_interior(m);
+                }
+            }, options.num_threads, 256);
+
+            std::vector<Segment<2, T>> boundary;
+            for (size_t e = 0; e < keep.size(); ++e) {
+                if (!keep[e]) continue;
+                const auto& a = noded.vertices()[half_edges[2 * e].origin].point;
+                const auto& b = noded.vertices()[half_edges[2 * e + 1].origin].point;
+                boundary.push_back(half_edges[2 * e].winding > 0 ? Segment<2, T>(a, b) : Segment<2, T>(b, a));
+            }
+            if (boundary.empty()) {
+                return result;
+            }
+
+            const Dcel<T> cleaned = Dcel<T>::from_segments(boundary, tolerance, options.num_threads);
+            for (size_t f = 1; f < cleaned.num_faces(); ++f) {
+                const auto& face = cleaned.faces()[f];
+                if (cleaned.half_edges()[face.outer_edge].winding <= 0) continue;
+                const auto exterior = simplify_cycle(cleaned.cycle_points(face.outer_edge));
+                if (exterior.size() < 3) continue;
+                std::vector<std::vector<Point<2, T>>> holes;
+                for (uint32_t k = 0; k < face.num_holes; ++k) {
+                    auto hole = simplify_cycle(cleaned.cycle_points(cleaned.hole_edges()[face.first_hole + k]));
+                    if (hole.size() >= 3) holes.push_back(std::move(hole));
+                }
+                result.add_polygon(exterior, holes);
+            }
+            return result;
+        }
+
+    } // namespace detail
+
+    // Offset of a simple polygon: outward for a positive distance, inward for a negative one. The
+    // result may split into several polygons (inward) or gain holes (outward around a concave
+    // bay); it is empty when an inward offset consumes the polygon.
+    template<typename T, typename Allocator>
+    PolygonCollection<T> offset(const Polygon<2, T, Allocator>& polygon, T distance, const OffsetOptions<T>& options = OffsetOptions<T>()) {
+        std::vector<Point<2, T>> ring = detail::simplify_cycle(polygon.vertices());
+        if (ring.size() < 3) {
+            return PolygonCollection<T>();
+        }
+        if (distance == 0) {
+            PolygonCollection<T> result;
+            result.add_polygon(ring);
+            return result;
+        }
+        if (Polygon<2, T>(ring).moments(1).signed_area < 0) {
+            std::reverse(ring.begin(), ring.end());
+        }
+        detail::OffsetPieces<T> pieces;
+        detail::offset_pieces(ring, distance, options, pieces);
+        return detail::fill_offset(ring, pieces, distance, true, options);
+    }
+
+    // Everything within |distance| of an open chain. The join also shapes the end caps: ROUND and
+    // SQUARE caps reach past the ends, MITER leaves them flat.
+    template<typename T>
+    PolygonCollection<T> buffer(const Polyline<2, T>& polyline, T distance, const OffsetOptions<T>& options = OffsetOptions<T>()) {
+        assert(!polyline.empty() && "Polyline must not be empty.");
+        const T d = std::abs(distance);
+        std::vector<Point<2, T>> chain;
+        for (const auto& p : polyline.vertices()) {
+            if (chain.empty() || !(chain.back() == p)) chain.push_back(p);
+        }
+        if (d == 0 || (chain.size() == 1 && options.join == JoinType::MITER)) {
+            return PolygonCollection<T>();
+        }
+        if (chain.size() == 1) {
+            // A single point: a square, or a circle with the same chords as round joins.
+            const T x = chain[0][0].value, y = chain[0][1].value;
+            std::vector<Point<2, T>> loop;
+            if (options.join == JoinType::SQUARE) {
+                loop = { Point<2, T>(x - d, y - d), Point<2, T>(x + d, y - d), Point<2, T>(x + d, y + d), Point<2, T>(x - d, y + d) };
+            }
+            else {
+                const size_t steps = std::max<size_t>(8, size_t(std::ceil(2 * T(3.14159265358979323846) / detail::arc_step(d, options))));
+                for (size_t k = 0; k < steps; ++k) {
+                    const T a = 2 * T(3.14159265358979323846) * T(k) / T(steps);
+                    loop.push_back(Point<2, T>(x + d * std::cos(a), y + d * std::sin(a)));
+                }
+            }
+            PolygonCollection<T> result;
+            result.add_polygon(loop);
+            return result;
+        }
+        // Forward along one side and back along the other: a closed chain with a half-turn at each end.
+        std::vector<Point<2, T>> there_and_back(chain);
+        there_and_back.insert(there_and_back.end(), chain.rbegin() + 1, chain.rend() - 1);
+        detail::OffsetPieces<T> pieces;
+        detail::offset_pieces(there_and_back, d, options, pieces);
+        return detail::fill_offset(there_and_back, pieces, d, false, options);
+    }
+
+
+} // namespace geom
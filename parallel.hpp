@@ -0,0 +1,50 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace geom {
+
+    inline size_t default_thread_count() {
+        const unsigned int hw = std::thread::hardware_concurrency();
+        return hw == 0 ? 1 : static_cast<size_t>(hw);
+    }
+
+    // Splits [0, count) into contiguous chunks and calls func(begin, end) for each chunk.
+    // The calling thread processes the first chunk, so small inputs never spawn threads.
+    template<typename Func>
+    void parallel_for(size_t count, Func&& func, size_t num_threads = 0, size_t min_chunk = 1024) {
+        if (count == 0) {
+            return;
+        }
+        if (num_threads == 0) {
+            num_threads = default_thread_count();
+        }
+        const size_t max_chunks = (count + min_chunk - 1) / min_chunk;
+        num_threads = std::max<size_t>(1, std::min(num_threads, max_chunks));
+
+        if (num_threads == 1) {
+            func(size_t(0), count);
+            return;
+        }
+
+        const size_t chunk = (count + num_threads - 1) / num_threads;
+        std::vector<std::thread> workers;
+        workers.reserve(num_threads - 1);
+        for (size_t t = 1; t < num_threads; ++t) {
+            const size_t begin = t * chunk;
+            const size_t end = std::min(count, begin + chunk);
+            if (begin >= end) {
+                break;
+            }
+            workers.emplace_back([&func, begin, end]() { func(begin, end); });
+        }
+        func(size_t(0), std::min(count, chunk));
+
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+} // namespace geom
@@ -0,0 +1,404 @@
+﻿#pragma once
+
+#include <cassert>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "vector.hpp"
+#include "algorithms.hpp"
+#include "polygon.hpp"
+
+namespace geom {
+
+    // Multi-producer, multi-consumer FIFO with a fixed capacity. push blocks while the queue is full,
+    // which is how a slow stage throttles the stages feeding it. The queue closes once every
+    // registered producer has called producer_done; pop then drains what is left and returns nullopt.
+    template<typename T>
+    class BoundedQueue {
+    private:
+        std::mutex m_mutex;
+        std::condition_variable m_not_full;
+        std::condition_variable m_not_empty;
+        std::deque<T> m_items;
+        size_t m_capacity;
+        size_t m_producers = 0;
+        bool m_closed = false;
+        bool m_cancelled = false;
+
+    public:
+        explicit BoundedQueue(size_t capacity) : m_capacity(capacity) {
+            assert(capacity > 0 && "Queue capacity must be positive.");
+        }
+
+        void add_producer() {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_producers;
+        }
+
+        void producer_done() {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            assert(m_producers > 0 && "producer_done called more often than add_producer.");
+            if (--m_producers == 0) {
+                m_closed = true;
+                m_not_empty.notify_all();
+            }
+        }
+
+        // Returns false when the queue was cancelled; the item is discarded.
+        bool push(T&& item) {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_not_full.wait(lock, [&]() { return m_items.size() < m_capacity || m_cancelled; });
+            if (m_cancelled) {
+                return false;
+            }
+            m_items.push_back(std::move(item));
+            m_not_empty.notify_one();
+            return true;
+        }
+
+        std::optional<T> pop() {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_not_empty.wait(lock, [&]() { return !m_items.empty() || m_closed || m_cancelled; });
+            if (m_cancelled || m_items.empty()) {
+                return std::nullopt;
+            }
+            T item = std::move(m_items.front());
+            m_items.pop_front();
+            m_not_full.notify_one();
+            return item;
+        }
+
+        // Wakes every blocked producer and consumer; used to tear the pipeline down after a failure.
+        void cancel() {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_cancelled = true;
+            m_items.clear();
+            m_not_full.notify_all();
+            m_not_empty.notify_all();
+        }
+    };
+
+    template<typename T>
+    class PipelineStage;
+
+    namespace detail {
+
+        template<typename T>
+        struct is_optional : std::false_type {};
+
+        template<typename T>
+        struct is_optional<std::optional<T>> : std::true_type {};
+
+        template<typename T>
+        struct unwrap_optional { using type = T; };
+
+        template<typename T>
+        struct unwrap_optional<std::optional<T>> { using type = T; };
+
+    } // namespace detail
+
+    // Owner of the threads and queues of a staged pipeline. Every stage runs on its own thread(s)
+    // as soon as it is attached, and items are moved, never copied, from one queue to the next.
+    //
+    //     Pipeline pipeline(8);
+    //     auto areas = pipeline.source(read_next)              // std::optional<Item>()
+    //                          .transform(stages::ConvexHull(), 4)
+    //                          .transform(stages::Area())
+    //                          .reduce(0.0, std::plus<double>());
+    //     pipeline.wait();
+    //
+    // If any stage throws, all queues are cancelled and wait() rethrows the first exception.
+    class Pipeline {
+    private:
+        std::vector<std::thread> m_threads;
+        std::vector<std::function<void()>> m_cancellers;
+        std::mutex m_mutex;
+        std::exception_ptr m_error;
+        bool m_abandoned = false;
+        size_t m_capacity;
+
+        template<typename T>
+        friend class PipelineStage;
+
+    public:
+        explicit Pipeline(size_t queue_capacity = 16) : m_capacity(queue_capacity) {
+            assert(queue_capacity > 0 && "Queue capacity must be positive.");
+        }
+
+        // Stops every stage that is still running: a stage whose output handle was dropped would
+        // otherwise block on its full queue forever. Call wait() first to let the stream finish;
+        // reductions cut short this way leave their futures with a broken promise.
+        ~Pipeline() {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_abandoned = true;
+                for (auto& cancel : m_cancellers) cancel();
+            }
+            join();
+        }
+
+        Pipeline(const Pipeline&) = delete;
+        Pipeline& operator=(const Pipeline&) = delete;
+
+        // A source is called repeatedly on its own thread until it returns nullopt.
+        template<typename Source>
+        auto source(Source&& generate) {
+            using Item = typename detail::unwrap_optional<std::invoke_result_t<Source&>>::type;
+            static_assert(detail::is_optional<std::invoke_result_t<Source&>>::value, "A pipeline source must return std::optional.");
+
+            auto out = make_queue<Item>();
+            out->add_producer();
+            spawn([this, out, generate = std::forward<Source>(generate)]() mutable {
+                guarded([&]() {
+                    while (std::optional<Item> item = generate()) {
+                        if (!out->push(std::move(*item))) break;
+                    }
+                });
+                out->producer_done();
+            });
+            return PipelineStage<Item>(*this, out);
+        }
+
+        // Feeds the items of a container into the pipeline, moving them out of it.
+        template<typename Container>
+        auto source_from(Container items) {
+            using Item = typename Container::value_type;
+            auto storage = std::make_shared<Container>(std::move(items));
+            auto it = storage->begin();
+            return source([storage, it]() mutable -> std::optional<Item> {
+                if (it == storage->end()) return std::nullopt;
+                return std::move(*it++);
+            });
+        }
+
+        // Joins every stage thread and rethrows the first exception raised by a stage.
+        void wait() {
+            join();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_error) {
+                std::exception_ptr error = m_error;
+                m_error = nullptr;
+                std::rethrow_exception(error);
+            }
+        }
+
+    private:
+        template<typename T>
+        std::shared_ptr<BoundedQueue<T>> make_queue() {
+            auto queue = std::make_shared<BoundedQueue<T>>(m_capacity);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_cancellers.push_back([queue]() { queue->cancel(); });
+            return queue;
+        }
+
+        template<typename Func>
+        void spawn(Func&& func) {
+            m_threads.emplace_back(std::forward<Func>(func));
+        }
+
+        template<typename Func>
+        void guarded(Func&& func) {
+            try {
+                func();
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (!m_error) {
+                    m_error = std::current_exception();
+                }
+                for (auto& cancel : m_cancellers) cancel();
+            }
+        }
+
+        std::exception_ptr failure() {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_error;
+        }
+
+        bool abandoned() {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_abandoned;
+        }
+
+        void join() {
+            for (auto& thread : m_threads) {
+                if (thread.joinable()) thread.join();
+            }
+            m_threads.clear();
+        }
+    };
+
+    // Handle to the output queue of one stage. Each handle must be consumed exactly once, by
+    // attaching the next stage, a reduction or a sink.
+    template<typename T>
+    class PipelineStage {
+    public:
+        using value_type = T;
+
+    private:
+        Pipeline* m_pipeline;
+        std::shared_ptr<BoundedQueue<T>> m_queue;
+
+        friend class Pipeline;
+        template<typename U>
+        friend class PipelineStage;
+
+        PipelineStage(Pipeline& pipeline, std::shared_ptr<BoundedQueue<T>> queue)
+            : m_pipeline(&pipeline), m_queue(std::move(queue)) {
+        }
+
+    public:
+        // Maps every item through func on num_workers threads; output order is only preserved with a
+        // single worker. A func returning std::optional drops the items it maps to nullopt.
+        template<typename Func>
+        auto transform(Func&& func, size_t num_workers = 1) {
+            using Result = std::invoke_result_t<Func&, T&&>;
+            using Item = typename detail::unwrap_optional<Result>::type;
+            assert(num_workers > 0 && "A transform stage needs at least one worker.");
+
+            auto out = m_pipeline->template make_queue<Item>();
+            auto shared_func = std::make_shared<std::decay_t<Func>>(std::forward<Func>(func));
+            for (size_t w = 0; w < num_workers; ++w) {
+                out->add_producer();
+                m_pipeline->spawn([pipeline = m_pipeline, in = m_queue, out, shared_func]() {
+                    pipeline->guarded([&]() {
+                        while (std::optional<T> item = in->pop()) {
+                            if constexpr (detail::is_optional<Result>::value) {
+                                Result result = (*shared_func)(std::move(*item));
+                                if (result && !out->push(std::move(*result))) break;
+                            }
+                            else {
+                                if (!out->push((*shared_func)(std::move(*item)))) break;
+                            }
+                        }
+                    });
+                    out->producer_done();
+                });
+            }
+            return PipelineStage<Item>(*m_pipeline, out);
+        }
+
+        template<typename Predicate>
+        PipelineStage<T> filter(Predicate&& keep, size_t num_workers = 1) {
+            return transform([keep = std::forward<Predicate>(keep)](T&& item) mutable -> std::optional<T> {
+                if (keep(static_cast<const T&>(item))) return std::optional<T>(std::move(item));
+                return std::nullopt;
+            }, num_workers);
+        }
+
+        // Groups consecutive items into vectors of up to batch_size items, so later stages pay the
+        // queue synchronization once per batch.
+        PipelineStage<std::vector<T>> batch(size_t batch_size) {
+            assert(batch_size > 0 && "Batch size must be positive.");
+            auto out = m_pipeline->template make_queue<std::vector<T>>();
+            out->add_producer();
+            m_pipeline->spawn([pipeline = m_pipeline, in = m_queue, out, batch_size]() {
+                pipeline->guarded([&]() {
+                    std::vector<T> current;
+                    current.reserve(batch_size);
+                    while (std::optional<T> item = in->pop()) {
+                        current.push_back(std::move(*item));
+                        if (current.size() == batch_size) {
+                            if (!out->push(std::move(current))) return;
+                            current = std::vector<T>();
+                            current.reserve(batch_size);
+                        }
+                    }
+                    if (!current.empty()) out->push(std::move(current));
+                });
+                out->producer_done();
+            });
+            return PipelineStage<std::vector<T>>(*m_pipeline, out);
+        }
+
+        // Folds all items with value = accumulate(std::move(value), item) on one thread. The future is
+        // ready when the stream ends, or holds the pipeline's error if a stage failed.
+        template<typename R, typename Accumulate>
+        std::future<R> reduce(R initial, Accumulate&& accumulate) {
+            auto promise = std::make_shared<std::promise<R>>();
+            std::future<R> result = promise->get_future();
+            m_pipeline->spawn([pipeline = m_pipeline, in = m_queue, promise, value = std::move(initial),
+                               accumulate = std::forward<Accumulate>(accumulate)]() mutable {
+                pipeline->guarded([&]() {
+                    while (std::optional<T> item = in->pop()) {
+                        value = accumulate(std::move(value), std::move(*item));
+                    }
+                });
+                if (std::exception_ptr error = pipeline->failure()) promise->set_exception(error);
+                else if (!pipeline->abandoned()) promise->set_value(std::move(value));
+            });
+            return result;
+        }
+
+        // Terminal stage: calls consume(T&&) for every item on one thread.
+        template<typename Consume>
+        void sink(Consume&& consume) {
+            m_pipeline->spawn([pipeline = m_pipeline, in = m_queue, consume = std::forward<Consume>(consume)]() mutable {
+                pipeline->guarded([&]() {
+                    while (std::optional<T> item = in->pop()) {
+                        consume(std::move(*item));
+                    }
+                });
+            });
+        }
+    };
+
+    // Ready-made transform stages for the existing algorithms. Each accepts a single item or a
+    // batch (std::vector of items); a batch result has one entry per input item.
+    namespace stages {
+
+        struct ConvexHull {
+            template<typename T>
+            std::optional<Polygon<2, T>> operator()(std::vector<Point<2, T>>&& points) const {
+                return convex_hull(points);
+            }
+
+            // Degenerate point sets keep their place as nullopt.
+            template<typename T>
+            std::vector<std::optional<Polygon<2, T>>> operator()(std::vector<std::vector<Point<2, T>>>&& batch) const {
+                std::vector<std::optional<Polygon<2, T>>> hulls;
+                hulls.reserve(batch.size());
+                for (auto& points : batch) {
+                    hulls.push_back(convex_hull(points));
+                }
+                return hulls;
+            }
+        };
+
+        struct Area {
+            template<typename T, typename Allocator>
+            T operator()(const Polygon<2, T, Allocator>& polygon) const {
+                return polygon.area();
+            }
+
+            template<typename T>
+            std::vector<T> operator()(const std::vector<Polygon<2, T>>& batch) const {
+                std::vector<T> areas;
+                areas.reserve(batch.size());
+                for (const auto& polygon : batch) areas.push_back(polygon.area());
+                return areas;
+            }
+
+            // A missing hull has no interior, so its area is zero.
+            template<typename T>
+            std::vector<T> operator()(const std::vector<std::optional<Polygon<2, T>>>& batch) const {
+                std::vector<T> areas;
+                areas.reserve(batch.size());
+                for (const auto& polygon : batch) areas.push_back(polygon ? polygon->area() : T(0));
+                return areas;
+            }
+        };
+
+    } // namespace stages
+
+
+} // namespace geom
@@ -2,30 +2,122 @@
 
 #include <vector>
 #include <cassert>
+#include <cmath>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <type_traits>
 #include "vector.hpp"
 #include "segment.hpp"
 #include "algorithms.hpp" 
+#include "parallel.hpp"
+#include "arena.hpp"
 
 namespace geom {
 
-    template<size_t Dim, typename T>
+    // Area, perimeter, centroid and second moments of area of a simple 2D polygon. The moments
+    // are taken about the centroid and do not depend on orientation. signed_area is positive for
+    // counter-clockwise rings.
+    template<typename T>
+    struct PolygonMoments {
+        T signed_area;
+        T perimeter;
+        Point<2, T> centroid;
+        T ixx;      // Integral of (y - cy)^2.
+        T iyy;      // Integral of (x - cx)^2.
+        T ixy;      // Integral of (x - cx) * (y - cy).
+
+        T area() const { return std::abs(signed_area); }
+    };
+
+    namespace detail {
+
+        // Neumaier's compensated summation.
+        template<typename T>
+        struct CompensatedSum {
+            T sum = 0;
+            T compensation = 0;
+
+            void add(T x) {
+                const T t = sum + x;
+                compensation += std::abs(sum) >= std::abs(x) ? (sum - t) + x : (x - t) + sum;
+                sum = t;
+            }
+
+            void add(const CompensatedSum& other) {
+                add(other.sum);
+                add(other.compensation);
+            }
+
+            T value() const { return sum + compensation; }
+        };
+
+        // Shoelace sums of a ring; each edge contributes its cross product c times a polynomial
+        // in its endpoints.
+        template<typename T>
+        struct RingMomentSums {
+            CompensatedSum<T> area, cx, cy, xx, yy, xy, perimeter;
+
+            void add_edge(T x0, T y0, T x1, T y1) {
+                const T c = x0 * y1 - x1 * y0;
+                area.add(c);
+                cx.add((x0 + x1) * c);
+                cy.add((y0 + y1) * c);
+                xx.add((x0 * x0 + x0 * x1 + x1 * x1) * c);
+                yy.add((y0 * y0 + y0 * y1 + y1 * y1) * c);
+                xy.add((x0 * y1 + 2 * x0 * y0 + 2 * x1 * y1 + x1 * y0) * c);
+                perimeter.add(std::sqrt((x1 - x0) * (x1 - x0) + (y1 - y0) * (y1 - y0)));
+            }
+
+            void add(const RingMomentSums& other) {
+                area.add(other.area);
+                cx.add(other.cx);
+                cy.add(other.cy);
+                xx.add(other.xx);
+                yy.add(other.yy);
+                xy.add(other.xy);
+                perimeter.add(other.perimeter);
+            }
+        };
+
+    } // namespace detail
+
+    // The allocator only decides where the vertices live; geom::pmr::Polygon takes them from a
+    // memory resource.
+    template<size_t Dim, typename T, typename Allocator = std::allocator<Point<Dim, T>>>
     class Polygon {
     public:
         using point_type = Point<Dim, T>;
+        using allocator_type = Allocator;
+        using container_type = std::vector<point_type, Allocator>;
 
     private:
-        std::vector<point_type> m_vertices;
+        container_type m_vertices;
+
+        // Edges per partial sum in moments(). Fixed, so the result does not depend on the number
+        // of threads.
+        static constexpr size_t MomentBlock = 4096;
 
     public:
-        Polygon(const std::vector<point_type>& vertices) : m_vertices(vertices) {
+        Polygon(const std::vector<point_type>& vertices, const Allocator& allocator = Allocator())
+            : m_vertices(vertices.begin(), vertices.end(), allocator) {
+            assert(m_vertices.size() >= 3 && "Polygon must have at least 3 vertices.");
+        }
+
+        // Takes over the vertices and their allocator.
+        Polygon(container_type&& vertices) : m_vertices(std::move(vertices)) {
             assert(m_vertices.size() >= 3 && "Polygon must have at least 3 vertices.");
         }
 
+        allocator_type get_allocator() const {
+            return m_vertices.get_allocator();
+        }
+
         size_t num_vertices() const {
             return m_vertices.size();
         }
 
-        const std::vector<point_type>& vertices() const {
+        const container_type& vertices() const {
             return m_vertices;
         }
 
@@ -34,16 +126,99 @@ namespace geom {
             return Segment<Dim, T>(m_vertices[i], m_vertices[(i + 1) % num_vertices()]);
         }
 
+        // In 3D the polygon must be planar.
         T area() const {
-            static_assert(Dim == 2, "Area calculation is only implemented for 2D polygons.");
+            static_assert(Dim == 2 || Dim == 3, "Area calculation is only implemented for 2D and 3D polygons.");
+            if constexpr (Dim == 3) {
+                return vector_area().length();
+            }
+            else {
+                T total_area = 0;
+                point_type p1 = m_vertices.back();
+                for (const point_type& p2 : m_vertices) {
+                    total_area += cross_product(p1, p2);
+                    p1 = p2;
+                }
+                return std::abs(total_area) / 2;
+            }
+        }
 
-            T total_area = 0;
-            for (size_t i = 0; i < num_vertices(); ++i) {
-                point_type p1 = m_vertices[i];
-                point_type p2 = m_vertices[(i + 1) % num_vertices()];
-                total_area += cross_product(p1, p2);
+        // Half the sum of the edge cross products (Newell's method): normal to the plane of a planar
+        // polygon, as long as its area and oriented by the right-hand rule.
+        template<size_t D = Dim, std::enable_if_t<D == 3, int> = 0>
+        Vector<3, T> vector_area() const {
+            T nx = 0, ny = 0, nz = 0;
+            point_type p = m_vertices.back();
+            for (const point_type& q : m_vertices) {
+                const T x0 = p[0].value, y0 = p[1].value, z0 = p[2].value;
+                const T x1 = q[0].value, y1 = q[1].value, z1 = q[2].value;
+                nx += (y0 - y1) * (z0 + z1);
+                ny += (z0 - z1) * (x0 + x1);
+                nz += (x0 - x1) * (y0 + y1);
+                p = q;
             }
-            return std::abs(total_area) / 2.0;
+            return Vector<3, T>(nx / 2, ny / 2, nz / 2);
+        }
+
+        // Unit normal of a planar 3D polygon, or nullopt when its area vanishes.
+        template<size_t D = Dim, std::enable_if_t<D == 3, int> = 0>
+        std::optional<Vector<3, T>> normal() const {
+            Vector<3, T> n = vector_area();
+            if (n.length() < Coord<T>::Epsilon) {
+                return std::nullopt;
+            }
+            n.normalize();
+            return n;
+        }
+
+        // Everything in one pass over the vertices, with compensated sums taken relative to the
+        // first vertex, so large far-from-origin rings (coastlines in projected coordinates) keep
+        // their precision. Rings longer than a few blocks are summed in parallel.
+        template<size_t D = Dim, std::enable_if_t<D == 2, int> = 0>
+        PolygonMoments<T> moments(size_t num_threads = 0) const {
+            const size_t n = num_vertices();
+            const size_t num_blocks = (n + MomentBlock - 1) / MomentBlock;
+            const T ox = m_vertices[0][0].value, oy = m_vertices[0][1].value;
+
+            ScratchScope scratch;
+            std::pmr::vector<detail::RingMomentSums<T>> partial(num_blocks, scratch.resource());
+            parallel_for(num_blocks, [&](size_t block_begin, size_t block_end) {
+                for (size_t b = block_begin; b < block_end; ++b) {
+                    detail::RingMomentSums<T>& sums = partial[b];
+                    const size_t begin = b * MomentBlock, end = std::min(n, begin + MomentBlock);
+                    // Edge i runs from vertex i - 1 to vertex i; edge 0 closes the ring.
+                    const point_type& prev = m_vertices[begin == 0 ? n - 1 : begin - 1];
+                    T x0 = prev[0].value - ox, y0 = prev[1].value - oy;
+                    for (size_t i = begin; i < end; ++i) {
+                        const T x1 = m_vertices[i][0].value - ox, y1 = m_vertices[i][1].value - oy;
+                        sums.add_edge(x0, y0, x1, y1);
+                        x0 = x1;
+                        y0 = y1;
+                    }
+                }
+            }, num_threads, 16);
+
+            detail::RingMomentSums<T> sums;
+            for (const auto& p : partial) sums.add(p);
+
+            PolygonMoments<T> m;
+            const T twice_area = sums.area.value();
+            m.signed_area = twice_area / 2;
+            m.perimeter = sums.perimeter.value();
+            if (std::abs(m.signed_area) < Coord<T>::Epsilon) {
+                m.centroid = m_vertices[0];
+                m.ixx = m.iyy = m.ixy = 0;
+                return m;
+            }
+            const T cx = sums.cx.value() / (3 * twice_area), cy = sums.cy.value() / (3 * twice_area);
+            m.centroid = point_type(ox + cx, oy + cy);
+            // Moments about the first vertex, moved to the centroid by the parallel axis theorem.
+            const T sign = m.signed_area < 0 ? T(-1) : T(1);
+            const T a = std::abs(m.signed_area);
+            m.ixx = sign * sums.yy.value() / 12 - a * cy * cy;
+            m.iyy = sign * sums.xx.value() / 12 - a * cx * cx;
+            m.ixy = sign * sums.xy.value() / 24 - a * cx * cy;
+            return m;
         }
     };
 
@@ -53,5 +228,18 @@ namespace geom {
     using Polygon2d = Polygon2<double>;
     using Polygon3d = Polygon3<double>;
 
+    using Polygon2f = Polygon2<float>;
+    using Polygon3f = Polygon3<float>;
+
+    namespace pmr {
+
+        template<size_t Dim, typename T>
+        using Polygon = geom::Polygon<Dim, T, std::pmr::polymorphic_allocator<Point<Dim, T>>>;
+
+        using Polygon2d = Polygon<2, double>;
+        using Polygon2f = Polygon<2, float>;
+
+    } // namespace pmr
+
 
 } // namespace geom
@@ -0,0 +1,314 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <utility>
+#include <vector>
+#include "vector.hpp"
+#include "box.hpp"
+#include "algorithms.hpp"
+#include "polygon.hpp"
+#include "parallel.hpp"
+
+namespace geom {
+
+    enum class FillRule {
+        EVEN_ODD,
+        NONZERO
+    };
+
+    namespace detail {
+
+        // Signed shoelace area of a ring stored as interleaved x, y coordinates.
+        template<typename T>
+        T ring_signed_area(const T* xy, size_t n) {
+            T sum = 0;
+            T px = xy[2 * (n - 1)], py = xy[2 * (n - 1) + 1];
+            for (size_t i = 0; i < n; ++i) {
+                const T x = xy[2 * i], y = xy[2 * i + 1];
+                sum += px * y - x * py;
+                px = x;
+                py = y;
+            }
+            return sum / 2;
+        }
+
+        // Winding number of a ring around (qx, qy). Points exactly on the boundary may go either way.
+        template<typename T>
+        int ring_winding(const T* xy, size_t n, T qx, T qy) {
+            int winding = 0;
+            T ax = xy[2 * (n - 1)], ay = xy[2 * (n - 1) + 1];
+            for (size_t i = 0; i < n; ++i) {
+                const T bx = xy[2 * i], by = xy[2 * i + 1];
+                const T side = (bx - ax) * (qy - ay) - (qx - ax) * (by - ay);
+                const bool up = (ay <= qy) & (by > qy);
+                const bool down = (ay > qy) & (by <= qy);
+                winding += int(up & (side > 0)) - int(down & (side < 0));
+                ax = bx;
+                ay = by;
+            }
+            return winding;
+        }
+
+    } // namespace detail
+
+    template<typename T>
+    class PolygonCollection;
+
+    // Non-owning view of one ring inside a PolygonCollection.
+    template<typename T>
+    class RingView {
+    public:
+        using point_type = Point<2, T>;
+
+    private:
+        const T* m_xy;
+        size_t m_size;
+
+    public:
+        RingView(const T* xy, size_t size) : m_xy(xy), m_size(size) {}
+
+        size_t num_vertices() const { return m_size; }
+        const T* data() const { return m_xy; }
+
+        point_type vertex(size_t i) const {
+            assert(i < m_size && "Vertex index out of bounds.");
+            return point_type(m_xy[2 * i], m_xy[2 * i + 1]);
+        }
+
+        T signed_area() const { return detail::ring_signed_area(m_xy, m_size); }
+
+        Polygon<2, T> to_polygon() const {
+            std::vector<point_type> vertices;
+            vertices.reserve(m_size);
+            for (size_t i = 0; i < m_size; ++i) vertices.push_back(vertex(i));
+            return Polygon<2, T>(vertices);
+        }
+    };
+
+    // Non-owning view of one polygon: an exterior ring followed by zero or more holes.
+    template<typename T>
+    class PolygonView {
+    public:
+        using point_type = Point<2, T>;
+
+    private:
+        const PolygonCollection<T>* m_collection;
+        size_t m_index;
+
+    public:
+        PolygonView(const PolygonCollection<T>& collection, size_t index) : m_collection(&collection), m_index(index) {}
+
+        size_t index() const { return m_index; }
+        size_t num_rings() const { return m_collection->ring_end(m_index) - m_collection->ring_begin(m_index); }
+        size_t num_holes() const { return num_rings() - 1; }
+
+        RingView<T> ring(size_t i) const {
+            assert(i < num_rings() && "Ring index out of bounds.");
+            return m_collection->ring(m_collection->ring_begin(m_index) + i);
+        }
+        RingView<T> exterior() const { return ring(0); }
+        RingView<T> hole(size_t i) const { return ring(i + 1); }
+
+        T area() const { return m_collection->area(m_index); }
+        bool contains(const point_type& p, FillRule rule = FillRule::EVEN_ODD) const { return m_collection->contains(m_index, p, rule); }
+        Box<2, T> bounds() const { return m_collection->bounds(m_index); }
+    };
+
+    // Many polygons with holes in three flat arrays: interleaved vertex coordinates, CSR offsets
+    // from rings into the vertex array, and CSR offsets from polygons into the ring array. Rings
+    // are stored without a repeated closing vertex; exteriors are normalized to counter-clockwise
+    // and holes to clockwise, so both fill rules treat holes as empty.
+    template<typename T>
+    class PolygonCollection {
+    public:
+        using point_type = Point<2, T>;
+        using box_type = Box<2, T>;
+
+    private:
+        std::vector<T> m_xy;
+        std::vector<uint32_t> m_ring_offsets{ 0 };     // Ring r spans vertices [m_ring_offsets[r], m_ring_offsets[r + 1]).
+        std::vector<uint32_t> m_polygon_offsets{ 0 };  // Polygon p spans rings [m_polygon_offsets[p], m_polygon_offsets[p + 1]).
+
+    public:
+        PolygonCollection() = default;
+
+        void reserve(size_t polygons, size_t rings, size_t vertices) {
+            m_polygon_offsets.reserve(polygons + 1);
+            m_ring_offsets.reserve(rings + 1);
+            m_xy.reserve(2 * vertices);
+        }
+
+        // Appends a polygon and returns its index. Each ring needs at least three vertices.
+        size_t add_polygon(const std::vector<point_type>& exterior, const std::vector<std::vector<point_type>>& holes = {}) {
+            append_ring(exterior, true);
+            for (const auto& hole : holes) {
+                append_ring(hole, false);
+            }
+            m_polygon_offsets.push_back(static_cast<uint32_t>(m_ring_offsets.size() - 1));
+            return size() - 1;
+        }
+
+        template<typename Allocator>
+        size_t add_polygon(const Polygon<2, T, Allocator>& exterior, const std::vector<Polygon<2, T, Allocator>>& holes = {}) {
+            append_ring(exterior.vertices(), true);
+            for (const auto& hole : holes) {
+                append_ring(hole.vertices(), false);
+            }
+            m_polygon_offsets.push_back(static_cast<uint32_t>(m_ring_offsets.size() - 1));
+            return size() - 1;
+        }
+
+        size_t size() const { return m_polygon_offsets.size() - 1; }
+        bool empty() const { return size() == 0; }
+        size_t num_rings() const { return m_ring_offsets.size() - 1; }
+        size_t num_vertices() const { return m_xy.size() / 2; }
+
+        const std::vector<T>& coordinates() const { return m_xy; }
+        const std::vector<uint32_t>& ring_offsets() const { return m_ring_offsets; }
+        const std::vector<uint32_t>& polygon_offsets() const { return m_polygon_offsets; }
+
+        size_t ring_begin(size_t polygon) const { return m_polygon_offsets[polygon]; }
+        size_t ring_end(size_t polygon) const { return m_polygon_offsets[polygon + 1]; }
+
+        RingView<T> ring(size_t r) const {
+            assert(r < num_rings() && "Ring index out of bounds.");
+            return RingView<T>(m_xy.data() + 2 * m_ring_offsets[r], m_ring_offsets[r + 1] - m_ring_offsets[r]);
+        }
+
+        PolygonView<T> operator[](size_t i) const {
+            assert(i < size() && "Polygon index out of bounds.");
+            return PolygonView<T>(*this, i);
+        }
+
+        class const_iterator {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = PolygonView<T>;
+            using difference_type = std::ptrdiff_t;
+            using pointer = void;
+            using reference = PolygonView<T>;
+
+        private:
+            const PolygonCollection* m_collection;
+            size_t m_index;
+
+        public:
+            const_iterator(const PolygonCollection* collection, size_t index) : m_collection(collection), m_index(index) {}
+
+            PolygonView<T> operator*() const { return PolygonView<T>(*m_collection, m_index); }
+            const_iterator& operator++() { ++m_index; return *this; }
+            const_iterator operator++(int) { const_iterator old = *this; ++m_index; return old; }
+            bool operator==(const const_iterator& other) const { return m_index == other.m_index; }
+            bool operator!=(const const_iterator& other) const { return m_index != other.m_index; }
+        };
+
+        const_iterator begin() const { return const_iterator(this, 0); }
+        const_iterator end() const { return const_iterator(this, size()); }
+
+        // Exterior area minus the area of the holes.
+        T area(size_t polygon) const {
+            T result = 0;
+            for (size_t r = ring_begin(polygon); r < ring_end(polygon); ++r) {
+                result += ring_area(r);
+            }
+            return result;
+        }
+
+        bool contains(size_t polygon, const point_type& p, FillRule rule = FillRule::EVEN_ODD) const {
+            return inside(polygon, p[0].value, p[1].value, rule);
+        }
+
+        box_type bounds(size_t polygon) const {
+            return ring_bounds(ring_begin(polygon));
+        }
+
+        // Bulk kernels. Each walks the coordinate array front to back; with num_threads != 1 the
+        // polygons are split into contiguous chunks.
+
+        void areas(std::vector<T>& out, size_t num_threads = 0) const {
+            out.resize(size());
+            parallel_for(size(), [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) out[i] = area(i);
+            }, num_threads);
+        }
+
+        void bounds(std::vector<box_type>& out, size_t num_threads = 0) const {
+            out.resize(size());
+            parallel_for(size(), [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) out[i] = bounds(i);
+            }, num_threads);
+        }
+
+        // inside[i] is 1 when points[i] lies in polygon i.
+        void contains(const std::vector<point_type>& points, std::vector<uint8_t>& inside_out, FillRule rule = FillRule::EVEN_ODD, size_t num_threads = 0) const {
+            assert(points.size() == size() && "Expected one query point per polygon.");
+            inside_out.resize(size());
+            parallel_for(size(), [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) inside_out[i] = inside(i, points[i][0].value, points[i][1].value, rule) ? 1 : 0;
+            }, num_threads);
+        }
+
+        // Indices of every polygon containing p, in increasing order.
+        void containing(const point_type& p, std::vector<size_t>& out, FillRule rule = FillRule::EVEN_ODD) const {
+            out.clear();
+            const T qx = p[0].value, qy = p[1].value;
+            for (size_t i = 0; i < size(); ++i) {
+                if (inside(i, qx, qy, rule)) out.push_back(i);
+            }
+        }
+
+    private:
+        template<typename Points>
+        void append_ring(const Points& points, bool exterior) {
+            assert(points.size() >= 3 && "A ring must have at least 3 vertices.");
+            const size_t start = m_xy.size();
+            for (const auto& p : points) {
+                m_xy.push_back(p[0].value);
+                m_xy.push_back(p[1].value);
+            }
+            const size_t n = points.size();
+            const T signed_area = detail::ring_signed_area(m_xy.data() + start, n);
+            if ((signed_area < 0) == exterior) {
+                // Reverse the vertex order in place.
+                for (size_t i = 0, j = n - 1; i < j; ++i, --j) {
+                    std::swap(m_xy[start + 2 * i], m_xy[start + 2 * j]);
+                    std::swap(m_xy[start + 2 * i + 1], m_xy[start + 2 * j + 1]);
+                }
+            }
+            m_ring_offsets.push_back(static_cast<uint32_t>(m_xy.size() / 2));
+        }
+
+        T ring_area(size_t r) const {
+            return detail::ring_signed_area(m_xy.data() + 2 * m_ring_offsets[r], m_ring_offsets[r + 1] - m_ring_offsets[r]);
+        }
+
+        box_type ring_bounds(size_t r) const {
+            const T* xy = m_xy.data() + 2 * m_ring_offsets[r];
+            const size_t n = m_ring_offsets[r + 1] - m_ring_offsets[r];
+            T min_x = xy[0], max_x = xy[0], min_y = xy[1], max_y = xy[1];
+            for (size_t i = 1; i < n; ++i) {
+                min_x = std::min(min_x, xy[2 * i]);
+                max_x = std::max(max_x, xy[2 * i]);
+                min_y = std::min(min_y, xy[2 * i + 1]);
+                max_y = std::max(max_y, xy[2 * i + 1]);
+            }
+            return box_type(point_type(min_x, min_y), point_type(max_x, max_y));
+        }
+
+        bool inside(size_t polygon, T qx, T qy, FillRule rule) const {
+            int winding = 0;
+            for (size_t r = ring_begin(polygon); r < ring_end(polygon); ++r) {
+                winding += detail::ring_winding(m_xy.data() + 2 * m_ring_offsets[r], m_ring_offsets[r + 1] - m_ring_offsets[r], qx, qy);
+            }
+            return rule == FillRule::EVEN_ODD ? (winding & 1) != 0 : winding != 0;
+        }
+    };
+
+    using PolygonCollection2d = PolygonCollection<double>;
+
+
+} // namespace geom
@@ -0,0 +1,114 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include "vector.hpp"
+#include "box.hpp"
+#include "segment.hpp"
+#include "algorithms.hpp"
+#include "polygon.hpp"
+
+namespace geom {
+
+    // Open chain of vertices, each stored once. append() keeps the length, the bounding box and
+    // the cumulative length at every vertex up to date, so arc-length queries are binary searches.
+    template<size_t Dim, typename T>
+    class Polyline {
+    public:
+        using point_type = Point<Dim, T>;
+        using edge_type = SegmentView<Dim, T>;
+
+    private:
+        std::vector<point_type> m_vertices;
+        std::vector<T> m_cumulative;            // Length from the first vertex to each vertex.
+        detail::CompensatedSum<T> m_length;     // Long tracks sum millions of short edges.
+        Box<Dim, T> m_bounds;
+
+    public:
+        Polyline() = default;
+
+        explicit Polyline(const std::vector<point_type>& vertices) {
+            reserve(vertices.size());
+            for (const auto& p : vertices) append(p);
+        }
+
+        void reserve(size_t count) {
+            m_vertices.reserve(count);
+            m_cumulative.reserve(count);
+        }
+
+        // Amortized O(1).
+        void append(const point_type& p) {
+            if (!m_vertices.empty()) {
+                m_length.add((p - m_vertices.back()).length());
+            }
+            m_vertices.push_back(p);
+            m_cumulative.push_back(m_length.value());
+            m_bounds.expand(p);
+        }
+
+        void clear() {
+            m_vertices.clear();
+            m_cumulative.clear();
+            m_length = detail::CompensatedSum<T>();
+            m_bounds = Box<Dim, T>();
+        }
+
+        bool empty() const { return m_vertices.empty(); }
+        size_t num_vertices() const { return m_vertices.size(); }
+        size_t num_edges() const { return m_vertices.empty() ? 0 : m_vertices.size() - 1; }
+
+        const std::vector<point_type>& vertices() const { return m_vertices; }
+        const std::vector<T>& cumulative_lengths() const { return m_cumulative; }
+        const Box<Dim, T>& bounds() const { return m_bounds; }
+
+        T length() const {
+            return m_cumulative.empty() ? T(0) : m_cumulative.back();
+        }
+
+        // View into the vertex buffer; invalidated by the next append.
+        edge_type edge(size_t i) const {
+            assert(i < num_edges() && "Edge index out of bounds.");
+            return edge_type(m_vertices.data() + i);
+        }
+
+        // Edge containing arc length s (clamped to [0, length()]) and the parameter along it.
+        std::pair<size_t, T> locate(T s) const {
+            assert(num_edges() > 0 && "Polyline must have at least one edge.");
+            const auto it = std::upper_bound(m_cumulative.begin(), m_cumulative.end(), s);
+            const size_t i = std::min(num_edges() - 1, size_t(std::max<ptrdiff_t>(1, it - m_cumulative.begin()) - 1));
+            const T edge_length = m_cumulative[i + 1] - m_cumulative[i];
+            const T t = edge_length > 0 ? std::clamp((s - m_cumulative[i]) / edge_length, T(0), T(1)) : T(0);
+            return { i, t };
+        }
+
+        // Point at arc length s from the first vertex, clamped to the ends. O(log n).
+        point_type point_at_distance(T s) const {
+            assert(!empty() && "Polyline must not be empty.");
+            if (m_vertices.size() == 1) {
+                return m_vertices[0];
+            }
+            const auto [i, t] = locate(s);
+            return m_vertices[i] + (m_vertices[i + 1] - m_vertices[i]) * t;
+        }
+
+        // Point at fraction t of the length.
+        point_type interpolate(T t) const {
+            return point_at_distance(t * length());
+        }
+    };
+
+    template<typename T> using Polyline2 = Polyline<2, T>;
+    template<typename T> using Polyline3 = Polyline<3, T>;
+
+    using Polyline2d = Polyline2<double>;
+    using Polyline3d = Polyline3<double>;
+
+    using Polyline2f = Polyline2<float>;
+    using Polyline3f = Polyline3<float>;
+
+
+} // namespace geom
@@ -0,0 +1,387 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <numeric>
+#include <optional>
+#include <string>
+#include <vector>
+#include "vector.hpp"
+#include "box.hpp"
+#include "parallel.hpp"
+#include "spatial_sort.hpp"
+#include "snapshot.hpp"
+
+namespace geom {
+
+    namespace detail {
+
+        inline uint32_t popcount64(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+            return static_cast<uint32_t>(__builtin_popcountll(x));
+#else
+            x = x - ((x >> 1) & 0x5555555555555555ull);
+            x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+            x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+            return static_cast<uint32_t>((x * 0x0101010101010101ull) >> 56);
+#endif
+        }
+
+    } // namespace detail
+
+    // Contiguous run of point indices inside a RangeTree; valid while the tree is alive.
+    class IndexSpan {
+    private:
+        const uint32_t* m_begin;
+        const uint32_t* m_end;
+
+    public:
+        IndexSpan(const uint32_t* begin, const uint32_t* end) : m_begin(begin), m_end(end) {}
+
+        const uint32_t* begin() const { return m_begin; }
+        const uint32_t* end() const { return m_end; }
+        size_t size() const { return static_cast<size_t>(m_end - m_begin); }
+        bool empty() const { return m_begin == m_end; }
+    };
+
+    // Static 2D orthogonal range counting and reporting. The points are ranked by x and a balanced
+    // tree is laid over the ranks; every tree level is one flat array holding each node's points
+    // sorted by y, plus one bit per entry telling whether it moves to the right child. A rank
+    // directory over the bits replaces the cascading pointers of a layered range tree, so a query
+    // binary-searches y once at the root and then follows O(log n) nodes in O(1) each.
+    //
+    // Counting only touches the bits (about 1.5 bits per point per level). Reporting returns the
+    // y-sorted index arrays of the covering nodes as spans, without copying indices.
+    template<typename T>
+    class RangeTree {
+    public:
+        using point_type = Point<2, T>;
+        using box_type = Box<2, T>;
+
+    private:
+        size_t m_size = 0;
+        size_t m_levels = 0;                // Levels that split; index arrays exist for m_levels + 1.
+        size_t m_words = 0;                 // 64-bit words per level.
+        std::vector<T> m_xs;                // x by rank.
+        std::vector<T> m_ys;                // y in root order.
+        std::vector<uint32_t> m_ids;        // (m_levels + 1) * m_size point indices.
+        std::vector<uint64_t> m_bits;       // m_levels * m_words.
+        std::vector<uint32_t> m_ranks;      // m_levels * (m_words + 1) set bits before each word.
+
+        static constexpr uint32_t SnapshotVersion = 1;
+
+        template<typename U>
+        friend class RangeTreeView;
+
+        RangeTree() = default;
+
+    public:
+        static RangeTree from_points(const std::vector<point_type>& points, size_t num_threads = 0) {
+            assert(points.size() < UINT32_MAX && "RangeTree indices are 32-bit.");
+            RangeTree tree;
+            const size_t n = points.size();
+            tree.m_size = n;
+            if (n == 0) {
+                return tree;
+            }
+            while ((size_t(1) << tree.m_levels) < n) ++tree.m_levels;
+            tree.m_words = (n + 63) / 64;
+
+            // x ranks and the root order (by y), both with the radix sort on order-preserving keys.
+            std::vector<uint64_t> keys(n);
+            std::vector<uint32_t> by_x(n);
+            std::iota(by_x.begin(), by_x.end(), 0u);
+            parallel_for(n, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) keys[i] = detail::ordered_bits(points[i][0].value);
+            }, num_threads);
+            radix_sort(keys, by_x);
+            std::vector<uint32_t> rank_of(n);
+            tree.m_xs.resize(n);
+            parallel_for(n, [&](size_t begin, size_t end) {
+                for (size_t r = begin; r < end; ++r) {
+                    rank_of[by_x[r]] = static_cast<uint32_t>(r);
+                    tree.m_xs[r] = points[by_x[r]][0].value;
+                }
+            }, num_threads);
+
+            tree.m_ids.resize((tree.m_levels + 1) * n);
+            std::iota(tree.m_ids.begin(), tree.m_ids.begin() + n, 0u);
+            keys.resize(n);
+            parallel_for(n, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) keys[i] = detail::ordered_bits(points[i][1].value);
+            }, num_threads);
+            std::vector<uint32_t> root(tree.m_ids.begin(), tree.m_ids.begin() + n);
+            radix_sort(keys, root);
+            std::copy(root.begin(), root.end(), tree.m_ids.begin());
+            tree.m_ys.resize(n);
+            parallel_for(n, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) tree.m_ys[i] = points[root[i]][1].value;
+            }, num_threads);
+
+            tree.m_bits.assign(tree.m_levels * tree.m_words, 0);
+            tree.m_ranks.assign(tree.m_levels * (tree.m_words + 1), 0);
+            // x ranks travel with the indices, so each level reads them sequentially.
+            std::vector<uint32_t> x_ranks(n), next_x_ranks(n);
+            parallel_for(n, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) x_ranks[i] = rank_of[root[i]];
+            }, num_threads);
+            std::vector<uint32_t> node_starts{ 0 };     // First rank of every node on the current level.
+            for (size_t level = 0; level < tree.m_levels; ++level) {
+                tree.build_level(level, node_starts, x_ranks, next_x_ranks, num_threads);
+                x_ranks.swap(next_x_ranks);
+                std::vector<uint32_t> next;
+                next.reserve(2 * node_starts.size());
+                for (size_t k = 0; k < node_starts.size(); ++k) {
+                    const uint32_t lo = node_starts[k];
+                    const uint32_t hi = k + 1 < node_starts.size() ? node_starts[k + 1] : static_cast<uint32_t>(n);
+                    next.push_back(lo);
+                    if (hi - lo > 1) next.push_back(lo + (hi - lo) / 2);
+                }
+                node_starts.swap(next);
+            }
+            return tree;
+        }
+
+        size_t size() const { return m_size; }
+        bool empty() const { return m_size == 0; }
+
+        // Bytes held by the tree's arrays.
+        size_t memory_bytes() const {
+            return m_xs.size() * sizeof(T) + m_ys.size() * sizeof(T) + m_ids.size() * sizeof(uint32_t) +
+                   m_bits.size() * sizeof(uint64_t) + m_ranks.size() * sizeof(uint32_t);
+        }
+
+        // Number of points inside the closed box.
+        size_t count(const box_type& range) const {
+            return layout().count(range);
+        }
+
+        // Spans of indices into the input points; together they list every point inside the closed
+        // box exactly once.
+        void report(const box_type& range, std::vector<IndexSpan>& spans) const {
+            layout().report(range, spans);
+        }
+
+        // Writes the tree as a snapshot that RangeTreeView::open maps back without rebuilding.
+        bool save(const std::string& path) const {
+            SnapshotWriter writer(SnapshotKind::RANGE_TREE, SnapshotVersion, sizeof(T));
+            const uint64_t shape[3] = { m_size, m_levels, m_words };
+            writer.add_section(shape, 3);
+            writer.add_section(m_xs);
+            writer.add_section(m_ys);
+            writer.add_section(m_ids);
+            writer.add_section(m_bits);
+            writer.add_section(m_ranks);
+            return writer.write(path);
+        }
+
+    private:
+        void build_level(size_t level, const std::vector<uint32_t>& node_starts, const std::vector<uint32_t>& x_ranks, std::vector<uint32_t>& next_x_ranks, size_t num_threads) {
+            const size_t n = m_size;
+            const uint32_t* ids = m_ids.data() + level * n;
+            uint32_t* next_ids = m_ids.data() + (level + 1) * n;
+            uint64_t* bits = m_bits.data() + level * m_words;
+            uint32_t* ranks = m_ranks.data() + level * (m_words + 1);
+
+            // Calls func(pos, lo, mid) for positions in [begin, end), walking the nodes alongside.
+            auto for_positions = [&](size_t begin, size_t end, auto&& func) {
+                size_t k = std::upper_bound(node_starts.begin(), node_starts.end(), static_cast<uint32_t>(begin)) - node_starts.begin() - 1;
+                for (size_t pos = begin; pos < end; ++pos) {
+                    while (k + 1 < node_starts.size() && node_starts[k + 1] <= pos) ++k;
+                    const size_t lo = node_starts[k];
+                    const size_t hi = k + 1 < node_starts.size() ? node_starts[k + 1] : n;
+                    // Single-point nodes stay where they are.
+                    func(pos, lo, hi - lo > 1 ? lo + (hi - lo) / 2 : hi);
+                }
+            };
+
+            parallel_for(m_words, [&](size_t word_begin, size_t word_end) {
+                for_positions(word_begin * 64, std::min(n, word_end * 64), [&](size_t pos, size_t, size_t mid) {
+                    if (x_ranks[pos] >= mid) bits[pos / 64] |= uint64_t(1) << (pos % 64);
+                });
+            }, num_threads, 256);
+
+            for (size_t w = 0; w < m_words; ++w) {
+                ranks[w + 1] = ranks[w] + detail::popcount64(bits[w]);
+            }
+
+            parallel_for(n, [&](size_t begin, size_t end) {
+                // Set bits before pos inside its node, counted as the walk goes.
+                size_t ones_before = 0;
+                size_t node = n;
+                for_positions(begin, end, [&](size_t pos, size_t lo, size_t mid) {
+                    if (lo != node) {
+                        node = lo;
+                        ones_before = layout().ones(level, pos) - layout().ones(level, lo);
+                    }
+                    const size_t right = (bits[pos / 64] >> (pos % 64)) & 1;
+                    const size_t dst = right ? mid + ones_before : pos - ones_before;
+                    next_ids[dst] = ids[pos];
+                    next_x_ranks[dst] = x_ranks[pos];
+                    ones_before += right;
+                });
+            }, num_threads);
+        }
+
+        // The query half of the tree over raw arrays, shared with RangeTreeView.
+        struct Layout {
+            size_t size, levels, words;
+            const T* xs;
+            const T* ys;
+            const uint32_t* ids;
+            const uint64_t* bits;
+            const uint32_t* ranks;
+
+            // Checks what the queries rely on, so that a snapshot opened without its checksum
+            // cannot send them out of bounds: the shape, the rank table, a split of every node
+            // at its middle, and point indices below size.
+            bool valid() const {
+                if (size >= UINT32_MAX || words != (size + 63) / 64) {
+                    return false;
+                }
+                size_t expected_levels = 0;
+                while ((size_t(1) << expected_levels) < size) ++expected_levels;
+                if (levels != expected_levels) {
+                    return false;
+                }
+                for (size_t level = 0; level < levels; ++level) {
+                    const uint64_t* level_bits = bits + level * words;
+                    const uint32_t* level_ranks = ranks + level * (words + 1);
+                    if (level_ranks[0] != 0) {
+                        return false;
+                    }
+                    for (size_t w = 0; w < words; ++w) {
+                        if (level_ranks[w + 1] != level_ranks[w] + detail::popcount64(level_bits[w])) {
+                            return false;
+                        }
+                    }
+                }
+                std::vector<size_t> node_starts{ 0 }, next;
+                for (size_t level = 0; level < levels; ++level) {
+                    next.clear();
+                    for (size_t k = 0; k < node_starts.size(); ++k) {
+                        const size_t lo = node_starts[k];
+                        const size_t hi = k + 1 < node_starts.size() ? node_starts[k + 1] : size;
+                        const size_t mid = hi - lo > 1 ? lo + (hi - lo) / 2 : hi;
+                        if (ones(level, hi) - ones(level, lo) != hi - mid) {
+                            return false;
+                        }
+                        next.push_back(lo);
+                        if (mid != hi) next.push_back(mid);
+                    }
+                    node_starts.swap(next);
+                }
+                return std::all_of(ids, ids + (levels + 1) * size, [&](uint32_t id) { return id < size; });
+            }
+
+            size_t ones(size_t level, size_t pos) const {
+                const size_t word = pos / 64, bit = pos % 64;
+                const uint32_t before = ranks[level * (words + 1) + word];
+                if (bit == 0) return before;
+                return before + detail::popcount64(bits[level * words + word] & ((uint64_t(1) << bit) - 1));
+            }
+
+            size_t count(const box_type& range) const {
+                size_t total = 0;
+                query(range, [&](size_t, size_t begin, size_t end) { total += end - begin; });
+                return total;
+            }
+
+            void report(const box_type& range, std::vector<IndexSpan>& spans) const {
+                spans.clear();
+                query(range, [&](size_t level, size_t begin, size_t end) {
+                    spans.emplace_back(ids + level * size + begin, ids + level * size + end);
+                });
+            }
+
+            // Calls visit(level, begin, end) for the position range of every node covered by the box.
+            template<typename Visit>
+            void query(const box_type& range, Visit&& visit) const {
+                if (size == 0 || range.is_empty()) {
+                    return;
+                }
+                const size_t x_begin = std::lower_bound(xs, xs + size, range.min()[0].value) - xs;
+                const size_t x_end = std::upper_bound(xs, xs + size, range.max()[0].value) - xs;
+                const size_t y_begin = std::lower_bound(ys, ys + size, range.min()[1].value) - ys;
+                const size_t y_end = std::upper_bound(ys, ys + size, range.max()[1].value) - ys;
+                if (x_begin < x_end && y_begin < y_end) {
+                    descend(0, 0, size, y_begin, y_end, x_begin, x_end, visit);
+                }
+            }
+
+            template<typename Visit>
+            void descend(size_t level, size_t lo, size_t hi, size_t begin, size_t end, size_t x_begin, size_t x_end, Visit& visit) const {
+                if (begin == end || hi <= x_begin || x_end <= lo) {
+                    return;
+                }
+                if (x_begin <= lo && hi <= x_end) {
+                    visit(level, begin, end);
+                    return;
+                }
+                const size_t mid = lo + (hi - lo) / 2;
+                const size_t ones_lo = ones(level, lo);
+                const size_t ones_begin = ones(level, begin) - ones_lo;
+                const size_t ones_end = ones(level, end) - ones_lo;
+                descend(level + 1, lo, mid, begin - ones_begin, end - ones_end, x_begin, x_end, visit);
+                descend(level + 1, mid, hi, mid + ones_begin, mid + ones_end, x_begin, x_end, visit);
+            }
+        };
+
+        Layout layout() const {
+            return { m_size, m_levels, m_words, m_xs.data(), m_ys.data(), m_ids.data(), m_bits.data(), m_ranks.data() };
+        }
+    };
+
+    using RangeTree2d = RangeTree<double>;
+
+    // A RangeTree queried straight from a memory-mapped snapshot.
+    template<typename T>
+    class RangeTreeView {
+    public:
+        using box_type = Box<2, T>;
+
+    private:
+        using Layout = typename RangeTree<T>::Layout;
+
+        Snapshot m_snapshot;
+        Layout m_layout;
+
+        RangeTreeView(Snapshot&& snapshot, const Layout& layout) : m_snapshot(std::move(snapshot)), m_layout(layout) {}
+
+    public:
+        // Returns nullopt for a missing, stale or corrupt snapshot.
+        static std::optional<RangeTreeView> open(const std::string& path, bool verify_checksum = true) {
+            auto snapshot = Snapshot::open(path, SnapshotKind::RANGE_TREE, RangeTree<T>::SnapshotVersion, sizeof(T), verify_checksum);
+            if (!snapshot || snapshot->num_sections() != 6) {
+                return std::nullopt;
+            }
+            size_t count;
+            const uint64_t* shape = snapshot->template section<uint64_t>(0, count);
+            if (count != 3) {
+                return std::nullopt;
+            }
+            Layout layout{};
+            layout.size = static_cast<size_t>(shape[0]);
+            layout.levels = static_cast<size_t>(shape[1]);
+            layout.words = static_cast<size_t>(shape[2]);
+            size_t xs, ys, ids, bits, ranks;
+            layout.xs = snapshot->template section<T>(1, xs);
+            layout.ys = snapshot->template section<T>(2, ys);
+            layout.ids = snapshot->template section<uint32_t>(3, ids);
+            layout.bits = snapshot->template section<uint64_t>(4, bits);
+            layout.ranks = snapshot->template section<uint32_t>(5, ranks);
+            if (xs != layout.size || ys != layout.size || ids != (layout.levels + 1) * layout.size ||
+                bits != layout.levels * layout.words || ranks != layout.levels * (layout.words + 1) || !layout.valid()) {
+                return std::nullopt;
+            }
+            return RangeTreeView(std::move(*snapshot), layout);
+        }
+
+        size_t size() const { return m_layout.size; }
+        size_t count(const box_type& range) const { return m_layout.count(range); }
+        void report(const box_type& range, std::vector<IndexSpan>& spans) const { m_layout.report(range, spans); }
+    };
+
+
+} // namespace geom
@@ -37,7 +37,7 @@ namespace geom {
 
         point_type point_at(const T& t) const {
             assert(t >= 0 && "Parameter t for Ray::point_at must be non-negative.");
-            return this->m_origin + (this->m_direction * t);
+            return lazy(this->m_origin) + lazy(this->m_direction) * t;
         }
 
         bool contains(const point_type& p) const {
@@ -55,5 +55,8 @@ namespace geom {
     using Ray2d = Ray2<double>;
     using Ray3d = Ray3<double>;
 
+    using Ray2f = Ray2<float>;
+    using Ray3f = Ray3<float>;
+
 
 } // namespace geom
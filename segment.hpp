@@ -29,23 +29,57 @@ namespace geom {
         }
 
         point_type project(const point_type& p) const {
-            const vector_type v = m_p2 - m_p1;
+            const vector_type v = lazy(m_p2) - lazy(m_p1);
             const T len_sq = v.length_sq();
 
             if (len_sq < Coord<T>::Epsilon) {
                 return m_p1;
             }
 
-            const T t = dot_product(p - m_p1, v) / len_sq;
+            const T t = dot_product(lazy(p) - lazy(m_p1), v) / len_sq;
             const T clamped_t = std::clamp(t, T(0), T(1));
-            return m_p1 + v * clamped_t;
+            return lazy(m_p1) + lazy(v) * clamped_t;
+        }
+    };
+
+    // Non-owning view of two consecutive points in a vertex buffer, used for the edges of chains
+    // that store each vertex once. Valid while the buffer is not reallocated.
+    template<size_t Dim, typename T>
+    class SegmentView {
+    public:
+        using point_type = Point<Dim, T>;
+
+    private:
+        const point_type* m_points;
+
+    public:
+        explicit SegmentView(const point_type* points) : m_points(points) {
+        }
+
+        const point_type& p1() const { return m_points[0]; }
+        const point_type& p2() const { return m_points[1]; }
+
+        T length_sq() const {
+            return (m_points[1] - m_points[0]).length_sq();
+        }
+
+        T length() const {
+            return (m_points[1] - m_points[0]).length();
+        }
+
+        Segment<Dim, T> segment() const {
+            return Segment<Dim, T>(m_points[0], m_points[1]);
+        }
+
+        operator Segment<Dim, T>() const {
+            return segment();
         }
     };
 
     template<size_t Dim, typename T>
     T distance(const Point<Dim, T>& p, const Segment<Dim, T>& s) {
         const Point<Dim, T> projected_point = s.project(p);
-        return (p - projected_point).length();
+        return (lazy(p) - lazy(projected_point)).length();
     }
 
     template<size_t Dim, typename T>
@@ -59,5 +93,8 @@ namespace geom {
     using Segment2d = Segment2<double>;
     using Segment3d = Segment3<double>;
 
+    using Segment2f = Segment2<float>;
+    using Segment3f = Segment3<float>;
+
 
 } // namespace geom
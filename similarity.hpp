@@ -0,0 +1,312 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <vector>
+#include "vector.hpp"
+#include "parallel.hpp"
+
+namespace geom {
+
+    // What the Hausdorff distance measures against: the other chain's vertices, or its edges.
+    enum class HausdorffMode {
+        POINTS,
+        SEGMENTS
+    };
+
+    namespace detail {
+
+        template<typename T>
+        T point_segment_distance_sq(T px, T py, T ax, T ay, T bx, T by) {
+            const T dx = bx - ax, dy = by - ay;
+            const T len_sq = dx * dx + dy * dy;
+            T t = len_sq > 0 ? ((px - ax) * dx + (py - ay) * dy) / len_sq : T(0);
+            t = std::min(T(1), std::max(T(0), t));
+            const T ex = ax + t * dx - px, ey = ay + t * dy - py;
+            return ex * ex + ey * ey;
+        }
+
+    } // namespace detail
+
+    // Uniform grid over the vertices or the edges of a point chain (a GPS trace, a route), for
+    // nearest-distance queries that may stop early. Distances are squared until the final result.
+    // Queries are const and can run from several threads.
+    template<typename T>
+    class ChainIndex {
+    public:
+        using point_type = Point<2, T>;
+
+    private:
+        HausdorffMode m_mode = HausdorffMode::POINTS;
+        std::vector<T> m_xs, m_ys;
+        T m_min_x = 0, m_min_y = 0, m_cell = 1;
+        int64_t m_cells_x = 1, m_cells_y = 1;
+        std::vector<uint32_t> m_cell_start;     // CSR offsets into m_items, one past the last cell.
+        std::vector<uint32_t> m_items;          // Vertex, or first vertex of an edge.
+
+        ChainIndex() = default;
+
+    public:
+        // An edge is listed in every cell its bounding box touches. A single-vertex chain has no
+        // edges and is indexed as a point either way.
+        static ChainIndex from_points(const std::vector<point_type>& chain, HausdorffMode mode = HausdorffMode::SEGMENTS) {
+            assert(!chain.empty() && "Chain must have at least one point.");
+            ChainIndex index;
+            index.m_mode = chain.size() == 1 ? HausdorffMode::POINTS : mode;
+            const size_t n = chain.size();
+            index.m_xs.resize(n);
+            index.m_ys.resize(n);
+            T max_x = chain[0][0].value, max_y = chain[0][1].value;
+            index.m_min_x = max_x;
+            index.m_min_y = max_y;
+            for (size_t i = 0; i < n; ++i) {
+                const T x = chain[i][0].value, y = chain[i][1].value;
+                index.m_xs[i] = x;
+                index.m_ys[i] = y;
+                index.m_min_x = std::min(index.m_min_x, x);
+                index.m_min_y = std::min(index.m_min_y, y);
+                max_x = std::max(max_x, x);
+                max_y = std::max(max_y, y);
+            }
+
+            // About two elements per cell.
+            const size_t count = index.num_elements();
+            const T w = max_x - index.m_min_x, h = max_y - index.m_min_y;
+            const T target = T(std::max<size_t>(1, count / 2));
+            if (w > 0 && h > 0) index.m_cell = std::sqrt(w * h / target);
+            else if (w > 0 || h > 0) index.m_cell = std::max(w, h) / target;
+            index.m_cells_x = std::min<int64_t>(int64_t(w / index.m_cell) + 1, int64_t(4 * count + 1));
+            index.m_cells_y = std::min<int64_t>(int64_t(h / index.m_cell) + 1, int64_t(4 * count + 1));
+
+            // Two passes over the cell ranges: count, then fill.
+            index.m_cell_start.assign(size_t(index.m_cells_x * index.m_cells_y) + 1, 0);
+            for (int pass = 0; pass < 2; ++pass) {
+                std::vector<uint32_t> cursor;
+                if (pass == 1) {
+                    for (size_t c = 1; c < index.m_cell_start.size(); ++c) index.m_cell_start[c] += index.m_cell_start[c - 1];
+                    index.m_items.resize(index.m_cell_start.back());
+                    cursor.assign(index.m_cell_start.begin(), index.m_cell_start.end() - 1);
+                }
+                for (size_t e = 0; e < count; ++e) {
+                    const size_t j = index.m_mode == HausdorffMode::SEGMENTS ? e + 1 : e;
+                    const int64_t x0 = index.cell_x(std::min(index.m_xs[e], index.m_xs[j])), x1 = index.cell_x(std::max(index.m_xs[e], index.m_xs[j]));
+                    const int64_t y0 = index.cell_y(std::min(index.m_ys[e], index.m_ys[j])), y1 = index.cell_y(std::max(index.m_ys[e], index.m_ys[j]));
+                    for (int64_t cy = y0; cy <= y1; ++cy) {
+                        for (int64_t cx = x0; cx <= x1; ++cx) {
+                            const size_t c = size_t(cy * index.m_cells_x + cx);
+                            if (pass == 0) ++index.m_cell_start[c + 1];
+                            else index.m_items[cursor[c]++] = uint32_t(e);
+                        }
+                    }
+                }
+            }
+            return index;
+        }
+
+        HausdorffMode mode() const { return m_mode; }
+        size_t size() const { return m_xs.size(); }
+
+        // Distance from p to the nearest vertex or edge.
+        T distance(const point_type& p) const {
+            return std::sqrt(nearest_sq(p[0].value, p[1].value, T(0)));
+        }
+
+        // Largest distance from a point of `from` to this chain, or nullopt as soon as one point is
+        // farther than threshold. Each point's search stops once it finds anything closer than
+        // the largest distance so far (Taha and Hanbury's early break), so only points that raise
+        // the maximum pay for an exact nearest search.
+        std::optional<T> directed_hausdorff(const std::vector<point_type>& from, T threshold = std::numeric_limits<T>::infinity()) const {
+            const T limit_sq = threshold * threshold;
+            T max_sq = 0;
+            for (const point_type& p : from) {
+                const T d = nearest_sq(p[0].value, p[1].value, max_sq);
+                if (d > max_sq) {
+                    max_sq = d;
+                    if (max_sq > limit_sq) {
+                        return std::nullopt;
+                    }
+                }
+            }
+            return std::sqrt(max_sq);
+        }
+
+        // Squared distance from (px, py) to the nearest element, or any squared distance below
+        // stop_below_sq once one is found. Cells are visited in square rings around the query cell
+        // until the nearest element so far is closer than any cell left.
+        T nearest_sq(T px, T py, T stop_below_sq) const {
+            const int64_t cx = cell_x(px), cy = cell_y(py);
+            T best = std::numeric_limits<T>::infinity();
+            for (int64_t r = 0;; ++r) {
+                const int64_t x0 = std::max<int64_t>(0, cx - r), x1 = std::min(m_cells_x - 1, cx + r);
+                const int64_t y0 = std::max<int64_t>(0, cy - r), y1 = std::min(m_cells_y - 1, cy + r);
+                for (int64_t y = y0; y <= y1; ++y) {
+                    if (y == cy - r || y == cy + r) {
+                        for (int64_t x = x0; x <= x1; ++x) best = std::min(best, scan_cell(y, x, px, py));
+                    }
+                    else {
+                        if (cx - r >= 0) best = std::min(best, scan_cell(y, cx - r, px, py));
+                        if (cx + r < m_cells_x) best = std::min(best, scan_cell(y, cx + r, px, py));
+                    }
+                }
+                if (best < stop_below_sq) {
+                    return best;
+                }
+
+                // Elements not seen yet lie wholly outside the visited block.
+                T bound = std::numeric_limits<T>::infinity();
+                if (x0 > 0) bound = std::min(bound, px - (m_min_x + T(x0) * m_cell));
+                if (x1 < m_cells_x - 1) bound = std::min(bound, m_min_x + T(x1 + 1) * m_cell - px);
+                if (y0 > 0) bound = std::min(bound, py - (m_min_y + T(y0) * m_cell));
+                if (y1 < m_cells_y - 1) bound = std::min(bound, m_min_y + T(y1 + 1) * m_cell - py);
+                if (bound == std::numeric_limits<T>::infinity()) {
+                    return best;
+                }
+                bound = std::max(bound, T(0));
+                if (best <= bound * bound) {
+                    return best;
+                }
+            }
+        }
+
+    private:
+        size_t num_elements() const {
+            return m_mode == HausdorffMode::SEGMENTS ? m_xs.size() - 1 : m_xs.size();
+        }
+
+        int64_t cell_x(T x) const {
+            return std::min(m_cells_x - 1, std::max<int64_t>(0, int64_t(std::floor((x - m_min_x) / m_cell))));
+        }
+
+        int64_t cell_y(T y) const {
+            return std::min(m_cells_y - 1, std::max<int64_t>(0, int64_t(std::floor((y - m_min_y) / m_cell))));
+        }
+
+        T scan_cell(int64_t y, int64_t x, T px, T py) const {
+            const size_t c = size_t(y * m_cells_x + x);
+            T best = std::numeric_limits<T>::infinity();
+            for (uint32_t k = m_cell_start[c]; k < m_cell_start[c + 1]; ++k) {
+                const uint32_t e = m_items[k];
+                T d;
+                if (m_mode == HausdorffMode::SEGMENTS) {
+                    d = detail::point_segment_distance_sq(px, py, m_xs[e], m_ys[e], m_xs[e + 1], m_ys[e + 1]);
+                }
+                else {
+                    const T dx = m_xs[e] - px, dy = m_ys[e] - py;
+                    d = dx * dx + dy * dy;
+                }
+                best = std::min(best, d);
+            }
+            return best;
+        }
+    };
+
+    using ChainIndex2d = ChainIndex<double>;
+
+    // Symmetric Hausdorff distance between two chains, or nullopt when it exceeds threshold. With
+    // SEGMENTS each chain's vertices are measured against the other chain's edges.
+    template<typename T>
+    std::optional<T> hausdorff_distance(const std::vector<Point<2, T>>& a, const std::vector<Point<2, T>>& b, HausdorffMode mode = HausdorffMode::SEGMENTS,
+                                        T threshold = std::numeric_limits<T>::infinity()) {
+        const auto ab = ChainIndex<T>::from_points(b, mode).directed_hausdorff(a, threshold);
+        if (!ab) {
+            return std::nullopt;
+        }
+        const auto ba = ChainIndex<T>::from_points(a, mode).directed_hausdorff(b, threshold);
+        if (!ba) {
+            return std::nullopt;
+        }
+        return std::max(*ab, *ba);
+    }
+
+    // Discrete Fréchet distance (Eiter and Mannila), or nullopt when it exceeds threshold. The
+    // dynamic program keeps two rows of squared coupling distances and, under a finite threshold,
+    // only the band of columns that can still be reached; it gives up as soon as a row has none.
+    template<typename T>
+    std::optional<T> discrete_frechet_distance(const std::vector<Point<2, T>>& a, const std::vector<Point<2, T>>& b,
+                                               T threshold = std::numeric_limits<T>::infinity()) {
+        assert(!a.empty() && !b.empty() && "Chains must have at least one point.");
+        const T inf = std::numeric_limits<T>::infinity();
+        const T limit_sq = threshold * threshold;
+        const size_t n = a.size(), m = b.size();
+        auto d = [&](size_t i, size_t j) { return (a[i] - b[j]).length_sq(); };
+        // Every coupling pairs the first points and the last points.
+        if (d(0, 0) > limit_sq || d(n - 1, m - 1) > limit_sq) {
+            return std::nullopt;
+        }
+
+        std::vector<T> prev(m, inf), cur(m, inf);
+        size_t lo = 0, hi = 0;
+        prev[0] = d(0, 0);
+        for (size_t j = 1; j < m; ++j) {
+            const T v = std::max(prev[j - 1], d(0, j));
+            if (v > limit_sq) break;
+            prev[j] = v;
+            hi = j;
+        }
+
+        for (size_t i = 1; i < n; ++i) {
+            size_t new_lo = m, new_hi = 0;
+            for (size_t j = lo; j < m; ++j) {
+                T best = j <= hi ? prev[j] : inf;
+                if (j > lo && j - 1 <= hi) best = std::min(best, prev[j - 1]);
+                if (j > lo) best = std::min(best, cur[j - 1]);
+                if (best > limit_sq || best == inf) {
+                    cur[j] = inf;
+                    if (j > hi) break;
+                    continue;
+                }
+                const T v = std::max(best, d(i, j));
+                cur[j] = v > limit_sq ? inf : v;
+                if (cur[j] != inf) {
+                    new_lo = std::min(new_lo, j);
+                    new_hi = j;
+                }
+            }
+            if (new_lo == m) {
+                return std::nullopt;
+            }
+            std::swap(prev, cur);
+            lo = new_lo;
+            hi = new_hi;
+        }
+        if (hi != m - 1 || prev[m - 1] == inf) {
+            return std::nullopt;
+        }
+        return std::sqrt(prev[m - 1]);
+    }
+
+    // out[i] is hausdorff_distance(query, candidates[i], mode, threshold). The query is indexed
+    // once and shared by all threads.
+    template<typename T>
+    void hausdorff_distances(const std::vector<Point<2, T>>& query, const std::vector<std::vector<Point<2, T>>>& candidates,
+                             std::vector<std::optional<T>>& out, HausdorffMode mode = HausdorffMode::SEGMENTS,
+                             T threshold = std::numeric_limits<T>::infinity(), size_t num_threads = 0) {
+        out.resize(candidates.size());
+        const ChainIndex<T> query_index = ChainIndex<T>::from_points(query, mode);
+        parallel_for(candidates.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                out[i] = std::nullopt;
+                const auto ba = query_index.directed_hausdorff(candidates[i], threshold);
+                if (!ba) continue;
+                const auto ab = ChainIndex<T>::from_points(candidates[i], mode).directed_hausdorff(query, threshold);
+                if (ab) out[i] = std::max(*ab, *ba);
+            }
+        }, num_threads, 4);
+    }
+
+    // out[i] is discrete_frechet_distance(query, candidates[i], threshold).
+    template<typename T>
+    void discrete_frechet_distances(const std::vector<Point<2, T>>& query, const std::vector<std::vector<Point<2, T>>>& candidates,
+                                    std::vector<std::optional<T>>& out, T threshold = std::numeric_limits<T>::infinity(), size_t num_threads = 0) {
+        out.resize(candidates.size());
+        parallel_for(candidates.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) out[i] = discrete_frechet_distance(query, candidates[i], threshold);
+        }, num_threads, 4);
+    }
+
+
+} // namespace geom
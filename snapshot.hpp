@@ -0,0 +1,262 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define GEOM_SNAPSHOT_MMAP 1
+#endif
+
+namespace geom {
+
+    // Which structure a snapshot holds. Each structure also stamps its own layout version, so a
+    // change to its record types invalidates old files.
+    enum class SnapshotKind : uint32_t {
+        RANGE_TREE = 1,
+        TRAPEZOIDAL_MAP = 2
+    };
+
+    constexpr uint32_t SnapshotFormatVersion = 1;
+
+    namespace detail {
+
+        struct SnapshotHeader {
+            char magic[8];
+            uint32_t format_version;
+            uint32_t kind;
+            uint32_t kind_version;
+            uint32_t scalar_size;       // sizeof(T) of the structure's coordinates.
+            uint32_t byte_order;        // Written as 0x01020304; files do not cross endianness.
+            uint32_t num_sections;
+            uint64_t payload_size;      // Bytes after the header.
+            uint64_t checksum;          // Of everything after the header.
+        };
+
+        struct SnapshotSection {
+            uint64_t offset;            // From the start of the file, a multiple of SectionAlignment.
+            uint64_t size;
+        };
+
+        constexpr char SnapshotMagic[8] = { 'G', 'E', 'O', 'M', 'S', 'N', 'A', 'P' };
+        constexpr uint32_t SnapshotByteOrder = 0x01020304;
+        constexpr size_t SectionAlignment = 64;
+
+        // FNV-1a over 64-bit words, then the tail bytes.
+        inline uint64_t snapshot_checksum(const uint8_t* data, size_t size) {
+            constexpr uint64_t Prime = 0x100000001B3ull;
+            uint64_t hash = 0xCBF29CE484222325ull;
+            size_t i = 0;
+            for (; i + 8 <= size; i += 8) {
+                uint64_t word;
+                std::memcpy(&word, data + i, 8);
+                hash = (hash ^ word) * Prime;
+            }
+            for (; i < size; ++i) hash = (hash ^ data[i]) * Prime;
+            return hash;
+        }
+
+    } // namespace detail
+
+    // Collects flat arrays and writes them as one snapshot file: a header, a section table and the
+    // sections, each aligned so that a mapped file can be read in place. Sections hold raw
+    // trivially copyable records; structures store indices rather than pointers, so the layout is
+    // position-independent.
+    class SnapshotWriter {
+    private:
+        detail::SnapshotHeader m_header;
+        std::vector<std::vector<uint8_t>> m_sections;
+
+    public:
+        SnapshotWriter(SnapshotKind kind, uint32_t kind_version, uint32_t scalar_size) {
+            std::memset(&m_header, 0, sizeof(m_header));
+            std::memcpy(m_header.magic, detail::SnapshotMagic, sizeof(m_header.magic));
+            m_header.format_version = SnapshotFormatVersion;
+            m_header.kind = static_cast<uint32_t>(kind);
+            m_header.kind_version = kind_version;
+            m_header.scalar_size = scalar_size;
+            m_header.byte_order = detail::SnapshotByteOrder;
+        }
+
+        template<typename Item>
+        void add_section(const Item* items, size_t count) {
+            static_assert(std::is_trivially_copyable<Item>::value, "Snapshot sections hold raw records.");
+            const uint8_t* bytes = reinterpret_cast<const uint8_t*>(items);
+            m_sections.emplace_back(bytes, bytes + count * sizeof(Item));
+        }
+
+        template<typename Item>
+        void add_section(const std::vector<Item>& items) {
+            add_section(items.data(), items.size());
+        }
+
+        // Returns false when the file cannot be written.
+        bool write(const std::string& path) const {
+            const size_t table_end = sizeof(detail::SnapshotHeader) + m_sections.size() * sizeof(detail::SnapshotSection);
+            std::vector<uint8_t> file(table_end);
+            std::vector<detail::SnapshotSection> table;
+            for (const auto& section : m_sections) {
+                file.resize((file.size() + detail::SectionAlignment - 1) / detail::SectionAlignment * detail::SectionAlignment, 0);
+                table.push_back({ file.size(), section.size() });
+                file.insert(file.end(), section.begin(), section.end());
+            }
+            std::memcpy(file.data() + sizeof(detail::SnapshotHeader), table.data(), table.size() * sizeof(detail::SnapshotSection));
+
+            detail::SnapshotHeader header = m_header;
+            header.num_sections = static_cast<uint32_t>(m_sections.size());
+            header.payload_size = file.size() - sizeof(header);
+            header.checksum = detail::snapshot_checksum(file.data() + sizeof(header), header.payload_size);
+            std::memcpy(file.data(), &header, sizeof(header));
+
+            std::FILE* out = std::fopen(path.c_str(), "wb");
+            if (!out) {
+                return false;
+            }
+            const bool written = std::fwrite(file.data(), 1, file.size(), out) == file.size();
+            return std::fclose(out) == 0 && written;
+        }
+    };
+
+    // Read-only snapshot file, memory-mapped where the platform allows and read into memory
+    // otherwise. Sections are used in place; nothing is deserialized.
+    class Snapshot {
+    private:
+        const uint8_t* m_data = nullptr;
+        size_t m_size = 0;
+        bool m_mapped = false;
+        std::vector<uint8_t> m_buffer;
+
+        Snapshot() = default;
+
+    public:
+        Snapshot(Snapshot&& other) noexcept { *this = std::move(other); }
+
+        Snapshot& operator=(Snapshot&& other) noexcept {
+            if (this != &other) {
+                release();
+                m_buffer = std::move(other.m_buffer);
+                m_data = other.m_mapped ? other.m_data : m_buffer.data();
+                m_size = other.m_size;
+                m_mapped = other.m_mapped;
+                other.m_data = nullptr;
+                other.m_size = 0;
+                other.m_mapped = false;
+            }
+            return *this;
+        }
+
+        Snapshot(const Snapshot&) = delete;
+        Snapshot& operator=(const Snapshot&) = delete;
+
+        ~Snapshot() { release(); }
+
+        // Returns nullopt when the file is missing or truncated, was written for a different
+        // structure, layout version, coordinate type or byte order, or fails the checksum.
+        // Skipping verification avoids reading the whole file at startup.
+        static std::optional<Snapshot> open(const std::string& path, SnapshotKind kind, uint32_t kind_version, uint32_t scalar_size, bool verify_checksum = true) {
+            Snapshot snapshot;
+            if (!snapshot.load(path) || snapshot.m_size < sizeof(detail::SnapshotHeader)) {
+                return std::nullopt;
+            }
+            const detail::SnapshotHeader& h = snapshot.header();
+            if (std::memcmp(h.magic, detail::SnapshotMagic, sizeof(h.magic)) != 0 || h.format_version != SnapshotFormatVersion ||
+                h.byte_order != detail::SnapshotByteOrder || h.kind != static_cast<uint32_t>(kind) || h.kind_version != kind_version ||
+                h.scalar_size != scalar_size || h.payload_size != snapshot.m_size - sizeof(detail::SnapshotHeader) ||
+                h.num_sections > h.payload_size / sizeof(detail::SnapshotSection)) {
+                return std::nullopt;
+            }
+            if (verify_checksum && detail::snapshot_checksum(snapshot.m_data + sizeof(h), h.payload_size) != h.checksum) {
+                return std::nullopt;
+            }
+            for (size_t i = 0; i < h.num_sections; ++i) {
+                const detail::SnapshotSection s = snapshot.section_entry(i);
+                if (s.offset % detail::SectionAlignment != 0 || s.offset > snapshot.m_size || s.size > snapshot.m_size - s.offset) {
+                    return std::nullopt;
+                }
+            }
+            return snapshot;
+        }
+
+        size_t num_sections() const { return header().num_sections; }
+        size_t size_bytes() const { return m_size; }
+        bool is_mapped() const { return m_mapped; }
+
+        // Section i as an array of Item; count receives the number of records.
+        template<typename Item>
+        const Item* section(size_t i, size_t& count) const {
+            static_assert(std::is_trivially_copyable<Item>::value, "Snapshot sections hold raw records.");
+            const detail::SnapshotSection s = section_entry(i);
+            count = static_cast<size_t>(s.size / sizeof(Item));
+            return reinterpret_cast<const Item*>(m_data + s.offset);
+        }
+
+    private:
+        const detail::SnapshotHeader& header() const {
+            return *reinterpret_cast<const detail::SnapshotHeader*>(m_data);
+        }
+
+        detail::SnapshotSection section_entry(size_t i) const {
+            detail::SnapshotSection s;
+            std::memcpy(&s, m_data + sizeof(detail::SnapshotHeader) + i * sizeof(s), sizeof(s));
+            return s;
+        }
+
+        bool load(const std::string& path) {
+#ifdef GEOM_SNAPSHOT_MMAP
+            const int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                return false;
+            }
+            struct stat st;
+            if (::fstat(fd, &st) != 0 || st.st_size <= 0) {
+                ::close(fd);
+                return false;
+            }
+            void* mapping = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+            if (mapping == MAP_FAILED) {
+                return false;
+            }
+            m_data = static_cast<const uint8_t*>(mapping);
+            m_size = static_cast<size_t>(st.st_size);
+            m_mapped = true;
+            return true;
+#else
+            std::FILE* in = std::fopen(path.c_str(), "rb");
+            if (!in) {
+                return false;
+            }
+            uint8_t chunk[1 << 16];
+            size_t read;
+            while ((read = std::fread(chunk, 1, sizeof(chunk), in)) > 0) m_buffer.insert(m_buffer.end(), chunk, chunk + read);
+            std::fclose(in);
+            m_data = m_buffer.data();
+            m_size = m_buffer.size();
+            return true;
+#endif
+        }
+
+        void release() {
+#ifdef GEOM_SNAPSHOT_MMAP
+            if (m_mapped && m_data) {
+                ::munmap(const_cast<uint8_t*>(m_data), m_size);
+            }
+#endif
+            m_data = nullptr;
+            m_size = 0;
+            m_mapped = false;
+            m_buffer.clear();
+        }
+    };
+
+
+} // namespace geom
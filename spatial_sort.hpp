@@ -0,0 +1,285 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <optional>
+#include <type_traits>
+#include <vector>
+#include "vector.hpp"
+#include "box.hpp"
+#include "algorithms.hpp"
+#include "polygon.hpp"
+#include "instrumentation.hpp"
+
+namespace geom {
+
+    namespace detail {
+
+        // Spreads the low 32 bits of x to the even bit positions.
+        inline uint64_t spread_bits_2(uint64_t x) {
+            x &= 0xFFFFFFFFull;
+            x = (x | (x << 16)) & 0x0000FFFF0000FFFFull;
+            x = (x | (x << 8)) & 0x00FF00FF00FF00FFull;
+            x = (x | (x << 4)) & 0x0F0F0F0F0F0F0F0Full;
+            x = (x | (x << 2)) & 0x3333333333333333ull;
+            x = (x | (x << 1)) & 0x5555555555555555ull;
+            return x;
+        }
+
+        // Spreads the low 21 bits of x to every third bit position.
+        inline uint64_t spread_bits_3(uint64_t x) {
+            x &= 0x1FFFFFull;
+            x = (x | (x << 32)) & 0x001F00000000FFFFull;
+            x = (x | (x << 16)) & 0x001F0000FF0000FFull;
+            x = (x | (x << 8)) & 0x100F00F00F00F00Full;
+            x = (x | (x << 4)) & 0x10C30C30C30C30C3ull;
+            x = (x | (x << 2)) & 0x1249249249249249ull;
+            return x;
+        }
+
+        template<size_t Dim>
+        uint64_t interleave(const std::array<uint32_t, Dim>& cell) {
+            if constexpr (Dim == 2) {
+                return (spread_bits_2(cell[0]) << 1) | spread_bits_2(cell[1]);
+            }
+            else {
+                static_assert(Dim == 3, "Space-filling curve keys are implemented for 2D and 3D.");
+                return (spread_bits_3(cell[0]) << 2) | (spread_bits_3(cell[1]) << 1) | spread_bits_3(cell[2]);
+            }
+        }
+
+        // Maps coordinates inside a box onto a 2^Bits integer grid per axis. The arithmetic is in
+        // double whatever T is: in float the largest cell, 2^32 - 1, rounds up out of uint32_t.
+        template<size_t Dim, typename T>
+        class GridQuantizer {
+        public:
+            static constexpr uint32_t Bits = Dim == 2 ? 32 : 21;
+            static constexpr double MaxCell = double((uint64_t(1) << Bits) - 1);
+
+        private:
+            std::array<double, Dim> m_min;
+            std::array<double, Dim> m_scale;
+
+        public:
+            explicit GridQuantizer(const Box<Dim, T>& bounds) {
+                for (size_t i = 0; i < Dim; ++i) {
+                    const double extent = double(bounds.max()[i].value) - double(bounds.min()[i].value);
+                    m_min[i] = double(bounds.min()[i].value);
+                    m_scale[i] = extent > 0 ? MaxCell / extent : 0.0;
+                }
+            }
+
+            std::array<uint32_t, Dim> cell(const Point<Dim, T>& p) const {
+                std::array<uint32_t, Dim> result;
+                for (size_t i = 0; i < Dim; ++i) {
+                    const double c = std::min(std::max((double(p[i].value) - m_min[i]) * m_scale[i], 0.0), MaxCell);
+                    result[i] = static_cast<uint32_t>(c);
+                }
+                return result;
+            }
+        };
+
+        // Skilling's transform from axes to the transposed Hilbert index ("Programming the Hilbert
+        // curve", AIP Conf. Proc. 707, 2004); interleaving the result gives the Hilbert key.
+        template<size_t Dim>
+        uint64_t hilbert_index(std::array<uint32_t, Dim> x, uint32_t bits) {
+            const uint32_t m = uint32_t(1) << (bits - 1);
+            for (uint32_t q = m; q > 1; q >>= 1) {
+                const uint32_t p = q - 1;
+                for (size_t i = 0; i < Dim; ++i) {
+                    if (x[i] & q) {
+                        x[0] ^= p;
+                    }
+                    else {
+                        const uint32_t t = (x[0] ^ x[i]) & p;
+                        x[0] ^= t;
+                        x[i] ^= t;
+                    }
+                }
+            }
+            for (size_t i = 1; i < Dim; ++i) x[i] ^= x[i - 1];
+            uint32_t t = 0;
+            for (uint32_t q = m; q > 1; q >>= 1) {
+                if (x[Dim - 1] & q) t ^= q - 1;
+            }
+            for (size_t i = 0; i < Dim; ++i) x[i] ^= t;
+            return interleave<Dim>(x);
+        }
+
+        // Unsigned integer whose order matches the floating-point order; -0 and +0 map to the same key.
+        template<typename T>
+        uint64_t ordered_bits(T value) {
+            static_assert(std::is_floating_point<T>::value, "ordered_bits expects a floating-point type.");
+            using Bits = std::conditional_t<sizeof(T) == 8, uint64_t, uint32_t>;
+            static_assert(sizeof(Bits) == sizeof(T), "Unsupported floating-point width.");
+            const T normalized = value + T(0);
+            Bits bits;
+            std::memcpy(&bits, &normalized, sizeof(T));
+            constexpr Bits sign = Bits(1) << (sizeof(Bits) * 8 - 1);
+            const Bits mask = (bits & sign) ? Bits(~Bits(0)) : sign;
+            return static_cast<uint64_t>(bits ^ mask);
+        }
+
+    } // namespace detail
+
+    template<size_t Dim, typename T>
+    uint64_t morton_key(const Point<Dim, T>& p, const Box<Dim, T>& bounds) {
+        return detail::interleave<Dim>(detail::GridQuantizer<Dim, T>(bounds).cell(p));
+    }
+
+    template<size_t Dim, typename T>
+    uint64_t hilbert_key(const Point<Dim, T>& p, const Box<Dim, T>& bounds) {
+        using Quantizer = detail::GridQuantizer<Dim, T>;
+        return detail::hilbert_index<Dim>(Quantizer(bounds).cell(p), Quantizer::Bits);
+    }
+
+    // Bulk key computation. The per-point work is branch-free bit arithmetic over a flat loop,
+    // which the compiler can vectorize where the target has 64-bit integer lanes.
+    template<size_t Dim, typename T>
+    void morton_keys(const std::vector<Point<Dim, T>>& points, const Box<Dim, T>& bounds, std::vector<uint64_t>& keys) {
+        const detail::GridQuantizer<Dim, T> quantizer(bounds);
+        keys.resize(points.size());
+        for (size_t i = 0; i < points.size(); ++i) {
+            keys[i] = detail::interleave<Dim>(quantizer.cell(points[i]));
+        }
+    }
+
+    template<size_t Dim, typename T>
+    void hilbert_keys(const std::vector<Point<Dim, T>>& points, const Box<Dim, T>& bounds, std::vector<uint64_t>& keys) {
+        using Quantizer = detail::GridQuantizer<Dim, T>;
+        const Quantizer quantizer(bounds);
+        keys.resize(points.size());
+        for (size_t i = 0; i < points.size(); ++i) {
+            keys[i] = detail::hilbert_index<Dim>(quantizer.cell(points[i]), Quantizer::Bits);
+        }
+    }
+
+    // Stable LSD radix sort of keys, 8 bits per pass, permuting values alongside. Passes whose
+    // digit is the same for every key are skipped, so small key ranges cost fewer passes.
+    template<typename Value>
+    void radix_sort(std::vector<uint64_t>& keys, std::vector<Value>& values) {
+        assert(keys.size() == values.size() && "Every key needs a value.");
+        constexpr size_t Passes = 8;
+        constexpr size_t Buckets = 256;
+        const size_t n = keys.size();
+
+        std::vector<std::array<size_t, Buckets>> histograms(Passes);
+        for (auto& h : histograms) h.fill(0);
+        for (size_t i = 0; i < n; ++i) {
+            const uint64_t key = keys[i];
+            for (size_t pass = 0; pass < Passes; ++pass) {
+                ++histograms[pass][(key >> (8 * pass)) & 0xFF];
+            }
+        }
+
+        std::vector<uint64_t> key_scratch(n);
+        std::vector<Value> value_scratch(n);
+        for (size_t pass = 0; pass < Passes; ++pass) {
+            std::array<size_t, Buckets>& h = histograms[pass];
+            if (n == 0 || h[(keys[0] >> (8 * pass)) & 0xFF] == n) {
+                continue;
+            }
+            size_t offset = 0;
+            for (size_t b = 0; b < Buckets; ++b) {
+                const size_t count = h[b];
+                h[b] = offset;
+                offset += count;
+            }
+            for (size_t i = 0; i < n; ++i) {
+                const size_t dst = h[(keys[i] >> (8 * pass)) & 0xFF]++;
+                key_scratch[dst] = keys[i];
+                value_scratch[dst] = std::move(values[i]);
+            }
+            keys.swap(key_scratch);
+            values.swap(value_scratch);
+        }
+    }
+
+    // Reorders items so that items[i] becomes old_items[order[i]].
+    template<typename Item>
+    void apply_permutation(std::vector<Item>& items, const std::vector<uint32_t>& order) {
+        assert(items.size() == order.size() && "Permutation size must match the item count.");
+        std::vector<Item> permuted;
+        permuted.reserve(items.size());
+        for (uint32_t index : order) permuted.push_back(std::move(items[index]));
+        items.swap(permuted);
+    }
+
+    // Permutation that visits the points along a space-filling curve, for reordering points or
+    // batch queries before a spatial step. The bounds default to the bounding box of the points.
+    template<size_t Dim, typename T>
+    std::vector<uint32_t> hilbert_order(const std::vector<Point<Dim, T>>& points, const Box<Dim, T>& bounds) {
+        std::vector<uint64_t> keys;
+        hilbert_keys(points, bounds, keys);
+        std::vector<uint32_t> order(points.size());
+        std::iota(order.begin(), order.end(), 0u);
+        radix_sort(keys, order);
+        return order;
+    }
+
+    template<size_t Dim, typename T>
+    std::vector<uint32_t> hilbert_order(const std::vector<Point<Dim, T>>& points) {
+        return hilbert_order(points, Box<Dim, T>::from_points(points));
+    }
+
+    template<size_t Dim, typename T>
+    std::vector<uint32_t> morton_order(const std::vector<Point<Dim, T>>& points, const Box<Dim, T>& bounds) {
+        std::vector<uint64_t> keys;
+        morton_keys(points, bounds, keys);
+        std::vector<uint32_t> order(points.size());
+        std::iota(order.begin(), order.end(), 0u);
+        radix_sort(keys, order);
+        return order;
+    }
+
+    template<size_t Dim, typename T>
+    std::vector<uint32_t> morton_order(const std::vector<Point<Dim, T>>& points) {
+        return morton_order(points, Box<Dim, T>::from_points(points));
+    }
+
+    // Batch queries at least this large are answered along the Hilbert curve.
+    constexpr size_t SpatialOrderMinBatch = 2048;
+
+    // Order in which a batch of queries at the given points is answered: along the Hilbert curve
+    // once the batch is large enough to repay the sort, so that consecutive queries walk the same
+    // parts of an index. Empty means input order.
+    template<size_t Dim, typename T>
+    std::vector<uint32_t> batch_query_order(const std::vector<Point<Dim, T>>& points) {
+        if (points.size() < SpatialOrderMinBatch || points.size() >= UINT32_MAX) {
+            return {};
+        }
+        return hilbert_order(points);
+    }
+
+    // Sorts by exact x, then exact y with two radix sorts on order-preserving integer keys, in
+    // place of comparison sorting with epsilon-aware Coord comparisons.
+    template<typename T>
+    void sort_lexicographic(std::vector<Point<2, T>>& points) {
+        std::vector<uint64_t> keys(points.size());
+        std::vector<uint32_t> order(points.size());
+        std::iota(order.begin(), order.end(), 0u);
+        for (size_t i = 0; i < points.size(); ++i) keys[i] = detail::ordered_bits(points[i][1].value);
+        radix_sort(keys, order);
+        for (size_t i = 0; i < points.size(); ++i) keys[i] = detail::ordered_bits(points[order[i]][0].value);
+        radix_sort(keys, order);
+        apply_permutation(points, order);
+    }
+
+    // convex_hull with the radix sort as its pre-pass. Sorts points in place.
+    template<typename T>
+    std::optional<Polygon<2, T>> convex_hull_radix(std::vector<Point<2, T>>& points) {
+        GEOM_COUNT(CONVEX_HULL_CALLS);
+        GEOM_TIME_SCOPE(CONVEX_HULL);
+        if (points.size() < 3) {
+            return std::nullopt;
+        }
+        sort_lexicographic(points);
+        return convex_hull_presorted(points);
+    }
+
+
+} // namespace geom
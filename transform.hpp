@@ -0,0 +1,314 @@
+﻿#pragma once
+
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <optional>
+#include <vector>
+#include "vector.hpp"
+#include "line.hpp"
+#include "ray.hpp"
+#include "segment.hpp"
+#include "algorithms.hpp"
+#include "polygon.hpp"
+#include "parallel.hpp"
+
+namespace geom {
+
+    // Factors of an affine map x -> rotation * shear * diag(scale) * x + translation.
+    // The rotation has determinant +1; a reflection shows up as a negative last scale factor.
+    // Matrices are row-major.
+    template<size_t Dim, typename T>
+    struct AffineDecomposition {
+        Vector<Dim, T> translation;
+        std::array<T, Dim * Dim> rotation;
+        std::array<T, Dim * Dim> shear;     // Unit upper triangular.
+        Vector<Dim, T> scale;
+
+        T angle() const {
+            static_assert(Dim == 2, "A single rotation angle is only defined in 2D.");
+            return std::atan2(rotation[2], rotation[0]);
+        }
+    };
+
+    // Affine transform x -> A * x + b with a row-major linear part A.
+    template<size_t Dim, typename T>
+    class Affine {
+    public:
+        using point_type = Point<Dim, T>;
+        using vector_type = Vector<Dim, T>;
+        using matrix_type = std::array<T, Dim * Dim>;
+
+        // Point arrays at least this long are transformed on several threads.
+        static constexpr size_t ParallelThreshold = 1 << 16;
+
+    private:
+        matrix_type m_linear;
+        std::array<T, Dim> m_translation;
+
+        Affine(const matrix_type& linear, const std::array<T, Dim>& translation)
+            : m_linear(linear), m_translation(translation) {
+        }
+
+    public:
+        Affine() : m_linear(identity_matrix()), m_translation{} {}
+
+        static Affine identity() { return Affine(); }
+
+        static Affine from_matrix(const matrix_type& linear, const vector_type& translation = vector_type()) {
+            std::array<T, Dim> b;
+            for (size_t i = 0; i < Dim; ++i) b[i] = translation[i].value;
+            return Affine(linear, b);
+        }
+
+        static Affine translation(const vector_type& offset) {
+            return from_matrix(identity_matrix(), offset);
+        }
+
+        static Affine scaling(const vector_type& factors) {
+            matrix_type m{};
+            for (size_t i = 0; i < Dim; ++i) m[i * Dim + i] = factors[i].value;
+            return from_matrix(m);
+        }
+
+        static Affine scaling(const T& factor) {
+            matrix_type m{};
+            for (size_t i = 0; i < Dim; ++i) m[i * Dim + i] = factor;
+            return from_matrix(m);
+        }
+
+        // Counter-clockwise rotation by an angle in radians.
+        static Affine rotation(const T& angle) {
+            static_assert(Dim == 2, "Rotation by an angle is only defined in 2D; pass an axis in 3D.");
+            const T c = std::cos(angle), s = std::sin(angle);
+            return from_matrix({ c, -s, s, c });
+        }
+
+        // Right-handed rotation about an axis through the origin (Rodrigues' formula).
+        static Affine rotation(const vector_type& axis, const T& angle) {
+            static_assert(Dim == 3, "Rotation about an axis is only defined in 3D.");
+            assert(axis.length_sq() > 0 && "Rotation axis cannot be zero.");
+            vector_type k = axis;
+            k.normalize();
+            const T x = k[0].value, y = k[1].value, z = k[2].value;
+            const T c = std::cos(angle), s = std::sin(angle), t = 1 - c;
+            return from_matrix({ t * x * x + c,     t * x * y - s * z, t * x * z + s * y,
+                                 t * x * y + s * z, t * y * y + c,     t * y * z - s * x,
+                                 t * x * z - s * y, t * y * z + s * x, t * z * z + c });
+        }
+
+        // Rotation about a point other than the origin.
+        static Affine rotation_about(const point_type& center, const T& angle) {
+            return translation(center) * rotation(angle) * translation(vector_type() - center);
+        }
+
+        const matrix_type& linear() const { return m_linear; }
+
+        vector_type translation_part() const {
+            vector_type result;
+            for (size_t i = 0; i < Dim; ++i) result[i].value = m_translation[i];
+            return result;
+        }
+
+        T determinant() const {
+            const matrix_type& m = m_linear;
+            if constexpr (Dim == 2) {
+                return m[0] * m[3] - m[1] * m[2];
+            }
+            else {
+                static_assert(Dim == 3, "Affine transforms are implemented for 2D and 3D.");
+                return m[0] * (m[4] * m[8] - m[5] * m[7])
+                     - m[1] * (m[3] * m[8] - m[5] * m[6])
+                     + m[2] * (m[3] * m[7] - m[4] * m[6]);
+            }
+        }
+
+        // True when the linear part is orthonormal, i.e. the map preserves lengths and angles.
+        bool is_rigid() const {
+            for (size_t i = 0; i < Dim; ++i) {
+                for (size_t j = 0; j < Dim; ++j) {
+                    T d = 0;
+                    for (size_t k = 0; k < Dim; ++k) d += m_linear[k * Dim + i] * m_linear[k * Dim + j];
+                    if (Coord<T>(d) != Coord<T>(i == j ? T(1) : T(0))) return false;
+                }
+            }
+            return true;
+        }
+
+        // Composition: (a * b).apply(p) == a.apply(b.apply(p)).
+        Affine operator*(const Affine& other) const {
+            matrix_type m{};
+            std::array<T, Dim> b = m_translation;
+            for (size_t i = 0; i < Dim; ++i) {
+                for (size_t j = 0; j < Dim; ++j) {
+                    for (size_t k = 0; k < Dim; ++k) m[i * Dim + j] += m_linear[i * Dim + k] * other.m_linear[k * Dim + j];
+                    b[i] += m_linear[i * Dim + j] * other.m_translation[j];
+                }
+            }
+            return Affine(m, b);
+        }
+
+        Affine& operator*=(const Affine& other) {
+            return *this = *this * other;
+        }
+
+        std::optional<Affine> inverse() const {
+            const T det = determinant();
+            if (std::abs(det) < Coord<T>::Epsilon) {
+                return std::nullopt;
+            }
+            const matrix_type& m = m_linear;
+            matrix_type inv;
+            if constexpr (Dim == 2) {
+                inv = { m[3] / det, -m[1] / det, -m[2] / det, m[0] / det };
+            }
+            else {
+                inv = { (m[4] * m[8] - m[5] * m[7]) / det, (m[2] * m[7] - m[1] * m[8]) / det, (m[1] * m[5] - m[2] * m[4]) / det,
+                        (m[5] * m[6] - m[3] * m[8]) / det, (m[0] * m[8] - m[2] * m[6]) / det, (m[2] * m[3] - m[0] * m[5]) / det,
+                        (m[3] * m[7] - m[4] * m[6]) / det, (m[1] * m[6] - m[0] * m[7]) / det, (m[0] * m[4] - m[1] * m[3]) / det };
+            }
+            std::array<T, Dim> b{};
+            for (size_t i = 0; i < Dim; ++i) {
+                for (size_t j = 0; j < Dim; ++j) b[i] -= inv[i * Dim + j] * m_translation[j];
+            }
+            return Affine(inv, b);
+        }
+
+        // Gram-Schmidt (QR) factorization of the linear part. Asserts the transform is invertible.
+        AffineDecomposition<Dim, T> decompose() const {
+            assert(std::abs(determinant()) >= Coord<T>::Epsilon && "Cannot decompose a singular transform.");
+            AffineDecomposition<Dim, T> result;
+            result.translation = translation_part();
+
+            // Columns of the linear part are orthonormalized into q; r holds the projections.
+            matrix_type q{}, r{};
+            for (size_t j = 0; j < Dim; ++j) {
+                std::array<T, Dim> v;
+                for (size_t i = 0; i < Dim; ++i) v[i] = m_linear[i * Dim + j];
+                for (size_t k = 0; k < j; ++k) {
+                    T d = 0;
+                    for (size_t i = 0; i < Dim; ++i) d += q[i * Dim + k] * m_linear[i * Dim + j];
+                    r[k * Dim + j] = d;
+                    for (size_t i = 0; i < Dim; ++i) v[i] -= d * q[i * Dim + k];
+                }
+                T len = 0;
+                for (size_t i = 0; i < Dim; ++i) len += v[i] * v[i];
+                len = std::sqrt(len);
+                r[j * Dim + j] = len;
+                for (size_t i = 0; i < Dim; ++i) q[i * Dim + j] = v[i] / len;
+            }
+
+            // Fold a reflection into the last column so the rotation is proper.
+            if (determinant() < 0) {
+                for (size_t i = 0; i < Dim; ++i) q[i * Dim + Dim - 1] = -q[i * Dim + Dim - 1];
+                for (size_t j = 0; j < Dim; ++j) r[(Dim - 1) * Dim + j] = -r[(Dim - 1) * Dim + j];
+            }
+
+            result.rotation = q;
+            result.shear = matrix_type{};
+            for (size_t i = 0; i < Dim; ++i) {
+                result.scale[i].value = r[i * Dim + i];
+                for (size_t j = i; j < Dim; ++j) result.shear[i * Dim + j] = r[i * Dim + j] / r[j * Dim + j];
+            }
+            return result;
+        }
+
+        point_type apply(const point_type& p) const {
+            point_type result;
+            for (size_t i = 0; i < Dim; ++i) {
+                T v = m_translation[i];
+                for (size_t j = 0; j < Dim; ++j) v += m_linear[i * Dim + j] * p[j].value;
+                result[i].value = v;
+            }
+            return result;
+        }
+
+        // Applies only the linear part, as for directions and displacements.
+        vector_type apply_vector(const vector_type& v) const {
+            vector_type result;
+            for (size_t i = 0; i < Dim; ++i) {
+                T sum = 0;
+                for (size_t j = 0; j < Dim; ++j) sum += m_linear[i * Dim + j] * v[j].value;
+                result[i].value = sum;
+            }
+            return result;
+        }
+
+        Segment<Dim, T> apply(const Segment<Dim, T>& segment) const {
+            return Segment<Dim, T>(apply(segment.p1()), apply(segment.p2()));
+        }
+
+        Ray<Dim, T> apply(const Ray<Dim, T>& ray) const {
+            return Ray<Dim, T>::from_point_direction(apply(ray.origin()), apply_vector(ray.direction()));
+        }
+
+        Line<Dim, T> apply(const Line<Dim, T>& line) const {
+            return Line<Dim, T>::from_point_direction(apply(line.origin()), apply_vector(line.direction()));
+        }
+
+        // The result keeps the polygon's allocator.
+        template<typename Allocator>
+        Polygon<Dim, T, Allocator> apply(const Polygon<Dim, T, Allocator>& polygon) const {
+            typename Polygon<Dim, T, Allocator>::container_type vertices(polygon.vertices(), polygon.get_allocator());
+            apply_in_place(vertices.data(), vertices.size());
+            return Polygon<Dim, T, Allocator>(std::move(vertices));
+        }
+
+        // Bulk transform. The coefficients are hoisted into locals and the loop body is straight-line
+        // code over the interleaved coordinates, which the compiler vectorizes at -O3.
+        void apply_in_place(point_type* points, size_t count, size_t num_threads = 0) const {
+            if (count >= ParallelThreshold) {
+                parallel_for(count, [&](size_t begin, size_t end) {
+                    transform_range(points, begin, end);
+                }, num_threads, ParallelThreshold / 4);
+            }
+            else {
+                transform_range(points, 0, count);
+            }
+        }
+
+        void apply_in_place(std::vector<point_type>& points, size_t num_threads = 0) const {
+            apply_in_place(points.data(), points.size(), num_threads);
+        }
+
+    private:
+        static matrix_type identity_matrix() {
+            matrix_type m{};
+            for (size_t i = 0; i < Dim; ++i) m[i * Dim + i] = T(1);
+            return m;
+        }
+
+        void transform_range(point_type* points, size_t begin, size_t end) const {
+            if constexpr (Dim == 2) {
+                const T a = m_linear[0], b = m_linear[1], c = m_linear[2], d = m_linear[3];
+                const T tx = m_translation[0], ty = m_translation[1];
+                for (size_t i = begin; i < end; ++i) {
+                    const T x = points[i][0].value, y = points[i][1].value;
+                    points[i][0].value = a * x + b * y + tx;
+                    points[i][1].value = c * x + d * y + ty;
+                }
+            }
+            else {
+                const matrix_type m = m_linear;
+                const T tx = m_translation[0], ty = m_translation[1], tz = m_translation[2];
+                for (size_t i = begin; i < end; ++i) {
+                    const T x = points[i][0].value, y = points[i][1].value, z = points[i][2].value;
+                    points[i][0].value = m[0] * x + m[1] * y + m[2] * z + tx;
+                    points[i][1].value = m[3] * x + m[4] * y + m[5] * z + ty;
+                    points[i][2].value = m[6] * x + m[7] * y + m[8] * z + tz;
+                }
+            }
+        }
+    };
+
+    template<typename T> using Affine2 = Affine<2, T>;
+    template<typename T> using Affine3 = Affine<3, T>;
+
+    using Affine2d = Affine2<double>;
+    using Affine3d = Affine3<double>;
+
+    using Affine2f = Affine2<float>;
+    using Affine3f = Affine3<float>;
+
+
+} // namespace geom
@@ -0,0 +1,506 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "vector.hpp"
+#include "box.hpp"
+#include "segment.hpp"
+#include "algorithms.hpp"
+#include "polygon.hpp"
+#include "dcel.hpp"
+#include "parallel.hpp"
+#include "snapshot.hpp"
+#include "spatial_sort.hpp"
+
+namespace geom {
+
+    // Point location by a randomized incremental trapezoidal map (de Berg et al., Computational
+    // Geometry, chapter 6). The input edges must not cross, but may share endpoints. Each edge
+    // carries the faces above and below it; a query walks the search DAG (expected O(log n) depth)
+    // to a trapezoid and reports the face below the trapezoid's top edge.
+    //
+    // Points are compared lexicographically by (x, y), which acts as a symbolic shear, so vertical
+    // edges and endpoints with equal x need no special handling. All records are index-based.
+    template<typename T>
+    class TrapezoidalMap {
+    public:
+        using point_type = Point<2, T>;
+
+        static constexpr uint32_t Invalid = std::numeric_limits<uint32_t>::max();
+
+        struct Edge {
+            point_type p;       // Lexicographically smaller endpoint.
+            point_type q;
+            uint32_t above;     // Face above the edge, Invalid for none.
+            uint32_t below;
+        };
+
+    private:
+        // Records are written to snapshots byte for byte, so none of them has implicit padding.
+        struct Trapezoid {
+            uint32_t top, bottom;
+            point_type leftp, rightp;
+            uint32_t upper_left, lower_left, upper_right, lower_right;
+            uint32_t node;
+            uint32_t padding = 0;
+        };
+
+        enum class NodeType : uint32_t { X, Y, LEAF };
+
+        struct Node {
+            NodeType type;
+            uint32_t index;     // Edge of a Y-node, trapezoid of a leaf.
+            point_type point;   // Point of an X-node.
+            uint32_t left;      // X: left child, Y: child above the edge.
+            uint32_t right;     // X: right child, Y: child below the edge.
+        };
+
+        static_assert(sizeof(Edge) == 2 * sizeof(point_type) + 2 * sizeof(uint32_t), "Edge must not have padding.");
+        static_assert(sizeof(Trapezoid) == 2 * sizeof(point_type) + 8 * sizeof(uint32_t), "Trapezoid must not have padding.");
+        static_assert(sizeof(Node) == sizeof(point_type) + 4 * sizeof(uint32_t), "Node must not have padding.");
+
+        std::vector<Edge> m_edges;
+        std::vector<Trapezoid> m_trapezoids;
+        std::vector<Node> m_nodes;
+        Box<2, T> m_bounds;
+        size_t m_depth = 0;
+
+        static constexpr uint32_t SnapshotVersion = 2;
+
+        template<typename U>
+        friend class TrapezoidalMapView;
+
+        TrapezoidalMap() = default;
+
+    public:
+        // Face i is the interior of polygons[i]. Edges shared by two polygons are merged; edges
+        // that overlap only partially must be noded first (see from_dcel).
+        static TrapezoidalMap from_polygons(const std::vector<Polygon<2, T>>& polygons, uint64_t seed = 0x5EED) {
+            std::vector<Edge> edges;
+            for (uint32_t f = 0; f < polygons.size(); ++f) {
+                const auto& v = polygons[f].vertices();
+                T signed_area = 0;
+                for (size_t i = 0, j = v.size() - 1; i < v.size(); j = i++) signed_area += cross_product(v[j], v[i]);
+                for (size_t i = 0, j = v.size() - 1; i < v.size(); j = i++) {
+                    // The interior is left of a counter-clockwise edge.
+                    add_directed_edge(edges, v[j], v[i], signed_area > 0 ? f : Invalid, signed_area > 0 ? Invalid : f);
+                }
+            }
+            return build(merge_shared_edges(edges), seed);
+        }
+
+        // Faces are the DCEL face indices; the unbounded face 0 is reported as no face.
+        static TrapezoidalMap from_dcel(const Dcel<T>& dcel, uint64_t seed = 0x5EED) {
+            std::vector<Edge> edges;
+            edges.reserve(dcel.num_edges());
+            const auto& half_edges = dcel.half_edges();
+            for (uint32_t h = 0; h < half_edges.size(); h += 2) {
+                const uint32_t left = half_edges[h].face, right = half_edges[h + 1].face;
+                add_directed_edge(edges, dcel.vertices()[half_edges[h].origin].point, dcel.vertices()[dcel.target(h)].point,
+                                  left == 0 ? Invalid : left, right == 0 ? Invalid : right);
+            }
+            return build(edges, seed);
+        }
+
+        size_t num_edges() const { return m_edges.size() - 2; }
+        size_t num_trapezoids() const { return m_trapezoids.size(); }
+        size_t num_nodes() const { return m_nodes.size(); }
+
+        // Longest root-to-leaf path of the search structure, measured at the end of the build.
+        size_t depth() const { return m_depth; }
+
+        std::optional<uint32_t> locate(const point_type& p) const {
+            return layout().locate(p);
+        }
+
+        // faces[i] is the face containing points[i], or Invalid. Large batches are answered in
+        // Hilbert order (see batch_query_order).
+        void locate(const std::vector<point_type>& points, std::vector<uint32_t>& faces, size_t num_threads = 0) const {
+            faces.resize(points.size());
+            const std::vector<uint32_t> order = batch_query_order(points);
+            parallel_for(points.size(), [&](size_t begin, size_t end) {
+                for (size_t k = begin; k < end; ++k) {
+                    const size_t i = order.empty() ? k : order[k];
+                    const auto face = locate(points[i]);
+                    faces[i] = face ? *face : Invalid;
+                }
+            }, num_threads);
+        }
+
+        // Writes the map as a snapshot that TrapezoidalMapView::open maps back without rebuilding.
+        bool save(const std::string& path) const {
+            SnapshotWriter writer(SnapshotKind::TRAPEZOIDAL_MAP, SnapshotVersion, sizeof(T));
+            const T bounds[4] = { m_bounds.min()[0].value, m_bounds.min()[1].value, m_bounds.max()[0].value, m_bounds.max()[1].value };
+            writer.add_section(bounds, 4);
+            writer.add_section(m_edges);
+            writer.add_section(m_trapezoids);
+            writer.add_section(m_nodes);
+            return writer.write(path);
+        }
+
+    private:
+        // The query half of the map over raw arrays, shared with TrapezoidalMapView.
+        struct Layout {
+            const Node* nodes;
+            const Edge* edges;
+            const Trapezoid* trapezoids;
+            Box<2, T> bounds;
+
+            std::optional<uint32_t> locate(const point_type& p) const {
+                if (!bounds.contains(p)) {
+                    return std::nullopt;
+                }
+                const uint32_t face = edges[trapezoids[find(nodes, edges, p, nullptr)].top].below;
+                if (face == Invalid) {
+                    return std::nullopt;
+                }
+                return face;
+            }
+
+            // Checks every index a query can follow and that the search structure has no cycle,
+            // so that a snapshot opened without its checksum cannot send locate astray.
+            bool valid(size_t num_nodes, size_t num_edges, size_t num_trapezoids) const {
+                std::vector<uint32_t> parents(num_nodes, 0);
+                for (size_t n = 0; n < num_nodes; ++n) {
+                    const Node& node = nodes[n];
+                    if (node.type == NodeType::LEAF) {
+                        if (node.index >= num_trapezoids) return false;
+                        continue;
+                    }
+                    if (node.type != NodeType::X && node.type != NodeType::Y) return false;
+                    if (node.type == NodeType::Y && node.index >= num_edges) return false;
+                    if (node.left >= num_nodes || node.right >= num_nodes) return false;
+                    ++parents[node.left];
+                    ++parents[node.right];
+                }
+                // Kahn's algorithm: every node is removed only if the graph is acyclic.
+                std::vector<uint32_t> ready;
+                for (uint32_t n = 0; n < num_nodes; ++n) {
+                    if (parents[n] == 0) ready.push_back(n);
+                }
+                size_t removed = 0;
+                while (!ready.empty()) {
+                    const Node& node = nodes[ready.back()];
+                    ready.pop_back();
+                    ++removed;
+                    if (node.type == NodeType::LEAF) continue;
+                    if (--parents[node.left] == 0) ready.push_back(node.left);
+                    if (--parents[node.right] == 0) ready.push_back(node.right);
+                }
+                return removed == num_nodes &&
+                       std::all_of(trapezoids, trapezoids + num_trapezoids, [&](const Trapezoid& t) { return t.top < num_edges; });
+            }
+        };
+
+        Layout layout() const {
+            return { m_nodes.data(), m_edges.data(), m_trapezoids.data(), m_bounds };
+        }
+
+        static bool lex_less(const point_type& a, const point_type& b) {
+            return a[0].value < b[0].value || (a[0].value == b[0].value && a[1].value < b[1].value);
+        }
+
+        static bool same_point(const point_type& a, const point_type& b) {
+            return a[0].value == b[0].value && a[1].value == b[1].value;
+        }
+
+        // Positive when c lies left of (above) the directed line a -> b.
+        static T orientation(const point_type& a, const point_type& b, const point_type& c) {
+            return (b[0].value - a[0].value) * (c[1].value - a[1].value) - (b[1].value - a[1].value) * (c[0].value - a[0].value);
+        }
+
+        static void add_directed_edge(std::vector<Edge>& edges, const point_type& from, const point_type& to, uint32_t left_face, uint32_t right_face) {
+            if (same_point(from, to)) return;
+            if (lex_less(from, to)) edges.push_back({ from, to, left_face, right_face });
+            else edges.push_back({ to, from, right_face, left_face });
+        }
+
+        static std::vector<Edge> merge_shared_edges(std::vector<Edge> edges) {
+            auto key = [](const Edge& e) { return std::make_tuple(e.p[0].value, e.p[1].value, e.q[0].value, e.q[1].value); };
+            std::sort(edges.begin(), edges.end(), [&](const Edge& a, const Edge& b) { return key(a) < key(b); });
+            size_t unique = 0;
+            for (size_t i = 0; i < edges.size(); ++i) {
+                if (unique > 0 && key(edges[unique - 1]) == key(edges[i])) {
+                    Edge& merged = edges[unique - 1];
+                    if (merged.above == Invalid) merged.above = edges[i].above;
+                    if (merged.below == Invalid) merged.below = edges[i].below;
+                }
+                else {
+                    edges[unique++] = edges[i];
+                }
+            }
+            edges.resize(unique);
+            return edges;
+        }
+
+        static TrapezoidalMap build(const std::vector<Edge>& edges, uint64_t seed) {
+            TrapezoidalMap map;
+            Box<2, T> bounds;
+            for (const Edge& e : edges) {
+                bounds.expand(e.p);
+                bounds.expand(e.q);
+            }
+            if (bounds.is_empty()) {
+                bounds = Box<2, T>(point_type(0, 0), point_type(0, 0));
+            }
+            map.m_bounds = bounds;
+
+            // The frame edges bound the initial trapezoid; they sit strictly outside every input edge.
+            const T margin = std::max(T(1), std::max(bounds.extent()[0].value, bounds.extent()[1].value));
+            const T x0 = bounds.min()[0].value - margin, x1 = bounds.max()[0].value + margin;
+            const T y0 = bounds.min()[1].value - margin, y1 = bounds.max()[1].value + margin;
+            map.m_edges.push_back({ point_type(x0, y1), point_type(x1, y1), Invalid, Invalid });
+            map.m_edges.push_back({ point_type(x0, y0), point_type(x1, y0), Invalid, Invalid });
+            map.m_edges.insert(map.m_edges.end(), edges.begin(), edges.end());
+
+            map.m_trapezoids.reserve(3 * edges.size() + 1);
+            map.m_nodes.reserve(8 * edges.size() + 1);
+            map.new_trapezoid(0, 1, point_type(x0, y0), point_type(x1, y0));
+
+            std::vector<uint32_t> order(edges.size());
+            for (uint32_t i = 0; i < order.size(); ++i) order[i] = i + 2;
+            std::mt19937_64 rng(seed);
+            std::shuffle(order.begin(), order.end(), rng);
+            for (uint32_t e : order) {
+                map.insert(e);
+            }
+            map.m_depth = map.measure_depth();
+            return map;
+        }
+
+        uint32_t new_trapezoid(uint32_t top, uint32_t bottom, const point_type& leftp, const point_type& rightp) {
+            const uint32_t t = static_cast<uint32_t>(m_trapezoids.size());
+            const uint32_t leaf = static_cast<uint32_t>(m_nodes.size());
+            m_nodes.push_back({ NodeType::LEAF, t, point_type(), Invalid, Invalid });
+            m_trapezoids.push_back({ top, bottom, leftp, rightp, Invalid, Invalid, Invalid, Invalid, leaf });
+            return t;
+        }
+
+        uint32_t new_node(NodeType type, uint32_t index, const point_type& point, uint32_t left, uint32_t right) {
+            m_nodes.push_back({ type, index, point, left, right });
+            return static_cast<uint32_t>(m_nodes.size() - 1);
+        }
+
+        // Descends the DAG. While inserting, inserting is the new edge: a query point equal to an
+        // X-node point goes right, and one lying on a Y-node edge is placed by the new edge's slope.
+        static uint32_t find(const Node* nodes, const Edge* edges, const point_type& p, const Edge* inserting) {
+            uint32_t n = 0;
+            while (nodes[n].type != NodeType::LEAF) {
+                const Node& node = nodes[n];
+                if (node.type == NodeType::X) {
+                    n = lex_less(p, node.point) ? node.left : node.right;
+                }
+                else {
+                    const Edge& e = edges[node.index];
+                    T side = orientation(e.p, e.q, p);
+                    if (side == 0 && inserting != nullptr) {
+                        side = orientation(e.p, e.q, inserting->q);
+                    }
+                    n = side >= 0 ? node.left : node.right;
+                }
+            }
+            return nodes[n].index;
+        }
+
+        // Makes every trapezoid that referred to old_t as a neighbour refer to new_t instead.
+        void redirect_left_of(uint32_t neighbour, uint32_t old_t, uint32_t new_t) {
+            if (neighbour == Invalid) return;
+            Trapezoid& t = m_trapezoids[neighbour];
+            if (t.upper_right == old_t) t.upper_right = new_t;
+            if (t.lower_right == old_t) t.lower_right = new_t;
+        }
+
+        void redirect_right_of(uint32_t neighbour, uint32_t old_t, uint32_t new_t) {
+            if (neighbour == Invalid) return;
+            Trapezoid& t = m_trapezoids[neighbour];
+            if (t.upper_left == old_t) t.upper_left = new_t;
+            if (t.lower_left == old_t) t.lower_left = new_t;
+        }
+
+        void insert(uint32_t s) {
+            const Edge edge = m_edges[s];
+            const point_type& p = edge.p;
+            const point_type& q = edge.q;
+
+            // Trapezoids crossed by the edge, left to right.
+            std::vector<uint32_t> crossed{ find(m_nodes.data(), m_edges.data(), p, &edge) };
+            while (lex_less(m_trapezoids[crossed.back()].rightp, q)) {
+                const Trapezoid& t = m_trapezoids[crossed.back()];
+                crossed.push_back(orientation(p, q, t.rightp) > 0 ? t.lower_right : t.upper_right);
+                assert(crossed.back() != Invalid && "Trapezoidal map edges must not cross.");
+            }
+
+            const Trapezoid first = m_trapezoids[crossed.front()];
+            const Trapezoid last = m_trapezoids[crossed.back()];
+
+            uint32_t left_piece = Invalid;
+            if (!same_point(p, first.leftp)) {
+                left_piece = new_trapezoid(first.top, first.bottom, first.leftp, p);
+                Trapezoid& a = m_trapezoids[left_piece];
+                a.upper_left = first.upper_left;
+                a.lower_left = first.lower_left;
+                redirect_left_of(first.upper_left, crossed.front(), left_piece);
+                redirect_left_of(first.lower_left, crossed.front(), left_piece);
+            }
+
+            uint32_t upper = new_trapezoid(first.top, s, p, q);
+            uint32_t lower = new_trapezoid(s, first.bottom, p, q);
+            if (left_piece != Invalid) {
+                m_trapezoids[left_piece].upper_right = upper;
+                m_trapezoids[left_piece].lower_right = lower;
+                m_trapezoids[upper].upper_left = left_piece;
+                m_trapezoids[lower].lower_left = left_piece;
+            }
+            else {
+                m_trapezoids[upper].upper_left = first.upper_left;
+                m_trapezoids[lower].lower_left = first.lower_left;
+                redirect_left_of(first.upper_left, crossed.front(), upper);
+                redirect_left_of(first.lower_left, crossed.front(), lower);
+            }
+
+            std::vector<std::pair<uint32_t, uint32_t>> pieces{ { upper, lower } };
+            for (size_t j = 1; j < crossed.size(); ++j) {
+                const Trapezoid prev = m_trapezoids[crossed[j - 1]];
+                const Trapezoid cur = m_trapezoids[crossed[j]];
+                const point_type& r = prev.rightp;
+                if (orientation(p, q, r) > 0) {
+                    // The vertical wall through r now stops at the new edge: the upper pieces split.
+                    m_trapezoids[upper].rightp = r;
+                    m_trapezoids[upper].upper_right = prev.upper_right;
+                    redirect_right_of(prev.upper_right, crossed[j - 1], upper);
+                    const uint32_t next = new_trapezoid(cur.top, s, r, q);
+                    m_trapezoids[upper].lower_right = next;
+                    m_trapezoids[next].lower_left = upper;
+                    m_trapezoids[next].upper_left = cur.upper_left;
+                    redirect_left_of(cur.upper_left, crossed[j], next);
+                    upper = next;
+                }
+                else {
+                    m_trapezoids[lower].rightp = r;
+                    m_trapezoids[lower].lower_right = prev.lower_right;
+                    redirect_right_of(prev.lower_right, crossed[j - 1], lower);
+                    const uint32_t next = new_trapezoid(s, cur.bottom, r, q);
+                    m_trapezoids[lower].upper_right = next;
+                    m_trapezoids[next].upper_left = lower;
+                    m_trapezoids[next].lower_left = cur.lower_left;
+                    redirect_left_of(cur.lower_left, crossed[j], next);
+                    lower = next;
+                }
+                pieces.push_back({ upper, lower });
+            }
+
+            uint32_t right_piece = Invalid;
+            if (!same_point(q, last.rightp)) {
+                right_piece = new_trapezoid(last.top, last.bottom, q, last.rightp);
+                Trapezoid& b = m_trapezoids[right_piece];
+                b.upper_left = upper;
+                b.lower_left = lower;
+                b.upper_right = last.upper_right;
+                b.lower_right = last.lower_right;
+                redirect_right_of(last.upper_right, crossed.back(), right_piece);
+                redirect_right_of(last.lower_right, crossed.back(), right_piece);
+                m_trapezoids[upper].upper_right = right_piece;
+                m_trapezoids[lower].lower_right = right_piece;
+            }
+            else {
+                m_trapezoids[upper].upper_right = last.upper_right;
+                m_trapezoids[lower].lower_right = last.lower_right;
+                redirect_right_of(last.upper_right, crossed.back(), upper);
+                redirect_right_of(last.lower_right, crossed.back(), lower);
+            }
+
+            // Each crossed leaf becomes a small subtree; rewriting the node in place keeps every
+            // parent pointer valid.
+            for (size_t j = 0; j < crossed.size(); ++j) {
+                const uint32_t leaf = m_trapezoids[crossed[j]].node;
+                uint32_t y = new_node(NodeType::Y, s, point_type(), m_trapezoids[pieces[j].first].node, m_trapezoids[pieces[j].second].node);
+                if (j + 1 == crossed.size() && right_piece != Invalid) {
+                    y = new_node(NodeType::X, 0, q, y, m_trapezoids[right_piece].node);
+                }
+                if (j == 0 && left_piece != Invalid) {
+                    y = new_node(NodeType::X, 0, p, m_trapezoids[left_piece].node, y);
+                }
+                m_nodes[leaf] = m_nodes[y];
+                m_nodes.pop_back();
+            }
+        }
+
+        size_t measure_depth() const {
+            std::vector<uint32_t> height(m_nodes.size(), Invalid);
+            return height_of(0, height);
+        }
+
+        // Nodes are shared between parents, so heights are memoized.
+        uint32_t height_of(uint32_t n, std::vector<uint32_t>& height) const {
+            if (height[n] == Invalid) {
+                const Node& node = m_nodes[n];
+                height[n] = node.type == NodeType::LEAF ? 0 : 1 + std::max(height_of(node.left, height), height_of(node.right, height));
+            }
+            return height[n];
+        }
+    };
+
+    using TrapezoidalMap2d = TrapezoidalMap<double>;
+
+    // A TrapezoidalMap queried straight from a memory-mapped snapshot.
+    template<typename T>
+    class TrapezoidalMapView {
+    public:
+        using point_type = Point<2, T>;
+
+    private:
+        using Map = TrapezoidalMap<T>;
+        using Layout = typename Map::Layout;
+
+        Snapshot m_snapshot;
+        Layout m_layout;
+
+        TrapezoidalMapView(Snapshot&& snapshot, const Layout& layout) : m_snapshot(std::move(snapshot)), m_layout(layout) {}
+
+    public:
+        // Returns nullopt for a missing, stale or corrupt snapshot.
+        static std::optional<TrapezoidalMapView> open(const std::string& path, bool verify_checksum = true) {
+            auto snapshot = Snapshot::open(path, SnapshotKind::TRAPEZOIDAL_MAP, Map::SnapshotVersion, sizeof(T), verify_checksum);
+            if (!snapshot || snapshot->num_sections() != 4) {
+                return std::nullopt;
+            }
+            size_t num_bounds, num_edges, num_trapezoids, num_nodes;
+            const T* b = snapshot->template section<T>(0, num_bounds);
+            Layout layout{};
+            layout.edges = snapshot->template section<typename Map::Edge>(1, num_edges);
+            layout.trapezoids = snapshot->template section<typename Map::Trapezoid>(2, num_trapezoids);
+            layout.nodes = snapshot->template section<typename Map::Node>(3, num_nodes);
+            if (num_bounds != 4 || num_edges < 2 || num_trapezoids == 0 || num_nodes == 0 ||
+                !layout.valid(num_nodes, num_edges, num_trapezoids)) {
+                return std::nullopt;
+            }
+            layout.bounds = Box<2, T>(point_type(b[0], b[1]), point_type(b[2], b[3]));
+            return TrapezoidalMapView(std::move(*snapshot), layout);
+        }
+
+        std::optional<uint32_t> locate(const point_type& p) const {
+            return m_layout.locate(p);
+        }
+
+        void locate(const std::vector<point_type>& points, std::vector<uint32_t>& faces, size_t num_threads = 0) const {
+            faces.resize(points.size());
+            const std::vector<uint32_t> order = batch_query_order(points);
+            parallel_for(points.size(), [&](size_t begin, size_t end) {
+                for (size_t k = begin; k < end; ++k) {
+                    const size_t i = order.empty() ? k : order[k];
+                    const auto face = m_layout.locate(points[i]);
+                    faces[i] = face ? *face : Map::Invalid;
+                }
+            }, num_threads);
+        }
+    };
+
+
+} // namespace geom
@@ -5,14 +5,58 @@
 #include <iostream>
 #include <numeric> 
 #include <cassert>
+#include <type_traits>
+#include <utility>
 #include "coord.hpp" 
 
 namespace geom {
 
+    // Base of all lazy vector expressions. Arithmetic on vectors builds a tree of expression nodes
+    // that is evaluated component by component, in a single loop, when assigned to a Vector.
+    template<typename E>
+    class VectorExpression {
+    public:
+        const E& self() const { return static_cast<const E&>(*this); }
+
+        auto length_sq() const {
+            typename E::value_type result = 0;
+            for (size_t i = 0; i < E::dimension; ++i) {
+                const auto c = self().eval(i);
+                result += c * c;
+            }
+            return result;
+        }
+
+        auto length() const {
+            return std::sqrt(length_sq());
+        }
+
+        // Read-only access as on a Vector; each call evaluates the expression.
+        auto operator[](size_t index) const {
+            return Coord<typename E::value_type>(self().eval(index));
+        }
+
+        template<typename E2>
+        bool operator==(const VectorExpression<E2>& other) const {
+            static_assert(E::dimension == E2::dimension, "Vector dimensions must match.");
+            for (size_t i = 0; i < E::dimension; ++i) {
+                if ((*this)[i] != other[i]) return false;
+            }
+            return true;
+        }
+
+        template<typename E2>
+        bool operator!=(const VectorExpression<E2>& other) const {
+            return !(*this == other);
+        }
+    };
+
     template<size_t Dim, typename T>
-    class Vector {
+    class Vector : public VectorExpression<Vector<Dim, T>> {
     public:
         using coord_type = Coord<T>;
+        using value_type = T;
+        static constexpr size_t dimension = Dim;
 
     private:
         std::array<coord_type, Dim> m_coords; 
@@ -23,11 +67,22 @@ namespace geom {
         }
 
    
-        template<typename... Args>
+        template<typename... Args, typename = std::enable_if_t<(std::is_convertible<Args, T>::value && ...)>>
         explicit Vector(Args... args) : m_coords{ coord_type(args)... } {
             static_assert(sizeof...(args) == Dim, "Incorrect number of arguments for Vector constructor.");
         }
 
+        template<typename E>
+        Vector(const VectorExpression<E>& expr) {
+            assign(expr.self());
+        }
+
+        template<typename E>
+        Vector& operator=(const VectorExpression<E>& expr) {
+            assign(expr.self());
+            return *this;
+        }
+
         Vector(const std::initializer_list<T>& list) {
             assert(list.size() == Dim && "Incorrect number of arguments for initializer_list constructor.");
             size_t i = 0;
@@ -39,24 +94,30 @@ namespace geom {
         coord_type& operator[](size_t index) { return m_coords[index]; }
         const coord_type& operator[](size_t index) const { return m_coords[index]; }
 
+        T eval(size_t index) const { return m_coords[index].value; }
+
         bool operator==(const Vector& other) const { return m_coords == other.m_coords; }
         bool operator!=(const Vector& other) const { return !(*this == other); }
 
-        Vector& operator+=(const Vector& other) {
-            for (size_t i = 0; i < Dim; ++i) { m_coords[i] += other.m_coords[i]; }
+        template<typename E>
+        Vector& operator+=(const VectorExpression<E>& other) {
+            static_assert(E::dimension == Dim, "Vector dimensions must match.");
+            for (size_t i = 0; i < Dim; ++i) { m_coords[i].value += other.self().eval(i); }
             return *this;
         }
-        Vector& operator-=(const Vector& other) {
-            for (size_t i = 0; i < Dim; ++i) { m_coords[i] -= other.m_coords[i]; }
+        template<typename E>
+        Vector& operator-=(const VectorExpression<E>& other) {
+            static_assert(E::dimension == Dim, "Vector dimensions must match.");
+            for (size_t i = 0; i < Dim; ++i) { m_coords[i].value -= other.self().eval(i); }
             return *this;
         }
 
         Vector& operator*=(const T& scalar) {
-            for (size_t i = 0; i < Dim; ++i) { m_coords[i] *= scalar; }
+            for (size_t i = 0; i < Dim; ++i) { m_coords[i].value *= scalar; }
             return *this;
         }
         Vector& operator/=(const T& scalar) {
-            for (size_t i = 0; i < Dim; ++i) { m_coords[i] /= scalar; }
+            for (size_t i = 0; i < Dim; ++i) { m_coords[i].value /= scalar; }
             return *this;
         }
 
@@ -78,36 +139,168 @@ namespace geom {
                 *this /= len;
             }
         }
+
+    private:
+        template<typename E>
+        void assign(const E& expr) {
+            static_assert(E::dimension == Dim, "Vector dimensions must match.");
+            // All expression nodes are component-wise, so writing in place is safe even when
+            // the expression references this vector.
+            for (size_t i = 0; i < Dim; ++i) { m_coords[i].value = expr.eval(i); }
+        }
+    };
+
+    namespace detail {
+
+        template<typename E>
+        struct is_vector : std::false_type {};
+
+        template<size_t Dim, typename T>
+        struct is_vector<Vector<Dim, T>> : std::true_type {};
+
+        template<typename E>
+        constexpr bool is_expression_v = std::is_base_of<VectorExpression<std::decay_t<E>>, std::decay_t<E>>::value;
+
+        // Arithmetic stays lazy only when an operand already is a lazy node; on two Vectors it
+        // returns a Vector, as it always has.
+        template<typename L, typename R>
+        constexpr bool is_lazy_pair_v = is_expression_v<L> && is_expression_v<R> &&
+                                        !(is_vector<std::decay_t<L>>::value && is_vector<std::decay_t<R>>::value);
+
+        // Operands as stored in a node: lvalue Vectors by reference, temporaries and nested nodes
+        // by value, so a node never outlives what it refers to within its full-expression.
+        template<typename E>
+        using expression_operand_t = std::conditional_t<std::is_lvalue_reference<E>::value && is_vector<std::decay_t<E>>::value,
+                                                        const std::decay_t<E>&, const std::decay_t<E>>;
+
+        template<typename T>
+        struct identity { using type = T; };
+
+    } // namespace detail
+
+    // Reads an lvalue Vector inside a lazy expression, e.g. lazy(o) + d * t evaluates in one loop
+    // when assigned.
+    template<size_t Dim, typename T>
+    class VectorRef : public VectorExpression<VectorRef<Dim, T>> {
+    private:
+        const Vector<Dim, T>& m_vector;
+
+    public:
+        using value_type = T;
+        static constexpr size_t dimension = Dim;
+
+        explicit VectorRef(const Vector<Dim, T>& vector) : m_vector(vector) {}
+        value_type eval(size_t i) const { return m_vector[i].value; }
     };
 
     template<size_t Dim, typename T>
-    Vector<Dim, T> operator+(Vector<Dim, T> lhs, const Vector<Dim, T>& rhs) {
-        lhs += rhs;
-        return lhs;
+    VectorRef<Dim, T> lazy(const Vector<Dim, T>& vector) {
+        return VectorRef<Dim, T>(vector);
     }
 
     template<size_t Dim, typename T>
-    Vector<Dim, T> operator-(Vector<Dim, T> lhs, const Vector<Dim, T>& rhs) {
-        lhs -= rhs;
-        return lhs;
+    VectorRef<Dim, T> lazy(const Vector<Dim, T>&& vector) = delete;
+
+    template<typename L, typename R>
+    class VectorSum : public VectorExpression<VectorSum<L, R>> {
+    private:
+        detail::expression_operand_t<L> m_lhs;
+        detail::expression_operand_t<R> m_rhs;
+
+    public:
+        using value_type = typename std::decay_t<L>::value_type;
+        static constexpr size_t dimension = std::decay_t<L>::dimension;
+        static_assert(std::decay_t<L>::dimension == std::decay_t<R>::dimension, "Vector dimensions must match.");
+
+        template<typename A, typename B>
+        VectorSum(A&& lhs, B&& rhs) : m_lhs(std::forward<A>(lhs)), m_rhs(std::forward<B>(rhs)) {}
+        value_type eval(size_t i) const { return m_lhs.eval(i) + m_rhs.eval(i); }
+    };
+
+    template<typename L, typename R>
+    class VectorDifference : public VectorExpression<VectorDifference<L, R>> {
+    private:
+        detail::expression_operand_t<L> m_lhs;
+        detail::expression_operand_t<R> m_rhs;
+
+    public:
+        using value_type = typename std::decay_t<L>::value_type;
+        static constexpr size_t dimension = std::decay_t<L>::dimension;
+        static_assert(std::decay_t<L>::dimension == std::decay_t<R>::dimension, "Vector dimensions must match.");
+
+        template<typename A, typename B>
+        VectorDifference(A&& lhs, B&& rhs) : m_lhs(std::forward<A>(lhs)), m_rhs(std::forward<B>(rhs)) {}
+        value_type eval(size_t i) const { return m_lhs.eval(i) - m_rhs.eval(i); }
+    };
+
+    template<typename E>
+    class VectorScaled : public VectorExpression<VectorScaled<E>> {
+    public:
+        using value_type = typename std::decay_t<E>::value_type;
+        static constexpr size_t dimension = std::decay_t<E>::dimension;
+
+    private:
+        detail::expression_operand_t<E> m_expr;
+        value_type m_scalar;
+
+    public:
+        template<typename A>
+        VectorScaled(A&& expr, value_type scalar) : m_expr(std::forward<A>(expr)), m_scalar(scalar) {}
+        value_type eval(size_t i) const { return m_expr.eval(i) * m_scalar; }
+    };
+
+    template<size_t Dim, typename T>
+    Vector<Dim, T> operator+(const Vector<Dim, T>& lhs, const Vector<Dim, T>& rhs) {
+        Vector<Dim, T> result(lhs);
+        result += rhs;
+        return result;
     }
 
     template<size_t Dim, typename T>
-    Vector<Dim, T> operator*(Vector<Dim, T> vec, const T& scalar) {
-        vec *= scalar;
-        return vec;
+    Vector<Dim, T> operator-(const Vector<Dim, T>& lhs, const Vector<Dim, T>& rhs) {
+        Vector<Dim, T> result(lhs);
+        result -= rhs;
+        return result;
     }
+
     template<size_t Dim, typename T>
-    Vector<Dim, T> operator*(const T& scalar, Vector<Dim, T> vec) {
-        vec *= scalar;
-        return vec;
+    Vector<Dim, T> operator*(const Vector<Dim, T>& vec, const typename detail::identity<T>::type& scalar) {
+        Vector<Dim, T> result(vec);
+        result *= scalar;
+        return result;
     }
 
     template<size_t Dim, typename T>
-    T dot_product(const Vector<Dim, T>& a, const Vector<Dim, T>& b) {
-        T result = 0;
-        for (size_t i = 0; i < Dim; ++i) {
-            result += a[i].value * b[i].value;
+    Vector<Dim, T> operator*(const typename detail::identity<T>::type& scalar, const Vector<Dim, T>& vec) {
+        return vec * scalar;
+    }
+
+    template<typename L, typename R, std::enable_if_t<detail::is_lazy_pair_v<L, R>, int> = 0>
+    VectorSum<L, R> operator+(L&& lhs, R&& rhs) {
+        return VectorSum<L, R>(std::forward<L>(lhs), std::forward<R>(rhs));
+    }
+
+    template<typename L, typename R, std::enable_if_t<detail::is_lazy_pair_v<L, R>, int> = 0>
+    VectorDifference<L, R> operator-(L&& lhs, R&& rhs) {
+        return VectorDifference<L, R>(std::forward<L>(lhs), std::forward<R>(rhs));
+    }
+
+    template<typename E, std::enable_if_t<detail::is_expression_v<E> && !detail::is_vector<std::decay_t<E>>::value, int> = 0>
+    VectorScaled<E> operator*(E&& vec, const typename std::decay_t<E>::value_type& scalar) {
+        return VectorScaled<E>(std::forward<E>(vec), scalar);
+    }
+
+    template<typename E, std::enable_if_t<detail::is_expression_v<E> && !detail::is_vector<std::decay_t<E>>::value, int> = 0>
+    VectorScaled<E> operator*(const typename std::decay_t<E>::value_type& scalar, E&& vec) {
+        return VectorScaled<E>(std::forward<E>(vec), scalar);
+    }
+
+    template<typename E1, typename E2>
+    typename E1::value_type dot_product(const VectorExpression<E1>& a, const VectorExpression<E2>& b) {
+        static_assert(E1::dimension == E2::dimension, "Vector dimensions must match.");
+        typename E1::value_type result = 0;
+        for (size_t i = 0; i < E1::dimension; ++i) {
+            result += a.self().eval(i) * b.self().eval(i);
         }
         return result;
     }
@@ -122,6 +315,11 @@ namespace geom {
         return os;
     }
 
+    template<typename E>
+    std::ostream& operator<<(std::ostream& os, const VectorExpression<E>& expr) {
+        return os << Vector<E::dimension, typename E::value_type>(expr);
+    }
+
     template<size_t Dim, typename T> using Point = Vector<Dim, T>;
 
     template<typename T> using Vector2 = Vector<2, T>;
@@ -135,4 +333,9 @@ namespace geom {
     using Point2d = Point2<double>;
     using Point3d = Point3<double>;
 
+    using Vector2f = Vector2<float>;
+    using Vector3f = Vector3<float>;
+    using Point2f = Point2<float>;
+    using Point3f = Point3<float>;
+
 } // namespace geom
@@ -0,0 +1,260 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <set>
+#include <vector>
+#include "vector.hpp"
+#include "box.hpp"
+#include "segment.hpp"
+#include "algorithms.hpp"
+#include "polygon.hpp"
+#include "parallel.hpp"
+
+namespace geom {
+
+    // Visibility polygon of a viewpoint among segment obstacles, by angular sweep (Asano's
+    // algorithm): endpoints are sorted by angle around the viewpoint and the obstacles crossed by
+    // the sweep ray are kept in a set ordered by distance, so each query costs O(n log n). The
+    // bounds close the polygon; obstacles are clipped to them and must not cross each other
+    // (node them with Dcel::from_segments first if they do).
+    //
+    // compute(viewpoint) keeps the previous angular order and repairs it by insertion sort, which
+    // is close to linear when the viewpoint moves only a little between calls.
+    template<typename T>
+    class VisibilitySweep {
+    public:
+        using point_type = Point<2, T>;
+        using polygon_type = Polygon<2, T>;
+
+    private:
+        struct Obstacle {
+            T x0, y0, x1, y1;
+        };
+
+        static constexpr uint8_t Skip = 2;
+
+        // Per-query state, reused between queries. Coordinates are relative to the viewpoint.
+        struct Scratch {
+            std::vector<uint32_t> order;    // Events (2 * obstacle + endpoint) by angle.
+            std::vector<T> dx, dy;          // Event directions.
+            std::vector<uint8_t> first;     // Endpoint where the sweep enters each obstacle, or Skip.
+        };
+
+        std::vector<Obstacle> m_obstacles;
+        Box<2, T> m_bounds;
+        Scratch m_scratch;
+
+        VisibilitySweep() = default;
+
+    public:
+        static VisibilitySweep from_segments(const std::vector<Segment<2, T>>& obstacles, const Box<2, T>& bounds) {
+            assert(!bounds.is_empty() && "Visibility bounds must not be empty.");
+            VisibilitySweep sweep;
+            sweep.m_bounds = bounds;
+            const T x0 = bounds.min()[0].value, y0 = bounds.min()[1].value;
+            const T x1 = bounds.max()[0].value, y1 = bounds.max()[1].value;
+            sweep.m_obstacles.reserve(obstacles.size() + 4);
+            sweep.m_obstacles.push_back({ x0, y0, x1, y0 });
+            sweep.m_obstacles.push_back({ x1, y0, x1, y1 });
+            sweep.m_obstacles.push_back({ x1, y1, x0, y1 });
+            sweep.m_obstacles.push_back({ x0, y1, x0, y0 });
+            for (const auto& s : obstacles) {
+                if (auto clipped = clip(s, x0, y0, x1, y1)) sweep.m_obstacles.push_back(*clipped);
+            }
+            return sweep;
+        }
+
+        size_t num_obstacles() const { return m_obstacles.size() - 4; }
+        const Box<2, T>& bounds() const { return m_bounds; }
+
+        // Counter-clockwise visibility polygon, or nullopt when the viewpoint is not strictly inside
+        // the bounds.
+        std::optional<polygon_type> compute(const point_type& viewpoint) {
+            return sweep(viewpoint, m_scratch);
+        }
+
+        // out[i] is the visibility polygon of viewpoints[i]. Each thread keeps its own angular order
+        // across consecutive viewpoints, so nearby viewpoints should be adjacent in the input.
+        void compute(const std::vector<point_type>& viewpoints, std::vector<std::optional<polygon_type>>& out, size_t num_threads = 0) const {
+            out.resize(viewpoints.size());
+            parallel_for(viewpoints.size(), [&](size_t begin, size_t end) {
+                Scratch scratch;
+                for (size_t i = begin; i < end; ++i) out[i] = sweep(viewpoints[i], scratch);
+            }, num_threads, 16);
+        }
+
+    private:
+        static std::optional<Obstacle> clip(const Segment<2, T>& s, T x0, T y0, T x1, T y1) {
+            const T px = s.p1()[0].value, py = s.p1()[1].value;
+            const T dx = s.p2()[0].value - px, dy = s.p2()[1].value - py;
+            T t0 = 0, t1 = 1;
+            // Liang-Barsky: each pair is (-delta, distance to the near slab side).
+            const T p[4] = { -dx, dx, -dy, dy };
+            const T q[4] = { px - x0, x1 - px, py - y0, y1 - py };
+            for (int i = 0; i < 4; ++i) {
+                if (p[i] == 0) {
+                    if (q[i] < 0) return std::nullopt;
+                    continue;
+                }
+                const T t = q[i] / p[i];
+                if (p[i] < 0) t0 = std::max(t0, t);
+                else t1 = std::min(t1, t);
+            }
+            if (t0 >= t1) return std::nullopt;
+            return Obstacle{ px + t0 * dx, py + t0 * dy, px + t1 * dx, py + t1 * dy };
+        }
+
+        static T cross(T ax, T ay, T bx, T by) { return ax * by - ay * bx; }
+
+        static int orientation(T ax, T ay, T bx, T by, T cx, T cy) {
+            const T c = cross(bx - ax, by - ay, cx - ax, cy - ay);
+            return (c > 0) - (c < 0);
+        }
+
+        // Angular order starting at the +x axis, counter-clockwise.
+        static bool angle_less(T ax, T ay, T bx, T by) {
+            const bool lower_a = ay < 0 || (ay == 0 && ax < 0);
+            const bool lower_b = by < 0 || (by == 0 && bx < 0);
+            if (lower_a != lower_b) return lower_b;
+            return cross(ax, ay, bx, by) > 0;
+        }
+
+        // Orders the obstacles crossed by one ray from the viewpoint (the origin) by distance. For
+        // non-crossing segments the answer does not depend on which ray is used.
+        struct Closer {
+            const std::vector<T>* sx;
+            const std::vector<T>* sy;
+
+            bool operator()(uint32_t i, uint32_t j) const {
+                if (i == j) return false;
+                T ax = (*sx)[2 * i], ay = (*sy)[2 * i], bx = (*sx)[2 * i + 1], by = (*sy)[2 * i + 1];
+                T cx = (*sx)[2 * j], cy = (*sy)[2 * j], dx = (*sx)[2 * j + 1], dy = (*sy)[2 * j + 1];
+                // Bring a shared endpoint to the front of both segments.
+                if ((bx == cx && by == cy) || (bx == dx && by == dy)) { std::swap(ax, bx); std::swap(ay, by); }
+                if (ax == dx && ay == dy) { std::swap(cx, dx); std::swap(cy, dy); }
+                if (ax == cx && ay == cy) {
+                    if ((bx == dx && by == dy) || orientation(0, 0, ax, ay, dx, dy) != orientation(0, 0, ax, ay, bx, by)) return false;
+                    return orientation(ax, ay, bx, by, dx, dy) != orientation(ax, ay, bx, by, 0, 0);
+                }
+                const int cda = orientation(cx, cy, dx, dy, ax, ay);
+                const int cdb = orientation(cx, cy, dx, dy, bx, by);
+                if (cda == 0 && cdb == 0) {
+                    return ax * ax + ay * ay < cx * cx + cy * cy;
+                }
+                if (cda == cdb || cda == 0 || cdb == 0) {
+                    const int cdo = orientation(cx, cy, dx, dy, 0, 0);
+                    return cdo == cda || cdo == cdb;
+                }
+                return orientation(ax, ay, bx, by, 0, 0) != orientation(ax, ay, bx, by, cx, cy);
+            }
+        };
+
+        std::optional<polygon_type> sweep(const point_type& viewpoint, Scratch& s) const {
+            const T vx = viewpoint[0].value, vy = viewpoint[1].value;
+            if (!(vx > m_bounds.min()[0].value && vx < m_bounds.max()[0].value && vy > m_bounds.min()[1].value && vy < m_bounds.max()[1].value)) {
+                return std::nullopt;
+            }
+
+            const size_t n = m_obstacles.size();
+            s.dx.resize(2 * n);
+            s.dy.resize(2 * n);
+            s.first.resize(n);
+            // Oriented copies: sx/sy[2i] is where the sweep enters obstacle i, [2i + 1] where it leaves.
+            std::vector<T> sx(2 * n), sy(2 * n);
+            for (size_t i = 0; i < n; ++i) {
+                const Obstacle& o = m_obstacles[i];
+                s.dx[2 * i] = o.x0 - vx;
+                s.dy[2 * i] = o.y0 - vy;
+                s.dx[2 * i + 1] = o.x1 - vx;
+                s.dy[2 * i + 1] = o.y1 - vy;
+                const T c = cross(s.dx[2 * i], s.dy[2 * i], s.dx[2 * i + 1], s.dy[2 * i + 1]);
+                // Obstacles seen edge-on cover no angle and never block the sweep.
+                s.first[i] = c > 0 ? 0 : (c < 0 ? 1 : Skip);
+                const size_t a = 2 * i + (s.first[i] == 1 ? 1 : 0), b = 2 * i + (s.first[i] == 1 ? 0 : 1);
+                sx[2 * i] = s.dx[a];
+                sy[2 * i] = s.dy[a];
+                sx[2 * i + 1] = s.dx[b];
+                sy[2 * i + 1] = s.dy[b];
+            }
+
+            auto less = [&](uint32_t a, uint32_t b) { return angle_less(s.dx[a], s.dy[a], s.dx[b], s.dy[b]); };
+            if (s.order.size() != 2 * n) {
+                s.order.resize(2 * n);
+                std::iota(s.order.begin(), s.order.end(), 0u);
+                std::sort(s.order.begin(), s.order.end(), less);
+            }
+            else {
+                for (size_t k = 1; k < s.order.size(); ++k) {
+                    const uint32_t e = s.order[k];
+                    size_t j = k;
+                    for (; j > 0 && less(e, s.order[j - 1]); --j) s.order[j] = s.order[j - 1];
+                    s.order[j] = e;
+                }
+            }
+
+            using ActiveSet = std::set<uint32_t, Closer>;
+            ActiveSet active(Closer{ &sx, &sy });
+            std::vector<typename ActiveSet::iterator> handles(n, active.end());
+            for (uint32_t i = 0; i < n; ++i) {
+                // Obstacles straddling the +x axis are crossed by the first ray.
+                if (s.first[i] != Skip && angle_less(sx[2 * i + 1], sy[2 * i + 1], sx[2 * i], sy[2 * i])) {
+                    handles[i] = active.insert(i).first;
+                }
+            }
+
+            std::vector<point_type> vertices;
+            auto emit = [&](uint32_t i, T rx, T ry) {
+                // Where the ray through (rx, ry) meets obstacle i.
+                const T ex = sx[2 * i + 1] - sx[2 * i], ey = sy[2 * i + 1] - sy[2 * i];
+                const T t = cross(sx[2 * i], sy[2 * i], ex, ey) / cross(rx, ry, ex, ey);
+                const point_type p(vx + t * rx, vy + t * ry);
+                if (vertices.empty() || !(vertices.back() == p)) vertices.push_back(p);
+            };
+
+            for (size_t k = 0; k < s.order.size();) {
+                size_t group_end = k + 1;
+                while (group_end < s.order.size() && !less(s.order[k], s.order[group_end])) ++group_end;
+
+                const uint32_t before = active.empty() ? std::numeric_limits<uint32_t>::max() : *active.begin();
+                for (size_t g = k; g < group_end; ++g) {
+                    const uint32_t e = s.order[g], i = e / 2;
+                    if (s.first[i] != Skip && e % 2 != s.first[i] && handles[i] != active.end()) {
+                        active.erase(handles[i]);
+                        handles[i] = active.end();
+                    }
+                }
+                for (size_t g = k; g < group_end; ++g) {
+                    const uint32_t e = s.order[g], i = e / 2;
+                    if (s.first[i] != Skip && e % 2 == s.first[i]) handles[i] = active.insert(i).first;
+                }
+                const uint32_t after = *active.begin();
+                if (before != after) {
+                    const T rx = s.dx[s.order[k]], ry = s.dy[s.order[k]];
+                    emit(before, rx, ry);
+                    emit(after, rx, ry);
+                }
+                k = group_end;
+            }
+
+            if (vertices.size() > 1 && vertices.front() == vertices.back()) vertices.pop_back();
+            if (vertices.size() < 3) {
+                return std::nullopt;
+            }
+            return polygon_type(vertices);
+        }
+    };
+
+    using VisibilitySweep2d = VisibilitySweep<double>;
+
+    template<typename T>
+    std::optional<Polygon<2, T>> visibility_polygon(const Point<2, T>& viewpoint, const std::vector<Segment<2, T>>& obstacles, const Box<2, T>& bounds) {
+        return VisibilitySweep<T>::from_segments(obstacles, bounds).compute(viewpoint);
+    }
+
+
+} // namespace geom
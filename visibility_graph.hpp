@@ -0,0 +1,440 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <queue>
+#include <utility>
+#include <vector>
+#include "vector.hpp"
+#include "box.hpp"
+#include "algorithms.hpp"
+#include "polygon.hpp"
+#include "polyline.hpp"
+#include "parallel.hpp"
+
+namespace geom {
+
+    // Shortest Euclidean paths among polygonal obstacles. Obstacles are simple polygons of either
+    // orientation that must not overlap. Paths may run along obstacle boundaries,
+    // and also between obstacles that touch.
+    //
+    // The graph nodes are the convex corners of the obstacles, the only places a shortest path
+    // turns. A node's edges are found the first time A* expands it and are kept for later queries,
+    // so repeated queries on the same obstacles only pay for the search and for linking the start
+    // and goal. Candidate edges must be tangent to the obstacles at both ends, and the survivors
+    // are tested for visibility against the obstacle edges in the grid cells the segment crosses.
+    template<typename T>
+    class VisibilityGraph {
+    public:
+        using point_type = Point<2, T>;
+        using polyline_type = Polyline<2, T>;
+
+    private:
+        static constexpr uint32_t Invalid = std::numeric_limits<uint32_t>::max();
+
+        // Obstacle vertices with their ring neighbours, counter-clockwise. Edge i runs from vertex
+        // i to vertex next.
+        struct Vertex {
+            T x, y;
+            uint32_t prev, next;
+        };
+
+        struct Neighbor {
+            uint32_t node;
+            T length;
+        };
+
+        // Per-thread state of the visibility test: edges already tested for the current segment.
+        struct Scratch {
+            std::vector<uint32_t> seen;
+            uint32_t stamp = 0;
+        };
+
+        // Per-query state of the search. Nodes m and m + 1 are the start and the goal.
+        struct Search {
+            std::vector<T> cost;
+            std::vector<uint32_t> parent;
+            std::vector<uint32_t> reached;  // Query stamp when cost and parent are valid.
+            std::vector<uint8_t> closed;
+            std::vector<Neighbor> start_neighbors;
+            uint32_t stamp = 0;
+        };
+
+        std::vector<Vertex> m_vertices;
+        std::vector<uint32_t> m_obstacle_start;     // Vertices of obstacle k are [start[k], start[k + 1]).
+        std::vector<Box<2, T>> m_obstacle_bounds;
+        std::vector<uint32_t> m_nodes;              // Node -> vertex.
+        T m_tolerance = 0;
+
+        // Edges per grid cell in CSR form.
+        T m_x0 = 0, m_y0 = 0, m_inv_cell = 0;
+        size_t m_cells_x = 1, m_cells_y = 1;
+        std::vector<uint32_t> m_cell_start;
+        std::vector<uint32_t> m_cell_edges;
+
+        std::vector<std::vector<Neighbor>> m_neighbors;
+        std::vector<uint8_t> m_expanded;
+        size_t m_num_expanded = 0;
+        Scratch m_scratch;
+        Search m_search;
+
+        VisibilityGraph() = default;
+
+    public:
+        static VisibilityGraph from_polygons(const std::vector<Polygon<2, T>>& obstacles) {
+            VisibilityGraph graph;
+            T magnitude = 1;
+            graph.m_obstacle_start.push_back(0);
+            for (const auto& polygon : obstacles) {
+                std::vector<point_type> ring;
+                for (const auto& p : polygon.vertices()) {
+                    if (ring.empty() || !(ring.back() == p)) ring.push_back(p);
+                }
+                while (ring.size() > 1 && ring.back() == ring.front()) ring.pop_back();
+                if (ring.size() < 3) continue;
+                if (Polygon<2, T>(ring).moments(1).signed_area < 0) std::reverse(ring.begin(), ring.end());
+
+                const uint32_t first = static_cast<uint32_t>(graph.m_vertices.size());
+                const uint32_t count = static_cast<uint32_t>(ring.size());
+                for (uint32_t i = 0; i < count; ++i) {
+                    const T x = ring[i][0].value, y = ring[i][1].value;
+                    graph.m_vertices.push_back({ x, y, first + (i + count - 1) % count, first + (i + 1) % count });
+                    magnitude = std::max({ magnitude, std::abs(x), std::abs(y) });
+                }
+                graph.m_obstacle_start.push_back(first + count);
+                graph.m_obstacle_bounds.push_back(Box<2, T>::from_points(ring));
+            }
+            graph.m_tolerance = Coord<T>::Epsilon * magnitude;
+
+            for (uint32_t v = 0; v < graph.m_vertices.size(); ++v) {
+                const Vertex& a = graph.m_vertices[graph.m_vertices[v].prev];
+                const Vertex& b = graph.m_vertices[v];
+                const Vertex& c = graph.m_vertices[b.next];
+                if (cross(b.x - a.x, b.y - a.y, c.x - b.x, c.y - b.y) > 0) graph.m_nodes.push_back(v);
+            }
+            graph.m_neighbors.resize(graph.m_nodes.size());
+            graph.m_expanded.assign(graph.m_nodes.size(), 0);
+            graph.build_grid();
+            return graph;
+        }
+
+        size_t num_nodes() const { return m_nodes.size(); }
+        size_t num_expanded() const { return m_num_expanded; }
+
+        // Computes the edges of every node up front, so later queries never extend the graph.
+        void build(size_t num_threads = 0) {
+            parallel_for(m_nodes.size(), [&](size_t begin, size_t end) {
+                Scratch scratch;
+                for (size_t u = begin; u < end; ++u) {
+                    if (!m_expanded[u]) m_neighbors[u] = find_neighbors(u, scratch);
+                }
+            }, num_threads, 16);
+            std::fill(m_expanded.begin(), m_expanded.end(), uint8_t(1));
+            m_num_expanded = m_nodes.size();
+        }
+
+        // True when the segment from a to b does not pass through the interior of an obstacle.
+        bool visible(const point_type& a, const point_type& b) {
+            return visible(a[0].value, a[1].value, b[0].value, b[1].value, m_scratch);
+        }
+
+        // Shortest path from start to goal by A*, or nullopt when either point is inside an
+        // obstacle or the goal cannot be reached.
+        std::optional<polyline_type> shortest_path(const point_type& start, const point_type& goal) {
+            const T sx = start[0].value, sy = start[1].value;
+            const T gx = goal[0].value, gy = goal[1].value;
+            if (inside_obstacle(sx, sy) || inside_obstacle(gx, gy)) {
+                return std::nullopt;
+            }
+            if (visible(sx, sy, gx, gy, m_scratch)) {
+                return polyline_type(std::vector<point_type>{ start, goal });
+            }
+
+            const uint32_t m = static_cast<uint32_t>(m_nodes.size());
+            const uint32_t start_id = m, goal_id = m + 1;
+            Search& s = m_search;
+            if (s.cost.size() != m + 2) {
+                s.cost.assign(m + 2, T(0));
+                s.parent.assign(m + 2, Invalid);
+                s.reached.assign(m + 2, 0);
+                s.closed.assign(m + 2, 0);
+            }
+            if (++s.stamp == 0) {
+                std::fill(s.reached.begin(), s.reached.end(), 0u);
+                s.stamp = 1;
+            }
+            std::fill(s.closed.begin(), s.closed.end(), uint8_t(0));
+
+            s.start_neighbors.clear();
+            for (uint32_t w = 0; w < m; ++w) {
+                const Vertex& b = m_vertices[m_nodes[w]];
+                if (tangent(m_nodes[w], sx, sy) && visible(sx, sy, b.x, b.y, m_scratch)) {
+                    s.start_neighbors.push_back({ w, std::hypot(b.x - sx, b.y - sy) });
+                }
+            }
+
+            using Entry = std::pair<T, uint32_t>;
+            std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+            auto relax = [&](uint32_t from, uint32_t to, T length, T tx, T ty) {
+                const T cost = s.cost[from] + length;
+                if (s.reached[to] == s.stamp && s.cost[to] <= cost) return;
+                s.reached[to] = s.stamp;
+                s.cost[to] = cost;
+                s.parent[to] = from;
+                open.push({ cost + std::hypot(gx - tx, gy - ty), to });
+            };
+
+            s.reached[start_id] = s.stamp;
+            s.cost[start_id] = 0;
+            s.parent[start_id] = Invalid;
+            open.push({ std::hypot(gx - sx, gy - sy), start_id });
+            while (!open.empty()) {
+                const uint32_t u = open.top().second;
+                open.pop();
+                if (s.closed[u]) continue;
+                s.closed[u] = 1;
+                if (u == goal_id) break;
+
+                const std::vector<Neighbor>& neighbors = u == start_id ? s.start_neighbors : expand(u);
+                for (const Neighbor& nb : neighbors) {
+                    if (s.closed[nb.node]) continue;
+                    const Vertex& b = m_vertices[m_nodes[nb.node]];
+                    relax(u, nb.node, nb.length, b.x, b.y);
+                }
+                if (u != start_id) {
+                    const Vertex& a = m_vertices[m_nodes[u]];
+                    if (tangent(m_nodes[u], gx, gy) && visible(a.x, a.y, gx, gy, m_scratch)) {
+                        relax(u, goal_id, std::hypot(gx - a.x, gy - a.y), gx, gy);
+                    }
+                }
+            }
+            if (!s.closed[goal_id]) {
+                return std::nullopt;
+            }
+
+            std::vector<point_type> points;
+            for (uint32_t u = goal_id; u != Invalid; u = s.parent[u]) {
+                if (u == goal_id) points.push_back(goal);
+                else if (u == start_id) points.push_back(start);
+                else points.push_back(point_type(m_vertices[m_nodes[u]].x, m_vertices[m_nodes[u]].y));
+            }
+            std::reverse(points.begin(), points.end());
+            return polyline_type(points);
+        }
+
+    private:
+        static T cross(T ax, T ay, T bx, T by) { return ax * by - ay * bx; }
+
+        // Sign of the side of (px, py) relative to the directed line through a with direction
+        // (dx, dy) of length len; within the tolerance of the line counts as on it.
+        int side(T ax, T ay, T dx, T dy, T len, T px, T py) const {
+            const T c = cross(dx, dy, px - ax, py - ay) / len;
+            return (c > m_tolerance) - (c < -m_tolerance);
+        }
+
+        size_t cell_x(T x) const {
+            return std::min(m_cells_x - 1, static_cast<size_t>(std::max(T(0), (x - m_x0) * m_inv_cell)));
+        }
+
+        size_t cell_y(T y) const {
+            return std::min(m_cells_y - 1, static_cast<size_t>(std::max(T(0), (y - m_y0) * m_inv_cell)));
+        }
+
+        void build_grid() {
+            const size_t n = m_vertices.size();
+            if (n == 0) {
+                m_cell_start.assign(2, 0);
+                return;
+            }
+            T x0 = m_vertices[0].x, y0 = m_vertices[0].y, x1 = x0, y1 = y0, mean_extent = 0;
+            for (const Vertex& v : m_vertices) {
+                const Vertex& w = m_vertices[v.next];
+                x0 = std::min(x0, v.x);
+                y0 = std::min(y0, v.y);
+                x1 = std::max(x1, v.x);
+                y1 = std::max(y1, v.y);
+                mean_extent += std::max(std::abs(w.x - v.x), std::abs(w.y - v.y));
+            }
+            const T width = x1 - x0, height = y1 - y0;
+            const T cell = std::max({ mean_extent / T(n), std::sqrt(width * height / T(n)), std::max(width, height) / T(4096), m_tolerance });
+            m_x0 = x0;
+            m_y0 = y0;
+            m_inv_cell = T(1) / cell;
+            m_cells_x = std::max<size_t>(1, static_cast<size_t>(std::ceil(width / cell)));
+            m_cells_y = std::max<size_t>(1, static_cast<size_t>(std::ceil(height / cell)));
+
+            m_cell_start.assign(m_cells_x * m_cells_y + 1, 0);
+            for (int pass = 0; pass < 2; ++pass) {
+                std::vector<uint32_t> fill;
+                if (pass == 1) {
+                    for (size_t c = 0; c + 1 < m_cell_start.size(); ++c) m_cell_start[c + 1] += m_cell_start[c];
+                    m_cell_edges.resize(m_cell_start.back());
+                    fill.assign(m_cell_start.begin(), m_cell_start.end() - 1);
+                }
+                for (uint32_t e = 0; e < n; ++e) {
+                    const Vertex& v = m_vertices[e];
+                    const Vertex& w = m_vertices[v.next];
+                    const size_t cx1 = cell_x(std::max(v.x, w.x) + m_tolerance), cy1 = cell_y(std::max(v.y, w.y) + m_tolerance);
+                    for (size_t y = cell_y(std::min(v.y, w.y) - m_tolerance); y <= cy1; ++y) {
+                        for (size_t x = cell_x(std::min(v.x, w.x) - m_tolerance); x <= cx1; ++x) {
+                            if (pass == 0) ++m_cell_start[y * m_cells_x + x + 1];
+                            else m_cell_edges[fill[y * m_cells_x + x]++] = e;
+                        }
+                    }
+                }
+            }
+        }
+
+        // True when direction (dx, dy) leaves vertex v strictly into its obstacle.
+        bool enters(uint32_t v, T dx, T dy) const {
+            const Vertex& p = m_vertices[v];
+            const Vertex& a = m_vertices[p.prev];
+            const Vertex& b = m_vertices[p.next];
+            const T e0x = a.x - p.x, e0y = a.y - p.y, e1x = b.x - p.x, e1y = b.y - p.y;
+            const T dl = std::hypot(dx, dy), l0 = std::hypot(e0x, e0y), l1 = std::hypot(e1x, e1y);
+            const T after_e1 = cross(e1x, e1y, dx, dy) / (l1 * dl);
+            const T before_e0 = cross(dx, dy, e0x, e0y) / (dl * l0);
+            if (cross(e1x, e1y, e0x, e0y) > 0) {
+                return after_e1 > Coord<T>::Epsilon && before_e0 > Coord<T>::Epsilon;
+            }
+            // Reflex or straight: the outside is the sector from e0 to e1, at most a half-turn.
+            return !(before_e0 <= Coord<T>::Epsilon && after_e1 <= Coord<T>::Epsilon);
+        }
+
+        // Whether a shortest path arriving from (ox, oy) can turn at vertex v: both ring
+        // neighbours lie on the same side of the line through it.
+        bool tangent(uint32_t v, T ox, T oy) const {
+            const Vertex& p = m_vertices[v];
+            const T dx = p.x - ox, dy = p.y - oy, len = std::hypot(dx, dy);
+            if (len <= m_tolerance) {
+                return false;
+            }
+            const int a = side(ox, oy, dx, dy, len, m_vertices[p.prev].x, m_vertices[p.prev].y);
+            const int b = side(ox, oy, dx, dy, len, m_vertices[p.next].x, m_vertices[p.next].y);
+            return a * b >= 0;
+        }
+
+        // A segment may touch obstacles and run along their edges; it is blocked when it crosses
+        // an edge, or leaves a vertex or an edge it touches into the obstacle.
+        bool visible(T ax, T ay, T bx, T by, Scratch& scratch) const {
+            const T dx = bx - ax, dy = by - ay, len = std::hypot(dx, dy);
+            if (len <= m_tolerance || m_vertices.empty()) {
+                return true;
+            }
+            if (scratch.seen.size() != m_vertices.size()) scratch.seen.assign(m_vertices.size(), 0);
+            if (++scratch.stamp == 0) {
+                std::fill(scratch.seen.begin(), scratch.seen.end(), 0u);
+                scratch.stamp = 1;
+            }
+
+            auto blocks = [&](uint32_t e) {
+                const Vertex& p = m_vertices[e];
+                const Vertex& q = m_vertices[p.next];
+                const T ex = q.x - p.x, ey = q.y - p.y, el = std::hypot(ex, ey);
+                const int sp = side(ax, ay, dx, dy, len, p.x, p.y), sq = side(ax, ay, dx, dy, len, q.x, q.y);
+                const int sa = side(p.x, p.y, ex, ey, el, ax, ay), sb = side(p.x, p.y, ex, ey, el, bx, by);
+                if (sp * sq < 0 && sa * sb < 0) {
+                    return true;
+                }
+                if (sp == 0) {
+                    // Vertex p on the segment: the segment must not leave it into the obstacle.
+                    const T t = ((p.x - ax) * dx + (p.y - ay) * dy) / len;
+                    if (t >= -m_tolerance && t <= len + m_tolerance) {
+                        if (t < len - m_tolerance && enters(e, dx, dy)) return true;
+                        if (t > m_tolerance && enters(e, -dx, -dy)) return true;
+                    }
+                }
+                // An endpoint inside the edge: the segment must leave it to the right.
+                const T turn = cross(ex, ey, dx, dy) / (el * len);
+                if (sa == 0 && turn > Coord<T>::Epsilon) {
+                    const T t = ((ax - p.x) * ex + (ay - p.y) * ey) / el;
+                    if (t > m_tolerance && t < el - m_tolerance) return true;
+                }
+                if (sb == 0 && turn < -Coord<T>::Epsilon) {
+                    const T t = ((bx - p.x) * ex + (by - p.y) * ey) / el;
+                    if (t > m_tolerance && t < el - m_tolerance) return true;
+                }
+                return false;
+            };
+
+            // Cells row by row, each row over the x range the segment spans inside it.
+            const T pad = m_tolerance, cell = T(1) / m_inv_cell;
+            const T min_y = std::min(ay, by), max_y = std::max(ay, by);
+            const size_t y1 = cell_y(max_y + pad);
+            for (size_t y = cell_y(min_y - pad); y <= y1; ++y) {
+                T xa = ax, xb = bx;
+                if (std::abs(dy) > m_tolerance) {
+                    const T lo = std::max(min_y, m_y0 + T(y) * cell - pad), hi = std::min(max_y, m_y0 + T(y + 1) * cell + pad);
+                    const T ta = std::clamp((lo - ay) / dy, T(0), T(1)), tb = std::clamp((hi - ay) / dy, T(0), T(1));
+                    xa = ax + ta * dx;
+                    xb = ax + tb * dx;
+                }
+                const size_t x1 = cell_x(std::max(xa, xb) + pad);
+                for (size_t x = cell_x(std::min(xa, xb) - pad); x <= x1; ++x) {
+                    const size_t c = y * m_cells_x + x;
+                    for (uint32_t k = m_cell_start[c]; k < m_cell_start[c + 1]; ++k) {
+                        const uint32_t e = m_cell_edges[k];
+                        if (scratch.seen[e] == scratch.stamp) continue;
+                        scratch.seen[e] = scratch.stamp;
+                        if (blocks(e)) return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        // Strictly inside, so points on an obstacle boundary may start or end a path.
+        bool inside_obstacle(T px, T py) const {
+            for (size_t k = 0; k < m_obstacle_bounds.size(); ++k) {
+                const Box<2, T>& box = m_obstacle_bounds[k];
+                if (px < box.min()[0].value || px > box.max()[0].value || py < box.min()[1].value || py > box.max()[1].value) continue;
+                bool inside = false;
+                for (uint32_t e = m_obstacle_start[k]; e < m_obstacle_start[k + 1]; ++e) {
+                    const Vertex& p = m_vertices[e];
+                    const Vertex& q = m_vertices[p.next];
+                    const T ex = q.x - p.x, ey = q.y - p.y, el = std::hypot(ex, ey);
+                    const T t = ((px - p.x) * ex + (py - p.y) * ey) / el;
+                    if (t >= -m_tolerance && t <= el + m_tolerance && side(p.x, p.y, ex, ey, el, px, py) == 0) {
+                        inside = false;
+                        break;
+                    }
+                    if ((p.y > py) != (q.y > py) && p.x + (py - p.y) * ex / ey > px) inside = !inside;
+                }
+                if (inside) return true;
+            }
+            return false;
+        }
+
+        std::vector<Neighbor> find_neighbors(size_t u, Scratch& scratch) const {
+            std::vector<Neighbor> neighbors;
+            const uint32_t vu = m_nodes[u];
+            const Vertex& a = m_vertices[vu];
+            for (uint32_t w = 0; w < m_nodes.size(); ++w) {
+                const uint32_t vw = m_nodes[w];
+                if (w == u) continue;
+                const Vertex& b = m_vertices[vw];
+                if (!tangent(vu, b.x, b.y) || !tangent(vw, a.x, a.y)) continue;
+                if (visible(a.x, a.y, b.x, b.y, scratch)) neighbors.push_back({ w, std::hypot(b.x - a.x, b.y - a.y) });
+            }
+            return neighbors;
+        }
+
+        const std::vector<Neighbor>& expand(uint32_t u) {
+            if (!m_expanded[u]) {
+                m_neighbors[u] = find_neighbors(u, m_scratch);
+                m_expanded[u] = 1;
+                ++m_num_expanded;
+            }
+            return m_neighbors[u];
+        }
+    };
+
+    using VisibilityGraph2d = VisibilityGraph<double>;
+
+
+} // namespace geom